@@ -0,0 +1,719 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// DESIGN
+//
+// Half-edge and (for unconstrained verts) full-edge collapses ordered by a binary heap with lazy
+// invalidation (per-vertex version numbers). Full-edge collapse positions are restricted to the edge
+// segment so that UVs and morph deltas can be interpolated with the same parameter.
+//
+// Each tri corner has a 'key' made from its surface and UV indices. A vertex with more than one key
+// lies on a UV seam or a surface boundary; such a vertex can only be collapsed along an edge which
+// maps every one of its keys to a key of the kept vertex, which restricts it to sliding along its
+// seam without tearing or stretching any UV island.
+//
+
+#include "stdafx.h"
+
+#include "Fg3dDecimate.hpp"
+#include "Fg3dMeshOps.hpp"
+#include "FgCommand.hpp"
+#include "FgApproxEqual.hpp"
+#include "FgTestUtils.hpp"
+#include "FgBounds.hpp"
+#include "Fg3dMeshIo.hpp"
+
+using namespace std;
+
+namespace Fg {
+
+namespace {
+
+// Symmetric quadric error form Q(p) = p^T A p + 2 b^T p + c:
+struct  Quadric
+{
+    double          a00=0,a01=0,a02=0,a11=0,a12=0,a22=0,
+                    b0=0,b1=0,b2=0,
+                    c=0;
+
+    Quadric() {}
+
+    // Weighted squared distance to the plane n^T p + d = 0, where 'n' is unit length:
+    Quadric(Vec3D n,double d,double w) :
+        a00(w*n[0]*n[0]), a01(w*n[0]*n[1]), a02(w*n[0]*n[2]),
+        a11(w*n[1]*n[1]), a12(w*n[1]*n[2]), a22(w*n[2]*n[2]),
+        b0(w*n[0]*d), b1(w*n[1]*d), b2(w*n[2]*d),
+        c(w*d*d)
+    {}
+
+    void
+    operator+=(Quadric const & r)
+    {
+        a00 += r.a00; a01 += r.a01; a02 += r.a02;
+        a11 += r.a11; a12 += r.a12; a22 += r.a22;
+        b0 += r.b0; b1 += r.b1; b2 += r.b2;
+        c += r.c;
+    }
+
+    Vec3D
+    mulA(Vec3D v) const
+    {
+        return Vec3D(
+            a00*v[0] + a01*v[1] + a02*v[2],
+            a01*v[0] + a11*v[1] + a12*v[2],
+            a02*v[0] + a12*v[1] + a22*v[2]);
+    }
+
+    double
+    dotB(Vec3D v) const
+    {return b0*v[0] + b1*v[1] + b2*v[2]; }
+
+    double
+    eval(Vec3D p) const
+    {return cDot(p,mulA(p)) + 2.0*dotB(p) + c; }
+};
+
+uint const          noUv = numeric_limits<uint>::max();
+uchar const         vertLocked = 1,
+                    vertBorder = 2,
+                    vertRemoved = 4;
+
+struct  DTri
+{
+    Vec3UI          pos;
+    Vec3UI          uv;             // 'noUv' if the surface has no UVs
+    uint            surf;
+    bool            valid;
+
+    int
+    find(uint vv) const
+    {
+        for (int ii=0; ii<3; ++ii)
+            if (pos[ii] == vv)
+                return ii;
+        return -1;
+    }
+
+    uint64
+    key(int corner) const
+    {return (uint64(surf) << 32) | uint64(uv[corner]); }
+};
+
+struct  Collapse
+{
+    float           cost;
+    uint            rem;            // Vertex removed
+    uint            keep;           // Vertex kept (moved to the collapse position)
+    float           t;              // Collapse position along the edge from 'rem' (0) to 'keep' (1)
+    uint            remVer;
+    uint            keepVer;
+
+    bool
+    operator>(Collapse const & rhs) const
+    {return (cost > rhs.cost); }
+};
+
+typedef Svec<pair<uint64,uint64> >  KeyMap;     // Corner keys of removed vert to those of kept vert
+
+struct  Decimator
+{
+    DecimateOptions     opts;
+    Vec3Fs              verts;
+    Vec2Fs              uvs;
+    Svec<Vec3Fs>        morphDeltas;    // By morph (delta then target), 1-1 with 'verts'
+    Svec<DTri>          tris;           // Over all surfaces in order
+    Uints               surfTriStart;   // Index of first tri of each surface in 'tris'
+    Svec<Uints>         vertTris;       // Valid tris using each vert
+    Svec<Quadric>       quadrics;
+    Doubles             morphErrs;      // Morph error accumulated by previous collapses into each vert
+    Uchars              flags;
+    Uints               versions;
+    Uchars              uvShared;       // UV is used by more than one vertex
+    size_t              numTris = 0;    // Valid tris remaining
+    Svec<Collapse>      heap;           // Min-heap on cost
+
+    Decimator(Mesh const & mesh,DecimateOptions const & options);
+
+    void
+    keys(uint vv,Svec<uint64> & ret) const
+    {
+        ret.clear();
+        for (uint tt : vertTris[vv]) {
+            DTri const &        tri = tris[tt];
+            uint64              key = tri.key(tri.find(vv));
+            if (!contains(ret,key))
+                ret.push_back(key);
+        }
+    }
+
+    // Can move freely without changing any seam or boundary:
+    bool
+    isFree(uint vv,Svec<uint64> const & ks) const
+    {
+        if ((flags[vv] & (vertLocked | vertBorder)) || (ks.size() != 1))
+            return false;
+        uint                uv = uint(ks[0] & 0xFFFFFFFF);
+        return ((uv == noUv) || (uvShared[uv] == 0));
+    }
+
+    bool
+    isBorderEdge(uint v0,uint v1) const
+    {
+        uint                cnt = 0;
+        for (uint tt : vertTris[v0])
+            if (tris[tt].find(v1) >= 0)
+                ++cnt;
+        return (cnt == 1);
+    }
+
+    // Can 'rem' slide into 'keep' (a half-edge collapse) while keeping boundaries and seams ?
+    bool
+    canSlide(uint rem,uint keep) const
+    {
+        if (flags[rem] & vertLocked)
+            return false;
+        if ((flags[rem] & vertBorder) && !isBorderEdge(rem,keep))
+            return false;
+        KeyMap              km;
+        return mapKeys(rem,keep,km);
+    }
+
+    double
+    morphDiffSqr(uint v0,uint v1) const
+    {
+        double              ret = 0.0;
+        for (Vec3Fs const & md : morphDeltas)
+            ret += (md[v0]-md[v1]).mag();
+        return ret;
+    }
+
+    // Map each corner key of 'rem' to the corner key of 'keep' in the tris sharing their edge.
+    // Returns false if any key of 'rem' is not mapped or is mapped inconsistently:
+    bool
+    mapKeys(uint rem,uint keep,KeyMap & ret) const;
+
+    Uints
+    neighbours(uint vv) const;
+
+    bool
+    evaluate(uint v0,uint v1,Collapse & ret) const;
+
+    void
+    push(uint v0,uint v1)
+    {
+        Collapse            c;
+        if (evaluate(v0,v1,c)) {
+            heap.push_back(c);
+            push_heap(heap.begin(),heap.end(),greater<Collapse>());
+        }
+    }
+
+    bool
+    isValid(Collapse const & c,Vec3F pos,KeyMap & keyMap) const;
+
+    void
+    collapse(Collapse const & c,Vec3F pos,KeyMap const & keyMap);
+
+    void
+    run(size_t targetTris);
+
+    Mesh
+    result(Mesh const & in) const;
+};
+
+Decimator::Decimator(Mesh const & mesh,DecimateOptions const & options) :
+    opts(options), verts(mesh.verts), uvs(mesh.uvs)
+{
+    size_t              numVerts = verts.size();
+    for (Morph const & morph : mesh.deltaMorphs) {
+        FGASSERT(morph.verts.size() == numVerts);
+        morphDeltas.push_back(morph.verts);
+    }
+    for (IndexedMorph const & morph : mesh.targetMorphs) {
+        Vec3Fs              deltas(numVerts,Vec3F(0));
+        for (size_t ii=0; ii<morph.baseInds.size(); ++ii)
+            deltas[morph.baseInds[ii]] = morph.verts[ii] - verts[morph.baseInds[ii]];
+        morphDeltas.push_back(deltas);
+    }
+    flags.resize(numVerts,0);
+    versions.resize(numVerts,0);
+    vertTris.resize(numVerts);
+    quadrics.resize(numVerts);
+    morphErrs.resize(numVerts,0.0);
+    for (MarkedVert const & mv : mesh.markedVerts)
+        flags[mv.idx] |= vertLocked;
+    for (size_t ss=0; ss<mesh.surfaces.size(); ++ss) {
+        Surf const &        surf = mesh.surfaces[ss];
+        Tris                ts = surf.asTris();
+        bool                hasUvs = !ts.empty() && ts.hasUvs();
+        surfTriStart.push_back(uint(tris.size()));
+        for (size_t tt=0; tt<ts.size(); ++tt) {
+            Vec3UI              p = ts.posInds[tt];
+            DTri                tri {p,hasUvs ? ts.uvInds[tt] : Vec3UI(noUv),uint(ss),true};
+            if ((p[0] == p[1]) || (p[1] == p[2]) || (p[2] == p[0]))
+                tri.valid = false;
+            tris.push_back(tri);
+        }
+        // Preserve tris referenced by surface points by locking their verts:
+        for (SurfPoint const & sp : surf.surfPoints)
+            for (uint vv : ts.posInds[sp.triEquivIdx].m)
+                flags[vv] |= vertLocked;
+    }
+    surfTriStart.push_back(uint(tris.size()));
+    Svec<pair<uint,uint> >  uvUses;
+    for (size_t tt=0; tt<tris.size(); ++tt) {
+        DTri const &        tri = tris[tt];
+        if (!tri.valid)
+            continue;
+        ++numTris;
+        for (uint ii=0; ii<3; ++ii) {
+            vertTris[tri.pos[ii]].push_back(uint(tt));
+            if (tri.uv[ii] != noUv)
+                uvUses.push_back(make_pair(tri.uv[ii],tri.pos[ii]));
+        }
+    }
+    uvShared.resize(uvs.size(),0);
+    sort(uvUses.begin(),uvUses.end());
+    for (size_t ii=1; ii<uvUses.size(); ++ii)
+        if ((uvUses[ii].first == uvUses[ii-1].first) && (uvUses[ii].second != uvUses[ii-1].second))
+            uvShared[uvUses[ii].first] = 1;
+    // Area-weighted facet plane quadrics:
+    Svec<Vec3D>         triNorms(tris.size(),Vec3D(0));
+    for (size_t tt=0; tt<tris.size(); ++tt) {
+        DTri const &        tri = tris[tt];
+        if (!tri.valid)
+            continue;
+        Vec3D               p0(verts[tri.pos[0]]),
+                            n = crossProduct(Vec3D(verts[tri.pos[1]])-p0,Vec3D(verts[tri.pos[2]])-p0);
+        double              len = n.len();
+        if (len == 0.0)
+            continue;
+        n /= len;
+        triNorms[tt] = n;
+        Quadric             q(n,-cDot(n,p0),len*0.5);
+        for (uint vv : tri.pos.m)
+            quadrics[vv] += q;
+    }
+    // Classify edges by sorting over (vertex pair, tri):
+    Svec<pair<uint64,uint> > edges;
+    edges.reserve(numTris*3);
+    for (size_t tt=0; tt<tris.size(); ++tt) {
+        DTri const &        tri = tris[tt];
+        if (!tri.valid)
+            continue;
+        for (uint ii=0; ii<3; ++ii) {
+            uint                v0 = tri.pos[ii],
+                                v1 = tri.pos[(ii+1)%3];
+            edges.push_back(make_pair((uint64(cMin(v0,v1)) << 32) | uint64(cMax(v0,v1)),uint(tt)));
+        }
+    }
+    sort(edges.begin(),edges.end());
+    // Constraint planes through feature edges perpendicular to their facets keep those edges in place:
+    auto                addConstraint = [&](uint v0,uint v1,uint tt)
+    {
+        Vec3D               p0(verts[v0]),
+                            edge = Vec3D(verts[v1]) - p0,
+                            n = crossProduct(edge,triNorms[tt]);
+        double              len = n.len();
+        if (len > 0.0) {
+            n /= len;
+            Quadric             q(n,-cDot(n,p0),opts.featureWeight*edge.mag());
+            quadrics[v0] += q;
+            quadrics[v1] += q;
+        }
+    };
+    Svec<pair<uint,uint> >  uniqueEdges;
+    for (size_t ii=0; ii<edges.size();) {
+        size_t              jj = ii+1;
+        while ((jj < edges.size()) && (edges[jj].first == edges[ii].first))
+            ++jj;
+        uint                v0 = uint(edges[ii].first >> 32),
+                            v1 = uint(edges[ii].first & 0xFFFFFFFF);
+        size_t              cnt = jj-ii;
+        if (cnt == 1) {
+            flags[v0] |= vertBorder;
+            flags[v1] |= vertBorder;
+            addConstraint(v0,v1,edges[ii].second);
+        }
+        else if (cnt == 2) {
+            DTri const &        t0 = tris[edges[ii].second];
+            DTri const &        t1 = tris[edges[ii+1].second];
+            if ((t0.key(t0.find(v0)) != t1.key(t1.find(v0))) || (t0.key(t0.find(v1)) != t1.key(t1.find(v1)))) {
+                addConstraint(v0,v1,edges[ii].second);
+                addConstraint(v0,v1,edges[ii+1].second);
+            }
+        }
+        else {                                          // Non-manifold
+            flags[v0] |= vertLocked;
+            flags[v1] |= vertLocked;
+        }
+        uniqueEdges.push_back(make_pair(v0,v1));
+        ii = jj;
+    }
+    for (auto const & e : uniqueEdges)
+        push(e.first,e.second);
+}
+
+bool
+Decimator::mapKeys(uint rem,uint keep,KeyMap & ret) const
+{
+    ret.clear();
+    for (uint tt : vertTris[rem]) {
+        DTri const &        tri = tris[tt];
+        int                 ik = tri.find(keep);
+        if (ik < 0)
+            continue;
+        uint64              kr = tri.key(tri.find(rem)),
+                            kk = tri.key(ik);
+        bool                found = false;
+        for (auto const & km : ret) {
+            if (km.first == kr) {
+                if (km.second != kk)
+                    return false;
+                found = true;
+            }
+        }
+        if (!found)
+            ret.push_back(make_pair(kr,kk));
+    }
+    for (uint tt : vertTris[rem]) {
+        DTri const &        tri = tris[tt];
+        uint64              kr = tri.key(tri.find(rem));
+        bool                found = false;
+        for (auto const & km : ret)
+            if (km.first == kr)
+                found = true;
+        if (!found)
+            return false;
+    }
+    return !ret.empty();
+}
+
+Uints
+Decimator::neighbours(uint vv) const
+{
+    Uints               ret;
+    ret.reserve(vertTris[vv].size()*2);
+    for (uint tt : vertTris[vv])
+        for (uint nn : tris[tt].pos.m)
+            if (nn != vv)
+                ret.push_back(nn);
+    sort(ret.begin(),ret.end());
+    ret.erase(unique(ret.begin(),ret.end()),ret.end());
+    return ret;
+}
+
+bool
+Decimator::evaluate(uint v0,uint v1,Collapse & ret) const
+{
+    Svec<uint64>        k0,k1;
+    keys(v0,k0);
+    keys(v1,k1);
+    bool                free0 = isFree(v0,k0),
+                        free1 = isFree(v1,k1);
+    uint                rem,keep;
+    // If only one vert is free it is removed. If neither, try sliding one into the other:
+    if (free0 || (!free1 && canSlide(v0,v1))) {
+        rem = v0;
+        keep = v1;
+    }
+    else if (free1 || canSlide(v1,v0)) {
+        rem = v1;
+        keep = v0;
+    }
+    else
+        return false;
+    Quadric             q = quadrics[rem];
+    q += quadrics[keep];
+    Vec3D               pr(verts[rem]),
+                        e = Vec3D(verts[keep]) - pr;
+    double              dm = opts.morphWeight * morphDiffSqr(rem,keep),
+                        t = 1.0;
+    if (free0 && free1) {
+        // Minimize Q(pr + t*e) + dm*(t^2 + (1-t)^2) over t in [0,1], where the morph term is the squared
+        // change in the interpolated morph deltas at the original positions of the two verts:
+        double              alpha = cDot(e,q.mulA(e)) + 2.0*dm,
+                            beta = 2.0*(cDot(q.mulA(pr),e) + q.dotB(e)) - 2.0*dm;
+        if (alpha > 0.0)
+            t = clampBounds(-beta/(2.0*alpha),0.0,1.0);
+        else if (q.eval(pr) + dm < q.eval(pr+e) + dm)
+            t = 0.0;
+    }
+    double              cost = q.eval(pr+e*t) + dm*(t*t + sqr(1.0-t)) + morphErrs[rem] + morphErrs[keep];
+    ret = Collapse {float(cost),rem,keep,float(t),versions[rem],versions[keep]};
+    return true;
+}
+
+bool
+Decimator::isValid(Collapse const & c,Vec3F pos,KeyMap & keyMap) const
+{
+    uint                rem = c.rem,
+                        keep = c.keep;
+    if (!mapKeys(rem,keep,keyMap))
+        return false;
+    Uints               opposite;
+    for (uint tt : vertTris[rem]) {
+        DTri const &        tri = tris[tt];
+        int                 ir = tri.find(rem),
+                            ik = tri.find(keep);
+        if (ik >= 0)
+            opposite.push_back(tri.pos[3-ir-ik]);
+    }
+    if (opposite.empty() || (opposite.size() > 2))
+        return false;
+    // Link condition; the only verts adjacent to both must be those opposite the edge, otherwise
+    // the collapse creates non-manifold topology:
+    Uints               n0 = neighbours(rem),
+                        n1 = neighbours(keep),
+                        common;
+    set_intersection(n0.begin(),n0.end(),n1.begin(),n1.end(),back_inserter(common));
+    if (common.size() != opposite.size())
+        return false;
+    // Reject collapses that flip or excessively rotate the remaining facets:
+    double              cosMax = cos(opts.maxNormalChange);
+    for (uint vv : {rem,keep}) {
+        for (uint tt : vertTris[vv]) {
+            DTri const &        tri = tris[tt];
+            if ((tri.find(rem) >= 0) && (tri.find(keep) >= 0))
+                continue;
+            Vec3D               p[3],q[3];
+            for (uint ii=0; ii<3; ++ii) {
+                p[ii] = Vec3D(verts[tri.pos[ii]]);
+                q[ii] = ((tri.pos[ii] == rem) || (tri.pos[ii] == keep)) ? Vec3D(pos) : p[ii];
+            }
+            Vec3D               nOld = crossProduct(p[1]-p[0],p[2]-p[0]),
+                                nNew = crossProduct(q[1]-q[0],q[2]-q[0]);
+            double              mNew = nNew.mag();
+            if (mNew == 0.0)
+                return false;
+            if (cDot(nOld,nNew) < cosMax * sqrt(nOld.mag()*mNew))
+                return false;
+        }
+    }
+    return true;
+}
+
+void
+Decimator::collapse(Collapse const & c,Vec3F pos,KeyMap const & keyMap)
+{
+    uint                rem = c.rem,
+                        keep = c.keep;
+    float               t = c.t;
+    double              dm = opts.morphWeight * morphDiffSqr(rem,keep);
+    if (t < 1.0f) {             // Full collapse of free verts; interpolate attributes to the new position:
+        for (auto const & km : keyMap) {
+            uint                ur = uint(km.first & 0xFFFFFFFF),
+                                uk = uint(km.second & 0xFFFFFFFF);
+            if ((ur != noUv) && (uk != noUv))
+                uvs[uk] = uvs[ur] + (uvs[uk]-uvs[ur]) * t;
+        }
+        for (Vec3Fs & md : morphDeltas)
+            md[keep] = md[rem] + (md[keep]-md[rem]) * t;
+    }
+    verts[keep] = pos;
+    quadrics[keep] += quadrics[rem];
+    morphErrs[keep] += morphErrs[rem] + dm*(sqr(t) + sqr(1.0f-t));
+    for (uint tt : vertTris[rem]) {
+        DTri &              tri = tris[tt];
+        int                 ir = tri.find(rem);
+        if (tri.find(keep) >= 0) {
+            tri.valid = false;
+            --numTris;
+            for (uint vv : tri.pos.m) {
+                if (vv != rem) {
+                    Uints &             vts = vertTris[vv];
+                    vts.erase(find(vts.begin(),vts.end(),tt));
+                }
+            }
+        }
+        else {
+            uint64              kr = tri.key(ir);
+            for (auto const & km : keyMap)
+                if (km.first == kr)
+                    tri.uv[ir] = uint(km.second & 0xFFFFFFFF);
+            tri.pos[ir] = keep;
+            vertTris[keep].push_back(tt);
+        }
+    }
+    Uints().swap(vertTris[rem]);
+    flags[rem] |= vertRemoved;
+    ++versions[rem];
+    ++versions[keep];
+    for (uint nn : neighbours(keep))
+        push(keep,nn);
+}
+
+void
+Decimator::run(size_t targetTris)
+{
+    KeyMap              keyMap;
+    while ((numTris > targetTris) && !heap.empty()) {
+        pop_heap(heap.begin(),heap.end(),greater<Collapse>());
+        Collapse            c = heap.back();
+        heap.pop_back();
+        if ((versions[c.rem] != c.remVer) || (versions[c.keep] != c.keepVer))
+            continue;
+        // Avoid rounding when the kept vert does not move:
+        Vec3F               pos = (c.t == 1.0f) ? verts[c.keep] : verts[c.rem] + (verts[c.keep]-verts[c.rem]) * c.t;
+        if (isValid(c,pos,keyMap))
+            collapse(c,pos,keyMap);
+    }
+}
+
+Mesh
+Decimator::result(Mesh const & in) const
+{
+    uint const          none = numeric_limits<uint>::max();
+    Mesh                ret;
+    ret.name = in.name;
+    Uints               vertMap(verts.size(),none),
+                        uvMap(uvs.size(),none),
+                        oldVerts;
+    for (DTri const & tri : tris)
+        if (tri.valid)
+            for (uint vv : tri.pos.m)
+                vertMap[vv] = 0;
+    for (MarkedVert const & mv : in.markedVerts)
+        vertMap[mv.idx] = 0;
+    for (size_t vv=0; vv<verts.size(); ++vv) {         // Retain original vertex order
+        if (vertMap[vv] == 0) {
+            vertMap[vv] = uint(ret.verts.size());
+            ret.verts.push_back(verts[vv]);
+            oldVerts.push_back(uint(vv));
+        }
+    }
+    auto                mapUv = [&](uint uv)
+    {
+        if (uvMap[uv] == none) {
+            uvMap[uv] = uint(ret.uvs.size());
+            ret.uvs.push_back(uvs[uv]);
+        }
+        return uvMap[uv];
+    };
+    for (size_t ss=0; ss<in.surfaces.size(); ++ss) {
+        Surf const &        surfIn = in.surfaces[ss];
+        Surf                surf;
+        surf.name = surfIn.name;
+        surf.material = surfIn.material;
+        Uints               triMap(surfTriStart[ss+1]-surfTriStart[ss],none);
+        for (uint tt=surfTriStart[ss]; tt<surfTriStart[ss+1]; ++tt) {
+            DTri const &        tri = tris[tt];
+            if (!tri.valid)
+                continue;
+            triMap[tt-surfTriStart[ss]] = uint(surf.tris.size());
+            surf.tris.posInds.push_back(Vec3UI(vertMap[tri.pos[0]],vertMap[tri.pos[1]],vertMap[tri.pos[2]]));
+            if (tri.uv[0] != noUv)
+                surf.tris.uvInds.push_back(Vec3UI(mapUv(tri.uv[0]),mapUv(tri.uv[1]),mapUv(tri.uv[2])));
+        }
+        for (SurfPoint sp : surfIn.surfPoints) {
+            sp.triEquivIdx = triMap[sp.triEquivIdx];
+            FGASSERT(sp.triEquivIdx != none);
+            surf.surfPoints.push_back(sp);
+        }
+        ret.surfaces.push_back(surf);
+    }
+    for (MarkedVert mv : in.markedVerts) {
+        mv.idx = vertMap[mv.idx];
+        ret.markedVerts.push_back(mv);
+    }
+    size_t              numDelta = in.deltaMorphs.size();
+    for (size_t mm=0; mm<numDelta; ++mm) {
+        Morph               morph(in.deltaMorphs[mm].name);
+        morph.verts.reserve(oldVerts.size());
+        for (uint vv : oldVerts)
+            morph.verts.push_back(morphDeltas[mm][vv]);
+        ret.deltaMorphs.push_back(morph);
+    }
+    for (size_t mm=0; mm<in.targetMorphs.size(); ++mm) {
+        Vec3Fs const &      deltas = morphDeltas[numDelta+mm];
+        IndexedMorph        morph;
+        morph.name = in.targetMorphs[mm].name;
+        for (size_t ii=0; ii<oldVerts.size(); ++ii) {
+            Vec3F               delta = deltas[oldVerts[ii]];
+            if (delta != Vec3F(0)) {
+                morph.baseInds.push_back(uint(ii));
+                morph.verts.push_back(ret.verts[ii]+delta);
+            }
+        }
+        ret.targetMorphs.push_back(morph);
+    }
+    return ret;
+}
+
+}
+
+Mesh
+decimate(Mesh const & mesh,size_t targetTris,DecimateOptions const & options)
+{
+    Decimator           dec(mesh,options);
+    dec.run(targetTris);
+    return dec.result(mesh);
+}
+
+static
+double
+surfaceArea(Mesh const & mesh)
+{
+    double              ret = 0.0;
+    for (Surf const & surf : mesh.surfaces) {
+        for (Vec3UI t : surf.tris.posInds) {
+            Vec3D               p0(mesh.verts[t[0]]);
+            ret += crossProduct(Vec3D(mesh.verts[t[1]])-p0,Vec3D(mesh.verts[t[2]])-p0).len() * 0.5;
+        }
+    }
+    return ret;
+}
+
+void
+testDecimate(CLArgs const &)
+{
+    // A flat grid must keep its exact outline and area (no flips or holes) however far it is decimated:
+    Mesh                grid {cGrid(32)};
+    Mesh                dec = decimate(grid,50);
+    dec.checkValidity();
+    FGASSERT(dec.numTris() <= 50);
+    FGASSERT(cBounds(dec.verts) == cBounds(grid.verts));
+    FGASSERT(isApproxEqualRel(surfaceArea(dec),4.0,0.0001));
+    // Including a bump morph in the error metric must retain more verts where the bump is:
+    Vec3Fs              bump;
+    for (Vec3F v : grid.verts)
+        bump.push_back(Vec3F(0,0,std::max(0.0f,0.25f-v[0]*v[0]-v[1]*v[1])));
+    grid.addDeltaMorph(Morph("bump",bump));
+    auto                numInBump = [](Mesh const & mesh)
+    {
+        size_t              ret = 0;
+        for (Vec3F v : mesh.verts)
+            if (v[0]*v[0] + v[1]*v[1] < 0.25f)
+                ++ret;
+        return ret;
+    };
+    DecimateOptions     opts;
+    opts.morphWeight = 0.0f;
+    size_t              numIgnored = numInBump(decimate(grid,200,opts));
+    dec = decimate(grid,200);
+    FGASSERT(dec.deltaMorphs.size() == 1);
+    FGASSERT(numInBump(dec) > numIgnored);
+    // Real mesh with UV seams, multiple surfaces, morphs, marked verts and surface points:
+    Mesh                jane = loadTri(dataDir()+"base/Jane.tri");
+    size_t              target = jane.numTriEquivs() / 4;
+    dec = decimate(jane,target);
+    dec.checkValidity();
+    FGASSERT(dec.numTris() <= target);
+    FGASSERT(dec.morphNames() == jane.morphNames());
+    FGASSERT(dec.markedVertPositions() == jane.markedVertPositions());
+    FGASSERT(dec.surfaces.size() == jane.surfaces.size());
+    Vec3Fs              spsIn = jane.surfPointPositions(),
+                        spsOut = dec.surfPointPositions();
+    FGASSERT(isApproxEqual(spsIn,spsOut,0.0));
+    Mat32F              bndsIn = cBounds(jane.verts),
+                        bndsOut = cBounds(dec.verts);
+    FGASSERT(isApproxEqual(bndsIn,bndsOut,cMaxElem(bndsIn.colVec(1)-bndsIn.colVec(0))*0.02));
+    for (Surf const & surf : dec.surfaces)
+        FGASSERT(surf.tris.hasUvs());
+}
+
+}
+
+// */
@@ -0,0 +1,42 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Quadric error metric edge-collapse mesh decimation (Garland & Heckbert 1997)
+//
+
+#ifndef FG3DDECIMATE_HPP
+#define FG3DDECIMATE_HPP
+
+#include "Fg3dMesh.hpp"
+
+namespace Fg {
+
+struct  DecimateOptions
+{
+    // Weight of the morph shape error (summed over all morphs at full application) relative to the
+    // base shape error. Use 0 to ignore morphs in the error metric (they are still interpolated):
+    float           morphWeight = 1.0f;
+    // Weight of the constraint planes which keep boundaries and UV seams in place:
+    float           featureWeight = 100.0f;
+    // Collapses which rotate any facet normal by more than this (radians) are rejected:
+    float           maxNormalChange = 1.2f;
+};
+
+// Reduce the mesh to approximately 'targetTris' tris (over all surfaces) by collapsing edges in
+// order of least quadric error. Stops early if no valid collapses remain.
+// * Quads are converted to tris.
+// * Boundary and UV seam vertices can only collapse along their boundary or seam, so UV islands
+//   and surface boundaries are kept intact.
+// * Delta and target morphs contribute to the error metric and are interpolated across collapses
+//   along with the vertex positions and UVs.
+// * Marked verts and the tris referenced by surface points are preserved.
+Mesh
+decimate(Mesh const & mesh,size_t targetTris,DecimateOptions const & options=DecimateOptions());
+
+}
+
+#endif
+
+// */
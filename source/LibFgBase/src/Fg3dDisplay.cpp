@@ -777,6 +777,7 @@ GuiPosedMeshes::addMesh(
     rm.normalsN = linkNormals(meshN,rm.posedVertsN);
     rm.surfVertsFlag = makeUpdateFlag(rm.posedVertsN);
     rm.allVertsFlag = makeUpdateFlag(rm.posedVertsN);
+    rm.pickVertsFlag = makeUpdateFlag(rm.posedVertsN);
     rendMeshes.push_back(rm);
 }
 
@@ -13,6 +13,7 @@
 #include "FgMath.hpp"
 #include "Fg3dTopology.hpp"
 #include "FgStdSet.hpp"
+#include "FgMemory.hpp"
 
 using namespace std;
 
@@ -812,4 +813,36 @@ cullVolume(TriSurf triSurf,Mat32F const & bounds)
     return meshRemoveUnusedVerts(triSurf.verts,nTris);
 }
 
+template<uint dim>
+size_t
+heapBytes(FacetInds<dim> const & fi)
+{return heapBytes(fi.posInds) + heapBytes(fi.uvInds); }
+
+size_t
+memoryFootprint(Mesh const & mesh)
+{
+    size_t          ret = sizeof(mesh) + heapBytes(mesh.name.m_str) + heapBytes(mesh.verts) + heapBytes(mesh.uvs);
+    ret += heapBytes(mesh.surfaces);
+    for (Surf const & surf : mesh.surfaces) {
+        ret += heapBytes(surf.name.m_str) + heapBytes(surf.tris) + heapBytes(surf.quads);
+        ret += heapBytes(surf.surfPoints);
+        for (SurfPoint const & sp : surf.surfPoints)
+            ret += heapBytes(sp.label);
+        if (surf.material.albedoMap)
+            ret += memoryFootprint(*surf.material.albedoMap);
+        if (surf.material.specularMap)
+            ret += memoryFootprint(*surf.material.specularMap);
+    }
+    ret += heapBytes(mesh.deltaMorphs);
+    for (Morph const & morph : mesh.deltaMorphs)
+        ret += heapBytes(morph.name.m_str) + heapBytes(morph.verts);
+    ret += heapBytes(mesh.targetMorphs);
+    for (IndexedMorph const & morph : mesh.targetMorphs)
+        ret += heapBytes(morph.name.m_str) + heapBytes(morph.baseInds) + heapBytes(morph.verts);
+    ret += heapBytes(mesh.markedVerts);
+    for (MarkedVert const & mv : mesh.markedVerts)
+        ret += heapBytes(mv.label);
+    return ret;
+}
+
 }
@@ -313,6 +313,10 @@ Mesh        subdivide(Mesh const &,bool loop = true);
 // Remove all tris that lie entirely outside the given bounds then remove all unused vertices:
 TriSurf     cullVolume(TriSurf surf,Mat32F const & bounds);
 
+// Bytes used by the mesh including all owned heap memory. Maps shared between surfaces are counted
+// for each surface:
+size_t      memoryFootprint(Mesh const & mesh);
+
 }
 
 #endif
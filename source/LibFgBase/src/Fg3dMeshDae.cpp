@@ -72,11 +72,9 @@ cEffect(string const & id)
     </effect>)";
 }
 
-string
-cGeometryVerts(string const & id,Vec3Fs const & verts,Vec3Fs const & norms,Vec2Fs const & uvs)
+void
+writeGeometryVerts(OutBuffer & ofs,string const & id,Vec3Fs const & verts,Vec3Fs const & norms,Vec2Fs const & uvs)
 {
-    ostringstream       ofs;
-    ofs.precision(7);
     ofs << "\n"
         "        <source id=\"" << id << "Coords\">\n"
         "          <float_array id=\"" << id << "CoordsArray\" count=\"" << verts.size()*3 << "\">";
@@ -123,13 +121,11 @@ cGeometryVerts(string const & id,Vec3Fs const & verts,Vec3Fs const & norms,Vec2F
         "        <vertices id=\"" << id << "Verts\">\n"
         "          <input semantic=\"POSITION\" source=\"#" << id << "Coords\" />\n"
         "        </vertices>";
-    return ofs.str();
 }
 
-string
-cGeometrySurfs(Surfs const & surfs,string const & id,size_t mm)
+void
+writeGeometrySurfs(OutBuffer & ofs,Surfs const & surfs,string const & id,size_t mm)
 {
-    ostringstream       ofs;
     for (size_t ss=0; ss<surfs.size(); ++ss) {
         Surf const &     surf = surfs[ss];
         bool        hasUVs = (surf.tris.hasUvs() && surf.quads.hasUvs());
@@ -169,39 +165,40 @@ cGeometrySurfs(Surfs const & surfs,string const & id,size_t mm)
         ofs << " </p>\n"
             "        </polylist>";
     }
-    return ofs.str();
 }
 
 string  cMeshId(size_t mm)  {return "Mesh" + toStr(mm); }
 string  cMorphId(size_t mm,size_t rr) {return "Mesh" + toStr(mm) + "Morph" + toStr(rr); }
 
-Ustring
-cGeometry(Mesh const & mesh,size_t mm)
+void
+writeGeometry(OutBuffer & ofs,Mesh const & mesh,size_t mm)
 {
     string              id = cMeshId(mm);
     Ustring             name = mesh.name.empty() ? id : mesh.name;
-    Ustring             ret = R"(
-    <geometry id=")" + id + R"(" name=")" + name + R"(">
-      <mesh>)" +
-        cGeometryVerts(id,mesh.verts,cNormals(mesh).vert,mesh.uvs) +
-        cGeometrySurfs(mesh.surfaces,id,mm) + R"(
+    ofs << R"(
+    <geometry id=")" << id << R"(" name=")" << name << R"(">
+      <mesh>)";
+    writeGeometryVerts(ofs,id,mesh.verts,cNormals(mesh).vert,mesh.uvs);
+    writeGeometrySurfs(ofs,mesh.surfaces,id,mm);
+    ofs << R"(
       </mesh>
     </geometry>)";
-    for (size_t rr=0; rr<mesh.numMorphs(); ++rr) {
+    // Morph targets are independent so are formatted concurrently:
+    writeBlocks(ofs,mesh.numMorphs(),[&](size_t rr,OutBuffer & out)
+    {
         string              morphId = cMorphId(mm,rr);
-        Ustring             morphName = mesh.morphName(rr);
         Vec3Fs              morphVerts = mesh.morphSingle(rr);
-        ret += R"(
-    <geometry id=")" + morphId + R"(" name=")" + morphName + R"(">
-      <mesh>)" +
-            cGeometryVerts(morphId,morphVerts,cNormals(mesh.surfaces,morphVerts).vert,mesh.uvs) +
-            // Blender crashes without repeating surface definition for each morph.
-            // Maya supposedly has the same problem (Collada docs).
-            cGeometrySurfs(mesh.surfaces,morphId,mm) + R"(
+        out << R"(
+    <geometry id=")" << morphId << R"(" name=")" << mesh.morphName(rr) << R"(">
+      <mesh>)";
+        writeGeometryVerts(out,morphId,morphVerts,cNormals(mesh.surfaces,morphVerts).vert,mesh.uvs);
+        // Blender crashes without repeating surface definition for each morph.
+        // Maya supposedly has the same problem (Collada docs).
+        writeGeometrySurfs(out,mesh.surfaces,morphId,mm);
+        out << R"(
       </mesh>
     </geometry>)";
-    }
-    return ret;
+    });
 }
 
 Ustring
@@ -279,13 +276,11 @@ saveDae(Ustring const & filename,Meshes const & meshes,string imgFormat,SpatialU
     Ustring             images,
                         effects,
                         materials,
-                        geometries,
                         controllers,
                         sceneNodes;
     map<ImgC4UC*,Ustring>  imagesSaved;
     for (size_t mm=0; mm<meshes.size(); ++mm) {
         Mesh const &        mesh = meshes[mm];
-        geometries += cGeometry(mesh,mm);
         controllers += cController(mesh,mm);
         sceneNodes += cSceneNode(mesh,mm);
         for (size_t ss=0; ss<mesh.surfaces.size(); ++ss) {
@@ -312,7 +307,8 @@ saveDae(Ustring const & filename,Meshes const & meshes,string imgFormat,SpatialU
             }
         }
     }
-    Ofstream            ofs {dirBase+".dae"};
+    BufferedOfstream    ofs {dirBase+".dae"};
+    ofs.precision = 7;
     ofs << R"(<?xml version="1.0" encoding="UTF-8"?>
 <COLLADA xmlns="http://www.collada.org/2005/11/COLLADASchema" version="1.4.1">
   <asset>
@@ -328,7 +324,10 @@ saveDae(Ustring const & filename,Meshes const & meshes,string imgFormat,SpatialU
   </library_effects>
   <library_materials>)" << materials << R"(
   </library_materials>
-  <library_geometries>)" << geometries << R"(
+  <library_geometries>)";
+    for (size_t mm=0; mm<meshes.size(); ++mm)
+        writeGeometry(ofs,meshes[mm],mm);
+    ofs << R"(
   </library_geometries>
   <library_controllers>)" << controllers << R"(
   </library_controllers>
@@ -341,6 +340,7 @@ saveDae(Ustring const & filename,Meshes const & meshes,string imgFormat,SpatialU
   </scene>
 </COLLADA>
 )";
+    ofs.close();
 }
 
 void
@@ -80,8 +80,8 @@ saveFbx(
     FGASSERT(!meshes.empty());
     Path      path(filename);
     path.ext = "fbx";
-    Ofstream  ofs(path.str());
-    ofs.precision(7);
+    BufferedOfstream    ofs(path.str());
+    ofs.precision = 7;
     ofs <<
         "; FBX 7.4.0 project file\n"
         "; Created by FaceGen\n"
@@ -251,29 +251,31 @@ saveFbx(
             "        }\n";
         ofs <<
             "    }\n";
-        for (size_t ee=0; ee<mesh.numMorphs(); ++ee) {
+        // Morph targets are independent so are formatted concurrently:
+        writeBlocks(ofs,mesh.numMorphs(),[&](size_t ee,OutBuffer & out)
+        {
             IndexedMorph  morph = mesh.getMorphAsIndexedDelta(ee);
-            ofs << 
+            out << 
                 "    Geometry: " << idGeoExp(mm,ee) << ", \"Geometry::" << morph.name << "\", \"Shape\" {\n"
                 "        Version: 100\n"
                 "        Indexes: *" << morph.baseInds.size() << " {\n"
                 "            a: ";
             for (size_t ii=0; ii<morph.baseInds.size(); ++ii) {
                 if (ii > 0)
-                    ofs << ",";
-                ofs << morph.baseInds[ii];
+                    out << ",";
+                out << morph.baseInds[ii];
             }
-            ofs << "\n"
+            out << "\n"
                 "        }\n"
                 "        Vertices: *" << morph.baseInds.size()*3 << " {\n"
                 "            a: ";
             for (size_t ii=0; ii<morph.baseInds.size(); ++ii) {
                 if (ii > 0)
-                    ofs << ",";
+                    out << ",";
                 Vec3F    v = morph.verts[ii];
-                ofs << v[0] << "," << v[1] << "," << v[2];
+                out << v[0] << "," << v[1] << "," << v[2];
             }
-            ofs << "\n"
+            out << "\n"
                 "        }\n"
                 "    }\n"
                 "    Deformer: " << idDeformer(mm,ee) << ", \"Deformer::" << morph.name << "\", \"BlendShape\" {\n"
@@ -286,7 +288,7 @@ saveFbx(
                 "            a: 10\n"
                 "        }\n"
                 "    }\n";
-        }
+        });
     }
     for (size_t mm=0; mm<meshes.size(); ++mm) {
         Mesh const &    mesh = meshes[mm];
@@ -365,6 +367,7 @@ saveFbx(
         }
     }
     ofs << "}\n";
+    ofs.close();
 }
 
 void
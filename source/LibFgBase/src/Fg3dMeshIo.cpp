@@ -12,6 +12,7 @@
 #include "FgSyntax.hpp"
 #include "FgCommand.hpp"
 #include "FgImageIo.hpp"
+#include "FgMemory.hpp"
 
 using namespace std;
 
@@ -76,13 +77,12 @@ meshExportFormats()
 }
 
 
-bool
-loadMesh(
-    Ustring const &     fname,
-    Mesh &              mesh)
+// If no extension is given, search for a readable mesh type and set it. Returns false if none found:
+static bool
+findMeshExt(Path & path)
 {
-    Path      path(fname);
     if (path.ext.empty()) {
+        Ustring         fname = path.str();
         if (pathExists(fname+".tri"))
             path.ext = "tri";
         else if (pathExists(fname + ".wobj"))
@@ -94,6 +94,18 @@ loadMesh(
         else
             return false;
     }
+    return true;
+}
+
+bool
+loadMesh(
+    Ustring const &     fname,
+    Mesh &              mesh)
+{
+    MemTagScope         mts(MemTag::mesh);
+    Path      path(fname);
+    if (!findMeshExt(path))
+        return false;
     Ustring    ext = path.ext.toLower();
     if(ext == "tri")
         mesh = loadTri(path.str());
@@ -101,6 +113,10 @@ loadMesh(
         mesh = loadWObj(path.str(),"usemtl");       // Split by material to remain 1-1 with any color map arguments
     else if (ext == "fgmesh")
         mesh = loadFgmesh(path.str());
+    else if (ext == "ply")
+        mesh = loadPly(path.str());
+    else if (ext == "stl")
+        mesh = loadStl(path.str());
     else
         fgThrow("Not a readable 3D mesh format",fname);
     return true;
@@ -115,29 +131,59 @@ loadMesh(Ustring const & fname)
     return ret;
 }
 
+AsyncResult<Mesh>
+loadMeshAsync(AsyncLoader & loader,Ustring const & fname)
+{
+    Path            path(fname);
+    // The in-memory representation is typically no larger than twice the file size for any format:
+    size_t          memEstimate = findMeshExt(path) ? size_t(fileSizeOrZero(path.str())*2) : 0;
+    return loader.submit<Mesh>(memEstimate,[fname]{return loadMesh(fname); });
+}
+
 Mesh
 loadMeshMaps(Ustring const & baseName)
 {
-    Mesh            ret = loadMesh(baseName);
-    if (!ret.surfaces.empty()) {
-        Strings         albExts = imgFindFiles(baseName);
-        if (!albExts.empty())
-            ret.surfaces[0].material.albedoMap = make_shared<ImgC4UC>(loadImage(baseName+"."+albExts[0]));
-        Ustring         specBase = baseName+"_Specular";
-        Strings         specExts = imgFindFiles(specBase);
-        if (!specExts.empty())
-            ret.surfaces[0].material.specularMap = make_shared<ImgC4UC>(loadImage(specBase+"."+specExts[0]));
-    }
+    Mesh                    ret = loadMesh(baseName);
+    if (ret.surfaces.empty())
+        return ret;
+    AsyncLoader &           loader = asyncLoaderDefault();
+    AsyncResult<ImgC4UC>    albLoad,
+                            specLoad;
+    Strings                 albExts = imgFindFiles(baseName);
+    if (!albExts.empty())
+        albLoad = loadImageAsync(loader,baseName+"."+albExts[0]);
+    Ustring                 specBase = baseName+"_Specular";
+    Strings                 specExts = imgFindFiles(specBase);
+    if (!specExts.empty())
+        specLoad = loadImageAsync(loader,specBase+"."+specExts[0]);
+    if (albLoad.valid())
+        ret.surfaces[0].material.albedoMap = make_shared<ImgC4UC>(albLoad.get());
+    if (specLoad.valid())
+        ret.surfaces[0].material.specularMap = make_shared<ImgC4UC>(specLoad.get());
+    return ret;
+}
+
+Meshes
+loadMeshes(Ustrings const & fnames)
+{
+    AsyncLoader &           loader = asyncLoaderDefault();
+    Svec<AsyncResult<Mesh> > loads;
+    for (Ustring const & fname : fnames)
+        loads.push_back(loadMeshAsync(loader,fname));
+    Meshes                  ret;
+    ret.reserve(loads.size());
+    for (AsyncResult<Mesh> & load : loads)
+        ret.push_back(load.get());
     return ret;
 }
 
 Strings
 meshLoadFormats()
-{return svec<string>("fgmesh","obj","wobj","tri"); }
+{return svec<string>("fgmesh","obj","wobj","tri","ply","stl"); }
 
 string
 meshLoadFormatsCLDescription()
-{return string("(fgmesh | [w]obj | tri)"); }
+{return string("(fgmesh | [w]obj | tri | ply | stl)"); }
 
 void
 saveMesh(Meshes const & meshes,Ustring const & fname,string const & imgFormat)
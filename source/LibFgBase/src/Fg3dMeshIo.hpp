@@ -47,6 +47,7 @@
 #define FG3DMESHIO_HPP
 
 #include "FgString.hpp"
+#include "FgAsyncLoad.hpp"
 #include "Fg3dMeshOps.hpp"
 
 namespace Fg {
@@ -86,9 +87,17 @@ loadMesh(
 // As above but throws if no mesh found:
 Mesh    loadMesh(Ustring const & fname);
 
-// Loads both mesh and albedo map (if present) and specular map (if present):
+// As above but queued for concurrent loading. The memory estimate is based on the file size:
+AsyncResult<Mesh>
+loadMeshAsync(AsyncLoader & loader,Ustring const & fname);
+
+// Loads both mesh and albedo map (if present) and specular map (if present), concurrently:
 Mesh    loadMeshMaps(Ustring const & baseName);
 
+// Load many meshes concurrently (using 'asyncLoaderDefault()'). Throws if any fails to load:
+Meshes
+loadMeshes(Ustrings const & fnames);
+
 // Returns lower case list of supported extensions:
 Strings
 meshLoadFormats();
@@ -133,6 +142,9 @@ saveFgmesh(Ustring const & fname,Meshes const & meshes);
 // FaceGen legacy mesh format load / save:
 
 Mesh        loadTri(std::istream & is);
+// Parses a TRI file held in memory using bounds-checked bulk copies:
+Mesh        loadTri(uchar const * data,size_t size);
+// Memory maps the file then parses as above:
 Mesh        loadTri(Ustring const & fname);
 Mesh        loadTri(Ustring const & meshFile,Ustring const & texFile);
 
@@ -177,6 +189,11 @@ saveFbx(Ustring const & filename,Meshes const & meshes,String imgFormat = "png")
 void
 saveStl(Ustring const & fname,Meshes const & meshes);
 
+// Binary or ASCII STL. STL facets are unindexed so vertices with identical positions are welded.
+// Facets which become degenerate are removed:
+Mesh
+loadStl(Ustring const & fname);
+
 // Morph targets are also saved:
 void
 saveLwo(Ustring const & fname,Meshes const & meshes,String imgFormat = "png");
@@ -201,7 +218,21 @@ save3ds(Ustring const & fname,Meshes meshes,String imgFormat = "png");
 // Vertices & surfaces must be merged to a single list but tex images are specified per facet.
 // Currently saves all facets as tris but can easily be changed to preverve quads:
 void
-savePly(Ustring const & fname,Meshes const & meshes,String imgFormat = "png");
+savePly(Ustring const & fname,Meshes const & meshes,String imgFormat = "png",bool binary=false);
+
+// Per-vertex data from scan formats which is not represented in 'Mesh':
+struct  MeshVertAttribs
+{
+    Vec3Fs              normals;        // Empty if not in file
+    Svec<RgbaUC>        colors;         // "
+};
+
+// ASCII, binary little-endian or binary big-endian PLY. Vertex 'x,y,z' properties are required,
+// normals, colours and per-vertex UVs are optional. Face 'vertex_indices' lists of 4 are loaded as
+// quads, others are fanned into tris. Per-face 'texcoord' lists take precedence over per-vertex UVs
+// and faces are split into surfaces by 'texnumber' (as written by 'savePly'):
+Mesh
+loadPly(Ustring const & fname,MeshVertAttribs * attribs=nullptr);
 
 // Collada. Does not yet support morphs.
 void
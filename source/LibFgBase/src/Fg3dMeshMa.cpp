@@ -125,11 +125,11 @@ static string getObjectTexFileName(
 static string getObjectTexPlaceName(
         const FffMultiObjectC &model, unsigned long mm);
 
-static void writeTexCoord(ofstream &ofs, const vector<Vec2F> &texCoord);
-static void writeVertices(ofstream &ofs, const vector<Vec3F> &vtxList);
-static void writeEdges(ofstream &ofs, const vector<Vec2UI> &edgeList);
+static void writeTexCoord(OutBuffer &ofs, const vector<Vec2F> &texCoord);
+static void writeVertices(OutBuffer &ofs, const vector<Vec3F> &vtxList);
+static void writeEdges(OutBuffer &ofs, const vector<Vec2UI> &edgeList);
 static void writeFacets(
-        ofstream                    &ofs,
+        OutBuffer                   &ofs,
         const vector<Vec3F>    &vtxList,
         Vec3UIs const    &triList,
         const vector<Vec4UI>    &quadList,
@@ -137,27 +137,34 @@ static void writeFacets(
         const vector<Vec2F>    &texCoord,
         Vec3UIs const    &texTriList,
         const vector<Vec4UI>    &texQuadList);
+static void writeMorphTarget(
+        OutBuffer                       &ofs,
+        const FffMultiObjectC           &model,
+        const FffMultiObjectC           &morphTarget,
+        string const                    &morphName,
+        const vector<EdgeMapT>          &edgeMap,
+        const vector<vector<Vec2UI> >   &edgeList);
 static void writeObjects(
-        ofstream                        &ofs,
+        OutBuffer                       &ofs,
         const FffMultiObjectC           &model,
         const vector<FffMultiObjectC>   *morphTargets,
         Strings const            *morphNames,
         vector<int>                     &edgeSizeList);
 static int writeShadingMaterialPhong(
-        ofstream                        &ofs,
+        OutBuffer                       &ofs,
         const FffMultiObjectC           &model,
         Strings const            *morphNames);
 static void writeBlendShapes(
-        ofstream                        &ofs, 
+        OutBuffer                       &ofs, 
         const FffMultiObjectC           &model,
         Strings const            *morphNames);
 static void writePolySoftEdge(
-        ofstream                        &ofs, 
+        OutBuffer                       &ofs, 
         const FffMultiObjectC           &model,
         Strings const            *morphNames,
         const vector<int>               &edgeSizeList);
 static void connectAttributes(
-        ofstream                        &ofs,
+        OutBuffer                       &ofs,
         const FffMultiObjectC           &model,
         Strings const            *morphNames);
 
@@ -218,11 +225,7 @@ static bool saveMayaAsciiFile(
 
     Path      path(fname);
     path.ext = "ma";
-    Ofstream ofs(path.str());
-    if (!ofs)
-    {
-        return false;
-    }
+    BufferedOfstream ofs(path.str());
 
     //
     // Write header
@@ -336,16 +339,8 @@ static bool saveMayaAsciiFile(
     //
     // Done.
     //
-    if (ofs.fail())
-    {
-        ofs.close();
-        return false;
-    }
-    else
-    {
-        ofs.close();
-        return true;
-    }
+    ofs.close();
+    return true;
 }
 
 
@@ -837,7 +832,7 @@ static string getObjectTexPlaceName(
 //****************************************************************************
 //                              writeTexCoord
 //****************************************************************************
-static void writeTexCoord(ofstream &ofs, const vector<Vec2F> &texCoord)
+static void writeTexCoord(OutBuffer &ofs, const vector<Vec2F> &texCoord)
 {
     if (texCoord.size())
     {
@@ -865,7 +860,7 @@ static void writeTexCoord(ofstream &ofs, const vector<Vec2F> &texCoord)
 //****************************************************************************
 //                              writeVertices
 //****************************************************************************
-static void writeVertices(ofstream &ofs, const vector<Vec3F> &vtxList)
+static void writeVertices(OutBuffer &ofs, const vector<Vec3F> &vtxList)
 {
     ofs << "\tsetAttr -s " << vtxList.size() 
                 << " \".vt[0:" << vtxList.size()-1 << "]\"\n";
@@ -890,7 +885,7 @@ static void writeVertices(ofstream &ofs, const vector<Vec3F> &vtxList)
 //****************************************************************************
 //                              writeEdges
 //****************************************************************************
-static void writeEdges(ofstream &ofs, const vector<Vec2UI> &edgeList)
+static void writeEdges(OutBuffer &ofs, const vector<Vec2UI> &edgeList)
 {
     ofs << "\tsetAttr -s " << edgeList.size() 
                 << " \".ed[0:" << edgeList.size()-1 << "]\"\n";
@@ -916,7 +911,7 @@ static void writeEdges(ofstream &ofs, const vector<Vec2UI> &edgeList)
 //****************************************************************************
 static void writeFacets(
 
-    ofstream                    &ofs,
+    OutBuffer                   &ofs,
     const vector<Vec3F>    &vtxList,
     Vec3UIs const    &triList,
     const vector<Vec4UI>    &quadList,
@@ -1014,7 +1009,7 @@ static void writeFacets(
 //****************************************************************************
 static void writeObjects(
 
-    ofstream                        &ofs,
+    OutBuffer                       &ofs,
     const FffMultiObjectC           &model,
     const vector<FffMultiObjectC>   *morphTargets,
     Strings const            *morphNames,
@@ -1126,63 +1121,78 @@ static void writeObjects(
                     texCoord,texTriList,texQuadList);
     }
 
-    // Now the morph targets
-    for (unsigned long mm=0; mm < numTargets; ++mm)
+    // Now the morph targets. These are independent so are formatted concurrently:
+    writeBlocks(ofs,numTargets,[&](size_t mm,OutBuffer & out)
     {
-        string morphGrp = getMorphName((*morphNames)[mm]);
+        writeMorphTarget(out,model,(*morphTargets)[mm],(*morphNames)[mm],edgeMap,edgeList);
+    });
+}
 
-        ofs << "createNode transform -n \"" << morphGrp << "\";\n";
 
-        for (unsigned long objId=0; objId<model.numObjs(); ++objId)
-        {
-            string texFname = model.getTextureFilename(objId);
-            if (texFname.size() == 0)
-                texFname = "";
-
-            const vector<Vec3F> &mVtxList = 
-                (*morphTargets)[mm].getPtList(objId);
-            const vector<Vec3F> &vtxList = model.getPtList(objId);
-            Vec3UIs const &triList = model.getTriList(objId);
-            const vector<Vec4UI> &quadList = model.getQuadList(objId);
-            const vector<Vec2F> &texCoord = model.getTextCoord(objId);
-            Vec3UIs const &texTriList = model.getTexTriList(objId);
-            const vector<Vec4UI> &texQuadList=model.getTexQuadList(objId);
-
-            size_t  numFacets = triList.size() + quadList.size();
-
-            string morphName = 
-                getObjMorphName(model,objId,(*morphNames)[mm]);
-            string morphShapeName = 
-                getObjMorphShapeName(model,objId,(*morphNames)[mm]);
-
-            ofs << "createNode transform -n \"" << morphName << "\" "
-                        << "-p \"" << morphGrp << "\";\n";
-            ofs << "\tsetAttr \".v\" no;\n";
-            ofs << "createNode mesh -n \"" << morphShapeName << "\" "
-                        << "-p \"" << morphName << "\";\n";
-            ofs << "\tsetAttr -k off \".v\";\n";
+//****************************************************************************
+//                              writeMorphTarget
+//****************************************************************************
+static void writeMorphTarget(
 
-            if (texFname != "")
-            {
-                ofs << "\tsetAttr -s 2 \".iog[0].og\";\n";
-                ofs << "\tsetAttr \".iog[0].og[0].gcl\" "
-                            << "-type \"componentList\" 0;\n";
-                ofs << "\tsetAttr \".iog[0].og[1].gcl\" "
-                            << "-type \"componentList\" 1 "
-                            << "\"f[0:" << numFacets-1 << "]\";\n";
-            }
+    OutBuffer                       &ofs,
+    const FffMultiObjectC           &model,
+    const FffMultiObjectC           &morphTarget,
+    string const                    &morphName,
+    const vector<EdgeMapT>          &edgeMap,
+    const vector<vector<Vec2UI> >   &edgeList)
+{
+    string morphGrp = getMorphName(morphName);
 
-            ofs << "\tsetAttr \".uvst[0].uvsn\" -type \"string\" \"map1\";\n"; 
-            ofs << "\tsetAttr \".cuvs\" -type \"string\" \"map1\";\n";
+    ofs << "createNode transform -n \"" << morphGrp << "\";\n";
 
-            // Morph vertices
-            writeVertices(ofs,mVtxList);
+    for (unsigned long objId=0; objId<model.numObjs(); ++objId)
+    {
+        string texFname = model.getTextureFilename(objId);
+        if (texFname.size() == 0)
+            texFname = "";
+
+        const vector<Vec3F> &mVtxList = morphTarget.getPtList(objId);
+        const vector<Vec3F> &vtxList = model.getPtList(objId);
+        Vec3UIs const &triList = model.getTriList(objId);
+        const vector<Vec4UI> &quadList = model.getQuadList(objId);
+        const vector<Vec2F> &texCoord = model.getTextCoord(objId);
+        Vec3UIs const &texTriList = model.getTexTriList(objId);
+        const vector<Vec4UI> &texQuadList=model.getTexQuadList(objId);
+
+        size_t  numFacets = triList.size() + quadList.size();
 
-            // Other info.
-            writeEdges(ofs,edgeList[objId]);
-            writeFacets(ofs,vtxList,triList,quadList,edgeMap[objId],
-                        texCoord,texTriList,texQuadList);
+        string objMorphName = 
+            getObjMorphName(model,objId,morphName);
+        string morphShapeName = 
+            getObjMorphShapeName(model,objId,morphName);
+
+        ofs << "createNode transform -n \"" << objMorphName << "\" "
+                    << "-p \"" << morphGrp << "\";\n";
+        ofs << "\tsetAttr \".v\" no;\n";
+        ofs << "createNode mesh -n \"" << morphShapeName << "\" "
+                    << "-p \"" << objMorphName << "\";\n";
+        ofs << "\tsetAttr -k off \".v\";\n";
+
+        if (texFname != "")
+        {
+            ofs << "\tsetAttr -s 2 \".iog[0].og\";\n";
+            ofs << "\tsetAttr \".iog[0].og[0].gcl\" "
+                        << "-type \"componentList\" 0;\n";
+            ofs << "\tsetAttr \".iog[0].og[1].gcl\" "
+                        << "-type \"componentList\" 1 "
+                        << "\"f[0:" << numFacets-1 << "]\";\n";
         }
+
+        ofs << "\tsetAttr \".uvst[0].uvsn\" -type \"string\" \"map1\";\n"; 
+        ofs << "\tsetAttr \".cuvs\" -type \"string\" \"map1\";\n";
+
+        // Morph vertices
+        writeVertices(ofs,mVtxList);
+
+        // Other info.
+        writeEdges(ofs,edgeList[objId]);
+        writeFacets(ofs,vtxList,triList,quadList,edgeMap[objId],
+                    texCoord,texTriList,texQuadList);
     }
 }
 
@@ -1192,7 +1202,7 @@ static void writeObjects(
 //****************************************************************************
 static int writeShadingMaterialPhong(
 
-    ofstream                    &ofs,
+    OutBuffer                   &ofs,
     const FffMultiObjectC       &model,
     Strings const        *morphNames)
 {
@@ -1259,7 +1269,7 @@ static int writeShadingMaterialPhong(
 //****************************************************************************
 static void writeBlendShapes(
 
-    ofstream                    &ofs, 
+    OutBuffer                   &ofs, 
     const FffMultiObjectC       &model,
     Strings const        *morphNames)
 {
@@ -1366,7 +1376,7 @@ static void writeBlendShapes(
 //****************************************************************************
 static void writePolySoftEdge(
 
-    ofstream                    &ofs, 
+    OutBuffer                   &ofs, 
     const FffMultiObjectC       &model,
     Strings const        *morphNames,
     const vector<int>           &edgeSizeList)
@@ -1410,7 +1420,7 @@ static void writePolySoftEdge(
 //****************************************************************************
 static void connectAttributes(
 
-    ofstream                        &ofs,
+    OutBuffer                       &ofs,
     const FffMultiObjectC           &model,
     Strings const            *morphNames)
 {
@@ -0,0 +1,527 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+
+#include "stdafx.h"
+
+#include "Fg3dMeshMapped.hpp"
+#include "Fg3dMeshIo.hpp"
+#include "FgStdStream.hpp"
+#include "FgSerial.hpp"
+#include "FgCommand.hpp"
+#include "FgApproxEqual.hpp"
+#include "MurmurHash2.h"
+
+using namespace std;
+
+namespace Fg {
+
+namespace {
+
+char const          magic[] = "FGMSHMAP";
+uint32 const        version = 1;
+size_t const        headerSize = 32,
+                    entrySize = 40,
+                    sectionAlign = 64;
+
+enum SectionId : uint32
+{
+    secMeta = 1,            // Names, surface points and marked verts (fgWritep serialized)
+    secVerts,               // Vec3F
+    secUvs,                 // Vec2F
+    secTriPos,              // Vec3UI per surface
+    secTriUv,               // "
+    secQuadPos,             // Vec4UI per surface
+    secQuadUv,              // "
+    secDeltaMorph,          // Per morph, see 'MorphCoding'
+    secTargetInds,          // uint32 per target morph
+    secTargetVerts,         // Vec3F per target morph
+};
+
+uint64
+checksum(uchar const * data,uint64 size)
+{
+    // MurmurHash64A gives the same result on 32 and 64 bit builds but takes an int length,
+    // so hash in chunks and combine:
+    uint64 const        chunk = 1ULL << 30;
+    uint64              ret = 0x3C6EF372FE94F82BULL ^ size;
+    for (uint64 pos=0; pos<size; pos+=chunk)
+        ret = fgHash(ret,MurmurHash64A(data+pos,int(cMin(chunk,size-pos)),0x18D75B7621B4434DULL));
+    return ret;
+}
+
+struct  SectionOut
+{
+    uint32              id;
+    uint32              index;
+    uint32              coding;
+    uint32              count;
+    String              data;
+};
+
+template<class T>
+SectionOut
+rawSection(uint32 id,uint32 index,Svec<T> const & vals)
+{
+    String              data;
+    if (!vals.empty())
+        data.assign(reinterpret_cast<char const *>(vals.data()),sizeof(T)*vals.size());
+    return {id,index,uint32(MorphCoding::raw),uint32(vals.size()),data};
+}
+
+template<class T>
+void
+append(String & str,T const * vals,size_t num)
+{
+    if (num > 0)
+        str.append(reinterpret_cast<char const *>(vals),sizeof(T)*num);
+}
+
+template<class T>
+void
+append(String & str,T val)
+{str.append(reinterpret_cast<char const *>(&val),sizeof(T)); }
+
+SectionOut
+deltaSection(uint32 index,Vec3Fs const & verts,MorphCoding coding)
+{
+    if (coding == MorphCoding::raw)
+        return rawSection(secDeltaMorph,index,verts);
+    // Sparse layout: uint32 inds[N] followed by the values, Vec3F[N] or (float scale, int16[3N]):
+    Uints               inds;
+    for (size_t ii=0; ii<verts.size(); ++ii)
+        if (verts[ii] != Vec3F(0))
+            inds.push_back(uint(ii));
+    SectionOut          ret {secDeltaMorph,index,uint32(coding),uint32(verts.size()),String()};
+    append(ret.data,uint32(inds.size()));
+    append(ret.data,inds.data(),inds.size());
+    if (coding == MorphCoding::sparse) {
+        for (uint idx : inds)
+            append(ret.data,&verts[idx],1);
+    }
+    else {
+        float               maxMag = 0.0f;
+        for (uint idx : inds)
+            maxMag = cMax(maxMag,cMaxElem(mapAbs(verts[idx])));
+        float               scale = (maxMag > 0.0f) ? maxMag / 32767.0f : 1.0f;
+        append(ret.data,scale);
+        Svec<int16>         qs;
+        qs.reserve(3*inds.size());
+        for (uint idx : inds)
+            for (uint dd=0; dd<3; ++dd)
+                qs.push_back(int16(std::round(verts[idx][dd] / scale)));
+        append(ret.data,qs.data(),qs.size());
+    }
+    return ret;
+}
+
+}
+
+void
+saveMeshMapped(Ustring const & fname,Mesh const & mesh,MorphCoding coding)
+{
+    Svec<SectionOut>    sections;
+    {
+        ostringstream       os;
+        fgWritep(os,uint32(mesh.surfaces.size()));
+        for (Surf const & surf : mesh.surfaces) {
+            fgWritep(os,surf.name);
+            fgWritep(os,uint32(surf.surfPoints.size()));
+            for (SurfPoint const & sp : surf.surfPoints) {
+                fgWritep(os,sp.triEquivIdx);
+                fgWritep(os,sp.weights);
+                fgWritep(os,sp.label);
+            }
+        }
+        fgWritep(os,uint32(mesh.markedVerts.size()));
+        for (MarkedVert const & mv : mesh.markedVerts) {
+            fgWritep(os,uint64(mv.idx));
+            fgWritep(os,mv.label);
+        }
+        fgWritep(os,uint32(mesh.deltaMorphs.size()));
+        for (Morph const & morph : mesh.deltaMorphs)
+            fgWritep(os,morph.name);
+        fgWritep(os,uint32(mesh.targetMorphs.size()));
+        for (IndexedMorph const & morph : mesh.targetMorphs)
+            fgWritep(os,morph.name);
+        sections.push_back({secMeta,0,0,0,os.str()});
+    }
+    sections.push_back(rawSection(secVerts,0,mesh.verts));
+    sections.push_back(rawSection(secUvs,0,mesh.uvs));
+    for (size_t ss=0; ss<mesh.surfaces.size(); ++ss) {
+        Surf const &        surf = mesh.surfaces[ss];
+        uint32              idx = uint32(ss);
+        sections.push_back(rawSection(secTriPos,idx,surf.tris.posInds));
+        sections.push_back(rawSection(secTriUv,idx,surf.tris.uvInds));
+        sections.push_back(rawSection(secQuadPos,idx,surf.quads.posInds));
+        sections.push_back(rawSection(secQuadUv,idx,surf.quads.uvInds));
+    }
+    for (size_t ii=0; ii<mesh.deltaMorphs.size(); ++ii) {
+        FGASSERT(mesh.deltaMorphs[ii].verts.size() == mesh.verts.size());
+        sections.push_back(deltaSection(uint32(ii),mesh.deltaMorphs[ii].verts,coding));
+    }
+    for (size_t ii=0; ii<mesh.targetMorphs.size(); ++ii) {
+        IndexedMorph const &    morph = mesh.targetMorphs[ii];
+        sections.push_back(rawSection(secTargetInds,uint32(ii),morph.baseInds));
+        sections.push_back(rawSection(secTargetVerts,uint32(ii),morph.verts));
+    }
+    auto                align = [](uint64 pos) {return (pos + sectionAlign - 1) / sectionAlign * sectionAlign; };
+    uint64              pos = align(headerSize + entrySize * sections.size());
+    Svec<uint64>        offsets;
+    for (SectionOut const & sec : sections) {
+        offsets.push_back(pos);
+        pos = align(pos + sec.data.size());
+    }
+    uint64              fileSize = pos;
+    Ofstream            ofs(fname);
+    ofs.write(magic,8);
+    fgWriteb(ofs,version);
+    fgWriteb(ofs,uint32(sections.size()));
+    fgWriteb(ofs,fileSize);
+    fgWriteb(ofs,uint64(0));
+    for (size_t ii=0; ii<sections.size(); ++ii) {
+        SectionOut const &  sec = sections[ii];
+        fgWriteb(ofs,sec.id);
+        fgWriteb(ofs,sec.index);
+        fgWriteb(ofs,sec.coding);
+        fgWriteb(ofs,sec.count);
+        fgWriteb(ofs,offsets[ii]);
+        fgWriteb(ofs,uint64(sec.data.size()));
+        fgWriteb(ofs,checksum(reinterpret_cast<uchar const *>(sec.data.data()),sec.data.size()));
+    }
+    uint64              written = headerSize + entrySize * sections.size();
+    String const        padding(sectionAlign,'\0');
+    for (size_t ii=0; ii<sections.size(); ++ii) {
+        ofs.write(padding.data(),offsets[ii]-written);
+        ofs.write(sections[ii].data.data(),sections[ii].data.size());
+        written = offsets[ii] + sections[ii].data.size();
+    }
+    ofs.write(padding.data(),fileSize-written);
+}
+
+MeshMapped::MeshMapped(Ustring const & fname,bool verifyChecksums) :
+    m_file(fname), m_verify(verifyChecksums)
+{
+    uchar const *       data = m_file.data();
+    size_t              size = m_file.size();
+    if ((size < headerSize) || (memcmp(data,magic,8) != 0))
+        fgThrow("Not a mapped mesh container file",fname);
+    auto                rd32 = [&](size_t pos) {uint32 v; memcpy(&v,data+pos,4); return v; };
+    auto                rd64 = [&](size_t pos) {uint64 v; memcpy(&v,data+pos,8); return v; };
+    uint32              ver = rd32(8);
+    if (ver > version)
+        fgThrow("Mapped mesh container version is newer than this software supports",fname);
+    uint32              numSections = rd32(12);
+    if ((rd64(16) != size) || (headerSize + entrySize * uint64(numSections) > size))
+        fgThrow("Mapped mesh container file is truncated",fname);
+    m_sections.resize(numSections);
+    m_verified.reset(new atomic<bool>[numSections]());
+    for (size_t ii=0; ii<numSections; ++ii) {
+        size_t              pos = headerSize + entrySize * ii;
+        Section &           sec = m_sections[ii];
+        sec.id = rd32(pos);
+        sec.index = rd32(pos+4);
+        sec.coding = rd32(pos+8);
+        sec.count = rd32(pos+12);
+        sec.offset = rd64(pos+16);
+        sec.size = rd64(pos+24);
+        sec.checksum = rd64(pos+32);
+        if ((sec.offset > size) || (sec.size > size - sec.offset) || (sec.offset % sectionAlign != 0))
+            fgThrow("Mapped mesh container section out of bounds",fname);
+    }
+    Section const *     meta = find(secMeta,0);
+    if (meta == nullptr)
+        fgThrow("Mapped mesh container has no metadata section",fname);
+    uchar const *       metaData = access(*meta);
+    istringstream       is(String(reinterpret_cast<char const *>(metaData),meta->size));
+    is.exceptions(ios::failbit | ios::badbit | ios::eofbit);
+    try {
+        uint32              num = fgReadpT<uint32>(is);
+        m_surfNames.resize(num);
+        m_surfPoints.resize(num);
+        for (size_t ss=0; ss<num; ++ss) {
+            fgReadp(is,m_surfNames[ss]);
+            uint32              numPts = fgReadpT<uint32>(is);
+            for (uint32 ii=0; ii<numPts; ++ii) {
+                SurfPoint           sp;
+                fgReadp(is,sp.triEquivIdx);
+                fgReadp(is,sp.weights);
+                fgReadp(is,sp.label);
+                m_surfPoints[ss].push_back(sp);
+            }
+        }
+        num = fgReadpT<uint32>(is);
+        for (uint32 ii=0; ii<num; ++ii) {
+            MarkedVert          mv;
+            mv.idx = size_t(fgReadpT<uint64>(is));
+            fgReadp(is,mv.label);
+            m_markedVerts.push_back(mv);
+        }
+        m_deltaNames.resize(fgReadpT<uint32>(is));
+        for (Ustring & name : m_deltaNames)
+            fgReadp(is,name);
+        m_targetNames.resize(fgReadpT<uint32>(is));
+        for (Ustring & name : m_targetNames)
+            fgReadp(is,name);
+    }
+    catch (std::ios_base::failure const &) {
+        fgThrow("Mapped mesh container metadata is corrupt",fname);
+    }
+}
+
+MeshMapped::Section const *
+MeshMapped::find(uint32 id,uint32 index) const
+{
+    for (Section const & sec : m_sections)
+        if ((sec.id == id) && (sec.index == index))
+            return &sec;
+    return nullptr;
+}
+
+uchar const *
+MeshMapped::access(Section const & sec) const
+{
+    uchar const *       ptr = m_file.data() + sec.offset;
+    if (m_verify) {
+        atomic<bool> &      verified = m_verified[&sec - m_sections.data()];
+        if (!verified.load(memory_order_acquire)) {
+            if (checksum(ptr,sec.size) != sec.checksum)
+                fgThrow("Mapped mesh container section checksum failure",toStr(sec.id)+":"+toStr(sec.index));
+            verified.store(true,memory_order_release);
+        }
+    }
+    return ptr;
+}
+
+template<class T>
+MappedArr<T>
+MeshMapped::arr(uint32 id,uint32 index) const
+{
+    MappedArr<T>        ret;
+    Section const *     sec = find(id,index);
+    if (sec != nullptr) {
+        if (sec->size != sizeof(T) * uint64(sec->count))
+            fgThrow("Mapped mesh container section size inconsistent",toStr(id));
+        ret.ptr = reinterpret_cast<T const *>(access(*sec));
+        ret.num = sec->count;
+    }
+    return ret;
+}
+
+MappedArr<Vec3F>
+MeshMapped::verts() const
+{return arr<Vec3F>(secVerts,0); }
+
+MappedArr<Vec2F>
+MeshMapped::uvs() const
+{return arr<Vec2F>(secUvs,0); }
+
+MappedArr<Vec3UI>
+MeshMapped::triPosInds(size_t surfIdx) const
+{return arr<Vec3UI>(secTriPos,uint32(surfIdx)); }
+
+MappedArr<Vec3UI>
+MeshMapped::triUvInds(size_t surfIdx) const
+{return arr<Vec3UI>(secTriUv,uint32(surfIdx)); }
+
+MappedArr<Vec4UI>
+MeshMapped::quadPosInds(size_t surfIdx) const
+{return arr<Vec4UI>(secQuadPos,uint32(surfIdx)); }
+
+MappedArr<Vec4UI>
+MeshMapped::quadUvInds(size_t surfIdx) const
+{return arr<Vec4UI>(secQuadUv,uint32(surfIdx)); }
+
+Vec3Fs
+MeshMapped::deltaMorph(size_t idx) const
+{
+    FGASSERT(idx < m_deltaNames.size());
+    MorphCoding         coding;
+    Section const *     sec = find(secDeltaMorph,uint32(idx));
+    if (sec == nullptr)
+        fgThrow("Mapped mesh container delta morph section missing",m_deltaNames[idx]);
+    coding = MorphCoding(sec->coding);
+    if (coding == MorphCoding::raw)
+        return arr<Vec3F>(secDeltaMorph,uint32(idx)).copy();
+    uchar const *       ptr = access(*sec);
+    uint64              numVerts = sec->count;
+    uint32              num;
+    if (sec->size < 4)
+        fgThrow("Mapped mesh container delta morph corrupt",m_deltaNames[idx]);
+    memcpy(&num,ptr,4);
+    uint64              valSize = (coding == MorphCoding::sparse) ? 12 * uint64(num) : 4 + 6 * uint64(num);
+    if (sec->size != 4 + 4 * uint64(num) + valSize)
+        fgThrow("Mapped mesh container delta morph corrupt",m_deltaNames[idx]);
+    Vec3Fs              ret(numVerts,Vec3F(0));
+    uint32 const *      inds = reinterpret_cast<uint32 const *>(ptr+4);
+    uchar const *       vals = ptr + 4 + 4 * uint64(num);
+    if (coding == MorphCoding::sparse) {
+        Vec3F const *       vs = reinterpret_cast<Vec3F const *>(vals);
+        for (size_t ii=0; ii<num; ++ii) {
+            FGASSERT(inds[ii] < numVerts);
+            ret[inds[ii]] = vs[ii];
+        }
+    }
+    else if (coding == MorphCoding::quant16) {
+        float               scale;
+        memcpy(&scale,vals,4);
+        int16 const *       qs = reinterpret_cast<int16 const *>(vals+4);
+        for (size_t ii=0; ii<num; ++ii) {
+            FGASSERT(inds[ii] < numVerts);
+            Vec3F &             v = ret[inds[ii]];
+            for (uint dd=0; dd<3; ++dd)
+                v[dd] = float(qs[3*ii+dd]) * scale;
+        }
+    }
+    else
+        fgThrow("Mapped mesh container delta morph coding unknown",toStr(sec->coding));
+    return ret;
+}
+
+IndexedMorph
+MeshMapped::targetMorph(size_t idx) const
+{
+    FGASSERT(idx < m_targetNames.size());
+    IndexedMorph        ret;
+    ret.name = m_targetNames[idx];
+    ret.baseInds = arr<uint>(secTargetInds,uint32(idx)).copy();
+    ret.verts = arr<Vec3F>(secTargetVerts,uint32(idx)).copy();
+    FGASSERT(ret.baseInds.size() == ret.verts.size());
+    return ret;
+}
+
+Mesh
+MeshMapped::toMesh(Svec<bool> const & deltas,Svec<bool> const & targets) const
+{
+    Mesh                ret;
+    ret.verts = verts().copy();
+    ret.uvs = uvs().copy();
+    ret.surfaces.resize(numSurfs());
+    for (size_t ss=0; ss<numSurfs(); ++ss) {
+        Surf &              surf = ret.surfaces[ss];
+        surf.name = m_surfNames[ss];
+        surf.tris.posInds = triPosInds(ss).copy();
+        surf.tris.uvInds = triUvInds(ss).copy();
+        surf.quads.posInds = quadPosInds(ss).copy();
+        surf.quads.uvInds = quadUvInds(ss).copy();
+        surf.surfPoints = m_surfPoints[ss];
+    }
+    ret.markedVerts = m_markedVerts;
+    for (size_t ii=0; ii<deltas.size(); ++ii) {
+        if (deltas[ii]) {
+            Morph               morph {m_deltaNames[ii]};
+            morph.verts = deltaMorph(ii);
+            ret.deltaMorphs.push_back(morph);
+        }
+    }
+    for (size_t ii=0; ii<targets.size(); ++ii)
+        if (targets[ii])
+            ret.targetMorphs.push_back(targetMorph(ii));
+    return ret;
+}
+
+Mesh
+MeshMapped::toMesh() const
+{return toMesh(Svec<bool>(m_deltaNames.size(),true),Svec<bool>(m_targetNames.size(),true)); }
+
+Mesh
+MeshMapped::toMesh(Ustrings const & morphNames) const
+{
+    Svec<bool>          deltas(m_deltaNames.size(),false),
+                        targets(m_targetNames.size(),false);
+    for (Ustring const & name : morphNames) {
+        size_t              di = findFirstIdx(m_deltaNames,name),
+                            ti = findFirstIdx(m_targetNames,name);
+        if (di < deltas.size())
+            deltas[di] = true;
+        else if (ti < targets.size())
+            targets[ti] = true;
+        else
+            fgThrow("Morph not found in mapped mesh container",name);
+    }
+    return toMesh(deltas,targets);
+}
+
+void
+testMeshMapped(CLArgs const &)
+{
+    TestDir             td("meshMapped");
+    Mesh                mesh = loadTri(dataDir()+"base/Jane.tri");
+    FGASSERT(!mesh.deltaMorphs.empty() && !mesh.targetMorphs.empty());
+    Svec<pair<MorphCoding,String> > codings {
+        {MorphCoding::raw,"raw.fgmm"},
+        {MorphCoding::sparse,"sparse.fgmm"},
+        {MorphCoding::quant16,"quant16.fgmm"},
+    };
+    for (auto const & cf : codings) {
+        saveMeshMapped(cf.second,mesh,cf.first);
+        MeshMapped          mm {cf.second};
+        // Zero-copy views:
+        FGASSERT(mm.verts().copy() == mesh.verts);
+        FGASSERT(mm.uvs().copy() == mesh.uvs);
+        FGASSERT(mm.numSurfs() == mesh.surfaces.size());
+        for (size_t ss=0; ss<mm.numSurfs(); ++ss) {
+            Surf const &        surf = mesh.surfaces[ss];
+            FGASSERT(mm.surfName(ss) == surf.name);
+            FGASSERT(mm.triPosInds(ss).copy() == surf.tris.posInds);
+            FGASSERT(mm.triUvInds(ss).copy() == surf.tris.uvInds);
+            FGASSERT(mm.quadPosInds(ss).copy() == surf.quads.posInds);
+            FGASSERT(mm.quadUvInds(ss).copy() == surf.quads.uvInds);
+        }
+        Mesh                full = mm.toMesh();
+        FGASSERT(full.markedVertPositions() == mesh.markedVertPositions());
+        FGASSERT(full.surfPointPositions() == mesh.surfPointPositions());
+        FGASSERT(full.morphNames() == mesh.morphNames());
+        for (size_t ii=0; ii<mesh.targetMorphs.size(); ++ii) {
+            FGASSERT(full.targetMorphs[ii].baseInds == mesh.targetMorphs[ii].baseInds);
+            FGASSERT(full.targetMorphs[ii].verts == mesh.targetMorphs[ii].verts);
+        }
+        for (size_t ii=0; ii<mesh.deltaMorphs.size(); ++ii) {
+            Vec3Fs const &      ref = mesh.deltaMorphs[ii].verts;
+            Vec3Fs const &      tst = full.deltaMorphs[ii].verts;
+            if (cf.first == MorphCoding::quant16) {
+                float               maxMag = cMaxElem(mapAbs(cBounds(ref)));
+                FGASSERT(isApproxEqual(ref,tst,maxMag/32767.0));
+            }
+            else
+                FGASSERT(ref == tst);
+        }
+    }
+    // Selective morph load:
+    MeshMapped          mm {"sparse.fgmm"};
+    Ustrings            names {mesh.deltaMorphs.back().name,mesh.targetMorphs[0].name};
+    Mesh                part = mm.toMesh(names);
+    FGASSERT(part.deltaMorphs.size() == 1);
+    FGASSERT(part.targetMorphs.size() == 1);
+    FGASSERT(part.deltaMorphs[0].verts == mesh.deltaMorphs.back().verts);
+    // Corrupt a byte in the section data. The container still opens but access to that section throws:
+    String              raw = loadRawString("raw.fgmm");
+    raw[raw.size()/2] ^= 0x5A;
+    saveRaw(raw,"corrupt.fgmm");
+    MeshMapped          corrupt {"corrupt.fgmm"};
+    bool                threw = false;
+    try {corrupt.toMesh(); }
+    catch (FgException const &) {threw = true; }
+    FGASSERT(threw);
+    // A failed verification is not cached:
+    threw = false;
+    try {corrupt.toMesh(); }
+    catch (FgException const &) {threw = true; }
+    FGASSERT(threw);
+    // Sections are verified once then accessed directly:
+    MeshMapped          valid {"raw.fgmm"};
+    for (size_t ii=0; ii<1000; ++ii)
+        FGASSERT(valid.verts().size() == mesh.verts.size());
+    // Truncation is detected on open:
+    saveRaw(raw.substr(0,raw.size()-64),"truncated.fgmm");
+    threw = false;
+    try {MeshMapped tr {"truncated.fgmm"}; }
+    catch (FgException const &) {threw = true; }
+    FGASSERT(threw);
+}
+
+}
+
+// */
@@ -0,0 +1,117 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Versioned binary mesh container designed to be used directly from a memory map.
+//
+// Layout, in native byte order (so files are not portable to big-endian platforms):
+//
+//   Header (32 bytes):     "FGMSHMAP", uint32 version, uint32 numSections, uint64 fileSize, uint64 0
+//   Section table:         numSections x SectionEntry (40 bytes, see .cpp)
+//   Sections:              each starting on a 64 byte boundary
+//
+// Vertex, UV and facet index sections are raw arrays which are returned as views into the mapped
+// file without copying. Each delta morph is a separate section so only the morphs required need
+// be touched, optionally stored sparse (lossless) or sparse and quantized to 16 bits.
+// Each section has a 64-bit checksum which (unless disabled) is verified on the first access to that
+// section, so later accesses cost nothing.
+//
+
+#ifndef FG3DMESHMAPPED_HPP
+#define FG3DMESHMAPPED_HPP
+
+#include "Fg3dMesh.hpp"
+#include "FgFileSystem.hpp"
+
+namespace Fg {
+
+enum struct MorphCoding
+{
+    raw,        // Float for every vertex
+    sparse,     // Only non-zero deltas are stored. Lossless.
+    quant16,    // As sparse but quantized to 16 bits per component relative to the max magnitude
+};
+
+void
+saveMeshMapped(Ustring const & fname,Mesh const & mesh,MorphCoding deltaMorphCoding=MorphCoding::sparse);
+
+// Read-only view of a contiguous array inside a mapped file:
+template<class T>
+struct  MappedArr
+{
+    T const *           ptr = nullptr;
+    size_t              num = 0;
+
+    size_t              size() const {return num; }
+    bool                empty() const {return (num == 0); }
+    T const *           begin() const {return ptr; }
+    T const *           end() const {return ptr+num; }
+    T const &           operator[](size_t idx) const {return ptr[idx]; }
+    Svec<T>             copy() const {return Svec<T>(ptr,ptr+num); }
+};
+
+struct  MeshMapped
+{
+    // Throws if the file is not a valid container of a supported version:
+    explicit MeshMapped(Ustring const & fname,bool verifyChecksums=true);
+
+    MappedArr<Vec3F>    verts() const;
+    MappedArr<Vec2F>    uvs() const;
+    size_t              numSurfs() const {return m_surfNames.size(); }
+    Ustring const &     surfName(size_t surfIdx) const {return m_surfNames.at(surfIdx); }
+    MappedArr<Vec3UI>   triPosInds(size_t surfIdx) const;
+    MappedArr<Vec3UI>   triUvInds(size_t surfIdx) const;
+    MappedArr<Vec4UI>   quadPosInds(size_t surfIdx) const;
+    MappedArr<Vec4UI>   quadUvInds(size_t surfIdx) const;
+
+    Ustrings const &    deltaMorphNames() const {return m_deltaNames; }
+    Ustrings const &    targetMorphNames() const {return m_targetNames; }
+    // Decodes a single delta morph to a full per-vertex delta list:
+    Vec3Fs              deltaMorph(size_t idx) const;
+    IndexedMorph        targetMorph(size_t idx) const;
+
+    // Full mesh, including all morphs:
+    Mesh                toMesh() const;
+    // Mesh including only the named morphs (delta or target). Throws if any is not found:
+    Mesh                toMesh(Ustrings const & morphNames) const;
+
+private:
+    struct  Section
+    {
+        uint32              id;
+        uint32              index;
+        uint32              coding;
+        uint32              count;
+        uint64              offset;
+        uint64              size;
+        uint64              checksum;
+    };
+    MappedFile          m_file;
+    bool                m_verify;
+    Svec<Section>       m_sections;
+    // 1-1 with 'm_sections'. Set once the checksum has been verified. Sections may be accessed
+    // concurrently and at worst are verified more than once:
+    std::unique_ptr<std::atomic<bool>[]>    m_verified;
+    Ustrings            m_surfNames;
+    Svec<SurfPoints>    m_surfPoints;
+    MarkedVerts         m_markedVerts;
+    Ustrings            m_deltaNames;
+    Ustrings            m_targetNames;
+
+    Section const *     find(uint32 id,uint32 index) const;     // Returns null if not present
+    uchar const *       access(Section const & sec) const;      // Checksum verified on first access
+
+    template<class T>
+    MappedArr<T>
+    arr(uint32 id,uint32 index) const;
+
+    Mesh
+    toMesh(Svec<bool> const & deltas,Svec<bool> const & targets) const;
+};
+
+}
+
+#endif
+
+// */
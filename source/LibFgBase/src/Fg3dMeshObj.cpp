@@ -17,6 +17,7 @@
 #include "FgParse.hpp"
 #include "Fg3dNormals.hpp"
 #include "FgTestUtils.hpp"
+#include "FgMemory.hpp"
 
 using namespace std;
 
@@ -154,6 +155,7 @@ loadWObj(
     Ustring const &     fname,
     string              surfSeparator)
 {
+    MemTagScope         mts(MemTag::mesh);
     Mesh                mesh;
     string              currName;
     map<string,Surf>    surfs;
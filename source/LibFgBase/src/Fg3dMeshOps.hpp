@@ -108,6 +108,8 @@ struct  MorphVal
 
     MorphVal() {}
     MorphVal(Ustring const & name_,float val_) : name(name_), val(val_) {}
+
+    FG_SERIALIZE2(name,val);
 };
 typedef Svec<MorphVal>  MorphVals;
 
@@ -13,24 +13,390 @@
 #include "FgFileSystem.hpp"
 #include "FgCommand.hpp"
 #include "FgTestUtils.hpp"
+#include "FgParse.hpp"
+#include "FgBounds.hpp"
+#include "FgApproxEqual.hpp"
 
 using namespace std;
 
 namespace Fg {
 
+namespace {
+
+enum struct PlyType {int8, uint8, int16, uint16, int32, uint32, float32, float64};
+
+PlyType
+plyType(String const & name)
+{
+    static map<String,PlyType>  types = {
+        {"char",PlyType::int8},     {"int8",PlyType::int8},
+        {"uchar",PlyType::uint8},   {"uint8",PlyType::uint8},
+        {"short",PlyType::int16},   {"int16",PlyType::int16},
+        {"ushort",PlyType::uint16}, {"uint16",PlyType::uint16},
+        {"int",PlyType::int32},     {"int32",PlyType::int32},
+        {"uint",PlyType::uint32},   {"uint32",PlyType::uint32},
+        {"float",PlyType::float32}, {"float32",PlyType::float32},
+        {"double",PlyType::float64},{"float64",PlyType::float64},
+    };
+    auto            it = types.find(name);
+    if (it == types.end())
+        fgThrow("PLY unsupported property type",name);
+    return it->second;
+}
+
+struct  PlyProp
+{
+    String          name;
+    PlyType         type;
+    bool            isList;
+    PlyType         countType;      // Only valid if 'isList'
+};
+
+struct  PlyElem
+{
+    String          name;
+    size_t          count;
+    Svec<PlyProp>   props;
+};
+
+enum struct PlyFormat {ascii, binaryLE, binaryBE};
+
+// Sequential reader of property values from the body of a PLY file. ASCII data must be null
+// terminated:
+struct  PlyReader
+{
+    char const *        ptr;
+    char const *        end;
+    PlyFormat           format;
+
+    double
+    read(PlyType type)
+    {
+        if (format == PlyFormat::ascii)
+            return readAscii();
+        static size_t const sizes[] = {1,1,2,2,4,4,4,8};
+        size_t          sz = sizes[size_t(type)];
+        if (size_t(end-ptr) < sz)
+            fgThrow("PLY file truncated");
+        char            buf[8];
+        memcpy(buf,ptr,sz);
+        ptr += sz;
+        if (format == PlyFormat::binaryBE)
+            std::reverse(buf,buf+sz);
+        switch (type) {
+            case PlyType::int8: return double(int8(buf[0]));
+            case PlyType::uint8: return double(uchar(buf[0]));
+            case PlyType::int16: return double(fromBytes<int16>(buf));
+            case PlyType::uint16: return double(fromBytes<uint16>(buf));
+            case PlyType::int32: return double(fromBytes<int32>(buf));
+            case PlyType::uint32: return double(fromBytes<uint32>(buf));
+            case PlyType::float32: return double(fromBytes<float>(buf));
+            case PlyType::float64: return fromBytes<double>(buf);
+        }
+        return 0.0;
+    }
+
+private:
+    template<class T>
+    static T
+    fromBytes(char const * buf)
+    {
+        T           ret;
+        memcpy(&ret,buf,sizeof(T));
+        return ret;
+    }
+
+    double
+    readAscii()
+    {
+        while ((ptr < end) && isspace(uchar(*ptr)))
+            ++ptr;
+        if (ptr == end)
+            fgThrow("PLY file truncated");
+        char *          next;
+        double          ret = strtod(ptr,&next);
+        if (next == ptr)
+            fgThrow("PLY invalid ASCII value",String(ptr,std::min(size_t(end-ptr),size_t(16))));
+        ptr = next;
+        return ret;
+    }
+};
+
+// Vertex property slots:
+enum PlySlot {px,py,pz, nx,ny,nz, cr,cg,cb,ca, tu,tv, numSlots};
+
+int
+plyVertSlot(String const & name)
+{
+    static map<String,int>      slots = {
+        {"x",px}, {"y",py}, {"z",pz},
+        {"nx",nx}, {"ny",ny}, {"nz",nz},
+        {"red",cr}, {"green",cg}, {"blue",cb}, {"alpha",ca},
+        {"r",cr}, {"g",cg}, {"b",cb}, {"a",ca},
+        {"diffuse_red",cr}, {"diffuse_green",cg}, {"diffuse_blue",cb}, {"diffuse_alpha",ca},
+        {"s",tu}, {"t",tv}, {"u",tu}, {"v",tv},
+        {"texture_u",tu}, {"texture_v",tv}, {"texture_s",tu}, {"texture_t",tv},
+    };
+    auto            it = slots.find(name);
+    return (it == slots.end()) ? -1 : it->second;
+}
+
+uchar
+plyColorComponent(double val,PlyType type)
+{
+    if ((type == PlyType::float32) || (type == PlyType::float64))
+        val *= 255.0;
+    return uchar(clampBounds(val+0.5,0.0,255.0));
+}
+
+}
+
+Mesh
+loadPly(Ustring const & fname,MeshVertAttribs * attribs)
+{
+    MappedFile          file(fname);
+    char const *        data = reinterpret_cast<char const *>(file.data());
+    size_t              size = file.size();
+    // Parse header:
+    String const        endHeader = "end_header";
+    char const *        headerEnd = std::search(data,data+size,endHeader.begin(),endHeader.end());
+    if ((size < 3) || (String(data,3) != "ply") || (headerEnd == data+size))
+        fgThrow("Not a valid PLY file",fname);
+    char const *        body = std::find(headerEnd,data+size,'\n');
+    if (body < data+size)
+        ++body;
+    PlyFormat           format = PlyFormat::ascii;
+    bool                formatFound = false;
+    Svec<PlyElem>       elems;
+    Strings             lines = splitLines(String(data,headerEnd));
+    for (String const & line : lines) {
+        Strings             toks = splitWhitespace(line);
+        if (toks.empty())
+            continue;
+        if (toks[0] == "format") {
+            if (toks.size() < 2)
+                fgThrow("PLY invalid format line",fname);
+            if (toks[1] == "ascii")
+                format = PlyFormat::ascii;
+            else if (toks[1] == "binary_little_endian")
+                format = PlyFormat::binaryLE;
+            else if (toks[1] == "binary_big_endian")
+                format = PlyFormat::binaryBE;
+            else
+                fgThrow("PLY unsupported format",toks[1]);
+            formatFound = true;
+        }
+        else if (toks[0] == "element") {
+            if (toks.size() != 3)
+                fgThrow("PLY invalid element line",line);
+            elems.push_back({toks[1],fromStrThrow<size_t>(toks[2]),{}});
+        }
+        else if (toks[0] == "property") {
+            if (elems.empty())
+                fgThrow("PLY property before element",line);
+            if ((toks.size() == 5) && (toks[1] == "list"))
+                elems.back().props.push_back({toks[4],plyType(toks[3]),true,plyType(toks[2])});
+            else if (toks.size() == 3)
+                elems.back().props.push_back({toks[2],plyType(toks[1]),false,PlyType::uint8});
+            else
+                fgThrow("PLY invalid property line",line);
+        }
+    }
+    if (!formatFound)
+        fgThrow("PLY format not specified",fname);
+    // ASCII parsing requires null termination so copy the body:
+    String              asciiBody;
+    PlyReader           rdr {body,data+size,format};
+    if (format == PlyFormat::ascii) {
+        asciiBody.assign(body,data+size);
+        rdr.ptr = asciiBody.c_str();
+        rdr.end = rdr.ptr + asciiBody.size();
+    }
+    Mesh                ret;
+    Vec3Fs              normals;
+    Svec<RgbaUC>        colors;
+    Vec2Fs              vertUvs;
+    map<int,size_t>     texToSurf;
+    auto                getSurf = [&](int texNum) -> Surf &
+    {
+        auto                it = texToSurf.find(texNum);
+        if (it != texToSurf.end())
+            return ret.surfaces[it->second];
+        texToSurf[texNum] = ret.surfaces.size();
+        ret.surfaces.emplace_back();
+        return ret.surfaces.back();
+    };
+    for (PlyElem const & elem : elems) {
+        if (elem.name == "vertex") {
+            FGASSERT(ret.verts.empty());
+            Svec<int>           slots;
+            bool                hasSlot[numSlots] {};
+            for (PlyProp const & prop : elem.props) {
+                int                 slot = prop.isList ? -1 : plyVertSlot(prop.name);
+                slots.push_back(slot);
+                if (slot >= 0)
+                    hasSlot[slot] = true;
+            }
+            if (!hasSlot[px] || !hasSlot[py] || !hasSlot[pz])
+                fgThrow("PLY vertex element has no x,y,z properties",fname);
+            bool                hasNorms = hasSlot[nx] && hasSlot[ny] && hasSlot[nz],
+                                hasColors = hasSlot[cr] && hasSlot[cg] && hasSlot[cb],
+                                hasUvs = hasSlot[tu] && hasSlot[tv];
+            ret.verts.resize(elem.count);
+            if (hasNorms)
+                normals.resize(elem.count);
+            if (hasColors)
+                colors.resize(elem.count);
+            if (hasUvs)
+                vertUvs.resize(elem.count);
+            double              vals[numSlots];
+            uchar               cvals[4];
+            for (size_t ii=0; ii<elem.count; ++ii) {
+                vals[ca] = 1.0;
+                cvals[3] = 255;
+                for (size_t pp=0; pp<elem.props.size(); ++pp) {
+                    PlyProp const &     prop = elem.props[pp];
+                    if (prop.isList) {
+                        size_t              num = size_t(rdr.read(prop.countType));
+                        for (size_t jj=0; jj<num; ++jj)
+                            rdr.read(prop.type);
+                    }
+                    else {
+                        double              val = rdr.read(prop.type);
+                        int                 slot = slots[pp];
+                        if (slot >= cr && slot <= ca)
+                            cvals[slot-cr] = plyColorComponent(val,prop.type);
+                        else if (slot >= 0)
+                            vals[slot] = val;
+                    }
+                }
+                ret.verts[ii] = Vec3F(vals[px],vals[py],vals[pz]);
+                if (hasNorms)
+                    normals[ii] = Vec3F(vals[nx],vals[ny],vals[nz]);
+                if (hasColors)
+                    colors[ii] = RgbaUC(cvals[0],cvals[1],cvals[2],cvals[3]);
+                if (hasUvs)
+                    vertUvs[ii] = Vec2F(vals[tu],vals[tv]);
+            }
+        }
+        else if (elem.name == "face") {
+            bool                hasPoly = false;
+            for (PlyProp const & prop : elem.props)
+                if (prop.isList && ((prop.name == "vertex_indices") || (prop.name == "vertex_index")))
+                    hasPoly = true;
+            if (!hasPoly)
+                fgThrow("PLY face element has no vertex_indices property",fname);
+            Svec<uint>          poly;
+            Vec2Fs              polyUvs;
+            for (size_t ii=0; ii<elem.count; ++ii) {
+                int                 texNum = 0;
+                poly.clear();
+                polyUvs.clear();
+                for (PlyProp const & prop : elem.props) {
+                    if (prop.isList) {
+                        size_t              num = size_t(rdr.read(prop.countType));
+                        if ((prop.name == "vertex_indices") || (prop.name == "vertex_index")) {
+                            for (size_t jj=0; jj<num; ++jj) {
+                                double              idx = rdr.read(prop.type);
+                                if ((idx < 0) || (idx >= double(ret.verts.size())))
+                                    fgThrow("PLY vertex index out of bounds",toStr(idx));
+                                poly.push_back(uint(idx));
+                            }
+                        }
+                        else if (prop.name == "texcoord") {
+                            for (size_t jj=0; jj<num/2; ++jj) {
+                                float               u = float(rdr.read(prop.type));
+                                polyUvs.push_back(Vec2F(u,float(rdr.read(prop.type))));
+                            }
+                            if (num % 2 == 1)
+                                rdr.read(prop.type);
+                        }
+                        else
+                            for (size_t jj=0; jj<num; ++jj)
+                                rdr.read(prop.type);
+                    }
+                    else {
+                        double              val = rdr.read(prop.type);
+                        if (prop.name == "texnumber")
+                            texNum = int(val);
+                    }
+                }
+                if (poly.size() < 3)
+                    continue;               // Degenerate
+                Surf &              surf = getSurf(texNum);
+                bool                faceUvs = (polyUvs.size() == poly.size());
+                Svec<uint>          uvInds;
+                if (faceUvs) {
+                    for (Vec2F uv : polyUvs) {
+                        uvInds.push_back(uint(ret.uvs.size()));
+                        ret.uvs.push_back(uv);
+                    }
+                }
+                else if (!vertUvs.empty())
+                    uvInds = poly;
+                bool                withUvs = !uvInds.empty();
+                if (poly.size() == 4) {
+                    surf.quads.posInds.push_back(Vec4UI(poly[0],poly[1],poly[2],poly[3]));
+                    if (withUvs)
+                        surf.quads.uvInds.push_back(Vec4UI(uvInds[0],uvInds[1],uvInds[2],uvInds[3]));
+                }
+                else {
+                    for (size_t jj=2; jj<poly.size(); ++jj) {       // Fan larger polygons
+                        surf.tris.posInds.push_back(Vec3UI(poly[0],poly[jj-1],poly[jj]));
+                        if (withUvs)
+                            surf.tris.uvInds.push_back(Vec3UI(uvInds[0],uvInds[jj-1],uvInds[jj]));
+                    }
+                }
+            }
+        }
+        else {
+            for (size_t ii=0; ii<elem.count; ++ii) {
+                for (PlyProp const & prop : elem.props) {
+                    size_t              num = prop.isList ? size_t(rdr.read(prop.countType)) : 1;
+                    for (size_t jj=0; jj<num; ++jj)
+                        rdr.read(prop.type);
+                }
+            }
+        }
+    }
+    // Per-vertex UVs are only used when no per-face UVs were given:
+    if (ret.uvs.empty() && !vertUvs.empty()) {
+        ret.uvs = vertUvs;
+        for (Surf & surf : ret.surfaces) {
+            if (surf.tris.uvInds.empty())
+                surf.tris.uvInds = surf.tris.posInds;
+            if (surf.quads.uvInds.empty())
+                surf.quads.uvInds = surf.quads.posInds;
+        }
+    }
+    // Surfaces with a mix of faces with and without UVs cannot be represented so drop the UVs:
+    for (Surf & surf : ret.surfaces) {
+        if (surf.tris.uvInds.size() != surf.tris.posInds.size())
+            surf.tris.uvInds.clear();
+        if (surf.quads.uvInds.size() != surf.quads.posInds.size())
+            surf.quads.uvInds.clear();
+    }
+    if (attribs != nullptr) {
+        attribs->normals = normals;
+        attribs->colors = colors;
+    }
+    return ret;
+}
+
 void
 savePly(
-    Ustring const &        fname,
-    Meshes const & meshes,
-    string                  imgFormat)
+    Ustring const &         fname,
+    Meshes const &          meshes,
+    string                  imgFormat,
+    bool                    binary)
 {
-    Mesh    mesh = mergeMeshes(meshes);
-    Path      path(fname);
+    Mesh                mesh = mergeMeshes(meshes);
+    Path                path(fname);
     path.ext = "ply";
-    Ofstream  ofs(path.str());
+    BufferedOfstream    ofs(path.str());
     ofs <<
         "ply\n"
-        "format ascii 1.0\n"
+        << (binary ? "format binary_little_endian 1.0\n" : "format ascii 1.0\n") <<
         "comment created by FaceGen\n";
     size_t      imgCnt = 0;
     for (size_t ii=0; ii<mesh.surfaces.size(); ++ii) {
@@ -56,7 +422,12 @@ savePly(
     for (size_t vv=0; vv<mesh.verts.size(); ++vv) {
         Vec3F    pos = mesh.verts[vv],
                     nrm = norms.vert[vv];
-        ofs << pos[0] << " " << pos[1] << " " << pos[2] << " " << nrm[0] << " " << nrm[1] << " " << nrm[2] << "\n";
+        if (binary) {
+            ofs.writeb(pos);
+            ofs.writeb(nrm);
+        }
+        else
+            ofs << pos[0] << " " << pos[1] << " " << pos[2] << " " << nrm[0] << " " << nrm[1] << " " << nrm[2] << "\n";
     }
     imgCnt = 0;
     for (size_t ss=0; ss<mesh.surfaces.size(); ++ss) {
@@ -64,21 +435,33 @@ savePly(
         FacetInds<3>          tris = surf.getTriEquivs();
         for (size_t ii=0; ii<tris.size(); ++ii) {
             Vec3UI           vinds = tris.posInds[ii];
-            ofs << "3 " << vinds[0] << " " << vinds[1] << " " << vinds[2] << " 6 ";
-            if (surf.tris.uvInds.empty())
-                ofs << "0 0 0 0 0 0 ";
-            else {
+            Mat<float,6,1>   uvs(0.0f);
+            if (tris.uvInds.size() == tris.posInds.size()) {
                 Vec3UI   uvInds = tris.uvInds[ii];
                 for (uint vv=0; vv<3; ++vv) {
                     Vec2F    uv = mesh.uvs[uvInds[vv]];
-                    ofs << uv[0] << " " << uv[1] << " ";
+                    uvs[2*vv] = uv[0];
+                    uvs[2*vv+1] = uv[1];
                 }
             }
-            ofs << imgCnt << "\n";
+            if (binary) {
+                ofs.writeb(uchar(3));
+                ofs.writeb(Mat<int32,3,1>(vinds));
+                ofs.writeb(uchar(6));
+                ofs.writeb(uvs);
+                ofs.writeb(int32(imgCnt));
+            }
+            else {
+                ofs << "3 " << vinds[0] << " " << vinds[1] << " " << vinds[2] << " 6 ";
+                for (uint jj=0; jj<6; ++jj)
+                    ofs << uvs[jj] << " ";
+                ofs << imgCnt << "\n";
+            }
         }
         if (mesh.surfaces[ss].material.albedoMap)
             ++imgCnt;
     }
+    ofs.close();
 }
 
 void
@@ -97,6 +480,124 @@ fgSavePlyTest(CLArgs const & args)
     regressFileRel("meshExportPly1.png","base/test/");
 }
 
+
+template<class T>
+static void
+appendBigEndian(String & str,T val)
+{
+    char                buf[sizeof(T)];
+    memcpy(buf,&val,sizeof(T));
+    std::reverse(buf,buf+sizeof(T));
+    str.append(buf,sizeof(T));
+}
+
+void
+testLoadPly(CLArgs const & args)
+{
+    FGTESTDIR
+    Ustring             dd = dataDir() + "base/";
+    Mesh                mouth = loadTri(dd+"Mouth.tri"),
+                        glasses = loadTri(dd+"Glasses.tri");
+    mouth.surfaces[0].setAlbedoMap(ImgC4UC(4,4,RgbaUC(255)));
+    glasses.surfaces[0].setAlbedoMap(ImgC4UC(4,4,RgbaUC(255)));
+    Mesh                orig = mergeMeshes(svec(mouth,glasses));
+    // Round trip, split into surfaces by 'texnumber':
+    for (bool binary : {false,true}) {
+        String              name = binary ? "binary" : "ascii";
+        savePly(name,svec(mouth,glasses),"png",binary);
+        MeshVertAttribs     attribs;
+        Mesh                mesh = loadPly(name+".ply",&attribs);
+        FGASSERT(mesh.verts.size() == orig.verts.size());
+        FGASSERT(attribs.normals.size() == orig.verts.size());
+        FGASSERT(attribs.colors.empty());
+        for (size_t ii=0; ii<orig.verts.size(); ++ii) {
+            Vec3F               v = orig.verts[ii];
+            if (binary)
+                FGASSERT(mesh.verts[ii] == v);
+            else
+                FGASSERT(isApproxEqual(mesh.verts[ii],v,1.0e-5*(v.len()+1.0)));
+        }
+        FGASSERT(mesh.surfaces.size() == orig.surfaces.size());
+        for (size_t ss=0; ss<orig.surfaces.size(); ++ss) {
+            FacetInds<3>        ref = orig.surfaces[ss].getTriEquivs();
+            Surf const &        surf = mesh.surfaces[ss];
+            FGASSERT(surf.tris.posInds == ref.posInds);
+            FGASSERT(surf.tris.uvInds.size() == ref.uvInds.size());
+            for (size_t tt=0; tt<ref.uvInds.size(); ++tt)
+                for (uint jj=0; jj<3; ++jj)
+                    FGASSERT(isApproxEqual(mesh.uvs[surf.tris.uvInds[tt][jj]],orig.uvs[ref.uvInds[tt][jj]],1.0e-5));
+        }
+    }
+    // Big-endian binary with vertex colours, normals, UVs, a quad and an unknown element to skip:
+    auto                header = [](String format,String colorType)
+    {
+        return
+            "ply\nformat " + format + " 1.0\ncomment test\n"
+            "element vertex 4\n"
+            "property float x\nproperty float y\nproperty float z\n"
+            "property float nx\nproperty float ny\nproperty float nz\n"
+            "property " + colorType + " red\nproperty " + colorType + " green\nproperty " + colorType + " blue\n"
+            "property float s\nproperty float t\n"
+            "element face 2\n"
+            "property list uchar int vertex_indices\n"
+            "element extra 1\n"
+            "property list uchar ushort data\n"
+            "end_header\n";
+    };
+    String              be = header("binary_big_endian","uchar");
+    Vec3Fs              verts {{0,0,0},{1,0,0},{1,1,0},{0,1,0}};
+    for (size_t ii=0; ii<4; ++ii) {
+        for (uint jj=0; jj<3; ++jj)
+            appendBigEndian(be,verts[ii][jj]);
+        appendBigEndian(be,0.0f);
+        appendBigEndian(be,0.0f);
+        appendBigEndian(be,1.0f);
+        for (uint jj=1; jj<4; ++jj)
+            appendBigEndian(be,uchar(ii*jj*10));
+        appendBigEndian(be,verts[ii][0]);
+        appendBigEndian(be,verts[ii][1]);
+    }
+    appendBigEndian(be,uchar(4));
+    for (int32 idx : {0,1,2,3})
+        appendBigEndian(be,idx);
+    appendBigEndian(be,uchar(3));
+    for (int32 idx : {0,2,3})
+        appendBigEndian(be,idx);
+    appendBigEndian(be,uchar(2));
+    appendBigEndian(be,uint16(7));
+    appendBigEndian(be,uint16(8));
+    saveRaw(be,"be.ply");
+    // The same in ASCII with floating point colour components:
+    String              ascii = header("ascii","float");
+    for (size_t ii=0; ii<4; ++ii) {
+        ascii += toStr(verts[ii][0]) + " " + toStr(verts[ii][1]) + " 0 0 0 1";
+        for (uint jj=1; jj<4; ++jj)
+            ascii += " " + toStr(ii*jj*10/255.0);
+        ascii += " " + toStr(verts[ii][0]) + " " + toStr(verts[ii][1]) + "\n";
+    }
+    ascii += "4 0 1 2 3\n3 0 2 3\n2 7 8\n";
+    saveRaw(ascii,"ascii.ply");
+    for (String name : {"be.ply","ascii.ply"}) {
+        MeshVertAttribs     attribs;
+        Mesh                mesh = loadPly(name,&attribs);
+        FGASSERT(mesh.verts == verts);
+        FGASSERT(mesh.uvs.size() == 4);
+        FGASSERT(mesh.surfaces.size() == 1);
+        Surf const &        surf = mesh.surfaces[0];
+        FGASSERT(surf.quads.posInds == svec(Vec4UI(0,1,2,3)));
+        FGASSERT(surf.quads.uvInds == surf.quads.posInds);
+        FGASSERT(surf.tris.posInds == svec(Vec3UI(0,2,3)));
+        FGASSERT(attribs.normals == Vec3Fs(4,Vec3F(0,0,1)));
+        for (uint ii=0; ii<4; ++ii)
+            FGASSERT(attribs.colors[ii] == RgbaUC(ii*10,ii*20,ii*30,255));
+    }
+    // Truncation must be detected:
+    saveRaw(be.substr(0,be.size()-3),"trunc.ply");
+    bool                threw = false;
+    try {loadPly("trunc.ply"); }
+    catch (FgException const &) {threw = true; }
+    FGASSERT(threw);
+}
 }
 
 // */
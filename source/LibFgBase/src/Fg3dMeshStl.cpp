@@ -9,6 +9,9 @@
 #include "FgFileSystem.hpp"
 #include "FgException.hpp"
 #include "Fg3dNormals.hpp"
+#include "FgTestUtils.hpp"
+#include "FgCommand.hpp"
+#include <unordered_map>
 
 using namespace std;
 
@@ -16,43 +19,33 @@ namespace Fg {
 
 static
 void
-saveStl(Ofstream & ff,Mesh const & mesh)
+writeFacet(BufferedOfstream & ff,Vec3F norm,Vec3F v0,Vec3F v1,Vec3F v2)
+{
+    ff.writeb(norm);
+    ff.writeb(v0);
+    ff.writeb(v1);
+    ff.writeb(v2);
+    ff.writeb(uint16(0));
+}
+
+static
+void
+saveStl(BufferedOfstream & ff,Mesh const & mesh)
 {
     MeshNormals     norms = cNormals(mesh);
+    Vec3Fs const &  verts = mesh.verts;
     for (size_t ss=0; ss<mesh.surfaces.size(); ++ss) {
         Surf const &         surf = mesh.surfaces[ss];
         const FacetNormals &    facetNorms = norms.facet[ss];
         for (uint ii=0; ii<surf.numTris(); ++ii) {
             Vec3UI           tri = surf.getTriPosInds(ii);
-            Vec3F            norm = facetNorms.tri[ii];
-            for (uint jj=0; jj<3; ++jj)
-                ff.writeb(norm[jj]);
-            for (uint jj=0; jj<3; ++jj) {
-                Vec3F        vert = mesh.verts[tri[jj]];
-                for (uint kk=0; kk<3; ++kk)
-                    ff.writeb(vert[kk]);
-            }
-            ff.writeb(uint16(0));
+            writeFacet(ff,facetNorms.tri[ii],verts[tri[0]],verts[tri[1]],verts[tri[2]]);
         }
         for (uint ii=0; ii<surf.numQuads(); ++ii) {
             Vec4UI           quad = surf.getQuadPosInds(ii);
             Vec3F            norm = facetNorms.quad[ii];
-            for (uint jj=0; jj<3; ++jj)
-                ff.writeb(norm[jj]);
-            for (uint jj=0; jj<3; ++jj) {
-                Vec3F        vert = mesh.verts[quad[jj]];
-                for (uint kk=0; kk<3; ++kk)
-                    ff.writeb(vert[kk]);
-            }
-            ff.writeb(uint16(0));
-            for (uint jj=0; jj<3; ++jj)
-                ff.writeb(norm[jj]);
-            for (uint jj=2; jj<5; ++jj) {
-                Vec3F        vert = mesh.verts[quad[jj%4]];
-                for (uint kk=0; kk<3; ++kk)
-                    ff.writeb(vert[kk]);
-            }
-            ff.writeb(uint16(0));
+            writeFacet(ff,norm,verts[quad[0]],verts[quad[1]],verts[quad[2]]);
+            writeFacet(ff,norm,verts[quad[2]],verts[quad[3]],verts[quad[0]]);
         }
     }
 }
@@ -61,7 +54,7 @@ void
 saveStl(Ustring const & fname,Meshes const & meshes)
 {
     FGASSERT(!meshes.empty());
-    Ofstream      ff(fname);
+    BufferedOfstream    ff(fname);
     ff.write("STL Binary file exported by FaceGen                                            ",80);
     uint32          numTris = 0;
     for (size_t ii=0; ii<meshes.size(); ++ii)
@@ -69,6 +62,132 @@ saveStl(Ustring const & fname,Meshes const & meshes)
     ff.writeb(numTris);
     for (size_t ii=0; ii<meshes.size(); ++ii)
         saveStl(ff,meshes[ii]);
+    ff.close();
+}
+
+namespace {
+
+// Exact position match, treating -0 and 0 as equal:
+struct  VertHash
+{
+    size_t
+    operator()(Vec3F const & v) const
+    {
+        uint64          hash = 0;
+        for (uint ii=0; ii<3; ++ii) {
+            uint32          bits;
+            memcpy(&bits,&v[ii],4);
+            if ((bits & 0x7FFFFFFFU) == 0)
+                bits = 0;
+            hash = (hash ^ bits) * 0x100000001B3ULL;
+        }
+        return size_t(hash ^ (hash >> 32));
+    }
+};
+
+}
+
+Mesh
+loadStl(Ustring const & fname)
+{
+    MappedFile          file(fname);
+    uchar const *       data = file.data();
+    size_t              size = file.size();
+    Vec3Fs              triVerts;           // 3 per tri, unwelded
+    uint32              numTris = 0;
+    if (size >= 84)
+        memcpy(&numTris,data+80,4);
+    // Binary files may also start with "solid" so the size is the reliable indicator:
+    if ((size >= 84) && (84 + size_t(numTris)*50 == size)) {
+        triVerts.resize(size_t(numTris)*3);
+        uchar const *       ptr = data + 84;
+        for (size_t ii=0; ii<numTris; ++ii) {
+            memcpy(&triVerts[ii*3],ptr+12,36);      // Skip the normal, Vec3F is densely packed
+            ptr += 50;
+        }
+    }
+    else if ((size >= 5) && (memcmp(data,"solid",5) == 0)) {
+        String              text(reinterpret_cast<char const *>(data),size);
+        char const *        ptr = text.c_str();
+        while ((ptr = strstr(ptr,"vertex")) != nullptr) {
+            ptr += 6;
+            Vec3F               vert;
+            for (uint ii=0; ii<3; ++ii) {
+                char *              next;
+                vert[ii] = strtof(ptr,&next);
+                if (next == ptr)
+                    fgThrow("STL invalid ASCII vertex",fname);
+                ptr = next;
+            }
+            triVerts.push_back(vert);
+        }
+        if (triVerts.size() % 3 != 0)
+            fgThrow("STL facets must have 3 vertices",fname);
+    }
+    else
+        fgThrow("Not a valid STL file",fname);
+    // Weld vertices:
+    Mesh                ret;
+    Vec3UIs             tris(triVerts.size()/3);
+    unordered_map<Vec3F,uint,VertHash>  vertToIdx;
+    vertToIdx.reserve(triVerts.size()/4);
+    for (size_t ii=0; ii<triVerts.size(); ++ii) {
+        auto                it = vertToIdx.emplace(triVerts[ii],uint(ret.verts.size()));
+        if (it.second)
+            ret.verts.push_back(triVerts[ii]);
+        tris[ii/3][ii%3] = it.first->second;
+    }
+    // Facets which are degenerate after welding are dropped:
+    auto                degenerate = [](Vec3UI t){return (t[0]==t[1]) || (t[1]==t[2]) || (t[2]==t[0]); };
+    tris.erase(remove_if(tris.begin(),tris.end(),degenerate),tris.end());
+    ret.surfaces.push_back(Surf(tris));
+    return ret;
+}
+
+void
+testLoadStl(CLArgs const & args)
+{
+    FGTESTDIR
+    Mesh                jane = loadTri(dataDir()+"base/Jane.tri");
+    saveStl("jane.stl",svec(jane));
+    Mesh                mesh = loadStl("jane.stl");
+    // Welded vertices must reproduce each original facet's positions:
+    FacetInds<3>        ref = jane.getTriEquivs();
+    FGASSERT(mesh.surfaces.size() == 1);
+    Vec3UIs const &     tris = mesh.surfaces[0].tris.posInds;
+    FGASSERT(tris.size() <= ref.size());
+    FGASSERT(mesh.verts.size() <= jane.verts.size());
+    size_t              tt = 0;
+    for (Vec3UI ri : ref.posInds) {
+        Vec3F               r0 = jane.verts[ri[0]],
+                            r1 = jane.verts[ri[1]],
+                            r2 = jane.verts[ri[2]];
+        if ((r0 == r1) || (r1 == r2) || (r2 == r0))
+            continue;       // Degenerate facets are removed
+        Vec3UI              ti = tris.at(tt++);
+        FGASSERT((mesh.verts[ti[0]] == r0) && (mesh.verts[ti[1]] == r1) && (mesh.verts[ti[2]] == r2));
+    }
+    FGASSERT(tt == tris.size());
+    // ASCII, including a shared edge and a -0 which must weld with 0:
+    String              ascii =
+        "solid test\n"
+        "facet normal 0 0 1\n outer loop\n  vertex 0 0 0\n  vertex 1 0 0\n  vertex 1 1 0\n endloop\nendfacet\n"
+        "facet normal 0 0 1\n outer loop\n  vertex -0 0 0\n  vertex 1 1 0\n  vertex 0 1 0\n endloop\nendfacet\n"
+        "endsolid test\n";
+    saveRaw(ascii,"ascii.stl");
+    mesh = loadStl("ascii.stl");
+    FGASSERT(mesh.verts == Vec3Fs({{0,0,0},{1,0,0},{1,1,0},{0,1,0}}));
+    FGASSERT(mesh.surfaces[0].tris.posInds == Vec3UIs({{0,1,2},{0,2,3}}));
+    // Binary with a header starting with 'solid':
+    String              binary = "solid" + String(75,' ');
+    binary.append(4,0);
+    binary[80] = 1;
+    Vec3F               facet[4] {{0,0,1},{0,0,0},{1,0,0},{1,1,0}};
+    binary.append(reinterpret_cast<char const *>(facet),48);
+    binary.append(2,0);
+    saveRaw(binary,"binary.stl");
+    mesh = loadStl("binary.stl");
+    FGASSERT(mesh.verts == Vec3Fs({{0,0,0},{1,0,0},{1,1,0}}));
 }
 
 }
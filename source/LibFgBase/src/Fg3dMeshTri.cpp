@@ -11,6 +11,14 @@
 #include "FgStdStream.hpp"
 #include "FgBounds.hpp"
 #include "FgFileSystem.hpp"
+#include "FgApproxEqual.hpp"
+#include "FgCommand.hpp"
+#include "FgMemory.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FG_TRI_SSE2
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -30,7 +38,9 @@ readString(istream & istr,bool wchar)
     str.resize(size);
     for (uint ii=0; ii<size; ++ii) {
         if (wchar) {
-            wchar_t     wch;
+            // Labels are UTF-16 per the spec (not 'wchar_t' which is 32 bit on some platforms).
+            // Only the low byte is kept:
+            uint16      wch;
             readb(istr,wch);
             str[ii] = char(wch);
         }
@@ -171,13 +181,192 @@ loadTri(istream & istr)
     return mesh;
 }
 
+namespace {
+
+// Bounds-checked sequential reader of a TRI file in memory:
+struct  TriReader
+{
+    uchar const *       ptr;
+    uchar const *       end;
+
+    TriReader(uchar const * data,size_t size) : ptr(data), end(data+size) {}
+
+    uchar const *
+    skip(size_t numBytes)
+    {
+        if (size_t(end-ptr) < numBytes)
+            fgThrow("TRI file is truncated");
+        uchar const *       ret = ptr;
+        ptr += numBytes;
+        return ret;
+    }
+
+    template<class T>
+    T
+    readt()
+    {
+        T                   ret;
+        memcpy(&ret,skip(sizeof(T)),sizeof(T));
+        return ret;
+    }
+
+    template<class T>
+    void
+    readVec(Svec<T> & vec,size_t num)
+    {
+        uchar const *       src = skip(sizeof(T)*num);
+        vec.resize(num);
+        if (num > 0)
+            memcpy(vec.data(),src,sizeof(T)*num);
+    }
+
+    String
+    readString(bool wchar)
+    {
+        uint32              size = readt<uint32>();
+        String              ret;
+        if (size == 0)
+            return ret;
+        if (wchar) {
+            // Labels are UTF-16 per the spec. As with the stream loader only the low byte is kept:
+            uchar const *       src = skip(2*size_t(size));
+            ret.resize(size);
+            for (size_t ii=0; ii<size; ++ii) {
+                uint16              wch;
+                memcpy(&wch,src+2*ii,2);
+                ret[ii] = char(wch);
+            }
+        }
+        else {
+            uchar const *       src = skip(size);
+            ret.assign(reinterpret_cast<char const *>(src),size);
+        }
+        // Remove the NULL terminating character required by the spec:
+        ret.resize(size-1);
+        return ret;
+    }
+};
+
+// Decode 'num' little-endian int16 values and scale them to floats:
+void
+decodeScaled(uchar const * src,size_t num,float scale,float * dst)
+{
+    size_t              ii = 0;
+#ifdef FG_TRI_SSE2
+    __m128              s = _mm_set1_ps(scale);
+    for (; ii+8<=num; ii+=8) {
+        __m128i             v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src+2*ii)),
+                            // Sign extend to 32 bit by placing in the high half then shifting down:
+                            lo = _mm_srai_epi32(_mm_unpacklo_epi16(v,v),16),
+                            hi = _mm_srai_epi32(_mm_unpackhi_epi16(v,v),16);
+        _mm_storeu_ps(dst+ii,_mm_mul_ps(_mm_cvtepi32_ps(lo),s));
+        _mm_storeu_ps(dst+ii+4,_mm_mul_ps(_mm_cvtepi32_ps(hi),s));
+    }
+#endif
+    for (; ii<num; ++ii) {
+        int16               val;
+        memcpy(&val,src+2*ii,2);
+        dst[ii] = float(val) * scale;
+    }
+}
+
+}
+
+Mesh
+loadTri(uchar const * data,size_t size)
+{
+    if ((size < 8) || (strncmp(reinterpret_cast<char const *>(data),triIdent.data(),8) != 0)) {
+        if ((size >= 8) && (strncmp(reinterpret_cast<char const *>(data),"FRTRI103",8) == 0))
+            fgThrow("File is encrypted, use 'fileconvert' utility to decrypt");
+        fgThrow("File not in TRI format");
+    }
+    TriReader           rdr {data+8,size-8};
+    uint32              numVerts = rdr.readt<uint32>(),
+                        numTris = rdr.readt<uint32>(),
+                        numQuads = rdr.readt<uint32>(),
+                        numLabVerts = rdr.readt<uint32>(),
+                        numSurfPts = rdr.readt<uint32>(),
+                        numUvs = rdr.readt<uint32>(),
+                        texExt = rdr.readt<uint32>(),
+                        numDiffMorph = rdr.readt<uint32>(),
+                        numStatMorph = rdr.readt<uint32>(),
+                        numStatMorphVerts = rdr.readt<uint32>();
+    rdr.skip(16);
+    bool                texs = ((texExt & 0x01) != 0),
+                        wchar = ((texExt & 0x02) != 0);
+    if (wchar)
+        fgout << fgnl << "WARNING: Unicode labels being converted to ASCII.";
+    if (numVerts == 0)
+        fgThrow("TRI file has no vertices");
+    Mesh                mesh;
+    Vec3Fs              targVerts;
+    rdr.readVec(mesh.verts,numVerts);
+    rdr.readVec(targVerts,numStatMorphVerts);
+    // A TRI has at most one surface:
+    bool                hasSurface =  ((numTris > 0) || (numQuads > 0));
+    if (hasSurface)
+        mesh.surfaces.resize(1);
+    Surf                dummy;
+    Surf &              surf = hasSurface ? mesh.surfaces[0] : dummy;
+    rdr.readVec(surf.tris.posInds,numTris);
+    rdr.readVec(surf.quads.posInds,numQuads);
+    mesh.markedVerts.resize(numLabVerts);
+    for (MarkedVert & mv : mesh.markedVerts) {
+        mv.idx = rdr.readt<uint32>();
+        mv.label = rdr.readString(wchar);
+    }
+    surf.surfPoints.reserve(numSurfPts);
+    for (uint ii=0; ii<numSurfPts; ++ii) {
+        SurfPoint           sp;
+        sp.triEquivIdx = rdr.readt<uint32>();
+        sp.weights = rdr.readt<Vec3F>();
+        sp.label = rdr.readString(wchar);
+        surf.surfPoints.push_back(sp);
+    }
+    if (numUvs > 0) {
+        rdr.readVec(mesh.uvs,numUvs);
+        rdr.readVec(surf.tris.uvInds,numTris);
+        rdr.readVec(surf.quads.uvInds,numQuads);
+    }
+    else if (texs) {    // Per-vertex UVs are converted to indexed UVs
+        rdr.readVec(mesh.uvs,numVerts);
+        surf.tris.uvInds = surf.tris.posInds;
+        surf.quads.uvInds = surf.quads.posInds;
+    }
+    mesh.deltaMorphs.resize(numDiffMorph);
+    for (Morph & morph : mesh.deltaMorphs) {
+        morph.name = rdr.readString(wchar);
+        float               scale = rdr.readt<float>();
+        uchar const *       src = rdr.skip(6*size_t(numVerts));
+        morph.verts.resize(numVerts);
+        decodeScaled(src,3*size_t(numVerts),scale,&morph.verts[0][0]);
+    }
+    size_t              targVertsStart = 0;
+    mesh.targetMorphs.reserve(numStatMorph);
+    for (uint ii=0; ii<numStatMorph; ++ii) {
+        IndexedMorph        tm;
+        tm.name = rdr.readString(wchar);
+        uint32              numTargVerts = rdr.readt<uint32>();
+        if (numTargVerts > 0) {         // For some reason this is not the case in v2.0 eyes
+            if (targVertsStart + numTargVerts > targVerts.size())
+                fgThrow("TRI file target morph vertex count inconsistent");
+            rdr.readVec(tm.baseInds,numTargVerts);
+            tm.verts = cSubvec(targVerts,targVertsStart,numTargVerts);
+            targVertsStart += numTargVerts;
+            mesh.targetMorphs.push_back(tm);
+        }
+    }
+    return mesh;
+}
+
 Mesh
 loadTri(Ustring const & fname)
 {
+    MemTagScope mts(MemTag::mesh);
     Mesh        ret;
     try {
-        Ifstream      ff(fname);
-        ret = loadTri(ff);
+        MappedFile      mf(fname);
+        ret = loadTri(mf.data(),mf.size());
     }
     catch (FgException & e) {
         e.m_ct.back().dataUtf8 = fname.m_str;
@@ -295,4 +484,71 @@ saveTri(
     }
 }
 
+
+void
+testLoadTri(CLArgs const &)
+{
+    auto                sameMesh = [](Mesh const & l,Mesh const & r)
+    {
+        FGASSERT(l.verts == r.verts);
+        FGASSERT(l.uvs == r.uvs);
+        FGASSERT(l.surfaces.size() == r.surfaces.size());
+        for (size_t ss=0; ss<l.surfaces.size(); ++ss) {
+            Surf const &        sl = l.surfaces[ss];
+            Surf const &        sr = r.surfaces[ss];
+            FGASSERT(sl.tris.posInds == sr.tris.posInds);
+            FGASSERT(sl.tris.uvInds == sr.tris.uvInds);
+            FGASSERT(sl.quads.posInds == sr.quads.posInds);
+            FGASSERT(sl.quads.uvInds == sr.quads.uvInds);
+            FGASSERT(sl.surfPoints.size() == sr.surfPoints.size());
+            for (size_t ii=0; ii<sl.surfPoints.size(); ++ii) {
+                SurfPoint const &   pl = sl.surfPoints[ii];
+                SurfPoint const &   pr = sr.surfPoints[ii];
+                FGASSERT((pl.triEquivIdx == pr.triEquivIdx) && (pl.weights == pr.weights) && (pl.label == pr.label));
+            }
+        }
+        FGASSERT(l.markedVerts.size() == r.markedVerts.size());
+        for (size_t ii=0; ii<l.markedVerts.size(); ++ii)
+            FGASSERT((l.markedVerts[ii].idx == r.markedVerts[ii].idx) && (l.markedVerts[ii].label == r.markedVerts[ii].label));
+        FGASSERT(l.deltaMorphs.size() == r.deltaMorphs.size());
+        for (size_t ii=0; ii<l.deltaMorphs.size(); ++ii)
+            FGASSERT((l.deltaMorphs[ii].name == r.deltaMorphs[ii].name) && (l.deltaMorphs[ii].verts == r.deltaMorphs[ii].verts));
+        FGASSERT(l.targetMorphs.size() == r.targetMorphs.size());
+        for (size_t ii=0; ii<l.targetMorphs.size(); ++ii) {
+            IndexedMorph const &    ml = l.targetMorphs[ii];
+            IndexedMorph const &    mr = r.targetMorphs[ii];
+            FGASSERT((ml.name == mr.name) && (ml.baseInds == mr.baseInds) && (ml.verts == mr.verts));
+        }
+    };
+    Ustring             dir = dataDir() + "base/";
+    Ustrings            fnames = globFiles(dir+"*.tri");
+    FGASSERT(!fnames.empty());
+    for (Ustring const & fname : fnames) {
+        Ifstream            ifs(dir+fname);
+        Mesh                ref = loadTri(ifs);
+        Mesh                tst = loadTri(dir+fname);
+        sameMesh(ref,tst);
+        // Every truncation must be detected rather than read past the end:
+        String              raw = loadRawString(dir+fname);
+        uchar const *       data = reinterpret_cast<uchar const *>(raw.data());
+        for (size_t sz : {size_t(0),size_t(7),size_t(50),raw.size()/2,raw.size()-1}) {
+            bool                threw = false;
+            try {loadTri(data,sz); }
+            catch (FgException const &) {threw = true; }
+            FGASSERT(threw);
+        }
+    }
+    // UTF-16 labels (16 bit units regardless of the platform 'wchar_t' size):
+    Ustring             wideFile = dataDir() + "base/test/WideLabels.tri";
+    Ifstream            ifs(wideFile);
+    Mesh                ref = loadTri(ifs),
+                        tst = loadTri(wideFile);
+    sameMesh(ref,tst);
+    FGASSERT(ref.verts.size() == 3);
+    FGASSERT((ref.markedVerts.size() == 1) && (ref.markedVerts[0].label == "tip"));
+    FGASSERT((ref.surfaces.size() == 1) && (ref.surfaces[0].surfPoints.size() == 1));
+    FGASSERT(ref.surfaces[0].surfPoints[0].label == "centre");
+    FGASSERT((ref.deltaMorphs.size() == 1) && (ref.deltaMorphs[0].name == "Smile"));
+    FGASSERT((ref.targetMorphs.size() == 1) && (ref.targetMorphs[0].name == "Blink"));
+}
 }
@@ -19,7 +19,7 @@ namespace Fg {
 
 template<uint dim>
 void
-writePoint(Ofstream & ofs,Mat<float,dim,1> const & pnt)
+writePoint(OutBuffer & ofs,Mat<float,dim,1> const & pnt)
 {
     ofs << "               ";
     for (uint kk=0; kk<dim; ++kk)
@@ -28,7 +28,7 @@ writePoint(Ofstream & ofs,Mat<float,dim,1> const & pnt)
 
 template<uint dim>
 void
-writePoints(Ofstream & ofs,vector<Mat<float,dim,1> > const & pts)
+writePoints(OutBuffer & ofs,vector<Mat<float,dim,1> > const & pts)
 {
     if (pts.empty())
         return;
@@ -46,7 +46,7 @@ writePoints(Ofstream & ofs,vector<Mat<float,dim,1> > const & pts)
 
 template<uint dim>
 void
-writeIdx(Ofstream & ofs,Mat<uint,dim,1> const & idx)
+writeIdx(OutBuffer & ofs,Mat<uint,dim,1> const & idx)
 {
     ofs << "            ";
     for (uint ii=0; ii<dim; ++ii)
@@ -56,7 +56,7 @@ writeIdx(Ofstream & ofs,Mat<uint,dim,1> const & idx)
 
 template<uint dim>
 void
-writeIndices(Ofstream & ofs,vector<Mat<uint,dim,1> > const &  inds)
+writeIndices(OutBuffer & ofs,vector<Mat<uint,dim,1> > const &  inds)
 {
     if (inds.size() == 0)
         return;
@@ -74,8 +74,8 @@ saveVrml(
     string                  imgFormat)
 {
     FGASSERT(meshes.size() > 0);
-    Ofstream            ofs(filename);
-    ofs.precision(7);
+    BufferedOfstream    ofs(filename);
+    ofs.precision = 7;
     ofs <<
         "#VRML V2.0 utf8\n"
         "# Copyright 2015 Singular Inversions Inc. (facegen.com)\n"
@@ -174,6 +174,7 @@ saveVrml(
             "    }\n"
             "}\n";
     }
+    ofs.close();
 }
 
 void
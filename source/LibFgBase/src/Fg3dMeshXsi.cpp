@@ -72,11 +72,7 @@ static bool saveXsiFile(
 
     Path      path(fname);
     path.ext = "xsi";
-    Ofstream ofs(path.str());
-    if (!ofs)
-    {
-        return false;
-    }
+    BufferedOfstream ofs(path.str());
 
     //
     // Get object's bounding box (for camera and lighting info)
@@ -501,42 +497,42 @@ static bool saveXsiFile(
                 ofs << "      {\n";
                 ofs << "         \"LINEAR\",\n";
                 ofs << "         " << numMorphs+1 << ",\n";
-                for (unsigned long mm=0; mm<numMorphs+1; ++mm)
+                // Shapes are independent so are formatted concurrently:
+                writeBlocks(ofs,numMorphs+1,[&](size_t mm,OutBuffer & out)
                 {
                     const vector<Vec3F> *mvtxList = &vtxList;
-                    FffMultiObjectC const & mobj = (*morphTargets)[mm-1];
                     if (mm > 0)
-                        mvtxList = &(mobj.getPtList(xx));
+                        mvtxList = &((*morphTargets)[mm-1].getPtList(xx));
                     MeshNormals         mnorms = cNormals({Surf{triList,quadList}},*mvtxList);
 
-                    ofs << "\n";
-                    ofs << "         SI_Shape SHP-" << objName 
+                    out << "\n";
+                    out << "         SI_Shape SHP-" << objName 
                                                     << "-" << mm << "\n";
-                    ofs << "         {\n";
+                    out << "         {\n";
                     if (perVertex || perFacet)
-                        ofs << "            3,\n";
+                        out << "            3,\n";
                     else
-                        ofs << "            2,\n";
-                    ofs << "            \"INDEXED\",\n";
+                        out << "            2,\n";
+                    out << "            \"INDEXED\",\n";
  
                     // New vertex list.
-                    ofs << "\n";
-                    ofs << "            " << mvtxList->size() << ",\n";
-                    ofs << "            \"POSITION\",\n";
-                    for (pt=0; pt<mvtxList->size(); ++pt)
+                    out << "\n";
+                    out << "            " << mvtxList->size() << ",\n";
+                    out << "            \"POSITION\",\n";
+                    for (size_t pt=0; pt<mvtxList->size(); ++pt)
                     {
-                        ofs << "            " << pt << ", "
+                        out << "            " << pt << ", "
                             << floatToString((*mvtxList)[pt][0]) << ", "
                             << floatToString((*mvtxList)[pt][1]) << ", "
                             << floatToString((*mvtxList)[pt][2]) << ",\n";
                     }
 
-                    ofs << "\n";
-                    ofs << "            " << mnorms.vert.size() << ",\n";
-                    ofs << "            \"NORMAL\",\n";
-                    for (pt=0; pt<mnorms.vert.size(); ++pt)
+                    out << "\n";
+                    out << "            " << mnorms.vert.size() << ",\n";
+                    out << "            \"NORMAL\",\n";
+                    for (size_t pt=0; pt<mnorms.vert.size(); ++pt)
                     {
-                        ofs << "            " << pt << ", "
+                        out << "            " << pt << ", "
                             << floatToString(mnorms.vert[pt][0]) << ", "
                             << floatToString(mnorms.vert[pt][1]) << ", "
                             << floatToString(mnorms.vert[pt][2]) << ",\n";
@@ -545,19 +541,19 @@ static bool saveXsiFile(
                     // Texture UV
                     if (perVertex || perFacet)
                     {
-                        ofs << "\n";
-                        ofs << "            " << txtList.size() << ",\n";
-                        ofs << "            \"TEX_COORD_UV\",\n";
-                        for (pt=0; pt<txtList.size(); ++pt)
+                        out << "\n";
+                        out << "            " << txtList.size() << ",\n";
+                        out << "            \"TEX_COORD_UV\",\n";
+                        for (size_t pt=0; pt<txtList.size(); ++pt)
                         {
-                            ofs << "            " << pt << ", "
+                            out << "            " << pt << ", "
                                 << floatToString(txtList[pt][0]) << ", "
                                 << floatToString(txtList[pt][1]) << ", \n";
                         }
                     }
 
-                    ofs << "         }\n";
-                }
+                    out << "         }\n";
+                });
                 ofs << "\n"
                     "         SI_FCurve " << objName << "-SHPANIM-1\n"
                     "         {\n"
@@ -589,16 +585,8 @@ static bool saveXsiFile(
     //
     // Done.
     //
-    if (ofs.fail())
-    {
-        ofs.close();
-        return false;
-    }
-    else
-    {
-        ofs.close();
-        return true;
-    }
+    ofs.close();
+    return true;
 }
 
 //****************************************************************************
@@ -610,9 +598,9 @@ static bool saveXsiFile(
 //
 static string floatToString(float val)
 {
-    std::ostringstream   oss;
-    oss << std::fixed << std::setw(4) << std::setfill('0') << val;
-    return oss.str();
+    char        str[64];
+    snprintf(str,sizeof(str),"%f",double(val));
+    return str;
 }
 
 void
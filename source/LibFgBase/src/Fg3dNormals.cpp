@@ -7,6 +7,7 @@
 #include "stdafx.h"
 
 #include "Fg3dNormals.hpp"
+#include "FgProfile.hpp"
 
 using namespace std;
 
@@ -56,6 +57,7 @@ cVertNorms(Vec3Ds const & verts,Vec3UIs const & tris)
 MeshNormals
 cNormals(Surfs const & surfs,Vec3Fs const & verts)
 {
+    FG_PROFILE("cNormals");
     MeshNormals             norms;
     norms.facet.resize(surfs.size());
     Vec3Ds              vertNorms(verts.size(),Vec3D(0));
@@ -0,0 +1,360 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+
+#include "stdafx.h"
+
+#include "Fg3dPick.hpp"
+#include "Fg3dMeshIo.hpp"
+#include "FgApproxEqual.hpp"
+#include "FgCommand.hpp"
+#include "FgQuaternion.hpp"
+
+using namespace std;
+
+namespace Fg {
+
+PickRay
+cPickRay(Mat44F worldToD3ps,Vec2D d3psPos)
+{
+    // Unproject points on the near plane and half way to the far plane (which may be at infinity):
+    Mat44D              xf {worldToD3ps};
+    Opt<Vec4D>          h0 = solveLinear(xf,Vec4D(d3psPos[0],d3psPos[1],0,1)),
+                        h1 = solveLinear(xf,Vec4D(d3psPos[0],d3psPos[1],0.5,1));
+    FGASSERT(h0.valid() && h1.valid());
+    Vec3D               p0 = fromHomogVec(h0.val()),
+                        p1 = fromHomogVec(h1.val());
+    return {p0,p1-p0};
+}
+
+PickRay
+cPickRay(Mat44F worldToD3ps,Vec2UI winSize,Vec2I pos)
+{
+    FGASSERT(cMinElem(winSize) > 0);
+    // Raster Y is down, D3PS Y is up:
+    Vec2D               d3ps {
+        (pos[0] + 0.5) * 2.0 / winSize[0] - 1.0,
+        1.0 - (pos[1] + 0.5) * 2.0 / winSize[1],
+    };
+    return cPickRay(worldToD3ps,d3ps);
+}
+
+Opt<pair<double,Vec3D> >
+intersectRayTri(PickRay const & ray,Vec3D v0,Vec3D v1,Vec3D v2)
+{
+    Vec3D               e1 = v1-v0,
+                        e2 = v2-v0,
+                        p = crossProduct(ray.dir,e2);
+    double              det = cDot(e1,p);
+    // Non-positive determinant means the facet is back facing, edge-on or degenerate:
+    if (!(det > 0.0))
+        return Opt<pair<double,Vec3D> >();
+    Vec3D               s = ray.origin - v0;
+    double              u = cDot(s,p);
+    if ((u < 0.0) || (u > det))
+        return Opt<pair<double,Vec3D> >();
+    Vec3D               q = crossProduct(s,e1);
+    double              v = cDot(ray.dir,q);
+    if ((v < 0.0) || (u + v > det))
+        return Opt<pair<double,Vec3D> >();
+    double              t = cDot(e2,q);
+    if (t < 0.0)
+        return Opt<pair<double,Vec3D> >();
+    double              invDet = 1.0 / det;
+    u *= invDet;
+    v *= invDet;
+    return make_pair(t*invDet,Vec3D(1.0-u-v,u,v));
+}
+
+void
+MeshPicker::update(Mesh const & mesh,Vec3Fs const & vs)
+{
+    Svec<Vec3UI>        topo;
+    topo.reserve(mesh.numTriEquivs());
+    for (Surf const & surf : mesh.surfaces) {
+        size_t              num = surf.numTriEquivs();
+        for (size_t tt=0; tt<num; ++tt) {
+            Vec3UI              tri = surf.getTriEquivPosInds(tt);
+            FGASSERT(cMaxElem(tri) < vs.size());
+            topo.push_back(tri);
+        }
+    }
+    verts = vs;
+    if ((topo == topology) && !nodes.empty()) {
+        refit();
+        return;
+    }
+    topology = topo;
+    tris.clear();
+    nodes.clear();
+    tris.reserve(topology.size());
+    size_t              cnt = 0;
+    for (size_t ss=0; ss<mesh.surfaces.size(); ++ss) {
+        size_t              num = mesh.surfaces[ss].numTriEquivs();
+        for (size_t tt=0; tt<num; ++tt)
+            tris.push_back({topology[cnt++],uint(ss),uint(tt)});
+    }
+    if (!tris.empty()) {
+        nodes.reserve(2*tris.size()/4+1);
+        build(0,uint(tris.size()));
+        refit();
+    }
+    ++m_numBuilds;
+}
+
+uint
+MeshPicker::build(uint begin,uint end)
+{
+    static const uint   maxLeafTris = 4;
+    uint                nodeIdx = uint(nodes.size());
+    nodes.push_back(Node{});
+    // Bounds are computed by 'refit' but the split needs the spread of tri centroids
+    // (left scaled by 3 since only their order matters):
+    auto                centroid = [&](Tri const & t)
+    {
+        return verts[t.posInds[0]] + verts[t.posInds[1]] + verts[t.posInds[2]];
+    };
+    Vec3F               lo = centroid(tris[begin]),
+                        hi = lo;
+    for (uint ii=begin+1; ii<end; ++ii) {
+        Vec3F               c = centroid(tris[ii]);
+        lo = cMin(lo,c);
+        hi = cMax(hi,c);
+    }
+    uint                axis = cMaxIdx(hi-lo);
+    // Coincident centroids can't be split:
+    if ((end-begin <= maxLeafTris) || !(hi[axis] > lo[axis])) {
+        nodes[nodeIdx].idx = begin;
+        nodes[nodeIdx].num = end-begin;
+        return nodeIdx;
+    }
+    uint                mid = (begin + end) / 2;
+    nth_element(tris.begin()+begin,tris.begin()+mid,tris.begin()+end,
+        [&](Tri const & l,Tri const & r){return (centroid(l)[axis] < centroid(r)[axis]); });
+    build(begin,mid);
+    uint                second = build(mid,end);
+    nodes[nodeIdx].idx = second;
+    nodes[nodeIdx].num = 0;
+    return nodeIdx;
+}
+
+void
+MeshPicker::refit()
+{
+    // Children always follow their parent so a reverse pass updates bottom-up:
+    for (size_t ii=nodes.size(); ii>0; --ii) {
+        Node &              node = nodes[ii-1];
+        if (node.num > 0) {
+            Tri const &         t0 = tris[node.idx];
+            node.lo = verts[t0.posInds[0]];
+            node.hi = node.lo;
+            for (uint tt=node.idx; tt<node.idx+node.num; ++tt) {
+                for (uint vv=0; vv<3; ++vv) {
+                    Vec3F               v = verts[tris[tt].posInds[vv]];
+                    node.lo = cMin(node.lo,v);
+                    node.hi = cMax(node.hi,v);
+                }
+            }
+        }
+        else {
+            Node const &        c0 = nodes[ii],
+                                c1 = nodes[node.idx];
+            node.lo = cMin(c0.lo,c1.lo);
+            node.hi = cMax(c0.hi,c1.hi);
+        }
+    }
+}
+
+Opt<MeshPick>
+MeshPicker::pick(PickRay const & ray) const
+{
+    Opt<MeshPick>       ret;
+    if (nodes.empty())
+        return ret;
+    double              maxD = numeric_limits<double>::max();
+    Vec3D               invDir;
+    for (uint dd=0; dd<3; ++dd)
+        invDir[dd] = (ray.dir[dd] == 0.0) ? maxD : 1.0 / ray.dir[dd];
+    // Returns the ray parameter at which the box is entered or max if it is missed:
+    auto                entry = [&](Node const & node)
+    {
+        double              tlo = 0.0,
+                            thi = maxD;
+        for (uint dd=0; dd<3; ++dd) {
+            double              t0 = (node.lo[dd] - ray.origin[dd]) * invDir[dd],
+                                t1 = (node.hi[dd] - ray.origin[dd]) * invDir[dd];
+            if (t0 > t1)
+                swap(t0,t1);
+            tlo = cMax(tlo,t0);
+            thi = cMin(thi,t1);
+        }
+        return (tlo <= thi) ? tlo : maxD;
+    };
+    double              best = maxD;
+    MeshPick            hit;
+    // Balanced median splits keep the depth to log2 of the number of tris:
+    pair<uint,double>   stack[64];
+    size_t              sp = 0;
+    double              rootEntry = entry(nodes[0]);
+    if (rootEntry < maxD)
+        stack[sp++] = make_pair(0U,rootEntry);
+    while (sp > 0) {
+        pair<uint,double>   top = stack[--sp];
+        if (top.second > best)
+            continue;
+        Node const &        node = nodes[top.first];
+        if (node.num > 0) {
+            for (uint tt=node.idx; tt<node.idx+node.num; ++tt) {
+                Tri const &         tri = tris[tt];
+                auto                isct = intersectRayTri(ray,
+                    Vec3D(verts[tri.posInds[0]]),
+                    Vec3D(verts[tri.posInds[1]]),
+                    Vec3D(verts[tri.posInds[2]]));
+                if (isct.valid() && (isct.val().first < best)) {
+                    best = isct.val().first;
+                    hit.surfIdx = tri.surfIdx;
+                    hit.surfPnt = SurfPoint(tri.triEquivIdx,Vec3F(isct.val().second));
+                    hit.rayParam = best;
+                }
+            }
+        }
+        else {
+            uint                c0 = top.first+1,
+                                c1 = node.idx;
+            double              e0 = entry(nodes[c0]),
+                                e1 = entry(nodes[c1]);
+            if (e0 > e1) {
+                swap(c0,c1);
+                swap(e0,e1);
+            }
+            FGASSERT(sp+2 <= 64);
+            // Push the farther child first so the nearer is traversed first:
+            if (e1 < best)
+                stack[sp++] = make_pair(c1,e1);
+            if (e0 < best)
+                stack[sp++] = make_pair(c0,e0);
+        }
+    }
+    if (best < maxD)
+        ret = hit;
+    return ret;
+}
+
+static
+Mat44F
+testWorldToD3ps(Mat32F bounds,QuaternionD rot)
+{
+    // Place the mesh in front of the camera at a random orientation then apply a D3D projection
+    // with a 30 degree half field of view (see FgGui3dWin.cpp):
+    Vec3D               centre = Vec3D(bounds.colVec(0) + bounds.colVec(1)) * 0.5;
+    double              radius = Vec3D(bounds.colVec(1) - bounds.colVec(0)).len() * 0.5,
+                        dist = radius * 2.5,
+                        hw = std::tan(30.0 * pi() / 180.0),
+                        nr = dist - radius * 1.5,
+                        fr = dist + radius * 1.5;
+    Mat44D              worldToOecs = asHomogMat(Vec3D(0,0,-dist)) * asHomogMat(rot.asMatrix()) * asHomogMat(-centre),
+                        oecsToD3vs {{
+                            1, 0, 0, 0,
+                            0, 1, 0, 0,
+                            0, 0,-1, 0,
+                            0, 0, 0, 1
+                        }},
+                        d3vsToD3ps {{
+                            1/hw, 0,    0,          0,
+                            0,    1/hw, 0,          0,
+                            0,    0,    fr/(fr-nr), -nr*fr/(fr-nr),
+                            0,    0,    1,          0
+                        }};
+    return Mat44F(d3vsToD3ps * oecsToD3vs * worldToOecs);
+}
+
+void
+testMeshPick(CLArgs const &)
+{
+    randSeedRepeatable();
+    Mesh                mesh = loadTri(dataDir()+"base/Jane.tri");
+    MeshPicker          picker {mesh,mesh.verts};
+    FGASSERT(picker.numTris() == mesh.numTriEquivs());
+    // Brute force reference over all tri equivalents:
+    auto                bruteForce = [&](Vec3Fs const & verts,PickRay const & ray)
+    {
+        Opt<MeshPick>       ret;
+        for (size_t ss=0; ss<mesh.surfaces.size(); ++ss) {
+            Surf const &        surf = mesh.surfaces[ss];
+            for (uint tt=0; tt<surf.numTriEquivs(); ++tt) {
+                Vec3UI              tri = surf.getTriEquivPosInds(tt);
+                auto                isct = intersectRayTri(ray,Vec3D(verts[tri[0]]),Vec3D(verts[tri[1]]),Vec3D(verts[tri[2]]));
+                if (isct.valid() && (!ret.valid() || (isct.val().first < ret.val().rayParam)))
+                    ret = MeshPick {ss,SurfPoint(tt,Vec3F(isct.val().second)),isct.val().first};
+            }
+        }
+        return ret;
+    };
+    auto                check = [&](Vec3Fs const & verts,MeshPicker const & mp,Mat44F worldToD3ps,Vec2D d3ps)
+    {
+        PickRay             ray = cPickRay(worldToD3ps,d3ps);
+        Opt<MeshPick>       ref = bruteForce(verts,ray),
+                            tst = mp.pick(ray);
+        FGASSERT(ref.valid() == tst.valid());
+        if (ref.valid()) {
+            // Ties (shared edges) may resolve to a different tri but must have the same depth:
+            FGASSERT(ref.val().rayParam == tst.val().rayParam);
+            MeshPick            hit = tst.val();
+            Surf const &        surf = mesh.surfaces[hit.surfIdx];
+            Vec3D               pos = Vec3D(cSurfPointPos(hit.surfPnt,surf.tris,surf.quads,verts));
+            // The hit must project back to the picked point:
+            Vec4D               prj = Mat44D(worldToD3ps) * asHomogVec(pos);
+            Vec3D               d3psHit = fromHomogVec(prj);
+            FGASSERT(isApproxEqual(d3psHit[0],d3ps[0],1e-4) && isApproxEqual(d3psHit[1],d3ps[1],1e-4));
+            FGASSERT((d3psHit[2] >= -1e-6) && (d3psHit[2] <= 1.0));
+        }
+        return ref.valid();
+    };
+    // Rays are concentrated near the centre, where the mesh projects, so most of them hit:
+    size_t              numHits = 0;
+    for (uint ii=0; ii<20; ++ii) {
+        QuaternionD         rot {randNormal(),randNormal(),randNormal(),randNormal()};
+        Mat44F              worldToD3ps = testWorldToD3ps(cBounds(mesh.verts),rot);
+        for (uint jj=0; jj<50; ++jj)
+            if (check(mesh.verts,picker,worldToD3ps,Vec2D(randUniform(-0.5,0.5),randUniform(-0.5,0.5))))
+                ++numHits;
+    }
+    FGASSERT(numHits > 100);
+    // Changing the pose (morph) must only refit and give the same picks as a fresh build:
+    Vec3Fs              posed = mesh.morphSingle(0);
+    picker.update(mesh,posed);
+    FGASSERT(picker.numBuilds() == 1);
+    MeshPicker          fresh {mesh,posed};
+    for (uint ii=0; ii<10; ++ii) {
+        QuaternionD         rot {randNormal(),randNormal(),randNormal(),randNormal()};
+        Mat44F              worldToD3ps = testWorldToD3ps(cBounds(posed),rot);
+        for (uint jj=0; jj<50; ++jj) {
+            Vec2D               d3ps {randUniform(-1,1),randUniform(-1,1)};
+            check(posed,picker,worldToD3ps,d3ps);
+            PickRay             ray = cPickRay(worldToD3ps,d3ps);
+            Opt<MeshPick>       p0 = picker.pick(ray),
+                                p1 = fresh.pick(ray);
+            FGASSERT(p0.valid() == p1.valid());
+            if (p0.valid()) {
+                FGASSERT(p0.val().rayParam == p1.val().rayParam);
+            }
+        }
+    }
+    // Changing the topology must rebuild:
+    Mesh                edited = mesh;
+    FGASSERT(edited.surfaces[0].quads.size() > 0);
+    edited.surfaces[0].removeQuad(0);
+    picker.update(edited,edited.verts);
+    FGASSERT(picker.numBuilds() == 2);
+    FGASSERT(picker.numTris() == edited.numTriEquivs());
+    // Pixel centre rays. Pixel (0,0) is the top left:
+    Mat44F              identity = Mat44F::identity();
+    PickRay             ray = cPickRay(identity,Vec2UI(4,2),Vec2I(0,0));
+    FGASSERT(isApproxEqual(ray.origin,Vec3D(-0.75,0.5,0),1e-6));
+}
+
+}
+
+// */
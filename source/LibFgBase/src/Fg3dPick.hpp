@@ -0,0 +1,103 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Mesh surface picking by ray casting against a bounding volume hierarchy (BVH)
+//
+
+#ifndef FG3DPICK_HPP
+#define FG3DPICK_HPP
+
+#include "Fg3dMesh.hpp"
+
+namespace Fg {
+
+// Pick ray in the mesh coordinate system. Only intersections with a non-negative ray parameter
+// (ie. on or beyond 'origin' in the direction of 'dir') are considered:
+struct  PickRay
+{
+    Vec3D           origin;
+    Vec3D           dir;            // Need not be normalized
+};
+
+// Ray from the near plane through the given point in D3PS (D3D projection space; X and Y in [-1,1]
+// with Y up, depth in [0,1] from near to far plane):
+PickRay
+cPickRay(Mat44F worldToD3ps,Vec2D d3psPos);
+
+// Ray through the centre of the given pixel (raster coordinates) of a viewport of size 'winSize':
+PickRay
+cPickRay(Mat44F worldToD3ps,Vec2UI winSize,Vec2I pos);
+
+// Ray-triangle intersection (Moller-Trumbore). Only front (CC winding) facets are intersected.
+// Returns the ray parameter and the barycentric coordinate of the intersection relative to
+// (v0,v1,v2) respectively:
+Opt<std::pair<double,Vec3D> >
+intersectRayTri(PickRay const & ray,Vec3D v0,Vec3D v1,Vec3D v2);
+
+struct  MeshPick
+{
+    size_t          surfIdx;
+    SurfPoint       surfPnt;        // Barycentric weights are in mesh space (not projected)
+    double          rayParam;       // Intersection is at ray.origin + ray.dir * rayParam
+};
+
+// Picking index for a single mesh. Construction cost is O(N log N) in the number of tris but
+// a pick is typically O(log N).
+struct  MeshPicker
+{
+    MeshPicker() {}
+    MeshPicker(Mesh const & mesh,Vec3Fs const & verts) {update(mesh,verts); }
+
+    // 'verts' are the current (eg. posed) vertex positions used in place of 'mesh.verts'.
+    // If the tri / quad topology is unchanged from the last update only the volume bounds
+    // are refit, in linear time:
+    void
+    update(Mesh const & mesh,Vec3Fs const & verts);
+
+    // Returns the closest front facing intersection:
+    Opt<MeshPick>
+    pick(PickRay const & ray) const;
+
+    size_t
+    numTris() const {return tris.size(); }
+
+    // Number of times the hierarchy has been fully rebuilt (rather than refit):
+    size_t
+    numBuilds() const {return m_numBuilds; }
+
+private:
+    struct  Tri
+    {
+        Vec3UI          posInds;
+        uint            surfIdx;
+        uint            triEquivIdx;
+    };
+    // Leaf nodes have 'num' > 0 and reference tris [idx,idx+num). Interior nodes have 'num' == 0,
+    // their first child immediately follows and 'idx' is the index of their second child:
+    struct  Node
+    {
+        Vec3F           lo;
+        Vec3F           hi;
+        uint            idx;
+        uint            num;
+    };
+    Svec<Tri>           tris;           // In leaf order
+    Svec<Vec3UI>        topology;       // Tri equivalents in surface order, for change detection
+    Vec3Fs              verts;
+    Svec<Node>          nodes;          // Depth-first order so children always follow their parent
+    size_t              m_numBuilds = 0;
+
+    uint
+    build(uint begin,uint end);
+
+    void
+    refit();
+};
+
+}
+
+#endif
+
+// */
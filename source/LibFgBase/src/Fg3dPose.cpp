@@ -12,6 +12,7 @@
 #include "FgBounds.hpp"
 #include "FgMath.hpp"
 #include "FgStdSet.hpp"
+#include "FgProfile.hpp"
 
 using namespace std;
 
@@ -39,6 +40,7 @@ accDeltaMorphs(
     Floats const &              coord,
     Vec3Fs &                   accVerts)
 {
+    FG_PROFILE("accDeltaMorphs");
     FGASSERT(deltaMorphs.size() == coord.size());
     for (size_t ii=0; ii<deltaMorphs.size(); ++ii) {
         Morph const &     morph = deltaMorphs[ii];
@@ -55,6 +57,7 @@ accTargetMorphs(
     Floats const &              coord,
     Vec3Fs &                   accVerts)
 {
+    FG_PROFILE("accTargetMorphs");
     FGASSERT(targMorphs.size() == coord.size());
     size_t          numTargVerts = 0;
     for (size_t ii=0; ii<targMorphs.size(); ++ii)
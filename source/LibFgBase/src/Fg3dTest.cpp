@@ -111,6 +111,12 @@ void fgSaveObjTest(CLArgs const &);
 void fgSavePlyTest(CLArgs const &);
 void fgSaveXsiTest(CLArgs const &);
 void testVrmlSave(CLArgs const &);
+void testDecimate(CLArgs const &);
+void testMeshPick(CLArgs const &);
+void testLoadTri(CLArgs const &);
+void testMeshMapped(CLArgs const &);
+void testLoadPly(CLArgs const &);
+void testLoadStl(CLArgs const &);
 
 void
 test3d(CLArgs const & args)
@@ -124,6 +130,12 @@ test3d(CLArgs const & args)
         {fgSaveObjTest, "obj", "Wavefront OBJ ASCII file format export"},
         {fgSavePlyTest, "ply", ".PLY file format export"},
         {testVrmlSave,  "vrml", ".WRL file format export"},
+        {testDecimate,  "decimate", "Quadric error mesh decimation"},
+        {testMeshPick,  "pick", "Mesh picking index"},
+        {testLoadTri,   "tri", "TRI file format memory mapped load"},
+        {testMeshMapped,"mapped", "Memory mappable mesh container"},
+        {testLoadPly,   "plyLoad", "PLY file format load and binary save"},
+        {testLoadStl,   "stl", "STL file format load with vertex welding"},
 #ifdef _MSC_VER     // Precision differences with gcc/clang:
         {fgSaveXsiTest, "xsi", ".XSI file format export"},
 #endif
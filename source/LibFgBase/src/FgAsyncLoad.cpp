@@ -0,0 +1,229 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+
+#include "stdafx.h"
+
+#include "FgAsyncLoad.hpp"
+#include "FgFileSystem.hpp"
+#include "FgCommand.hpp"
+#include "FgParallel.hpp"
+#include <deque>
+
+using namespace std;
+
+namespace Fg {
+
+struct  AsyncLoadState
+{
+    size_t                      budget;
+    mutex                       mtx;
+    condition_variable          cv;
+    deque<Sptr<AsyncJob> >      queue;
+    size_t                      inFlight = 0;
+    size_t                      inFlightPeak = 0;
+    bool                        stop = false;
+
+    explicit AsyncLoadState(size_t b) : budget(b) {}
+
+    // Must be called with 'mtx' locked:
+    void
+    charge(AsyncJob & job)
+    {
+        job.claimed = true;
+        job.charged = true;
+        inFlight += job.memEstimate;
+        inFlightPeak = std::max(inFlightPeak,inFlight);
+    }
+
+    // Must be called with 'mtx' locked. Removes jobs already run by their 'get()' and returns true
+    // if the next job can be started within the budget:
+    bool
+    ready()
+    {
+        while (!queue.empty() && queue.front()->claimed)
+            queue.pop_front();
+        if (queue.empty())
+            return false;
+        return ((inFlight == 0) || (inFlight + queue.front()->memEstimate <= budget));
+    }
+
+    void
+    work()
+    {
+        unique_lock<mutex>      lock(mtx);
+        for (;;) {
+            cv.wait(lock,[this]{return (stop || ready()); });
+            if (stop)
+                return;
+            Sptr<AsyncJob>      job = queue.front();
+            queue.pop_front();
+            charge(*job);
+            lock.unlock();
+            job->run();         // packaged_task captures any exception
+            job.reset();        // Release our reference outside the lock
+            lock.lock();
+        }
+    }
+};
+
+AsyncJob::~AsyncJob()
+{release(); }
+
+bool
+AsyncJob::claim()
+{
+    lock_guard<mutex>       lock(state->mtx);
+    if (claimed)
+        return false;
+    state->charge(*this);
+    return true;
+}
+
+void
+AsyncJob::release()
+{
+    if (!charged.exchange(false))
+        return;
+    {
+        lock_guard<mutex>       lock(state->mtx);
+        state->inFlight -= memEstimate;
+    }
+    state->cv.notify_all();
+}
+
+AsyncLoader::AsyncLoader(size_t memBudget,size_t numThreads) :
+    m_state(make_shared<AsyncLoadState>(memBudget))
+{
+    if (numThreads == 0)
+        numThreads = cNumHardwareThreads();
+    Sptr<AsyncLoadState>    state = m_state;
+    for (size_t ii=0; ii<numThreads; ++ii)
+        m_threads.emplace_back([state]{state->work(); });
+}
+
+AsyncLoader::~AsyncLoader()
+{
+    {
+        lock_guard<mutex>       lock(m_state->mtx);
+        m_state->stop = true;
+    }
+    m_state->cv.notify_all();
+    for (thread & t : m_threads)
+        t.join();
+    // Break the reference cycle between the state and its queued jobs:
+    deque<Sptr<AsyncJob> >  queue;
+    {
+        lock_guard<mutex>       lock(m_state->mtx);
+        queue.swap(m_state->queue);
+    }
+}
+
+void
+AsyncLoader::push(Sptr<AsyncJob> const & job)
+{
+    {
+        lock_guard<mutex>       lock(m_state->mtx);
+        m_state->queue.push_back(job);
+    }
+    m_state->cv.notify_one();
+}
+
+size_t
+AsyncLoader::memInFlight() const
+{
+    lock_guard<mutex>       lock(m_state->mtx);
+    return m_state->inFlight;
+}
+
+size_t
+AsyncLoader::memInFlightPeak() const
+{
+    lock_guard<mutex>       lock(m_state->mtx);
+    return m_state->inFlightPeak;
+}
+
+AsyncLoader &
+asyncLoaderDefault()
+{
+    static AsyncLoader      loader;
+    return loader;
+}
+
+uint64
+fileSizeOrZero(Ustring const & fname)
+{
+    boost::system::error_code   ec;
+    uintmax_t                   sz = boost::filesystem::file_size(fname.ns(),ec);
+    return ec ? 0 : uint64(sz);
+}
+
+void
+testAsyncLoad(CLArgs const &)
+{
+    // Results match and are retrievable in any order:
+    {
+        AsyncLoader             loader(100,4);
+        Svec<AsyncResult<size_t> > results;
+        for (size_t ii=0; ii<50; ++ii)
+            results.push_back(loader.submit<size_t>(10,[ii]{return ii*ii; }));
+        for (size_t ii=50; ii>0; --ii)
+            FGASSERT(results[ii-1].get() == (ii-1)*(ii-1));
+        FGASSERT(loader.memInFlight() == 0);
+        FGASSERT(loader.memInFlightPeak() <= 100 + 10);     // Inline loads can exceed the budget
+    }
+    // Budget is respected while results are held, and a single load over budget still runs:
+    {
+        AsyncLoader             loader(25,4);
+        atomic<int>             running {0},
+                                maxRunning {0};
+        auto                    fn = [&]()
+        {
+            int         rr = ++running;
+            int         mr = maxRunning;
+            while ((rr > mr) && !maxRunning.compare_exchange_weak(mr,rr))
+                ;
+            this_thread::sleep_for(chrono::milliseconds(5));
+            --running;
+            return rr;
+        };
+        Svec<AsyncResult<int> > results;
+        for (size_t ii=0; ii<20; ++ii)
+            results.push_back(loader.submit<int>(10,fn));
+        results.push_back(loader.submit<int>(1000,fn));
+        for (AsyncResult<int> & res : results)
+            res.get();
+        FGASSERT(maxRunning <= 2);
+        FGASSERT(loader.memInFlightPeak() == 1000);
+        FGASSERT(loader.memInFlight() == 0);
+    }
+    // Exceptions propagate and release their budget:
+    {
+        AsyncLoader             loader(10,2);
+        AsyncResult<int>        res = loader.submit<int>(10,[]()->int{fgThrow("testAsyncLoad"); return 0; });
+        bool                    caught = false;
+        try {res.get(); }
+        catch (FgException const &) {caught = true; }
+        FGASSERT(caught);
+        FGASSERT(loader.memInFlight() == 0);
+    }
+    // Results discarded without retrieval release their budget, and loads still queued when the
+    // loader is destroyed remain retrievable:
+    {
+        AsyncResult<int>        late;
+        {
+            AsyncLoader             loader(10,1);
+            {
+                AsyncResult<int>        dropped = loader.submit<int>(10,[]{return 1; });
+            }
+            late = loader.submit<int>(10,[]{return 2; });
+        }
+        FGASSERT(late.get() == 2);
+    }
+}
+
+}
+
+// */
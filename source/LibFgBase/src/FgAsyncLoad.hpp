@@ -0,0 +1,128 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Concurrent loading of many files (parsing / decoding) on a pool of worker threads with a bounded
+// memory budget.
+//
+// Each load is given an estimate of the memory it will use. A queued load is only started when the
+// sum of estimates for loads that are running or complete but not yet retrieved fits within the
+// budget (or when nothing else is outstanding, so a single load larger than the budget still runs).
+// Loads are started in the order queued. Calling 'get()' on a load that has not yet been started
+// runs it immediately in the calling thread, so retrieving results in any order cannot deadlock
+// (such a load is not limited by the budget).
+//
+
+#ifndef FGASYNCLOAD_HPP
+#define FGASYNCLOAD_HPP
+
+#include "FgStdExtensions.hpp"
+
+namespace Fg {
+
+struct  AsyncLoadState;
+
+struct  AsyncJob
+{
+    Sptr<AsyncLoadState>    state;
+    size_t                  memEstimate;
+    bool                    claimed = false;        // Protected by state mutex
+    // Set under the state mutex but atomic so that a job which is not charged can be released
+    // (eg. destroyed) while the state mutex is held:
+    std::atomic<bool>       charged {false};
+
+    AsyncJob(Sptr<AsyncLoadState> const & s,size_t m) : state(s), memEstimate(m) {}
+    virtual ~AsyncJob();
+
+    virtual void    run() = 0;
+
+    // Returns true if the job was not yet started by a worker and must be run by the caller:
+    bool            claim();
+    void            release();
+};
+
+template<class T>
+struct  AsyncJobT : AsyncJob
+{
+    std::packaged_task<T()>     task;
+    std::future<T>              result;
+
+    AsyncJobT(Sptr<AsyncLoadState> const & s,size_t m,std::function<T()> const & fn) :
+        AsyncJob(s,m), task(fn), result(task.get_future())
+    {}
+
+    virtual void    run() {task(); }
+};
+
+// Handle to a queued load. Exceptions thrown by the load are re-thrown by 'get()':
+template<class T>
+struct  AsyncResult
+{
+    AsyncResult() {}
+    explicit AsyncResult(Sptr<AsyncJobT<T> > const & job) : m_job(job) {}
+
+    bool
+    valid() const {return bool(m_job); }
+
+    // Blocks until the load is complete. Can only be called once:
+    T
+    get()
+    {
+        FGASSERT(m_job);
+        Sptr<AsyncJobT<T> >     job = m_job;
+        m_job.reset();
+        if (job->claim())
+            job->run();
+        struct Release {AsyncJob & j; ~Release() {j.release(); }} release {*job};
+        return job->result.get();
+    }
+
+private:
+    Sptr<AsyncJobT<T> >     m_job;
+};
+
+struct  AsyncLoader
+{
+    // 'memBudget' is in bytes. 'numThreads' == 0 uses the hardware concurrency:
+    explicit AsyncLoader(size_t memBudget=size_t(1)<<30,size_t numThreads=0);
+    // Loads not yet started are not run by the workers after destruction but will still be run
+    // by any subsequent call to their 'get()':
+    ~AsyncLoader();
+
+    AsyncLoader(AsyncLoader const &) = delete;
+    void operator=(AsyncLoader const &) = delete;
+
+    template<class T>
+    AsyncResult<T>
+    submit(size_t memEstimate,std::function<T()> const & load)
+    {
+        auto            job = std::make_shared<AsyncJobT<T> >(m_state,memEstimate,load);
+        push(job);
+        return AsyncResult<T>(job);
+    }
+
+    // Sum of estimates for loads currently outstanding and the maximum this has reached:
+    size_t          memInFlight() const;
+    size_t          memInFlightPeak() const;
+
+private:
+    Sptr<AsyncLoadState>    m_state;
+    Svec<std::thread>       m_threads;
+
+    void            push(Sptr<AsyncJob> const & job);
+};
+
+// Shared process-wide loader with default budget, for use by library loading functions:
+AsyncLoader &
+asyncLoaderDefault();
+
+// Size of the given file in bytes, or zero if it can't be determined, for use in memory estimates:
+uint64
+fileSizeOrZero(Ustring const & fname);
+
+}
+
+#endif
+
+// */
@@ -38,6 +38,7 @@
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/throw_exception.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 
 #endif  // FGBOOSTLIBS_HPP
 
@@ -182,6 +182,19 @@ cMinIdx(Mat<T,nrows,ncols> const & mat)
     return idx;
 }
 
+// Element-wise min:
+template<class T,uint nrows,uint ncols>
+Mat<T,nrows,ncols>
+cMin(
+    Mat<T,nrows,ncols> const & m1,
+    Mat<T,nrows,ncols> const & m2)
+{
+    Mat<T,nrows,ncols>    ret;
+    for (uint ii=0; ii<nrows*ncols; ++ii)
+        ret[ii] = cMin(m1[ii],m2[ii]);
+    return ret;
+}
+
 // Element-wise max:
 template<class T,uint nrows,uint ncols>
 Mat<T,nrows,ncols>
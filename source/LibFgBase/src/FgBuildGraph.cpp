@@ -0,0 +1,613 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+
+#include "stdafx.h"
+
+#include "FgBuildGraph.hpp"
+#include "FgParallel.hpp"
+#include "FgFileSystem.hpp"
+#include "FgStdStream.hpp"
+#include "FgParse.hpp"
+#include "FgOut.hpp"
+#include "FgCommand.hpp"
+#include "FgSyntax.hpp"
+#include "FgPath.hpp"
+#include "FgTestUtils.hpp"
+#include "MurmurHash2.h"
+
+using namespace std;
+
+namespace Fg {
+
+namespace {
+
+typedef chrono::steady_clock    Clock;
+
+double
+secondsSince(Clock::time_point start)
+{return chrono::duration<double>(Clock::now()-start).count(); }
+
+uint64
+hashCombine(uint64 hash,void const * data,size_t size)
+{return MurmurHash64A(data,int(size),hash); }
+
+uint64
+hashCombine(uint64 hash,String const & str)
+{
+    uint64          sz = str.size();
+    hash = hashCombine(hash,&sz,sizeof(sz));
+    return hashCombine(hash,str.data(),str.size());
+}
+
+// Invalid if the file cannot be read:
+Opt<uint64>
+hashFile(Ustring const & fname)
+{
+    Ifstream            ifs(fname,false);
+    if (!ifs.is_open())
+        return Opt<uint64>();
+    uint64              hash = 0x4E6F4C0DD1A7B3C5ULL;
+    Svec<char>          buf(size_t(1) << 20);
+    while (ifs) {
+        ifs.read(buf.data(),buf.size());
+        size_t              num = size_t(ifs.gcount());
+        if (num > 0)
+            hash = hashCombine(hash,buf.data(),num);
+    }
+    if (ifs.bad())
+        return Opt<uint64>();
+    return Opt<uint64>(hash);
+}
+
+String
+toHex(uint64 val)
+{
+    ostringstream       oss;
+    oss << hex << setw(16) << setfill('0') << val;
+    return oss.str();
+}
+
+// Hashes of a step's source and sink file contents when it last succeeded:
+struct  StepState
+{
+    uint64              inputs;
+    uint64              outputs;
+    double              duration;
+};
+typedef map<String,StepState>   StepStates;
+
+// One line per step: <inputs hash> <outputs hash> <duration> <name>
+StepStates
+loadStepStates(Ustring const & fname)
+{
+    StepStates          ret;
+    if (fname.empty() || !fileExists(fname))
+        return ret;
+    for (String const & line : splitLines(loadRawString(fname))) {
+        istringstream       iss(line);
+        StepState           st;
+        String              name;
+        iss >> hex >> st.inputs >> st.outputs >> dec >> st.duration;
+        getline(iss >> ws,name);
+        if (!iss.fail() && !name.empty())       // Ignore corrupt lines; those steps will be re-run
+            ret[name] = st;
+    }
+    return ret;
+}
+
+void
+saveStepStates(StepStates const & states,Ustring const & fname)
+{
+    ostringstream       oss;
+    for (auto const & it : states)
+        oss << toHex(it.second.inputs) << " " << toHex(it.second.outputs) << " "
+            << it.second.duration << " " << it.first << "\n";
+    saveRaw(oss.str(),fname);
+}
+
+enum struct StepStatus { waiting, ready, running, done, failed, skipped };
+
+}
+
+ostream &
+operator<<(ostream & os,BuildReport const & br)
+{
+    os << fgnl << "Steps run: " << br.numRun << " up to date: " << br.numUpToDate
+        << " failed: " << br.numFailed << " skipped: " << br.numSkipped
+        << fgnl << "Wall time: " << br.wallTime << "s step time: " << br.stepTime << "s";
+    if (br.wallTime > 0.0)
+        os << " (" << br.stepTime / br.wallTime << "x)";
+    os << fgnl << "Critical path: " << br.criticalPathTime << "s" << fgpush;
+    for (BuildStepTime const & st : br.criticalPath)
+        os << fgnl << st.start << "s +" << st.duration << "s " << st.name;
+    os << fgpop;
+    for (String const & err : br.errors)
+        os << fgnl << "FAILED " << err;
+    return os;
+}
+
+BuildReport
+runBuildGraph(BuildGraph const & graph,BuildOptions const & options)
+{
+    Clock::time_point       startTime = Clock::now();
+    uint                    numSteps = graph.numLinks();
+    // Step dependencies, without duplicates:
+    Uintss                  producers(numSteps),
+                            consumers(numSteps);
+    {
+        set<String>             names;
+        for (uint ss=0; ss<numSteps; ++ss) {
+            String const &          name = graph.linkData(ss).name;
+            if (!names.insert(name).second)
+                fgThrow("Build graph has duplicate step name",name);
+            set<uint>               prods;
+            for (uint src : graph.linkSources(ss))
+                if (graph.hasIncomingLink(src))
+                    prods.insert(graph.incomingLink(src));
+            producers[ss].assign(prods.begin(),prods.end());
+            for (uint pp : prods)
+                consumers[pp].push_back(ss);
+        }
+    }
+    // Topological order:
+    Uints                   order;
+    {
+        Uints                   numProds(numSteps);
+        for (uint ss=0; ss<numSteps; ++ss) {
+            numProds[ss] = uint(producers[ss].size());
+            if (numProds[ss] == 0)
+                order.push_back(ss);
+        }
+        for (size_t ii=0; ii<order.size(); ++ii)
+            for (uint cc : consumers[order[ii]])
+                if (--numProds[cc] == 0)
+                    order.push_back(cc);
+        if (order.size() != numSteps)
+            fgThrow("Build graph contains a cycle");
+    }
+    StepStates              prevStates = loadStepStates(options.stateFile);
+    // Priority is the estimated duration of the longest chain of steps starting with this one,
+    // using the durations from the previous build (unknown steps count as 1s so that chain length
+    // is still taken into account):
+    Doubles                 priority(numSteps,0.0);
+    for (auto it=order.rbegin(); it!=order.rend(); ++it) {
+        auto                    ps = prevStates.find(graph.linkData(*it).name);
+        double                  maxCons = 0.0;
+        for (uint cc : consumers[*it])
+            maxCons = max(maxCons,priority[cc]);
+        priority[*it] = maxCons + ((ps == prevStates.end()) ? 1.0 : ps->second.duration);
+    }
+
+    mutex                   mtx;
+    condition_variable      cv;
+    // Protected by 'mtx':
+    Svec<StepStatus>        status(numSteps,StepStatus::waiting);
+    Uints                   numWaiting(numSteps);           // Producers not yet done
+    set<pair<double,uint> > ready;                          // By priority
+    size_t                  numRunning = 0;
+    bool                    stop = false;
+    StepStates              states;
+    Svec<BuildStepTime>     times(numSteps);
+    BuildReport             report;
+    for (uint ss=0; ss<numSteps; ++ss) {
+        numWaiting[ss] = uint(producers[ss].size());
+        if (numWaiting[ss] == 0) {
+            status[ss] = StepStatus::ready;
+            ready.insert(make_pair(priority[ss],ss));
+        }
+    }
+    // Sink file hashes are set by the producing step before it is marked done, source files
+    // which are not produced by any step are hashed by each step which uses them:
+    Svec<Opt<uint64> >      fileHashes(graph.numNodes());
+    auto                    fileHash = [&](uint nodeIdx) -> Opt<uint64>
+    {
+        if (graph.hasIncomingLink(nodeIdx))
+            return fileHashes[nodeIdx];
+        return hashFile(graph.nodeData(nodeIdx));
+    };
+    // Returns true if run, false if up to date. Throws on failure:
+    auto                    runStep = [&](uint ss) -> bool
+    {
+        BuildStep const &       step = graph.linkData(ss);
+        uint64                  inputs = hashCombine(0x6A09E667F3BCC908ULL,step.signature);
+        for (uint src : graph.linkSources(ss)) {
+            Opt<uint64>             hash = fileHash(src);
+            if (!hash.valid())
+                fgThrow("Build step input file not found",graph.nodeData(src));
+            inputs = hashCombine(inputs,graph.nodeData(src).m_str);
+            inputs = hashCombine(inputs,&hash.ref(),8);
+        }
+        auto                    hashOutputs = [&]() -> Opt<uint64>
+        {
+            uint64                  outputs = 0xBB67AE8584CAA73BULL;
+            for (uint snk : graph.linkSinks(ss)) {
+                Opt<uint64>             hash = hashFile(graph.nodeData(snk));
+                fileHashes[snk] = hash;     // Sinks are only accessed by this step until it is done
+                if (!hash.valid())
+                    return Opt<uint64>();
+                outputs = hashCombine(outputs,&hash.ref(),8);
+            }
+            return Opt<uint64>(outputs);
+        };
+        auto                    ps = prevStates.find(step.name);
+        if ((ps != prevStates.end()) && (ps->second.inputs == inputs)) {
+            Opt<uint64>             outputs = hashOutputs();
+            if (outputs.valid() && (outputs.val() == ps->second.outputs)) {
+                lock_guard<mutex>       lock(mtx);
+                states[step.name] = ps->second;
+                return false;
+            }
+        }
+        if (options.verbose) {
+            lock_guard<mutex>       lock(mtx);
+            fgout << fgnl << step.name;
+        }
+        Clock::time_point       start = Clock::now();
+        if (step.action)
+            step.action();
+        double                  duration = secondsSince(start);
+        Opt<uint64>             outputs = hashOutputs();
+        if (!outputs.valid())
+            fgThrow("Build step did not create all its output files",step.name);
+        lock_guard<mutex>       lock(mtx);
+        states[step.name] = StepState {inputs,outputs.val(),duration};
+        times[ss].duration = duration;
+        return true;
+    };
+    // Must be called under the mutex:
+    function<void(uint)>    skipDependents = [&](uint ss)
+    {
+        for (uint cc : consumers[ss]) {
+            if (status[cc] == StepStatus::ready)
+                ready.erase(make_pair(priority[cc],cc));
+            if ((status[cc] == StepStatus::waiting) || (status[cc] == StepStatus::ready)) {
+                status[cc] = StepStatus::skipped;
+                skipDependents(cc);
+            }
+        }
+    };
+    auto                    worker = [&]()
+    {
+        unique_lock<mutex>      lock(mtx);
+        for (;;) {
+            cv.wait(lock,[&]{return (stop || !ready.empty() || (numRunning == 0)); });
+            if (stop || ready.empty())
+                return;
+            uint                    ss = prev(ready.end())->second;
+            ready.erase(prev(ready.end()));
+            status[ss] = StepStatus::running;
+            times[ss] = BuildStepTime {graph.linkData(ss).name,secondsSince(startTime),0.0};
+            ++numRunning;
+            lock.unlock();
+            bool                    ran = false;
+            String                  error;
+            try {
+                ran = runStep(ss);
+            }
+            catch (FgException const & e) {
+                error = e.no_tr_message();
+            }
+            catch (std::exception const & e) {
+                error = String("Standard library exception: ") + e.what();
+            }
+            catch (...) {
+                error = "Unknown exception type";
+            }
+            lock.lock();
+            --numRunning;
+            if (error.empty()) {
+                status[ss] = StepStatus::done;
+                if (ran) {
+                    ++report.numRun;
+                    report.stepTime += times[ss].duration;
+                }
+                else
+                    ++report.numUpToDate;
+                for (uint cc : consumers[ss]) {
+                    if ((status[cc] == StepStatus::waiting) && (--numWaiting[cc] == 0)) {
+                        status[cc] = StepStatus::ready;
+                        ready.insert(make_pair(priority[cc],cc));
+                    }
+                }
+            }
+            else {
+                status[ss] = StepStatus::failed;
+                ++report.numFailed;
+                report.errors.push_back(graph.linkData(ss).name + ": " + error);
+                states.erase(graph.linkData(ss).name);
+                skipDependents(ss);
+                if (!options.keepGoing)
+                    stop = true;
+            }
+            cv.notify_all();
+        }
+    };
+    size_t                  numThreads = (options.numThreads == 0) ? cNumHardwareThreads() : options.numThreads;
+    numThreads = max(min(numThreads,size_t(numSteps)),size_t(1));
+    Svec<thread>            threads;
+    for (size_t tt=1; tt<numThreads; ++tt)
+        threads.emplace_back(worker);
+    worker();
+    for (thread & t : threads)
+        t.join();
+    report.numSkipped = numSteps - report.numRun - report.numUpToDate - report.numFailed;
+    report.wallTime = secondsSince(startTime);
+    if (!options.stateFile.empty()) {
+        // Keep the state of steps which weren't reached so they aren't re-run unnecessarily next time:
+        for (uint ss=0; ss<numSteps; ++ss) {
+            String const &          name = graph.linkData(ss).name;
+            auto                    ps = prevStates.find(name);
+            if ((status[ss] != StepStatus::done) && (status[ss] != StepStatus::failed) && (ps != prevStates.end()))
+                states[name] = ps->second;
+        }
+        saveStepStates(states,options.stateFile);
+    }
+    // Critical path over the steps completed, in topological order:
+    Doubles                 finish(numSteps,0.0);
+    Svec<Opt<uint> >        pred(numSteps);
+    Opt<uint>               last;
+    for (uint ss : order) {
+        if (status[ss] != StepStatus::done)
+            continue;
+        double                  maxPrev = 0.0;
+        for (uint pp : producers[ss]) {
+            if (finish[pp] >= maxPrev) {
+                maxPrev = finish[pp];
+                pred[ss] = pp;
+            }
+        }
+        finish[ss] = maxPrev + times[ss].duration;
+        if (!last.valid() || (finish[ss] > finish[last.val()]))
+            last = ss;
+    }
+    if (last.valid()) {
+        report.criticalPathTime = finish[last.val()];
+        for (Opt<uint> ss=last; ss.valid(); ss=pred[ss.val()])
+            report.criticalPath.insert(report.criticalPath.begin(),times[ss.val()]);
+    }
+    return report;
+}
+
+BuildGraph
+loadBuildGraph(Ustring const & fname)
+{
+    BuildGraph              ret;
+    map<Ustring,uint>       nodes;
+    auto                    node = [&](String const & path) -> uint
+    {
+        auto                    it = nodes.find(path);
+        if (it != nodes.end())
+            return it->second;
+        uint                    idx = ret.addNode(path);
+        nodes[path] = idx;
+        return idx;
+    };
+    struct  Block
+    {
+        String                  name,
+                                cmd;
+        Strings                 ins,
+                                outs;
+    };
+    Svec<Block>             blocks;
+    Strings                 lines = splitLines(loadRawString(fname));
+    for (size_t ll=0; ll<lines.size(); ++ll) {
+        String                  line = lines[ll];
+        if (!line.empty() && (line.back() == '\r'))
+            line.pop_back();
+        Strings                 words = splitWhitespace(line);
+        if (words.empty() || (words[0][0] == '#'))
+            continue;
+        String                  rest = (words.size() > 1) ? cRest(line,line.find(words[1],words[0].size())) : String();
+        auto                    error = [&](String const & msg)
+        {fgThrow("Build graph file "+msg,fname+":"+toStr(ll+1)); };
+        if (words[0] == "step") {
+            if (words.size() != 2)
+                error("step requires a single name");
+            blocks.push_back(Block {words[1],String(),Strings(),Strings()});
+            continue;
+        }
+        if (blocks.empty())
+            error("expected 'step'");
+        Block &                 block = blocks.back();
+        if ((words[0] == "in") || (words[0] == "out")) {
+            Strings &               files = (words[0] == "in") ? block.ins : block.outs;
+            files.insert(files.end(),words.begin()+1,words.end());
+        }
+        else if (words[0] == "run") {
+            if (!block.cmd.empty() || rest.empty())
+                error("requires a single non-empty 'run' for each step");
+            block.cmd = rest;
+        }
+        else
+            error("unrecognized keyword '"+words[0]+"'");
+    }
+    for (Block const & block : blocks) {
+        if (block.outs.empty() || block.cmd.empty())
+            fgThrow("Build graph file step requires 'out' and 'run'",block.name);
+        Uints                   ins,
+                                outs;
+        for (String const & in : block.ins)
+            ins.push_back(node(in));
+        for (String const & out : block.outs)
+            outs.push_back(node(out));
+        String                  cmd = block.cmd;
+        BuildStep               step {block.name,cmd,[cmd]()
+        {
+            int                     rv = system(cmd.c_str());
+            if (rv != 0)
+                fgThrow("Build command failed with exit code "+toStr(rv),cmd);
+        }};
+        ret.addLink(step,ins,outs);
+    }
+    return ret;
+}
+
+void
+cmdBuildGraph(CLArgs const & args)
+{
+    Syntax              syn(args,
+        "[-j <threads>] [-k] [-q] <graph>.txt\n"
+        "    -j         - Number of steps to run concurrently. Defaults to the number of hardware threads.\n"
+        "    -k         - Keep going with independent steps after a step fails.\n"
+        "    -q         - Quiet; don't output each step name as it is run.\n"
+        "    <graph>    - Build graph file in the format:\n"
+        "        step <name>\n"
+        "        in <file>*\n"
+        "        out <file>+\n"
+        "        run <command line>\n"
+        "    Files and commands are relative to the directory of <graph>. Steps are only run if the content\n"
+        "    of their input or output files, or their command, has changed since they last succeeded.\n"
+        "    This is tracked in <graph>.state"
+    );
+    BuildOptions        opts;
+    while (syn.peekNext()[0] == '-') {
+        String              opt = syn.next();
+        if (opt == "-j")
+            opts.numThreads = syn.nextAs<uint>();
+        else if (opt == "-k")
+            opts.keepGoing = true;
+        else if (opt == "-q")
+            opts.verbose = false;
+        else
+            syn.error("Unrecognized option",opt);
+    }
+    Path                path(syn.next());
+    syn.noMoreArgsExpected();
+    PushDir             pd;
+    if (!path.dir().empty())
+        pd.push(path.dir());
+    Ustring             fname = path.baseExt();
+    opts.stateFile = path.base + ".state";
+    BuildReport         report = runBuildGraph(loadBuildGraph(fname),opts);
+    fgout << report;
+    if (!report.success())
+        fgThrow("Build graph failed",toStr(report.numFailed)+" steps");
+}
+
+void
+testBuildGraph(CLArgs const &)
+{
+    TestDir             td("buildGraph");
+    saveRaw("abc","a.txt");
+    map<String,size_t>  runs;
+    mutex               runsMtx;
+    BuildGraph          graph;
+    auto                addStep = [&](String const & name,Strings const & ins,String const & out,
+        String const & sig,function<String(Strings const &)> fn)
+    {
+        Uints               srcs,
+                            snks;
+        for (String const & in : ins) {
+            uint                idx = graph.numNodes();
+            for (uint nn=0; nn<graph.numNodes(); ++nn)
+                if (graph.nodeData(nn) == in)
+                    idx = nn;
+            if (idx == graph.numNodes())
+                graph.addNode(in);
+            srcs.push_back(idx);
+        }
+        snks.push_back(graph.addNode(out));
+        auto                action = [=,&runs,&runsMtx]()
+        {
+            Strings             data;
+            for (String const & in : ins)
+                data.push_back(loadRawString(in));
+            saveRaw(fn(data)+sig,out,false);
+            lock_guard<mutex>   lock(runsMtx);
+            ++runs[name];
+        };
+        return graph.addLink(BuildStep {name,sig,action},srcs,snks);
+    };
+    auto                cat = [](Strings const & d) -> String
+    {
+        String              ret;
+        for (String const & s : d)
+            ret += s;
+        return ret;
+    };
+    auto                slow = [cat](Strings const & d)
+    {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        return cat(d);
+    };
+    addStep("upper",{"a.txt"},"b.txt","",[](Strings const & d){return toUpper(d[0]); });
+    addStep("concat",{"a.txt","b.txt"},"c.txt","",cat);
+    for (uint ii=0; ii<4; ++ii)
+        addStep("p"+toStr(ii),{"a.txt"},"p"+toStr(ii)+".txt","",slow);
+    addStep("join",{"c.txt","p0.txt","p1.txt","p2.txt","p3.txt"},"out.txt","",cat);
+    BuildOptions        opts;
+    opts.numThreads = 4;
+    opts.stateFile = "state.txt";
+    opts.verbose = false;
+    BuildReport         rep = runBuildGraph(graph,opts);
+    fgout << rep;
+    FGASSERT(rep.success() && (rep.numRun == 7));
+    FGASSERT(loadRawString("out.txt") == "abcABCabcabcabcabc");
+    // The 4 slow steps run concurrently:
+    FGASSERT(rep.wallTime < 0.3);
+    FGASSERT(rep.criticalPath.size() == 2);
+    FGASSERT(rep.criticalPath[1].name == "join");
+    // Nothing changed:
+    rep = runBuildGraph(graph,opts);
+    FGASSERT(rep.success() && (rep.numRun == 0) && (rep.numUpToDate == 7));
+    // Re-writing a source with the same content doesn't trigger anything:
+    saveRaw("abc","a.txt",false);
+    rep = runBuildGraph(graph,opts);
+    FGASSERT(rep.numRun == 0);
+    // Changing an output re-runs its step, which re-creates the same content so nothing downstream runs:
+    saveRaw("xyz","b.txt",false);
+    rep = runBuildGraph(graph,opts);
+    FGASSERT((rep.numRun == 1) && (runs["upper"] == 2) && (runs["concat"] == 1));
+    // Changing a source re-runs everything downstream:
+    saveRaw("def","a.txt",false);
+    rep = runBuildGraph(graph,opts);
+    FGASSERT(rep.numRun == 7);
+    FGASSERT(loadRawString("out.txt") == "defDEFdefdefdefdef");
+    // Changing a step's signature re-runs it. The action ignores the new signature so its output is
+    // unchanged and 'join' remains up to date:
+    graph.linkData(2).signature = "!";
+    rep = runBuildGraph(graph,opts);
+    FGASSERT((rep.numRun == 1) && (runs["p0"] == 3) && (runs["join"] == 2));
+    // A failing step skips its dependents but independent steps still run with 'keepGoing':
+    graph.linkData(1).action = [](){fgThrow("Test step failure"); };
+    graph.linkData(1).signature = "fail";
+    graph.linkData(3).signature = "?";
+    opts.keepGoing = true;
+    rep = runBuildGraph(graph,opts);
+    FGASSERT(!rep.success() && (rep.numFailed == 1) && (rep.numSkipped == 1) && (rep.numRun == 1));
+    FGASSERT(runs["p1"] == 3);
+    // Graph file with commands:
+    saveRaw(
+        "# Test graph\n"
+        "step hello\n"
+        "out h.txt\n"
+        "run echo hello> h.txt\n"
+        "\n"
+        "step world\n"
+        "in h.txt\n"
+        "out w.txt\n"
+        "run echo world> w.txt\n"
+        ,"graph.txt");
+    BuildGraph          fileGraph = loadBuildGraph("graph.txt");
+    FGASSERT((fileGraph.numLinks() == 2) && (fileGraph.numNodes() == 2));
+    opts.stateFile = "graph.state";
+    rep = runBuildGraph(fileGraph,opts);
+    FGASSERT(rep.success() && (rep.numRun == 2) && fileExists("w.txt"));
+    rep = runBuildGraph(fileGraph,opts);
+    FGASSERT(rep.success() && (rep.numUpToDate == 2));
+    // Cycles are detected:
+    BuildGraph          cyclic;
+    cyclic.addNode("x");
+    cyclic.addNode("y");
+    cyclic.addLink(BuildStep {"xy","",nullptr},{0},{1});
+    cyclic.addLink(BuildStep {"yx","",nullptr},{1},{0});
+    FG_TEST_CHECK_THROW_1(runBuildGraph(cyclic,opts),"Build graph contains a cycle");
+}
+
+}
+
+// */
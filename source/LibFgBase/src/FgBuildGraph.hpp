@@ -0,0 +1,94 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Parallel execution of file-producing steps described by a FgLinkGraph in which each node is a file
+// and each link is a step which creates its sink files from its source files.
+//
+// A step is only run if it is out of date, ie. if the content of any of its source or sink files,
+// or its signature, has changed since it last succeeded. Since this is based on content hashes
+// rather than modification times, a step whose outputs are re-created unchanged does not cause
+// the steps which depend on them to run. The hashes are kept in a state file along with the
+// duration of each step, which is used to start the steps with the longest remaining chain of
+// dependents first.
+//
+// Graph file format (see 'loadBuildGraph'), one block of lines per step:
+//
+//   step <name>
+//   in <file>              (zero or more)
+//   out <file>             (one or more)
+//   run <command line>     (run by the system shell)
+//
+// Blank lines and lines beginning with '#' are ignored. File names cannot contain whitespace.
+//
+
+#ifndef FGBUILDGRAPH_HPP
+#define FGBUILDGRAPH_HPP
+
+#include "FgLinkGraph.hpp"
+#include "FgStdFunction.hpp"
+#include "FgString.hpp"
+
+namespace Fg {
+
+struct  BuildStep
+{
+    String                  name;       // Must be unique within a graph
+    // Anything other than the source files which affects the sink files (eg. the command line):
+    String                  signature;
+    // Creates the sink files. Throws on failure. Called concurrently with other steps:
+    std::function<void()>   action;
+};
+
+typedef FgLinkGraph<Ustring,BuildStep>  BuildGraph;     // Nodes are file paths
+
+struct  BuildOptions
+{
+    uint                numThreads = 0;         // 0 selects the number of hardware threads
+    Ustring             stateFile;              // If empty no state is kept so all steps are run
+    bool                keepGoing = false;      // Continue with independent steps after a failure
+    bool                verbose = true;         // Output the name of each step as it is run
+};
+
+struct  BuildStepTime
+{
+    String              name;
+    double              start;                  // Seconds from start of build
+    double              duration;               // Zero if the step was up to date
+};
+
+struct  BuildReport
+{
+    size_t              numRun = 0,
+                        numUpToDate = 0,
+                        numFailed = 0,
+                        numSkipped = 0;         // Not run due to a failure
+    Strings             errors;                 // One for each failed step
+    double              wallTime = 0.0;         // Seconds
+    double              stepTime = 0.0;         // Sum of the durations of steps run
+    // The chain of dependent steps with the longest total duration, in order of execution. With
+    // unlimited threads the build cannot take less time than this:
+    Svec<BuildStepTime> criticalPath;
+    double              criticalPathTime = 0.0;
+
+    bool                success() const {return ((numFailed == 0) && (numSkipped == 0)); }
+};
+
+std::ostream &
+operator<<(std::ostream &,BuildReport const &);
+
+// Throws if the graph contains a cycle or duplicate step names. Step failures are returned in the report:
+BuildReport
+runBuildGraph(BuildGraph const & graph,BuildOptions const & options);
+
+// Parses a graph file in the format described above. File names are used as given so are relative to
+// the current directory when the graph is run, as are the commands:
+BuildGraph
+loadBuildGraph(Ustring const & fname);
+
+}
+
+#endif
+
+// */
@@ -19,11 +19,120 @@
 #include "FgSyntax.hpp"
 #include "FgParse.hpp"
 #include "FgTcp.hpp"
+#include "FgSerial.hpp"
 
 using namespace std;
 
 namespace Fg {
 
+bool
+FgClustInStream::next(String & part)
+{
+    if (m_pos < m_buf.size()) {
+        part = m_buf.substr(m_pos);
+        m_buf.clear();
+        m_pos = 0;
+        return true;
+    }
+    return nextChunk(part);
+}
+
+void
+FgClustInStream::read(char * data,size_t size)
+{
+    while (size > 0) {
+        if (m_pos == m_buf.size()) {
+            m_pos = 0;
+            if (!nextChunk(m_buf)) {
+                m_buf.clear();
+                fgThrow("Cluster message ended before the expected size",toStr(size)+" bytes remaining");
+            }
+            continue;
+        }
+        size_t              num = std::min(size,m_buf.size()-m_pos);
+        memcpy(data,m_buf.data()+m_pos,num);
+        data += num;
+        size -= num;
+        m_pos += num;
+    }
+}
+
+String
+FgClustInStream::readAll()
+{
+    String              ret,
+                        part;
+    while (next(part)) {
+        if (ret.empty())
+            ret.swap(part);
+        else
+            ret += part;
+    }
+    return ret;
+}
+
+std::future<String>
+FgClustQueue::submit(String const & task)
+{
+    auto                promise = std::make_shared<std::promise<String> >();
+    std::future<String> ret = promise->get_future();
+    submit(task,
+        [promise](String const & result) {promise->set_value(result); },
+        [promise](String const & error)
+        {promise->set_exception(std::make_exception_ptr(FgException("Cluster task failed",error))); });
+    return ret;
+}
+
+void
+fgClustProcess(
+    FgClustQueue &                                  queue,
+    Strings const &                                 tasks,
+    std::function<void(size_t,String const &)>      onResult)
+{
+    std::mutex              mtx;
+    std::condition_variable cv;
+    size_t                  numDone = 0;
+    Strings                 errors;
+    // Notify under the lock so this function can't return and destroy 'cv' before the notify:
+    auto                    done = [&](Opt<String> const & error)
+    {
+        if (error.valid())
+            errors.push_back(error.val());
+        ++numDone;
+        cv.notify_all();
+    };
+    for (size_t tt=0; tt<tasks.size(); ++tt) {
+        queue.submit(tasks[tt],
+            [&,tt](String const & result)
+            {
+                std::lock_guard<std::mutex>     lock(mtx);
+                Opt<String>     error;
+                try {
+                    onResult(tt,result);
+                }
+                catch (FgException const & e) {
+                    error = e.no_tr_message();
+                }
+                catch (std::exception const & e) {
+                    error = String(e.what());
+                }
+                catch (...) {
+                    error = String("Unknown exception type");
+                }
+                done(error);
+            },
+            [&,tt](String const & error)
+            {
+                std::lock_guard<std::mutex>     lock(mtx);
+                done(Opt<String>("Task "+toStr(tt)+": "+error));
+            });
+    }
+    std::unique_lock<std::mutex>    lock(mtx);
+    cv.wait(lock,[&]{return (numDone == tasks.size()); });
+    if (!errors.empty())
+        fgThrow("Cluster processing failed",errors[0]);
+}
+
 void
 fgClusterDeploy(
     string const &          name,
@@ -100,9 +209,9 @@ string
 testWorkerFunc(string const & msg)
 {
     Doubles      vals;
-    fgDeserialize(msg,vals);
+    fromNative(msg,vals);
     //fgout << fgnl << "Received: " << vals;
-    return fgSerialize(cSum(vals));
+    return toNative(cSum(vals));
 }
 
 static
@@ -110,14 +219,14 @@ void
 testCoordinator(const FgClustDispatcher * dispatcher)
 {
     Doubles              vals = svec(3.14,2.72,1.41);
-    string              msg = fgSerialize(vals);
+    string              msg = toNative(vals);
     size_t              sz = dispatcher->numMachines();
     Strings              msgsOut(sz,msg),
                         msgsIn(sz);
     dispatcher->batchProcess(msgsOut,msgsIn);
     for (size_t ww=0; ww<sz; ++ww) {
         double          res;
-        fgDeserialize(msgsIn[ww],res);
+        fromNative(msgsIn[ww],res);
         //fgout << fgnl << "Worker " << ww << " result: " << res;
         FGASSERT(res == cSum(vals));
     }
@@ -128,9 +237,208 @@ testCoordinator(const FgClustDispatcher * dispatcher)
 void
 fgClusterTest(CLArgs const &)
 {
-    std::thread       worker(fgClustWorker,testWorkerFunc,fgClusterPortDefault());
+    std::thread       worker(fgClustWorker,testWorkerFunc,fgClusterPortDefault(),false,1);
     shared_ptr<FgClustDispatcher>   dispatcher = fgClustDispatcher(svec<string>("127.0.0.1"),fgClusterPortDefault());
     testCoordinator(dispatcher.get());      // Local host loop-back IP for testing
+    dispatcher.reset();                     // Closing the connection terminates the worker
+    worker.join();
+}
+
+// Several workers on loopback ports, one slow and one which drops its connection part way through:
+void
+testClustQueue(CLArgs const &)
+{
+    size_t                  numWorkers = 4,
+                            inFlight = 2;
+    uint                    numTasks = 60;
+    Svec<std::atomic<size_t> > counts(numWorkers);
+    Svec<std::thread>       workers;
+    Strings                 hosts;
+    for (size_t ww=0; ww<numWorkers; ++ww) {
+        counts[ww] = 0;
+        uint16              port = uint16(fgClusterPortDefault()+1+ww);
+        FgFnStr2Str         handler = [&counts,ww,inFlight,numTasks](String const & msg)
+        {
+            Uints               task;
+            fromNative(msg,task);
+            if ((ww == 3) && (counts[ww] == 3))
+                fgThrow("Test worker failure");     // Terminates the worker, dropping its connection
+            if (ww == 0) {
+                // The slow worker stalls until the others have done all tasks it can't be holding:
+                auto                others = [&counts](){return counts[1] + counts[2] + counts[3]; };
+                auto                deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+                while ((others() + inFlight < numTasks) && (std::chrono::steady_clock::now() < deadline))
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(task[1]));
+            ++counts[ww];
+            return toNative(task[0]*2);
+        };
+        workers.emplace_back([handler,port]()
+        {
+            try {fgClustWorker(handler,port); }
+            catch (...) {}
+        });
+        hosts.push_back("127.0.0.1:"+toStr(port));
+    }
+    shared_ptr<FgClustQueue>    queue = fgClustQueue(hosts,fgClusterPortDefault(),inFlight);
+    FGASSERT(queue->numWorkers() == numWorkers);
+    Strings                 tasks;
+    for (uint tt=0; tt<numTasks; ++tt)
+        tasks.push_back(toNative(svec(tt,(tt*7)%20+1)));       // Uneven durations
+    Uints                   results(numTasks,0);
+    size_t                  numResults = 0;
+    fgClustProcess(*queue,tasks,[&](size_t idx,String const & msg)
+    {
+        uint                res;
+        fromNative(msg,res);
+        FGASSERT(res == idx*2);
+        ++results[idx];
+        ++numResults;
+    });
+    FGASSERT(numResults == numTasks);
+    FGASSERT(results == Uints(numTasks,1));
+    FGASSERT(counts[3] == 3);
+    FGASSERT(queue->numWorkers() == numWorkers-1);
+    FGASSERT(counts[0] <= inFlight);                // Slow worker was given no more than its first tasks
+    // Futures:
+    Svec<std::future<String> >  futures;
+    for (uint tt=0; tt<10; ++tt)
+        futures.push_back(queue->submit(toNative(svec(tt,1U))));
+    for (uint tt=0; tt<10; ++tt) {
+        uint                res;
+        fromNative(futures[tt].get(),res);
+        FGASSERT(res == tt*2);
+    }
+    queue.reset();                                  // Closes the connections, terminating the workers
+    for (std::thread & worker : workers)
+        worker.join();
+    fgout << fgnl << "Tasks per worker: ";
+    for (size_t ww=0; ww<numWorkers; ++ww)
+        fgout << counts[ww] << " ";
+}
+
+// The first tasks wait for each other so all worker threads are busy at once, and the first task
+// waits until another result has been received so a multi-threaded worker returns results out of order:
+void
+testClustConcurrent(CLArgs const &)
+{
+    uint16                  port = uint16(fgClusterPortDefault()+6);
+    uint const              numThreads = 4;
+    size_t const            numTasks = 24;
+    std::atomic<uint>       running {0},
+                            maxRunning {0};
+    std::atomic<size_t>     numReceived {0};
+    auto                    waitFor = [](std::function<bool()> const & done)
+    {
+        auto                    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!done() && (std::chrono::steady_clock::now() < deadline))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    };
+    FgFnStr2Str             handler = [&](String const & msg)
+    {
+        uint                    task;
+        fromNative(msg,task);
+        uint                    curr = ++running,
+                                prev = maxRunning;
+        while ((curr > prev) && !maxRunning.compare_exchange_weak(prev,curr))
+            {}
+        if (task < numThreads)
+            waitFor([&]{return (maxRunning == numThreads); });
+        if (task == 0)
+            waitFor([&]{return (numReceived > 0); });
+        --running;
+        return toNative(task*3);
+    };
+    std::thread             worker([&]()
+    {
+        try {fgClustWorker(handler,port,false,numThreads); }
+        catch (...) {}
+    });
+    // The worker's thread count isn't known until its first response so allow enough tasks in
+    // flight for every thread to start on one of the first tasks:
+    shared_ptr<FgClustQueue>    queue = fgClustQueue(svec<String>("127.0.0.1"),port,numThreads);
+    Strings                 tasks;
+    for (uint tt=0; tt<numTasks; ++tt)
+        tasks.push_back(toNative(tt));
+    Sizes                   order;
+    fgClustProcess(*queue,tasks,[&](size_t idx,String const & res)
+    {
+        uint                    val;
+        fromNative(res,val);
+        FGASSERT(val == idx*3);
+        order.push_back(idx);
+        ++numReceived;
+    });
+    FGASSERT(order.size() == numTasks);
+    FGASSERT(order[0] != 0);
+    FgClustWorkerLoads      loads = queue->workerLoads();
+    FGASSERT(loads.size() == 1);
+    FGASSERT(loads[0].threads == numThreads);
+    FGASSERT(loads[0].completed == numTasks);
+    FGASSERT(loads[0].inFlight == 0);
+    FGASSERT(maxRunning == numThreads);
+    queue.reset();
+    worker.join();
+}
+
+// A message larger than the previous 32MB limit is deserialized by the worker as it arrives:
+void
+testClustStream(CLArgs const &)
+{
+    uint16                  port = uint16(fgClusterPortDefault()+5);
+    size_t                  numVals = size_t(12) << 20;     // 48MB
+    Svec<float>             vals(numVals);
+    double                  sum = 0.0;
+    for (size_t ii=0; ii<numVals; ++ii) {
+        vals[ii] = float(ii % 1000) * 0.5f;
+        sum += vals[ii];
+    }
+    String                  msg(8 + numVals*4,'\0');
+    uint64                  num = numVals;
+    memcpy(&msg[0],&num,8);
+    memcpy(&msg[8],vals.data(),numVals*4);
+    size_t                  peakBytes = 0;      // Peak bytes held by the handler and its stream
+    FgFnClustStream         handler = [&peakBytes](FgClustInStream & in)
+    {
+        uint64                  cnt;
+        in.read(reinterpret_cast<char*>(&cnt),8);
+        Svec<float>             buf(4096);
+        double                  total = 0.0;
+        while (cnt > 0) {
+            size_t                  sz = size_t(std::min(cnt,uint64(buf.size())));
+            in.read(reinterpret_cast<char*>(buf.data()),sz*4);
+            peakBytes = std::max(peakBytes,in.bufferedBytes() + buf.size()*4);
+            for (size_t ii=0; ii<sz; ++ii)
+                total += buf[ii];
+            cnt -= sz;
+        }
+        String                  part;
+        FGASSERT(!in.next(part));
+        return toNative(total);
+    };
+    for (bool compress : {false,true}) {
+        peakBytes = 0;
+        std::thread             worker(fgClustWorkerStream,handler,port,compress);
+        shared_ptr<FgClustQueue>    queue = fgClustQueue(svec<String>("127.0.0.1"),port,1,1,compress);
+        double                  res;
+        fromNative(queue->submit(msg).get(),res);
+        queue.reset();
+        worker.join();
+        FGASSERT(res == sum);
+        FGASSERT(peakBytes > 0);
+        FGASSERT(peakBytes < msg.size()/16);    // Only a chunk or so is held at a time
+    }
+    // Non-streaming worker receives the whole message:
+    {
+        FgFnStr2Str             tail = [](String const & m){return (m.size() < 16) ? m : m.substr(m.size()-16); };
+        std::thread             worker(fgClustWorker,tail,port,true,1);
+        shared_ptr<FgClustQueue>    queue = fgClustQueue(svec<String>("127.0.0.1"),port,1,1,true);
+        FGASSERT(queue->submit(msg).get() == msg.substr(msg.size()-16));
+        FGASSERT(queue->submit(String()).get().empty());
+        queue.reset();
+        worker.join();
+    }
 }
 
 void
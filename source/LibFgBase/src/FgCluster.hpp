@@ -6,6 +6,10 @@
 // Compute clustering for synchronous batch jobs.
 //
 // Uses boost asio but those parts are defined in platform-specific libs due to header & define requirements.
+//
+// Messages are opaque byte strings; 'toNative' / 'fromNative' (FgSerial.hpp) are recommended for
+// (de)serializing them as they are much faster than boost archives for large numeric data and
+// detect a coordinator / worker structure mismatch via the schema hash.
 
 #ifndef FGCLUSTER_HPP
 #define FGCLUSTER_HPP
@@ -14,6 +18,7 @@
 #include "FgStdString.hpp"
 #include "FgStdFunction.hpp"
 #include "FgString.hpp"
+#include <future>
 
 namespace Fg {
 
@@ -25,11 +30,53 @@ inline
 uint16
 fgClusterPortDefault() {return 59407; }
 
-// Serves a single client synchronously until client shuts connection.
+// Messages are sent in chunks of at most 1MB, each with a checksum and optionally compressed, so there
+// is no limit on message size.
+
+// Serves a single client until client shuts connection. With more than one thread, messages are
+// handled concurrently and each response is returned as soon as it's ready (tagged with the ID of
+// its request) so responses can be out of order. Each response also reports the number of threads
+// and the number of messages waiting or in progress so the client can balance its load.
+// If the handler throws, the connection is closed and the exception is rethrown:
 void
 fgClustWorker(
-    FgFnStr2Str         handler,       // Must do it's own deserialization/serialization
-    uint16              port=fgClusterPortDefault());
+    FgFnStr2Str         handler,       // Must do it's own deserialization/serialization. Must be thread-safe if numThreads != 1
+    uint16              port=fgClusterPortDefault(),
+    bool                compress=false,     // Compress responses (see 'compressFast')
+    uint                numThreads=1);      // 0 selects the number of hardware threads
+
+// A message which can be processed as its chunks arrive rather than after all have been received:
+struct  FgClustInStream
+{
+    virtual ~FgClustInStream() {}
+
+    // Returns the next part of the message, or false if the message is complete:
+    bool                next(String & part);
+    // Reads exactly 'size' bytes. Throws if the message ends first:
+    void                read(char * data,size_t size);
+    // Returns the remainder of the message:
+    String              readAll();
+    // Bytes of the message currently held by the stream:
+    size_t              bufferedBytes() const {return m_buf.capacity(); }
+
+protected:
+    virtual bool        nextChunk(String & chunk) = 0;
+
+private:
+    String              m_buf;          // Remainder of a partly read chunk
+    size_t              m_pos = 0;
+};
+
+// Handler need not read all of the message:
+typedef std::function<String(FgClustInStream &)>    FgFnClustStream;
+
+// As 'fgClustWorker' (single-threaded) but the handler can begin deserializing before the whole
+// message has arrived and without the whole message being held in memory:
+void
+fgClustWorkerStream(
+    FgFnClustStream     handler,
+    uint16              port=fgClusterPortDefault(),
+    bool                compress=false);
 
 struct  FgClustDispatcher
 {
@@ -37,18 +84,76 @@ struct  FgClustDispatcher
 
     virtual size_t numMachines() const = 0;
 
-    // Dispatches outgoing messages to all workers, receives all responses, then returns:
+    // Dispatches outgoing messages to all workers, receives all responses, then returns.
+    // Throws if sending to or receiving from any worker fails:
     virtual void batchProcess(
         Strings const &  msgsSend,   // Messages serialized to byte strings by client
-        // Worker-serialized responses, unless an error happened in which case it's the error description:
-        Strings &        msgsRecv) const = 0;
+        Strings &        msgsRecv) const = 0;   // Worker-serialized responses
 };
 
 // Must be called after 'fgClustWorker' has been called on worker machines:
 std::shared_ptr<FgClustDispatcher>
 fgClustDispatcher(
     Strings const &      hostnames,      // DNS or IP
-    uint16              port=fgClusterPortDefault());
+    uint16              port=fgClusterPortDefault(),
+    bool                compress=false);    // Compress outgoing messages
+
+struct  FgClustWorkerLoad
+{
+    String              name;
+    bool                alive;
+    uint                threads;        // As reported by the worker. Zero until its first response
+    uint                queued;         // Tasks waiting or in progress on the worker at its last response
+    size_t              inFlight;       // Tasks sent to the worker and not yet returned
+    size_t              completed;
+};
+typedef Svec<FgClustWorkerLoad>     FgClustWorkerLoads;
+
+// Asynchronous work queue over workers running 'fgClustWorker'. Any number of tasks can be submitted
+// at any time. Each worker is kept supplied with up to 'inFlight' tasks per worker thread (so it doesn't
+// wait on a network round trip between tasks) and each task goes to whichever worker has capacity
+// first, so workers stay busy with tasks of uneven duration. Results from multi-threaded workers can
+// arrive in any order. If a worker disconnects, its unfinished tasks are sent to the remaining
+// workers (so tasks must be safe to repeat).
+struct  FgClustQueue
+{
+    virtual ~FgClustQueue() {};
+
+    // Number of workers still connected:
+    virtual size_t numWorkers() const = 0;
+
+    virtual FgClustWorkerLoads workerLoads() const = 0;
+
+    // Thread-safe. 'onResult' is called with the worker's response as soon as it arrives, or 'onError'
+    // with a description if the task could not be completed. Both are called from internal threads:
+    virtual void submit(
+        String const &                          task,
+        std::function<void(String const &)>     onResult,
+        std::function<void(String const &)>     onError) = 0;
+
+    // As above but the future's 'get' throws if the task could not be completed:
+    std::future<String>
+    submit(String const & task);
+};
+
+// Destroying the queue closes the connections, which terminates the workers, so wait for all
+// results first:
+std::shared_ptr<FgClustQueue>
+fgClustQueue(
+    Strings const &     hostnames,      // DNS or IP, optionally followed by ':<port>' to override 'port'
+    uint16              port=fgClusterPortDefault(),
+    size_t              inFlight=2,     // Maximum tasks per worker thread sent but not yet returned
+    size_t              maxAttempts=3,  // Maximum number of workers a task is sent to
+    bool                compress=false);    // Compress outgoing messages
+
+// Submits all tasks and returns once all are complete, calling 'onResult' with the index of each task
+// and its result in order of completion. 'onResult' calls are serialized so need not be thread-safe.
+// Throws if any task could not be completed:
+void
+fgClustProcess(
+    FgClustQueue &                                  queue,
+    Strings const &                                 tasks,
+    std::function<void(size_t,String const &)>      onResult);
 
 typedef std::function<void(const FgClustDispatcher *)>    FgFuncCrdntor;
 
@@ -9,90 +9,336 @@
 #include "FgCluster.hpp"
 #include "FgDiagnostics.hpp"
 #include "FgOut.hpp"
+#include "FgSerial.hpp"
+#include "FgCompress.hpp"
+#include "FgParallel.hpp"
+#include "MurmurHash2.h"
 
 using namespace boost::asio;
 
 namespace Fg {
 
 // TCP provides a full duplex stream but no mechanism for discrete messages (although each direction of
-// the stream can be closed separately) so we do our own 'framing' of messsages using a size-block format
-// in the functions below:
+// the stream can be closed separately) so we do our own 'framing' of messsages. Each message is sent as
+// a sequence of chunks, so there is no limit on message size and the receiver can process a message
+// as it arrives. Each chunk is a header:
+//
+//   uint32     flags: bit 0 set on the last chunk of a message, bit 1 set if compressed with 'compressFast'
+//   uint32     stored size (number of bytes following the header)
+//   uint32     raw size
+//   uint32     message ID: chosen by the client for requests, copied from the request for responses
+//   uint64     MurmurHash64A checksum of the raw data
+//   uint32     worker threads (responses only, otherwise 0)
+//   uint32     worker load: requests waiting or in progress when the response was sent (responses only)
+//
+// followed by the stored data. Values are little-endian (as on all supported platforms).
+
+struct  ClustChunkHdr
+{
+    uint32          flags;
+    uint32          storedSize;
+    uint32          rawSize;
+    uint32          id;
+    uint64          checksum;
+    uint32          threads;
+    uint32          load;
+};
+static_assert(sizeof(ClustChunkHdr) == 32,"ClustChunkHdr must be packed");
+
+static uint32 const     clustChunkLast = 1;
+static uint32 const     clustChunkCompressed = 2;
+static size_t const     clustChunkSize = size_t(1) << 20;   // Raw bytes per chunk sent
+static size_t const     clustChunkMax = size_t(1) << 26;    // Sanity check on chunks received
+
+static
+uint64
+clustChecksum(char const * data,size_t size)
+{return MurmurHash64A(data,int(size),0x18D75B7621B4434DULL); }
 
 static
 void
-sendFrame(ip::tcp::socket & sock,String const & msg)
+sendFrame(
+    ip::tcp::socket &   sock,
+    String const &      msg,
+    bool                compress,
+    uint32              id=0,
+    uint32              threads=0,
+    uint32              load=0)
 {
-    boost::system::error_code err;
-    size_t              msgSz = msg.size();
-    write(sock,buffer(&msgSz,8),err);
-    FGASSERT(!err);
-    write(sock,buffer(msg.data(),msgSz),err);
-    FGASSERT(!err);
+    size_t              pos = 0;
+    do {
+        char const *        raw = msg.data() + pos;
+        size_t              rawSize = std::min(msg.size()-pos,clustChunkSize);
+        pos += rawSize;
+        ClustChunkHdr       hdr {(pos == msg.size()) ? clustChunkLast : 0U,
+            uint32(rawSize),uint32(rawSize),id,clustChecksum(raw,rawSize),threads,load};
+        char const *        stored = raw;
+        String              comp;
+        if (compress && (rawSize > 0)) {
+            comp = compressFast(raw,rawSize);
+            if (comp.size() < rawSize) {        // Otherwise send uncompressed
+                hdr.flags |= clustChunkCompressed;
+                hdr.storedSize = uint32(comp.size());
+                stored = comp.data();
+            }
+        }
+        std::array<const_buffer,2>  bufs {{buffer(&hdr,sizeof(hdr)),buffer(stored,hdr.storedSize)}};
+        boost::system::error_code   err;
+        write(sock,bufs,err);
+        if (err)
+            fgThrow("Cluster send failed",err.message());
+    }
+    while (pos < msg.size());
 }
 
-// Returns 'false' if connection closed by sender
+// Receives the chunks of one message:
+struct  ClustChunkReader
+{
+    ip::tcp::socket &   sock;
+    bool                started = false,
+                        finished = false;
+    ClustChunkHdr       first {};           // Header of the first chunk once started
+
+    explicit ClustChunkReader(ip::tcp::socket & s) : sock(s) {}
+
+    // Returns false at the end of the message, or if the connection was closed before the message
+    // started (in which case 'started' is false). Throws if a chunk is corrupt or the connection
+    // fails during the message:
+    bool
+    next(String & raw)
+    {
+        if (finished)
+            return false;
+        ClustChunkHdr       hdr;
+        boost::system::error_code err;
+        read(sock,buffer(&hdr,sizeof(hdr)),err);
+        if (err) {
+            finished = true;
+            if (!started && (err == error::eof))
+                return false;
+            fgThrow("Cluster receive failed",err.message());
+        }
+        if ((hdr.flags > 3) || (hdr.rawSize > clustChunkMax) || (hdr.storedSize > clustChunkMax))
+            fgThrow("Cluster receive corrupt chunk header");
+        if (!started) {
+            started = true;
+            first = hdr;
+        }
+        else if (hdr.id != first.id)
+            fgThrow("Cluster receive chunk ID mismatch");
+        String              stored(hdr.storedSize,'\0');
+        if (hdr.storedSize > 0) {
+            read(sock,buffer(&stored[0],stored.size()),err);
+            if (err)
+                fgThrow("Cluster receive failed",err.message());
+        }
+        if (hdr.flags & clustChunkCompressed)
+            raw = decompressFast(stored,hdr.rawSize);
+        else if (hdr.storedSize == hdr.rawSize)
+            raw.swap(stored);
+        else
+            fgThrow("Cluster receive corrupt chunk size");
+        if (clustChecksum(raw.data(),raw.size()) != hdr.checksum)
+            fgThrow("Cluster receive checksum mismatch");
+        if (hdr.flags & clustChunkLast)
+            finished = true;
+        return true;
+    }
+};
+
+// Returns 'false' if connection closed by sender before the message started:
 static
 bool
-recvFrame(ip::tcp::socket & sock,String & msg)
+recvFrame(ip::tcp::socket & sock,String & msg,ClustChunkHdr * hdrPtr=nullptr)
 {
-    boost::system::error_code err;
-    size_t              msgSz,
-                        szRead;
-    // 'read' makes repeated use of sock::read_some (== receive) to read the requested amount:
-    szRead = read(sock,buffer(&msgSz,8),err);
-    if (err == error::eof)
-        return false;
-    FGASSERT(!err);
-    FGASSERT(szRead == 8);
-    FGASSERT(msgSz <= 0x02000000);      // < 32MB sanity check
-    msg.resize(msgSz);
-    szRead = read(sock,buffer(&msg[0],msgSz),err);
-    if (err == error::eof)
-        return false;
-    FGASSERT(!err);
-    FGASSERT(szRead == msgSz);
-    return true;
+    ClustChunkReader    reader(sock);
+    String              chunk;
+    msg.clear();
+    while (reader.next(chunk)) {
+        if (msg.empty())
+            msg.swap(chunk);
+        else
+            msg += chunk;
+    }
+    if (hdrPtr != nullptr)
+        *hdrPtr = reader.first;
+    return reader.started;
 }
 
-// The worker can receive and send messages in the same thread as the dispatcher won't send
-// another message until it receives its response:
+struct  ClustInStreamImpl : FgClustInStream
+{
+    ClustChunkReader &  reader;
+    String              first;
+    bool                firstTaken = false;
+
+    ClustInStreamImpl(ClustChunkReader & r,String & f) : reader(r) {first.swap(f); }
+
+    virtual
+    bool
+    nextChunk(String & chunk)
+    {
+        if (firstTaken)
+            return reader.next(chunk);
+        firstTaken = true;
+        chunk.swap(first);
+        return true;
+    }
+};
+
+// Receives and sends in the same thread. A queue may have several tasks in flight to this worker;
+// those not yet being handled wait in the socket buffer and are handled one at a time in the order
+// sent. Each response carries the ID of its task, which the queue uses to match it, and responses
+// can't interleave since this thread is the only sender:
 void
-fgClustWorker(FgFnStr2Str handler,uint16 port)
+fgClustWorkerStream(FgFnClustStream handler,uint16 port,bool compress)
 {
     io_service              ios;                    // Initialize networking functionality
     ip::tcp::endpoint       ep(ip::tcp::v4(),port);
     ip::tcp::acceptor       acc(ios,ep);
     ip::tcp::socket         sock(ios);
     acc.accept(sock);
-    boost::system::error_code err;
     for (;;) {
-        String              msg;
-        if (!recvFrame(sock,msg))                   // Can block for a long time
+        ClustChunkReader    reader(sock);
+        String              first;
+        if (!reader.next(first))                    // Can block for a long time
             return;                                 // Connection closed, terminate
-        String              resp = handler(msg);    // Can take a long time before returning
-        sendFrame(sock,resp);
+        ClustInStreamImpl   stream(reader,first);
+        String              resp = handler(stream); // Can take a long time before returning
+        String              rest;
+        while (reader.next(rest))                   // Discard any part of the message not read
+            {}
+        sendFrame(sock,resp,compress,reader.first.id,1,0);
     }
 }
 
-// If an exception is thrown, store it's details in the message:
+// The calling thread receives requests while the handler threads process them and send responses:
 void
-recvFrameThread(ip::tcp::socket & sock,String & msg)
+fgClustWorker(FgFnStr2Str handler,uint16 port,bool compress,uint numThreads)
+{
+    if (numThreads == 0)
+        numThreads = cNumHardwareThreads();
+    if (numThreads == 1) {
+        fgClustWorkerStream([handler](FgClustInStream & msg){return handler(msg.readAll()); },port,compress);
+        return;
+    }
+    io_service              ios;
+    ip::tcp::endpoint       ep(ip::tcp::v4(),port);
+    ip::tcp::acceptor       acc(ios,ep);
+    ip::tcp::socket         sock(ios);
+    acc.accept(sock);
+    struct  Request
+    {
+        uint32              id;
+        String              msg;
+    };
+    std::mutex              mtx;
+    std::condition_variable cv;
+    std::deque<Request>     requests;               // Protected by 'mtx'
+    uint32                  load = 0;               // "
+    bool                    closed = false;         // "
+    std::exception_ptr      failure;                // "
+    std::mutex              sendMtx;                // Responses must not interleave
+    auto                    closeConnection = [&]()
+    {
+        closed = true;
+        requests.clear();
+        boost::system::error_code   err;
+        sock.shutdown(ip::tcp::socket::shutdown_both,err);  // Unblocks receive
+    };
+    auto                    handlerLoop = [&]()
+    {
+        for (;;) {
+            Request             req;
+            {
+                std::unique_lock<std::mutex>    lock(mtx);
+                cv.wait(lock,[&]{return (closed || !requests.empty()); });
+                if (closed)
+                    return;
+                req = std::move(requests.front());
+                requests.pop_front();
+            }
+            String              resp;
+            try {
+                resp = handler(req.msg);            // Can take a long time before returning
+            }
+            catch (...) {
+                std::lock_guard<std::mutex>     lock(mtx);
+                if (!failure)
+                    failure = std::current_exception();
+                closeConnection();
+                cv.notify_all();
+                return;
+            }
+            std::lock_guard<std::mutex>     sendLock(sendMtx);
+            uint32              currLoad;
+            {
+                std::lock_guard<std::mutex>     lock(mtx);
+                if (closed)
+                    return;
+                currLoad = --load;
+            }
+            try {
+                sendFrame(sock,resp,compress,req.id,numThreads,currLoad);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex>     lock(mtx);
+                closeConnection();
+                cv.notify_all();
+                return;
+            }
+        }
+    };
+    Svec<std::thread>       threads;
+    for (uint tt=0; tt<numThreads; ++tt)
+        threads.emplace_back(handlerLoop);
+    for (;;) {
+        Request             req;
+        ClustChunkHdr       hdr {};
+        bool                received = false;
+        try {
+            received = recvFrame(sock,req.msg,&hdr);    // Can block for a long time
+        }
+        catch (...) {
+            std::lock_guard<std::mutex>     lock(mtx);
+            if (!failure && !closed)
+                failure = std::current_exception();
+        }
+        std::lock_guard<std::mutex>     lock(mtx);
+        if (!received || closed) {
+            closeConnection();                      // Connection closed, terminate
+            break;
+        }
+        req.id = hdr.id;
+        requests.push_back(std::move(req));
+        ++load;
+        cv.notify_one();
+    }
+    cv.notify_all();
+    for (std::thread & thread : threads)
+        thread.join();
+    if (failure)
+        std::rethrow_exception(failure);
+}
+
+// Messages are opaque so any failure is returned separately in 'err', which is empty on success:
+void
+recvFrameThread(ip::tcp::socket & sock,String & msg,String & err)
 {
     bool    connectionOpen = true;
     try {
         connectionOpen = recvFrame(sock,msg);
     }
     catch(FgException const & e) {
-        msg = e.tr_message();
+        err = e.tr_message();
     }
     catch(std::exception const & e) {
-        msg = String("Standard library exception\n")+e.what();
+        err = String("Standard library exception\n")+e.what();
     }
     catch(...) {
-        msg = "Unknown exception type";
+        err = "Unknown exception type";
     }
     if (!connectionOpen)
-        msg = "Worker closed connection";
+        err = "Worker closed connection";
 }
 
 struct  FgClustDispatcherImpl : FgClustDispatcher
@@ -101,8 +347,10 @@ struct  FgClustDispatcherImpl : FgClustDispatcher
 
     io_service              ios;
     Svec<SockPtr>         sockPtrs;
+    bool                    compress;
 
-    FgClustDispatcherImpl(Strings const & hosts,String const & port)
+    FgClustDispatcherImpl(Strings const & hosts,String const & port,bool comp) :
+        compress(comp)
     {
         sockPtrs.reserve(hosts.size());
         for (size_t hh=0; hh<hosts.size(); ++hh) {
@@ -127,6 +375,7 @@ struct  FgClustDispatcherImpl : FgClustDispatcher
     {
         FGASSERT(msgsSend.size() == sockPtrs.size());
         msgsRecv.resize(msgsSend.size());
+        Strings                 errs(msgsSend.size());
         // Start the receive threads before sending in case of long send and short return times.
         // Since workers will finish in different times, we cannot receive sequentially (not just due to
         // inefficiencies but also because input buffers could overflow) so each send is a thread:
@@ -135,26 +384,293 @@ struct  FgClustDispatcherImpl : FgClustDispatcher
         for (size_t mm=0; mm<msgsSend.size(); ++mm)
             recvThreads.push_back(std::thread(recvFrameThread,
                 std::ref(*sockPtrs[mm]),
-                std::ref(msgsRecv[mm])));
+                std::ref(msgsRecv[mm]),
+                std::ref(errs[mm])));
         // Since there's only one physical ethernet cable and recipients are close by we just send each
         // message sequentially. A possible future optimization would be to make this asynchronous with some
         // number of threads (via asio):
         for (size_t mm=0; mm<msgsSend.size(); ++mm)
-            sendFrame(*sockPtrs[mm],msgsSend[mm]);
+            sendFrame(*sockPtrs[mm],msgsSend[mm],compress);
         for (size_t mm=0; mm<recvThreads.size(); ++mm)
             recvThreads[mm].join();
-        // Check for errors within the receive threads;
-        static String       hdrSer = "\26\0\\0\0\0\0\0\0serialization::archive";    // Character literals in octal
-        for (size_t mm=0; mm<msgsRecv.size(); ++mm)
-            if (!beginsWith(msgsRecv[mm],hdrSer))
-                fgThrow("Cluster worker "+toStr(mm),msgsRecv[mm]);
+        // Check for errors within the receive threads:
+        for (size_t mm=0; mm<errs.size(); ++mm)
+            if (!errs[mm].empty())
+                fgThrow("Cluster worker "+toStr(mm),errs[mm]);
     }
 };
 
 std::shared_ptr<FgClustDispatcher>
-fgClustDispatcher(Strings const & hostnames,uint16 port)
+fgClustDispatcher(Strings const & hostnames,uint16 port,bool compress)
+{
+    return std::make_shared<FgClustDispatcherImpl>(hostnames,toStr(port),compress);
+}
+
+// Workers may still be starting up so retry for a short time:
+static
+void
+connectRetry(io_service & ios,ip::tcp::socket & sock,String const & hostPort,uint16 defaultPort)
+{
+    String              host = hostPort,
+                        port = toStr(defaultPort);
+    size_t              colon = hostPort.find(':');
+    if (colon != String::npos) {
+        host = hostPort.substr(0,colon);
+        port = hostPort.substr(colon+1);
+    }
+    for (uint ii=0;; ++ii) {
+        boost::system::error_code   err;
+        ip::tcp::resolver           res(ios);
+        ip::tcp::resolver::query    query(ip::tcp::v4(),host,port);
+        ip::tcp::resolver::iterator iter = res.resolve(query,err);
+        if (!err)
+            connect(sock,iter,err);
+        if (!err)
+            return;
+        if (ii == 20)
+            fgThrow("Cluster queue connect failed",hostPort);
+        sock.close(err);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+struct  FgClustQueueImpl : FgClustQueue
+{
+    struct  Task
+    {
+        String                                  msg;
+        std::function<void(String const &)>     onResult;
+        std::function<void(String const &)>     onError;
+        size_t                                  attempts = 0;
+    };
+    typedef Sptr<Task>      TaskPtr;
+
+    // Each worker has a send and a receive thread since either can block for a long time (and if
+    // a single thread did both, large messages could deadlock with both sides' buffers full):
+    struct  Worker
+    {
+        String                  name;
+        ip::tcp::socket         sock;
+        std::map<uint32,TaskPtr> inFlight;          // By message ID (in order sent). Protected by queue mutex
+        uint32                  nextId = 0;         // "
+        bool                    alive = true;       // "
+        uint                    threads = 0,        // "
+                                queued = 0;         // "
+        size_t                  completed = 0;      // "
+        std::thread             sender,
+                                receiver;
+
+        Worker(io_service & ios,String const & n) : name(n), sock(ios) {}
+    };
+
+    io_service                  ios;
+    size_t                      maxInFlight,
+                                maxAttempts;
+    bool                        compress;
+    mutable std::mutex          mtx;
+    std::condition_variable     cv;
+    std::deque<TaskPtr>         pending;            // Protected by 'mtx'
+    bool                        closing = false;    // "
+    Svec<Sptr<Worker> >         workers;
+
+    FgClustQueueImpl(Strings const & hosts,uint16 port,size_t inFlight,size_t attempts,bool comp) :
+        maxInFlight(std::max(inFlight,size_t(1))), maxAttempts(std::max(attempts,size_t(1))), compress(comp)
+    {
+        for (String const & host : hosts) {
+            auto                worker = std::make_shared<Worker>(ios,host);
+            connectRetry(ios,worker->sock,host,port);
+            workers.push_back(worker);
+        }
+        for (Sptr<Worker> const & worker : workers) {
+            worker->sender = std::thread(&FgClustQueueImpl::sendLoop,this,std::ref(*worker));
+            worker->receiver = std::thread(&FgClustQueueImpl::recvLoop,this,std::ref(*worker));
+        }
+    }
+
+    ~FgClustQueueImpl()
+    {
+        Svec<TaskPtr>       failed;
+        {
+            std::lock_guard<std::mutex>     lock(mtx);
+            closing = true;
+            for (Sptr<Worker> const & worker : workers) {
+                boost::system::error_code   err;
+                worker->sock.shutdown(ip::tcp::socket::shutdown_both,err);
+            }
+            failed.assign(pending.begin(),pending.end());
+            pending.clear();
+        }
+        cv.notify_all();
+        for (Sptr<Worker> const & worker : workers) {
+            worker->sender.join();
+            worker->receiver.join();
+        }
+        for (TaskPtr const & task : failed)
+            task->onError("Cluster queue closed");
+    }
+
+    virtual
+    size_t
+    numWorkers() const
+    {
+        std::lock_guard<std::mutex>     lock(mtx);
+        size_t              ret = 0;
+        for (Sptr<Worker> const & worker : workers)
+            if (worker->alive)
+                ++ret;
+        return ret;
+    }
+
+    virtual
+    FgClustWorkerLoads
+    workerLoads() const
+    {
+        std::lock_guard<std::mutex>     lock(mtx);
+        FgClustWorkerLoads  ret;
+        for (Sptr<Worker> const & worker : workers)
+            ret.push_back({worker->name,worker->alive,worker->threads,worker->queued,
+                worker->inFlight.size(),worker->completed});
+        return ret;
+    }
+
+    virtual
+    void
+    submit(
+        String const &                          msg,
+        std::function<void(String const &)>     onResult,
+        std::function<void(String const &)>     onError)
+    {
+        auto                task = std::make_shared<Task>();
+        task->msg = msg;
+        task->onResult = onResult;
+        task->onError = onError;
+        {
+            std::lock_guard<std::mutex>     lock(mtx);
+            if (!closing && anyAlive()) {
+                pending.push_back(task);
+                task.reset();
+            }
+        }
+        if (task)
+            task->onError("No cluster workers available");
+        else
+            cv.notify_all();
+    }
+
+    // Must be called under the mutex. The number of threads is not known until the first response:
+    size_t
+    capacity(Worker const & worker) const
+    {
+        return maxInFlight * std::max(worker.threads,1U);
+    }
+
+    // Must be called under the mutex:
+    bool
+    anyAlive() const
+    {
+        for (Sptr<Worker> const & worker : workers)
+            if (worker->alive)
+                return true;
+        return false;
+    }
+
+    void
+    sendLoop(Worker & worker)
+    {
+        for (;;) {
+            TaskPtr             task;
+            uint32              id;
+            {
+                std::unique_lock<std::mutex>    lock(mtx);
+                cv.wait(lock,[&]{return (closing || !worker.alive ||
+                    (!pending.empty() && (worker.inFlight.size() < capacity(worker)))); });
+                if (closing || !worker.alive)
+                    return;
+                task = pending.front();
+                pending.pop_front();
+                ++task->attempts;
+                id = worker.nextId++;
+                worker.inFlight[id] = task;
+            }
+            try {
+                sendFrame(worker.sock,task->msg,compress,id);
+            }
+            catch (...) {
+                workerFailed(worker,"send failed");
+                return;
+            }
+        }
+    }
+
+    void
+    recvLoop(Worker & worker)
+    {
+        for (;;) {
+            String              msg;
+            ClustChunkHdr       hdr {};
+            bool                received = false;
+            try {
+                received = recvFrame(worker.sock,msg,&hdr);
+            }
+            catch (...) {}
+            TaskPtr             task;
+            {
+                std::lock_guard<std::mutex>     lock(mtx);
+                auto                it = worker.inFlight.find(hdr.id);
+                if (received && (it != worker.inFlight.end())) {
+                    task = it->second;
+                    worker.inFlight.erase(it);
+                    worker.threads = hdr.threads;
+                    worker.queued = hdr.load;
+                    ++worker.completed;
+                }
+            }
+            if (!task) {
+                workerFailed(worker,received ? "unexpected response" : "connection lost");
+                return;
+            }
+            cv.notify_all();
+            task->onResult(msg);
+        }
+    }
+
+    // Tasks in flight on the failed worker are re-queued (in their original order, ahead of other
+    // pending tasks) unless they've used all their attempts or there are no workers left:
+    void
+    workerFailed(Worker & worker,String const & reason)
+    {
+        Svec<TaskPtr>       failed;
+        {
+            std::lock_guard<std::mutex>     lock(mtx);
+            if (!worker.alive)
+                return;
+            worker.alive = false;
+            boost::system::error_code   err;
+            worker.sock.shutdown(ip::tcp::socket::shutdown_both,err);   // Unblocks this worker's other thread
+            bool                retry = !closing && anyAlive();
+            for (auto it=worker.inFlight.rbegin(); it!=worker.inFlight.rend(); ++it) {
+                TaskPtr             task = it->second;
+                if (retry && (task->attempts < maxAttempts))
+                    pending.push_front(task);
+                else
+                    failed.push_back(task);
+            }
+            worker.inFlight.clear();
+            if (!retry) {
+                failed.insert(failed.end(),pending.begin(),pending.end());
+                pending.clear();
+            }
+        }
+        cv.notify_all();
+        for (TaskPtr const & task : failed)
+            task->onError("Cluster worker "+worker.name+" "+reason);
+    }
+};
+
+std::shared_ptr<FgClustQueue>
+fgClustQueue(Strings const & hostnames,uint16 port,size_t inFlight,size_t maxAttempts,bool compress)
 {
-    return std::make_shared<FgClustDispatcherImpl>(hostnames,toStr(port));
+    return std::make_shared<FgClustQueueImpl>(hostnames,port,inFlight,maxAttempts,compress);
 }
 
 }
@@ -15,8 +15,11 @@ Cmd     getImgopsCmd();
 Cmd     getMeshopsCmd();
 Cmd     getMorphCmd();
 Cmd     getRenderCmd();
+Cmd     getRenderBatchCmd();
 Cmd     getTriExportCmd();
+Cmd     getBenchCmd();
 void    cmdCons(CLArgs const &);
+void    cmdBuildGraph(CLArgs const &);
 Cmds    getViewCmds();
 Cmd     getCompileShadersCmd();
 
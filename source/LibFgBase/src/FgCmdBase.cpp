@@ -22,6 +22,9 @@ namespace Fg {
 
 void test3d(CLArgs const &);
 void fgBoostSerializationTest(CLArgs const &);
+void testBench(CLArgs const &);
+void testAsyncLoad(CLArgs const &);
+void testBuildGraph(CLArgs const &);
 void fgCmdTestDfg(CLArgs const &);
 void fgExceptionTest(CLArgs const &);
 void fgFileSystemTest(CLArgs const &);
@@ -38,12 +41,26 @@ void fgMetaFormatTest(CLArgs const &);
 void fgMorphTest(CLArgs const &);
 void fgPathTest(CLArgs const &);
 void fgQuaternionTest(CLArgs const &);
+void testRandStream(CLArgs const &);
 void fgCmdRenderTest(CLArgs const &);
 void fgSerializeTest(CLArgs const &);
+void testSerial(CLArgs const &);
+void testNativeArchive(CLArgs const &);
+#ifdef __linux__
+void testTcpServer(CLArgs const &);
+#endif
+void testClustQueue(CLArgs const &);
+void testClustConcurrent(CLArgs const &);
+void testClustStream(CLArgs const &);
+void testCompressFast(CLArgs const &);
 void fgSimilarityTest(CLArgs const &);
 void fgSimilarityApproxTest(CLArgs const &);
+void testSimilarityRobust(CLArgs const &);
 void fgStdVectorTest(CLArgs const &);
 void fgStringTest(CLArgs const &);
+void testOutBuffer(CLArgs const &);
+void testProfile(CLArgs const &);
+void testMemory(CLArgs const &);
 
 Cmd testSoftRenderInfo();   // Don't put these in a macro as it generates a clang warning about vexing parse.
 
@@ -52,11 +69,19 @@ fgCmdBaseTests()
 {
     Cmds      cmds {
         {test3d,"3d"},
+        {testAsyncLoad,"asyncLoad"},
+        {testBench,"bench","Benchmark harness statistics, output and comparison"},
         {fgBoostSerializationTest,"boostSerialization"},
+        {testBuildGraph,"buildGraph","Concurrent build graph with content-hash up-to-date checks"},
+        {testClustQueue,"clustQueue","Cluster work queue with uneven and failing loopback workers"},
+        {testClustStream,"clustStream","Cluster messages larger than 32MB, compressed and streamed"},
+        {testClustConcurrent,"clustThreads","Cluster worker with concurrent threads returning results out of order"},
+        {testCompressFast,"compress","Fast LZ compression"},
         {fgCmdTestDfg,"dataflow"},
         {fgExceptionTest,"exception"},
         {fgFileSystemTest,"filesystem"},
         {fgOpenTest,"open"},
+        {testOutBuffer,"outBuffer"},
         {testGeometry,"geometry"},
         {fgGridTrianglesTest,"gridTriangles"},
         {fgImageTest,"image"},
@@ -66,15 +91,24 @@ fgCmdBaseTests()
         {testMatrixC,"matC","MatrixC"},
         {fgMatrixVTest,"matV","MatrixV"},
         {fgMetaFormatTest,"metaFormat"},
+        {testNativeArchive,"nativeArchive","Native binary archive"},
         {fgMorphTest,"morph"},
         {fgPathTest,"path"},
+        {testMemory,"memory","Allocation tracking by subsystem and memory footprints"},
+        {testProfile,"profile","Hierarchical profiler zones, counters and reports"},
         {fgQuaternionTest,"quaternion"},
+        {testRandStream,"randStream","Counter-based random streams"},
         {fgCmdRenderTest,"rendc","render command"},
+        {testSimilarityRobust,"robustAlign","Weighted, robust and batched alignment with outliers"},
+        {testSerial,"serial","Buffered binary serialization"},
         {fgSerializeTest,"serialize"},
         {fgSimilarityTest,"similarity"},
         {fgSimilarityApproxTest,"similarityApprox"},
         {fgStdVectorTest,"vector"},
         {fgStringTest,"string"},
+#ifdef __linux__
+        {testTcpServer,"tcpServer","Concurrent TCP server with many loopback clients"},
+#endif
     };
     cmds.push_back(testSoftRenderInfo());
     return cmds;
@@ -126,6 +160,7 @@ void fgRandomTest(CLArgs const &);
 void testmGeometry(CLArgs const &);
 void fgTextureImageMappingRenderTest(CLArgs const &);
 void fgImageTestm(CLArgs const &);
+void testmSoftRender(CLArgs const &);
 
 Cmds
 fgCmdBaseTestms()
@@ -141,7 +176,8 @@ fgCmdBaseTestms()
         {fgRandomTest,"random"},
         {testmGeometry,"geometry"},
         {fgTextureImageMappingRenderTest,"texturemap"},
-        {fgImageTestm,"image"}
+        {fgImageTestm,"image"},
+        {testmSoftRender,"rend","renderSoft close-up crop benchmark"}
     };
     return cmds;
 }
@@ -173,8 +209,11 @@ fgCmdFgbl(CLArgs const & args)
         {getMeshopsCmd()},
         {getMorphCmd()},
         {getRenderCmd()},
+        {getRenderBatchCmd()},
         {getTriExportCmd()},
+        {getBenchCmd()},
         {cmdCons,"cons","Construct makefiles / solution file / project files"},
+        {cmdBuildGraph,"graph","Run a build graph file concurrently with content-hash up-to-date checks"},
         {sysinfo,"sys","Show system info"},
         {fgCmdBaseTest,"test","Automated tests"},
         {testm,"testm","Manual tests"},
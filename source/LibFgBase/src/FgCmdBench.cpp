@@ -0,0 +1,569 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Benchmarks of library hot paths. The setup of each benchmark (loading data etc.) is not timed.
+// The benchmark body is run a number of times untimed to warm up caches and lazy initialization,
+// then repeatedly timed. The median is used for comparisons since it is robust to interruptions.
+//
+
+#include "stdafx.h"
+
+#include "FgCmd.hpp"
+#include "FgSyntax.hpp"
+#include "FgTime.hpp"
+#include "FgRandom.hpp"
+#include "FgMatrixV.hpp"
+#include "FgMatrixSolver.hpp"
+#include "FgKdTree.hpp"
+#include "FgSoftRender.hpp"
+#include "Fg3dMeshIo.hpp"
+#include "Fg3dNormals.hpp"
+#include "Fg3dPose.hpp"
+#include "Fg3dPick.hpp"
+#include "Fg3dMeshMapped.hpp"
+#include "FgProfile.hpp"
+#include "FgImage.hpp"
+#include "FgImageIo.hpp"
+#include "FgFileSystem.hpp"
+#include "FgStdStream.hpp"
+#include "FgSerial.hpp"
+#include "FgParse.hpp"
+#include "FgTestUtils.hpp"
+
+#ifdef _MSC_VER
+    #pragma warning(push,0)     // Eigen triggers lots of warnings
+#endif
+
+#include "Eigen/Dense"
+
+#ifdef _MSC_VER
+    #pragma warning(pop)
+#endif
+
+using namespace std;
+
+namespace Fg {
+
+namespace {
+
+struct  Bench
+{
+    String                              name;
+    String                              desc;
+    // Does the untimed setup and returns the function to be timed:
+    function<function<void()>()>        setup;
+};
+
+struct  BenchStats
+{
+    String              name;
+    size_t              reps;
+    double              medianMs,
+                        p10Ms,
+                        p90Ms,
+                        minMs,
+                        maxMs,
+                        meanMs;
+};
+
+// Linear interpolation between order statistics. 'sorted' must be non-empty:
+double
+percentile(Doubles const & sorted,double pct)
+{
+    double              pos = pct / 100.0 * double(sorted.size()-1);
+    size_t              lo = size_t(pos);
+    if (lo+1 >= sorted.size())
+        return sorted.back();
+    double              frac = pos - double(lo);
+    return sorted[lo] * (1.0-frac) + sorted[lo+1] * frac;
+}
+
+BenchStats
+runBench(Bench const & bench,size_t warmups,size_t reps)
+{
+    FGASSERT(reps > 0);
+    randSeedRepeatable();
+    function<void()>    fn = bench.setup();
+    for (size_t ii=0; ii<warmups; ++ii)
+        fn();
+    Doubles             times;
+    for (size_t ii=0; ii<reps; ++ii) {
+        uint64              start = getTimeNs();
+        fn();
+        times.push_back(double(getTimeNs()-start) / 1.0e6);
+    }
+    sort(times.begin(),times.end());
+    double              sum = 0.0;
+    for (double t : times)
+        sum += t;
+    return BenchStats {bench.name,reps,percentile(times,50),percentile(times,10),percentile(times,90),
+        times.front(),times.back(),sum/double(reps)};
+}
+
+String const        csvHeader = "name,reps,median_ms,p10_ms,p90_ms,min_ms,max_ms,mean_ms";
+
+String
+toCsv(BenchStats const & s)
+{
+    ostringstream       oss;
+    oss << setprecision(6) << s.name << "," << s.reps << "," << s.medianMs << "," << s.p10Ms << ","
+        << s.p90Ms << "," << s.minMs << "," << s.maxMs << "," << s.meanMs;
+    return oss.str();
+}
+
+// Returns median time by benchmark name:
+map<String,double>
+loadBenchMedians(Ustring const & fname)
+{
+    map<String,double>  ret;
+    Strings             lines = splitLines(loadRawString(fname));
+    if (lines.empty() || (lines[0] != csvHeader))
+        fgThrow("Not a benchmark results file",fname);
+    for (size_t ll=1; ll<lines.size(); ++ll) {
+        Strings             fields = splitChar(lines[ll],',');
+        Opt<double>         median;
+        if (fields.size() == 8)
+            median = fromStr<double>(fields[2]);
+        if (!median.valid())
+            fgThrow("Invalid benchmark results line",fname+":"+toStr(ll+1));
+        ret[fields[0]] = median.val();
+    }
+    return ret;
+}
+
+MatD
+randMat(size_t sz)
+{
+    MatD                ret(sz,sz);
+    for (double & v : ret.m_data)
+        v = randNormal();
+    return ret;
+}
+
+Mesh
+loadJaneTris()
+{
+    Mesh                mesh = loadMeshMaps(dataDir()+"base/Jane");
+    for (Surf & surf : mesh.surfaces)
+        surf = surf.convertToTris();
+    return mesh;
+}
+
+Svec<Bench>
+getBenches()
+{
+    return {
+        {"randNormals","RandStream 4M normals",[]()
+        {
+            auto                buf = make_shared<Doubles>(size_t(1) << 22);
+            return [=]() {RandStream(42).normals(0,buf->size(),buf->data()); };
+        }},
+        {"randUniforms","RandStream 4M uniforms",[]()
+        {
+            auto                buf = make_shared<Doubles>(size_t(1) << 22);
+            return [=]() {RandStream(42).uniforms(0,buf->size(),buf->data()); };
+        }},
+        {"matMul","MatD 256x256 multiply",[]()
+        {
+            MatD                lhs = randMat(256),
+                                rhs = randMat(256);
+            return [=]() {MatD prod = lhs * rhs; FGASSERT(prod.numRows() == 256); };
+        }},
+        {"eigenSym","Symmetric eigensolver 128x128",[]()
+        {
+            MatD                m = randMat(128);
+            MatD                rsm = m * m.transpose();
+            return [=]() {EigsRsm eigs = cEigsRsm(rsm); FGASSERT(eigs.vals.size() == 128); };
+        }},
+        {"eigenLdlt","Eigen LDLT solve 512x512 SPD",[]()
+        {
+            Eigen::MatrixXd     m = Eigen::MatrixXd::Random(512,512);
+            Eigen::MatrixXd     spd = m * m.transpose() + Eigen::MatrixXd::Identity(512,512);
+            Eigen::VectorXd     b = Eigen::VectorXd::Random(512);
+            return [=]() {Eigen::VectorXd x = spd.ldlt().solve(b); FGASSERT(x.size() == 512); };
+        }},
+        {"kdBuild","KdTree construction 100K points",[]()
+        {
+            Vec3Fs              pnts = randVecNormals<float,3>(100000,1.0);
+            return [=]() {KdTree kd(pnts); };
+        }},
+        {"kdQuery","KdTree 100K closest point queries on 100K points",[]()
+        {
+            auto                kd = make_shared<KdTree>(randVecNormals<float,3>(100000,1.0));
+            Vec3Fs              queries = randVecNormals<float,3>(100000,1.0);
+            return [=]()
+            {
+                double              sum = 0.0;
+                for (Vec3F const & q : queries)
+                    sum += kd->findClosest(q).distMag;
+                FGASSERT(sum > 0.0);
+            };
+        }},
+        {"renderSoft","Software render of textured Jane 512x512",[]()
+        {
+            Meshes              meshes {loadJaneTris()};
+            return [=]() {ImgC4UC img = renderSoft(Vec2UI(512),meshes,RgbaF(0)); };
+        }},
+        {"morph","Accumulate 50 delta morphs over 100K verts",[]()
+        {
+            Morphs              morphs;
+            for (size_t ii=0; ii<50; ++ii)
+                morphs.push_back(Morph("m"+toStr(ii),randVecNormals<float,3>(100000,1.0)));
+            Floats              coord = randNormalFs(50);
+            return [=]()
+            {
+                Vec3Fs              acc(100000,Vec3F(0));
+                accDeltaMorphs(morphs,coord,acc);
+            };
+        }},
+        {"cNormals","Vertex and facet normals of subdivided Jane",[]()
+        {
+            Mesh                mesh = subdivide(loadJaneTris(),false);
+            return [=]() {MeshNormals norms = cNormals(mesh.surfaces,mesh.verts); };
+        }},
+        {"loadTri","Load Jane.tri",[]()
+        {
+            Ustring             fname = dataDir()+"base/Jane.tri";
+            return [=]() {Mesh mesh = loadTri(fname); };
+        }},
+        {"loadObj","Load Jane as OBJ",[]()
+        {
+            // The test directory remains current for the life of the returned function:
+            auto                td = make_shared<TestDir>("benchObj");
+            Mesh                mesh = loadTri(dataDir()+"base/Jane.tri");
+            mesh.deltaMorphs.clear();       // Not supported by OBJ
+            mesh.targetMorphs.clear();
+            saveWObj("Jane.obj",{mesh});
+            return [=]() {Mesh mesh = loadWObj("Jane.obj"); FGASSERT(td); };
+        }},
+        {"savePly","Save Jane as binary PLY",[]()
+        {
+            auto                td = make_shared<TestDir>("benchPlySave");
+            Meshes              meshes {loadTri(dataDir()+"base/Jane.tri")};
+            return [=]() {savePly("Jane",meshes,"png",true); FGASSERT(td); };
+        }},
+        {"loadPly","Load Jane as binary PLY",[]()
+        {
+            auto                td = make_shared<TestDir>("benchPlyLoad");
+            savePly("Jane",{loadTri(dataDir()+"base/Jane.tri")},"png",true);
+            return [=]() {Mesh mesh = loadPly("Jane.ply"); FGASSERT(td); };
+        }},
+        {"saveStl","Save Jane as binary STL",[]()
+        {
+            auto                td = make_shared<TestDir>("benchStlSave");
+            Meshes              meshes {loadTri(dataDir()+"base/Jane.tri")};
+            return [=]() {saveStl("Jane.stl",meshes); FGASSERT(td); };
+        }},
+        {"loadStl","Load and weld Jane as binary STL",[]()
+        {
+            auto                td = make_shared<TestDir>("benchStlLoad");
+            saveStl("Jane.stl",{loadTri(dataDir()+"base/Jane.tri")});
+            return [=]() {Mesh mesh = loadStl("Jane.stl"); FGASSERT(td); };
+        }},
+        {"openMeshMapped","Open Jane as a sparse FGMM with checksums and decode all delta morphs",[]()
+        {
+            auto                td = make_shared<TestDir>("benchMapped");
+            saveMeshMapped("Jane.fgmm",loadTri(dataDir()+"base/Jane.tri"));
+            return [=]()
+            {
+                MeshMapped          mm {"Jane.fgmm"};
+                for (size_t ii=0; ii<mm.deltaMorphNames().size(); ++ii)
+                    FGASSERT(!mm.deltaMorph(ii).empty());
+                FGASSERT(td);
+            };
+        }},
+        {"meshPick","MeshPicker 1000 view-axis picks on Jane",[]()
+        {
+            Mesh                mesh = loadJaneTris();
+            auto                picker = make_shared<MeshPicker>(mesh,mesh.verts);
+            Mat32F              bounds = cBounds(mesh.verts);
+            Svec<PickRay>       rays;
+            for (size_t ii=0; ii<1000; ++ii) {
+                Vec3D               origin {
+                    randUniform(bounds.rc(0,0),bounds.rc(0,1)),
+                    randUniform(bounds.rc(1,0),bounds.rc(1,1)),
+                    bounds.rc(2,1) + 1.0};
+                rays.push_back({origin,Vec3D{0,0,-1}});
+            }
+            return [=]()
+            {
+                size_t              hits = 0;
+                for (PickRay const & ray : rays)
+                    if (picker->pick(ray).valid())
+                        ++hits;
+                FGASSERT(hits > 0);
+            };
+        }},
+        {"profileZoneOff","1M disabled profile zones and counters",[]()
+        {
+            return []()
+            {
+                profileEnable(false);
+                for (size_t ii=0; ii<1000000; ++ii) {
+                    FG_PROFILE("benchZone");
+                    profileCount("benchCount");
+                }
+            };
+        }},
+        {"profileZoneOn","100K enabled profile zones",[]()
+        {
+            return []()
+            {
+                profileEnable(true);
+                for (size_t ii=0; ii<100000; ++ii)
+                    FG_PROFILE("benchZone");
+                profileEnable(false);
+                profileReset();
+            };
+        }},
+        {"imgResize","Resize 2048^2 to 1000^2 RGBA",[]()
+        {
+            ImgC4UC             src(2048,2048);
+            for (RgbaUC & p : src.m_data)
+                p = RgbaUC(uchar(randUint(256)),uchar(randUint(256)),uchar(randUint(256)),255);
+            return [=]()
+            {
+                ImgC4UC             dst(1000,1000);
+                imgResize(src,dst);
+            };
+        }},
+        {"loadTga","Load 2048^2 TGA to RGBA and to grey",[]()
+        {
+            // The test directory remains current for the life of the returned function:
+            auto                td = make_shared<TestDir>("benchTga");
+            ImgC4UC             img(2048,2048);
+            for (RgbaUC & p : img.m_data)
+                p = RgbaUC(uchar(randUint(256)),uchar(randUint(256)),uchar(randUint(256)),255);
+            saveImage("big.tga",img);
+            return [=]()
+            {
+                ImgC4UC             imgC;
+                ImgUC               imgUC;
+                loadImage_("big.tga",imgC);
+                loadImage_("big.tga",imgUC);
+                FGASSERT(td && (imgUC.dims() == imgC.dims()));
+            };
+        }},
+        {"jpegEncode","JPEG encode 1024^2 at quality 90",[]()
+        {
+            ImgC4UC             img(1024,1024);
+            imgResize(loadImage(dataDir()+"base/trees.jpg"),img);
+            return [=]() {Uchars blob = imgEncodeJpeg(img,90); };
+        }},
+        {"jpegDecode","JPEG decode 1024^2",[]()
+        {
+            ImgC4UC             img(1024,1024);
+            imgResize(loadImage(dataDir()+"base/trees.jpg"),img);
+            Uchars              blob = imgEncodeJpeg(img,90);
+            return [=]() {ImgC4UC dec = imgDecodeJpeg(blob); };
+        }},
+        {"jpegDecodeEighth","JPEG decode 1024^2 at 1/8 scale",[]()
+        {
+            ImgC4UC             img(1024,1024);
+            imgResize(loadImage(dataDir()+"base/trees.jpg"),img);
+            Uchars              blob = imgEncodeJpeg(img,90);
+            return [=]() {ImgC4UC dec = imgDecodeJpeg(blob,Vec2UI(128)); FGASSERT(dec.width() == 128); };
+        }},
+        {"toSerUints","Serialize 4M uints",[]()
+        {
+            Uints               vals(size_t(1) << 22);
+            for (uint & v : vals)
+                v = randUint();
+            return [=]() {String blob = toSer(vals); FGASSERT(blob.size() > vals.size()*4); };
+        }},
+        {"fromSerUints","Deserialize 4M uints",[]()
+        {
+            Uints               vals(size_t(1) << 22);
+            for (uint & v : vals)
+                v = randUint();
+            String              blob = toSer(vals);
+            return [=]() {Uints ret; fromSer(blob,ret); FGASSERT(ret.size() == vals.size()); };
+        }},
+        {"toSerStrings","Serialize 256K short strings",[]()
+        {
+            Strings             strs(size_t(1) << 18);
+            for (String & str : strs)
+                str = toStr(randUint());
+            return [=]() {String blob = toSer(strs); FGASSERT(!blob.empty()); };
+        }},
+        {"toNative","Native archive of 1M Vec3F",[]()
+        {
+            Vec3Fs              verts = randVecNormals<float,3>(size_t(1) << 20,1.0);
+            return [=]() {String blob = toNative(verts); FGASSERT(isNative(blob)); };
+        }},
+        {"fromNative","Load native archive of 1M Vec3F",[]()
+        {
+            Vec3Fs              verts = randVecNormals<float,3>(size_t(1) << 20,1.0);
+            String              blob = toNative(verts);
+            return [=]() {Vec3Fs ret; fromNative(blob,ret); FGASSERT(ret.size() == verts.size()); };
+        }},
+        {"writeBlocks","Format 200 blocks of 1000 doubles as text concurrently",[]()
+        {
+            Doubles             vals = randNormals(200000,0.0,1.0);
+            return [=]()
+            {
+                OutBuffer           out;
+                writeBlocks(out,200,[&](size_t ii,OutBuffer & buf)
+                {
+                    for (size_t jj=0; jj<1000; ++jj)
+                        buf << vals[ii*1000+jj] << ' ';
+                    buf << '\n';
+                });
+                FGASSERT(!out.str().empty());
+            };
+        }},
+    };
+}
+
+void
+benchRun(CLArgs const & args)
+{
+    Svec<Bench>         benches = getBenches();
+    String              names;
+    for (Bench const & b : benches)
+        names += "\n        " + b.name + " - " + b.desc;
+    Syntax              syn(args,
+        "[-w <warmups>] [-r <reps>] [-o <results>.csv] (all | <name>+)\n"
+        "    <warmups>  - Untimed runs before timing (default 2)\n"
+        "    <reps>     - Timed runs (default 11)\n"
+        "    <results>  - Save results in CSV format for 'bench compare'\n"
+        "    <name>     - One of:" + names
+    );
+    size_t              warmups = 2,
+                        reps = 11;
+    String              outFile;
+    while (syn.peekNext()[0] == '-') {
+        String              opt = syn.next();
+        if (opt == "-w")
+            warmups = syn.nextAs<size_t>();
+        else if (opt == "-r")
+            reps = syn.nextAs<size_t>();
+        else if (opt == "-o")
+            outFile = syn.next();
+        else
+            syn.error("Unrecognized option",opt);
+    }
+    if (reps == 0)
+        syn.error("<reps> must be at least 1");
+    Svec<Bench>         selected;
+    while (syn.more()) {
+        String              name = syn.next();
+        if (name == "all")
+            selected.insert(selected.end(),benches.begin(),benches.end());
+        else {
+            auto                it = find_if(benches.begin(),benches.end(),[&](Bench const & b){return b.name == name; });
+            if (it == benches.end())
+                syn.error("Unknown benchmark",name);
+            selected.push_back(*it);
+        }
+    }
+    if (selected.empty())
+        syn.error("No benchmarks specified");
+    fgout << fgnl << left << setw(14) << "name" << right << setw(12) << "median ms"
+        << setw(12) << "p10 ms" << setw(12) << "p90 ms" << setw(12) << "min ms";
+    String              csv = csvHeader + "\n";
+    for (Bench const & bench : selected) {
+        BenchStats          s = runBench(bench,warmups,reps);
+        fgout << fgnl << left << setw(14) << s.name << right << setw(12) << toStrFixed(s.medianMs,3)
+            << setw(12) << toStrFixed(s.p10Ms,3) << setw(12) << toStrFixed(s.p90Ms,3) << setw(12) << toStrFixed(s.minMs,3);
+        csv += toCsv(s) + "\n";
+    }
+    if (!outFile.empty())
+        saveRaw(csv,outFile,false);
+}
+
+// Returns the names of benchmarks whose median time regressed by more than 'thresholdPct':
+Strings
+compareBench(map<String,double> const & baseline,map<String,double> const & results,double thresholdPct)
+{
+    Strings             ret;
+    fgout << fgnl << left << setw(14) << "name" << right << setw(12) << "base ms" << setw(12) << "new ms"
+        << setw(10) << "change";
+    for (auto const & res : results) {
+        fgout << fgnl << left << setw(14) << res.first << right;
+        auto                it = baseline.find(res.first);
+        if (it == baseline.end()) {
+            fgout << setw(12) << "-" << setw(12) << toStrFixed(res.second,3) << "  (no baseline)";
+            continue;
+        }
+        double              pct = (res.second / it->second - 1.0) * 100.0;
+        fgout << setw(12) << toStrFixed(it->second,3) << setw(12) << toStrFixed(res.second,3)
+            << setw(9) << toStrFixed(pct,1) << "%";
+        if (pct > thresholdPct) {
+            fgout << "  REGRESSION";
+            ret.push_back(res.first);
+        }
+    }
+    return ret;
+}
+
+void
+benchCompare(CLArgs const & args)
+{
+    Syntax              syn(args,
+        "[-t <percent>] <baseline>.csv <results>.csv\n"
+        "    <percent>  - Median time increase above which a benchmark is considered a regression (default 10)\n"
+        "    Returns an error if any benchmark in both files has regressed."
+    );
+    double              threshold = 10.0;
+    if (syn.peekNext() == "-t") {
+        syn.next();
+        threshold = syn.nextAs<double>();
+    }
+    String              baseFile = syn.next(),
+                        resFile = syn.next();
+    syn.noMoreArgsExpected();
+    Strings             regressed = compareBench(loadBenchMedians(baseFile),loadBenchMedians(resFile),threshold);
+    if (!regressed.empty())
+        fgThrow("Benchmark regression",cat(regressed,","));
+}
+
+void
+benchList(CLArgs const &)
+{
+    for (Bench const & b : getBenches())
+        fgout << fgnl << left << setw(14) << b.name << b.desc;
+}
+
+void
+bench(CLArgs const & args)
+{
+    Cmds            cmds {
+        {benchRun,"run","Run benchmarks"},
+        {benchCompare,"compare","Compare results against a baseline"},
+        {benchList,"list","List benchmarks"},
+    };
+    doMenu(args,cmds);
+}
+
+}
+
+Cmd
+getBenchCmd()
+{return Cmd(bench,"bench","Benchmarks of library hot paths"); }
+
+void
+testBench(CLArgs const & args)
+{
+    FGTESTDIR
+    Doubles             vals {4,1,3,2,5};
+    sort(vals.begin(),vals.end());
+    FGASSERT(percentile(vals,50) == 3.0);
+    FGASSERT(percentile(vals,0) == 1.0);
+    FGASSERT(percentile(vals,100) == 5.0);
+    FGASSERT(percentile(vals,10) == 1.4);
+    runCmd(bench,"bench run -w 1 -r 3 -o res.csv matMul kdQuery");
+    map<String,double>  res = loadBenchMedians("res.csv");
+    FGASSERT((res.size() == 2) && (res["matMul"] > 0.0));
+    runCmd(bench,"bench compare res.csv res.csv");
+    map<String,double>  base = res;
+    base["matMul"] /= 2.0;
+    FGASSERT(compareBench(base,res,10.0) == svec<String>("matMul"));
+    FGASSERT(compareBench(base,res,150.0).empty());
+}
+
+}
+
+// */
@@ -17,6 +17,8 @@
 #include "Fg3dTopology.hpp"
 #include "Fg3dDisplay.hpp"
 #include "FgBestN.hpp"
+#include "Fg3dDecimate.hpp"
+#include "FgTime.hpp"
 
 using namespace std;
 
@@ -33,15 +35,19 @@ combinesurfs(CLArgs const & args)
         "    <extOut> = " + meshSaveFormatsCLDescription() + "\n"
         "    All input meshes must have identical vertex lists.\n"
         );
-    Mesh    mesh = loadMesh(syn.next());
+    Svec<AsyncResult<Mesh> > loads;
     while (syn.more()) {
         string  name = syn.next();
-        if (syn.more()) {
-            Mesh    next = loadMesh(name);
-            cat_(mesh.surfaces,next.surfaces);
-        }
-        else
+        if (syn.more())
+            loads.push_back(loadMeshAsync(asyncLoaderDefault(),name));
+        else {
+            if (loads.empty())
+                syn.error("No input meshes specified");
+            Mesh    mesh = loads[0].get();
+            for (size_t ii=1; ii<loads.size(); ++ii)
+                cat_(mesh.surfaces,loads[ii].get().surfaces);
             saveMesh(mesh,name);
+        }
     }
 }
 
@@ -118,6 +124,38 @@ copyverts(CLArgs const & args)
     return;
 }
 
+void
+decimateCmd(CLArgs const & args)
+{
+    Syntax    syn(args,
+        "[-m <morphWeight>] <in>.<extIn> <out>.<extOut> <numTris>\n"
+        "    <morphWeight> - Weight of the morph shape error relative to the base shape error (default 1).\n"
+        "        Use 0 to ignore morphs when choosing collapses (they are still interpolated).\n"
+        "    <extIn>   - " + meshLoadFormatsCLDescription() + "\n"
+        "    <extOut>  - " + meshSaveFormatsCLDescription() + "\n"
+        "    <numTris> - Target number of tris over all surfaces\n"
+        "NOTES:\n"
+        "    Quads are converted to tris. Boundaries, UV seams, marked verts and surface points are\n"
+        "    preserved and all morphs are carried through."
+        );
+    DecimateOptions     opts;
+    while (syn.peekNext()[0] == '-') {
+        String              opt = syn.next();
+        if (opt == "-m")
+            opts.morphWeight = syn.nextAs<float>();
+        else
+            syn.error("Unrecognized option",opt);
+    }
+    Mesh                mesh = loadMesh(syn.next());
+    Ustring             outName = syn.next();
+    size_t              numTris = syn.nextAs<size_t>();
+    Timer               timer;
+    Mesh                out = decimate(mesh,numTris,opts);
+    fgout << fgnl << "Decimated from " << mesh.numTriEquivs() << " to " << out.numTris() << " tris in "
+        << timer.read() << "s";
+    saveMesh(out,outName);
+}
+
 void
 emboss(CLArgs const & args)
 {
@@ -214,13 +252,19 @@ mmerge(CLArgs const & args)
         "    <extIn> = " + meshLoadFormatsCLDescription() + "\n"
         "    <extOut> = " + meshSaveFormatsCLDescription()
         );
-    Mesh    mesh = loadMesh(syn.next());
+    Svec<AsyncResult<Mesh> > loads;
     while (syn.more()) {
         string  name = syn.next();
         if (syn.more())
-            mesh = mergeMeshes(mesh,loadMesh(name));
-        else
+            loads.push_back(loadMeshAsync(asyncLoaderDefault(),name));
+        else {
+            if (loads.empty())
+                syn.error("No input meshes specified");
+            Mesh    mesh = loads[0].get();
+            for (size_t ii=1; ii<loads.size(); ++ii)
+                mesh = mergeMeshes(mesh,loads[ii].get());
             saveMesh(mesh,name);
+        }
     }
 }
 
@@ -327,12 +371,18 @@ sortFacets(CLArgs const & args)
         "Will find the best compromise sorted rendering order for front/back (+/-Z), side (+/-X)\n"
         "and top (Y) views, on a per-surface basis, and save the sorted result. All quads are\n"
         "converted to tris and all surfaces are merged into one.");
-    Mesh        mesh = loadMesh(syn.next());
-    ImgC4UC     albedo = loadImage(syn.next());
+    AsyncLoader &       loader = asyncLoaderDefault();
+    AsyncResult<Mesh>   meshLoad = loadMeshAsync(loader,syn.next());
+    AsyncResult<ImgC4UC> albedoLoad = loadImageAsync(loader,syn.next());
     Ustring        outName = syn.next();
-    Mesh        opaque;
+    Svec<AsyncResult<Mesh> > opaqueLoads;
     while (syn.more())
-        opaque = mergeMeshes(opaque,loadMesh(syn.next()));
+        opaqueLoads.push_back(loadMeshAsync(loader,syn.next()));
+    Mesh        mesh = meshLoad.get();
+    ImgC4UC     albedo = albedoLoad.get();
+    Mesh        opaque;
+    for (AsyncResult<Mesh> & load : opaqueLoads)
+        opaque = mergeMeshes(opaque,load.get());
     mesh = sortTransparentFaces(mesh,albedo,opaque);
     saveMesh(mesh,outName);
 }
@@ -977,6 +1027,7 @@ meshops(CLArgs const & args)
         {copyUvList,"copyUvList","Copy UV list from one mesh to another with same UV count"},
         {copyUvs,"copyUvs","Copy UVs from one mesh to another with identical facet structure"},
         {copyverts,"copyverts","Copy verts from one mesh to another with same vertex count"},
+        {decimateCmd,"decimate","Reduce the number of tris by quadric error edge collapse"},
         {emboss,"emboss","Emboss a mesh based on greyscale values of a UV image"},
         {invWind,"invWind","Invert facet winding of a mesh"},
         {markVerts,"markVerts","Mark vertices in a .TRI file from a given list"},
@@ -16,6 +16,7 @@
 #include "FgTime.hpp"
 #include "FgSyntax.hpp"
 #include "FgMetaFormat.hpp"
+#include "FgSerial.hpp"
 #include "FgImgDisplay.hpp"
 #include "FgParse.hpp"
 #include "FgTestUtils.hpp"
@@ -76,10 +77,58 @@ struct  Options
     FG_SERIALIZE3(rend,saveSurfPointFile,outputFile);
 };
 
+struct  BatchArgs
+{
+    vector<ModelFiles>      models;
+    // Each combination of morph pose, camera pose and lighting is rendered:
+    vector<MorphVals>       poses;          // If empty, the base shape is rendered
+    vector<Pose>            cameras;        // Must not be empty
+    vector<Lighting>        lightings;      // If empty, 'options.lighting' is used
+    Vec2UI                  imagePixelSize = Vec2UI(512,512);
+    RenderOptions           options;
+    // Images are saved as <outputPrefix>_p<pose>_c<camera>_l<lighting>.png (zero-based indices):
+    string                  outputPrefix;
+
+    FG_SERIALIZE7(models,poses,cameras,lightings,imagePixelSize,options,outputPrefix);
+};
+
 }   // namespace FgCmdRender
 
 using namespace FgCmdRender;
 
+static
+CameraParams
+toCameraParams(Pose const & pose,Mat32F bounds)
+{
+    CameraParams        cps(fgF2D(bounds));
+    cps.pose =
+        cRotateY(pose.panRadians) *
+        cRotateX(pose.tiltRadians) *
+        cRotateZ(pose.rollRadians);
+    cps.relTrans = pose.relTrans;
+    cps.logRelScale = std::log(pose.relScale);
+    cps.fovMaxDeg = pose.fovMaxDeg;
+    return cps;
+}
+
+static
+Meshes
+loadModels(vector<ModelFiles> const & models,QuaternionD rotateToHcs)
+{
+    Meshes              meshes(models.size());
+    Mat33F              rotMatrix = Mat33F(rotateToHcs.asMatrix());
+    for (size_t ii=0; ii<meshes.size(); ++ii) {
+        const ModelFiles &  mf = models[ii];
+        Mesh &              mesh = meshes[ii];
+        mesh = loadTri(mf.triFilename);
+        if (!mf.imgFilename.empty())
+            loadImage_(Ustring(mf.imgFilename),mesh.surfaces[0].albedoMapRef());
+        mesh.transform(rotMatrix);
+        mesh.surfaces[0].material.shiny = mf.shiny;
+    }
+    return meshes;
+}
+
 /**
    \ingroup Base_Commands
    Command to render a mesh and colour map to an image.
@@ -118,6 +167,11 @@ fgCmdRender(CLArgs const & args)
         "        <antiAliasBitDepth> - Defaults to 3, use 4 or 5 for higher quality (slower).\n"
         "        <renderSurfPoints> - 0 means don't, 1 means when visible and 2 means always.\n"
         "            They are rendered as single-pixel green dots over the image.\n"
+        "        <useMaps> - 0 to ignore texture maps and render raw geometry.\n"
+        "        <allShiny> - 1 to render all surfaces as shiny.\n"
+        "        <texFilter> - 0 bilinear (default), 1 trilinear, 2 anisotropic. Mip-mapped filters reduce\n"
+        "            aliasing of distant or oblique texture maps.\n"
+        "        <cullBackFaces> - 1 to skip backfacing tris (faster), only for closed opaque meshes.\n"
         "    <saveSurfPointFile> - 0 means don't, 1 means save <name>.csv with a list of surface points\n"
         "        written as <label>,<position>,<visible>, where <position> is in image unit coordinates; [0,1]\n"
         "    <outputFile> - Name of image output file."
@@ -157,28 +211,10 @@ fgCmdRender(CLArgs const & args)
     }
 
     //! Load data from files:
-    Meshes              meshes(opts.rend.models.size());
-    Mat33F              rotMatrix = Mat33F(opts.rend.pose.rotateToHcs.asMatrix());
-    for (size_t ii=0; ii<meshes.size(); ++ii) {
-        const ModelFiles &  mf = opts.rend.models[ii];
-        Mesh &              mesh = meshes[ii];
-        mesh = loadTri(mf.triFilename);
-        if (!mf.imgFilename.empty())
-            loadImage_(Ustring(mf.imgFilename),mesh.surfaces[0].albedoMapRef());
-        mesh.transform(rotMatrix);
-        mesh.surfaces[0].material.shiny = mf.shiny;
-    }
+    Meshes              meshes = loadModels(opts.rend.models,opts.rend.pose.rotateToHcs);
 
     //! Calculate view transforms:
-    Mat32F              bounds = cBounds(meshes);
-    CameraParams        cps(fgF2D(bounds));
-    cps.pose =
-        cRotateY(opts.rend.pose.panRadians) *
-        cRotateX(opts.rend.pose.tiltRadians) *
-        cRotateZ(opts.rend.pose.rollRadians);
-    cps.relTrans = opts.rend.pose.relTrans;
-    cps.logRelScale = std::log(opts.rend.pose.relScale);
-    cps.fovMaxDeg = opts.rend.pose.fovMaxDeg;
+    CameraParams        cps = toCameraParams(opts.rend.pose,cBounds(meshes));
     Camera              cam;
     SimilarityD         mvm;
     if (!viewLoad.empty()) {
@@ -213,6 +249,66 @@ Cmd
 getRenderCmd()
 {return Cmd(fgCmdRender,"render","Render TRI files with optional texture images to an image file"); }
 
+/**
+   \ingroup Base_Commands
+   Command to render many views of the same meshes from a single job file.
+ */
+void
+fgCmdRenderBatch(CLArgs const & args)
+{
+    Syntax              syntax(args,
+        "<job>.xml\n"
+        "    Render every combination of the morph poses, camera poses and lightings in <job>.xml.\n"
+        "    The mesh setup for each morph pose is shared between views and views are rendered concurrently.\n"
+        "JOB XML:\n"
+        "    <models> - As for the 'render' command. Only the 'rotateToHcs' of the first camera is used.\n"
+        "    <poses> - List of morph poses, each a list of <name>,<val> pairs. If empty the base shape is used.\n"
+        "    <cameras> - List of <pose> as for the 'render' command.\n"
+        "    <lightings> - List of <lighting> as for the 'render' command. If empty <options> lighting is used.\n"
+        "    <imagePixelSize>\n"
+        "    <options> - As for the 'render' command.\n"
+        "    <outputPrefix> - Images are saved to <outputPrefix>_p<pose>_c<camera>_l<lighting>.png"
+    );
+    BatchArgs           job;
+    job.options.lighting.lights.clear();    // See boost XML vector comment in 'fgCmdRender'
+    loadBsaXml(syntax.next(),job);
+    if (syntax.more())
+        syntax.error("Too many arguments");
+    if (job.cameras.empty())
+        fgThrow("renderBatch: no cameras specified");
+    for (Pose & pose : job.cameras)
+        if (!pose.rotateToHcs.normalize())
+            fgThrow("rotateToHcs: quaternion cannot be zero magnitude");
+    if (job.lightings.empty())
+        job.lightings.push_back(job.options.lighting);
+    Meshes              meshes = loadModels(job.models,job.cameras[0].rotateToHcs);
+    // Frame all views from the base shape bounds so they are consistent across poses:
+    Mat32F              bounds = cBounds(meshes);
+    RenderViews         views;
+    Strings             outFiles;
+    for (size_t pp=0; pp<cMax(job.poses.size(),size_t(1)); ++pp) {
+        for (size_t cc=0; cc<job.cameras.size(); ++cc) {
+            Camera              cam = toCameraParams(job.cameras[cc],bounds).camera(job.imagePixelSize);
+            for (size_t ll=0; ll<job.lightings.size(); ++ll) {
+                RenderOptions       ro = job.options;
+                ro.lighting = job.lightings[ll];
+                ro.projSurfPoints.reset();
+                views.push_back(RenderView(pp,RenderXform(cam),job.imagePixelSize,ro));
+                outFiles.push_back(job.outputPrefix+"_p"+toStr(pp)+"_c"+toStr(cc)+"_l"+toStr(ll)+".png");
+            }
+        }
+    }
+    Timer               timer;
+    ImgC4UCs            images = renderSoftBatch(meshes,job.poses,views);
+    fgout << fgnl << "Rendered " << images.size() << " views in " << timer.read() << "s ";
+    for (size_t ii=0; ii<images.size(); ++ii)
+        saveImage(Ustring(outFiles[ii]),images[ii]);
+}
+
+Cmd
+getRenderBatchCmd()
+{return Cmd(fgCmdRenderBatch,"renderBatch","Render multiple views of TRI files from an XML job file"); }
+
 static
 bool
 imgApproxEqual(Ustring const & file0,Ustring const & file1)
@@ -240,11 +336,50 @@ fgCmdRenderTest(CLArgs const & args)
     opts.rend.models.push_back(mf);
     saveBsaXml("render_test.xml",opts);
     fgCmdRender(splitChar("render render_test"));
+    // Batch rendering of the same view must give the same image:
+    BatchArgs           job;
+    job.models = opts.rend.models;
+    job.cameras = {opts.rend.pose,opts.rend.pose};
+    job.cameras[1].panRadians = 0.0;
+    job.imagePixelSize = opts.rend.imagePixelSize;
+    job.options = opts.rend.options;
+    job.outputPrefix = "render_batch";
+    saveBsaXml("render_batch.xml",job);
+    fgCmdRenderBatch(splitChar("renderBatch render_batch.xml"));
+    FGASSERT(imgApproxEqual("render_batch_p0_c0_l0.png","render_test.png"));
+    FGASSERT(pathExists("render_batch_p0_c1_l0.png"));
+    // Mip-mapped filtering is selected in the job file:
+    job.options.texFilter = TexFilter::trilinear;
+    job.outputPrefix = "render_trilinear";
+    saveBsaXml("render_trilinear.xml",job);
+    fgCmdRenderBatch(splitChar("renderBatch render_trilinear.xml"));
+    FGASSERT(pathExists("render_trilinear_p0_c0_l0.png"));
     regressFileRel("render_test.png","base/test/",imgApproxEqual);
     // TODO: make a struct and serialize to XML so an approx comparison can be done (debug has precision diffs):
     if ((getCurrentCompiler() == Compiler::vs15) && (getCurrentBuildConfig() == "release")) {
         regressFileRel("render_test.csv","base/test/");
     }
+    // Files saved before 'texFilter' and 'cullBackFaces' were added to RenderOptions must still load:
+    Options             old;
+    old.rend.options.lighting.lights.clear();
+    old.rend.options.texFilter = TexFilter::anisotropic;
+    old.rend.options.cullBackFaces = true;
+    loadBsaXml(dataDir()+"base/test/renderOptionsV0.xml",old);
+    FGASSERT(old.outputFile == "renderOptionsV0.png");
+    FGASSERT((old.rend.options.lighting.lights.size() == 1) && (old.rend.options.antiAliasBitDepth == 3));
+    FGASSERT(old.rend.options.texFilter == TexFilter::anisotropic);
+    FGASSERT(old.rend.options.cullBackFaces);
+    // And the new members must round trip:
+    opts.rend.options.texFilter = TexFilter::trilinear;
+    opts.rend.options.cullBackFaces = true;
+    saveBsaXml("render_v1.xml",opts);
+    Options             opts1;
+    opts1.rend.options.lighting.lights.clear();
+    loadBsaXml("render_v1.xml",opts1);
+    FGASSERT((opts1.rend.options.texFilter == TexFilter::trilinear) && opts1.rend.options.cullBackFaces);
+    RenderOptions       ro;
+    fromNative(toNative(opts.rend.options),ro);
+    FGASSERT((ro.texFilter == TexFilter::trilinear) && ro.cullBackFaces);
 }
 
 }
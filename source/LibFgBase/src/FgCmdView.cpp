@@ -46,10 +46,51 @@ cmdViewMesh(CLArgs const & args)
         else
             syn.error("Unrecognized option: ",syn.curr());
     }
-    Meshes           meshes;
+    // Parse all arguments first so that all meshes and maps can be loaded concurrently:
+    struct  MapLoad
+    {
+        String                  albedoName;
+        AsyncResult<ImgC4UC>    albedo;
+        String                  optName;
+        AsyncResult<ImgC4UC>    trans;
+        AsyncResult<ImgC4UC>    specular;
+    };
+    struct  MeshLoad
+    {
+        Path                    path;
+        AsyncResult<Mesh>       mesh;
+        Svec<MapLoad>           maps;
+    };
+    AsyncLoader &       loader = asyncLoaderDefault();
+    Svec<MeshLoad>      loads;
     while (syn.more()) {
-        Path            path(syn.next());
-        Mesh            mesh = loadMesh(path.str());
+        MeshLoad            ml;
+        ml.path = Path(syn.next());
+        ml.mesh = loadMeshAsync(loader,ml.path.str());
+        while (syn.more() && hasImgExtension(syn.peekNext())) {
+            MapLoad             map;
+            map.albedoName = syn.next();
+            map.albedo = loadImageAsync(loader,map.albedoName);
+            if (syn.more() && (syn.peekNext()[0] == '-')) {
+                if(syn.next() == "-t") {
+                    map.optName = syn.next();
+                    map.trans = loadImageAsync(loader,map.optName);
+                }
+                else if (syn.curr() == "-s") {
+                    map.optName = syn.next();
+                    map.specular = loadImageAsync(loader,map.optName);
+                }
+                else
+                    syn.error("Unrecognized image map option",syn.curr());
+            }
+            ml.maps.push_back(map);
+        }
+        loads.push_back(ml);
+    }
+    Meshes           meshes;
+    for (MeshLoad & ml : loads) {
+        Path const &    path = ml.path;
+        Mesh            mesh = ml.mesh.get();
         mesh.name = path.base;
         if (removeUnused) {
             size_t          origVerts = mesh.verts.size();
@@ -58,36 +99,30 @@ cmdViewMesh(CLArgs const & args)
                 fgout << fgnl << origVerts-mesh.verts.size() << " unused vertices removed for viewing";
         }
         fgout << fgnl << path.baseExt() << fgpush << mesh << fgpop;
-        if (syn.more() && hasImgExtension(syn.peekNext())) {
-            if (mesh.uvs.empty())
-                fgout << fgnl << "WARNING: " << syn.curr() << " has no UVs, color maps will not be seen.";
-            size_t              mapIdx = 0;
-            while (syn.more() && hasImgExtension(syn.peekNext())) {
-                ImgC4UC         albedo = loadImage(syn.next()),
-                                specular;
-                fgout << fgnl << syn.curr() << fgpush << albedo << fgpop;
-                if (syn.more() && (syn.peekNext()[0] == '-')) {
-                    if(syn.next() == "-t") {
-                        ImgC4UC         trans = loadImage(syn.next());
-                        fgout << fgnl << syn.curr() << fgpush << trans << fgpop;
-                        albedo = fgImgApplyTransparencyPow2(albedo,trans);
-                    }
-                    else if (syn.curr() == "-s") {
-                        loadImage_(syn.next(),specular);
-                        fgout << fgnl << syn.curr() << fgpush << specular << fgpop;
-                    }
-                    else
-                        syn.error("Unrecognized image map option",syn.curr());
-                }
-                if (mapIdx < mesh.surfaces.size()) {
-                    Surf &              surf = mesh.surfaces[mapIdx++];
-                    surf.setAlbedoMap(albedo);
-                    if (!specular.empty())
-                        surf.material.specularMap = make_shared<ImgC4UC>(specular);
-                }
-                else
-                    fgout << fgnl << "WARNING: " << path.baseExt() << " does not have enough surfaces for the given number of maps.";
+        if (!ml.maps.empty() && mesh.uvs.empty())
+            fgout << fgnl << "WARNING: " << path.str() << " has no UVs, color maps will not be seen.";
+        size_t              mapIdx = 0;
+        for (MapLoad & map : ml.maps) {
+            ImgC4UC         albedo = map.albedo.get(),
+                            specular;
+            fgout << fgnl << map.albedoName << fgpush << albedo << fgpop;
+            if (map.trans.valid()) {
+                ImgC4UC         trans = map.trans.get();
+                fgout << fgnl << map.optName << fgpush << trans << fgpop;
+                albedo = fgImgApplyTransparencyPow2(albedo,trans);
+            }
+            else if (map.specular.valid()) {
+                specular = map.specular.get();
+                fgout << fgnl << map.optName << fgpush << specular << fgpop;
+            }
+            if (mapIdx < mesh.surfaces.size()) {
+                Surf &              surf = mesh.surfaces[mapIdx++];
+                surf.setAlbedoMap(albedo);
+                if (!specular.empty())
+                    surf.material.specularMap = make_shared<ImgC4UC>(specular);
             }
+            else
+                fgout << fgnl << "WARNING: " << path.baseExt() << " does not have enough surfaces for the given number of maps.";
         }
         meshes.push_back(mesh);
     }
@@ -0,0 +1,219 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+
+#include "stdafx.h"
+
+#include "FgCompress.hpp"
+#include "FgDiagnostics.hpp"
+#include "FgMath.hpp"
+#include "FgCommand.hpp"
+#include "FgTime.hpp"
+#include "FgRandom.hpp"
+#include "FgOut.hpp"
+
+using namespace std;
+
+namespace Fg {
+
+namespace {
+
+uint const      minMatch = 4;
+uint const      hashBits = 14;
+size_t const    maxOffset = 0xFFFF;
+size_t const    lastLiterals = 5;       // The final bytes are always literals so matching can read 4 ahead
+
+inline uint32
+read32(char const * ptr)
+{
+    uint32          ret;
+    memcpy(&ret,ptr,4);
+    return ret;
+}
+
+inline uint32
+hashSeq(uint32 seq)
+{return (seq * 2654435761U) >> (32 - hashBits); }
+
+void
+writeLength(String & out,size_t len)
+{
+    while (len >= 255) {
+        out.push_back(char(255));
+        len -= 255;
+    }
+    out.push_back(char(len));
+}
+
+void
+writeSequence(String & out,char const * literals,size_t numLiterals,size_t offset,size_t matchLen)
+{
+    size_t          matchCode = matchLen - minMatch;
+    uchar           token = uchar((cMin(numLiterals,size_t(15)) << 4) | cMin(matchCode,size_t(15)));
+    out.push_back(char(token));
+    if (numLiterals >= 15)
+        writeLength(out,numLiterals-15);
+    out.append(literals,numLiterals);
+    out.push_back(char(offset & 0xFF));
+    out.push_back(char(offset >> 8));
+    if (matchCode >= 15)
+        writeLength(out,matchCode-15);
+}
+
+void
+writeLast(String & out,char const * literals,size_t numLiterals)
+{
+    out.push_back(char(cMin(numLiterals,size_t(15)) << 4));
+    if (numLiterals >= 15)
+        writeLength(out,numLiterals-15);
+    out.append(literals,numLiterals);
+}
+
+}
+
+String
+compressFast(char const * src,size_t size)
+{
+    FGASSERT(size < 0xFFFFFFFFULL);         // Positions are stored in 32 bits
+    String          ret;
+    ret.reserve(size + size/255 + 16);
+    size_t          anchor = 0,
+                    pos = 0;
+    if (size > minMatch + lastLiterals) {
+        Svec<uint32>    table(size_t(1) << hashBits,0);
+        size_t          limit = size - lastLiterals - minMatch;
+        while (pos <= limit) {
+            uint32          seq = read32(src+pos);
+            uint32 &        entry = table[hashSeq(seq)];
+            size_t          cand = entry;
+            entry = uint32(pos);
+            if ((cand < pos) && (pos-cand <= maxOffset) && (read32(src+cand) == seq)) {
+                size_t          len = minMatch,
+                                maxLen = size - lastLiterals - pos;
+                while ((len < maxLen) && (src[cand+len] == src[pos+len]))
+                    ++len;
+                writeSequence(ret,src+anchor,pos-anchor,pos-cand,len);
+                pos += len;
+                anchor = pos;
+            }
+            else
+                // Skip faster through data which isn't matching:
+                pos += 1 + ((pos-anchor) >> 6);
+        }
+    }
+    writeLast(ret,src+anchor,size-anchor);
+    return ret;
+}
+
+String
+decompressFast(char const * data,size_t size,size_t rawSize)
+{
+    String          ret(rawSize,'\0');
+    uchar const *   in = reinterpret_cast<uchar const *>(data);
+    uchar const *   inEnd = in + size;
+    char *          out = rawSize > 0 ? &ret[0] : nullptr;
+    size_t          outPos = 0;
+    auto            readLength = [&](size_t len) -> size_t
+    {
+        if (len == 15) {
+            uchar           add;
+            do {
+                if (in == inEnd)
+                    fgThrow("decompressFast corrupt data (length)");
+                add = *in++;
+                len += add;
+            }
+            while (add == 255);
+        }
+        return len;
+    };
+    for (;;) {
+        if (in == inEnd)
+            fgThrow("decompressFast corrupt data (token)");
+        uchar           token = *in++;
+        size_t          numLiterals = readLength(token >> 4);
+        if ((size_t(inEnd-in) < numLiterals) || (rawSize-outPos < numLiterals))
+            fgThrow("decompressFast corrupt data (literals)");
+        if (numLiterals > 0)
+            memcpy(out+outPos,in,numLiterals);
+        in += numLiterals;
+        outPos += numLiterals;
+        if (in == inEnd)
+            break;
+        if (inEnd-in < 2)
+            fgThrow("decompressFast corrupt data (offset)");
+        size_t          offset = size_t(in[0]) | (size_t(in[1]) << 8);
+        in += 2;
+        size_t          matchLen = readLength(token & 0x0F) + minMatch;
+        if ((offset == 0) || (offset > outPos) || (rawSize-outPos < matchLen))
+            fgThrow("decompressFast corrupt data (match)");
+        char *          dst = out + outPos;
+        char const *    mtch = dst - offset;
+        if (offset >= matchLen)
+            memcpy(dst,mtch,matchLen);
+        else                                // Overlapping copy repeats the pattern
+            for (size_t ii=0; ii<matchLen; ++ii)
+                dst[ii] = mtch[ii];
+        outPos += matchLen;
+    }
+    if (outPos != rawSize)
+        fgThrow("decompressFast size mismatch",toStr(outPos)+" != "+toStr(rawSize));
+    return ret;
+}
+
+void
+testCompressFast(CLArgs const &)
+{
+    auto            roundTrip = [](String const & data)
+    {
+        String          comp = compressFast(data);
+        FGASSERT(comp.size() <= data.size() + data.size()/255 + 16);
+        FGASSERT(decompressFast(comp,data.size()) == data);
+        return comp.size();
+    };
+    // Edge cases:
+    for (size_t sz=0; sz<40; ++sz) {
+        roundTrip(String(sz,'a'));
+        String          str;
+        for (size_t ii=0; ii<sz; ++ii)
+            str.push_back(char('a' + (ii*7)%5));
+        roundTrip(str);
+    }
+    // Long runs use extended lengths and overlapping matches:
+    FGASSERT(roundTrip(String(100000,'x')) < 500);
+    // Random data doesn't compress but mustn't expand much:
+    String          rnd(100000,'\0');
+    for (char & ch : rnd)
+        ch = char(randUint(256));
+    roundTrip(rnd);
+    // Typical numeric data (mesh-like float array):
+    Svec<float>     verts(3*200000);
+    for (size_t ii=0; ii<verts.size(); ++ii)
+        verts[ii] = float(int(ii%3000)/16) * 0.25f;
+    String          numeric(reinterpret_cast<char const *>(verts.data()),verts.size()*sizeof(float));
+    Timer           timer;
+    String          comp = compressFast(numeric);
+    double          compTime = timer.read();
+    timer.start();
+    String          decomp = decompressFast(comp,numeric.size());
+    double          decompTime = timer.read();
+    FGASSERT(decomp == numeric);
+    // Corrupt data must throw rather than read or write out of bounds:
+    size_t          numThrown = 0;
+    for (size_t ii=0; ii<200; ++ii) {
+        String          bad = comp.substr(0,2000);
+        bad[randUint(uint(bad.size()))] ^= char(1 + randUint(255));
+        try {decompressFast(bad,20000); }
+        catch (FgException const &) {++numThrown; }
+    }
+    FGASSERT(numThrown > 0);
+    double          mb = double(numeric.size()) / (1 << 20);
+    fgout << fgnl << "Compressed " << mb << "MB to " << 100.0*double(comp.size())/double(numeric.size())
+        << "% at " << mb/std::max(compTime,0.001) << "MB/s, decompressed at " << mb/std::max(decompTime,0.001) << "MB/s";
+}
+
+}
+
+// */
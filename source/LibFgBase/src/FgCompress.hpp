@@ -0,0 +1,41 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Fast LZ77 byte compression in the style of LZ4, for transient data such as network messages where
+// speed matters more than ratio. Not intended as a file format.
+//
+// Each sequence is a token byte (high nibble literal count, low nibble match length - 4, with the
+// value 15 in either extended by following bytes which are added until one is less than 255), then
+// the literals, then a 16-bit little-endian match offset. The final sequence has only literals.
+//
+
+#ifndef FGCOMPRESS_HPP
+#define FGCOMPRESS_HPP
+
+#include "FgStdString.hpp"
+
+namespace Fg {
+
+// Output can be larger than the input (by at most 1/255 + 16 bytes) for incompressible data:
+String
+compressFast(char const * data,size_t size);
+
+inline String
+compressFast(String const & data)
+{return compressFast(data.data(),data.size()); }
+
+// 'rawSize' must be the exact uncompressed size. Throws if the data is corrupt:
+String
+decompressFast(char const * data,size_t size,size_t rawSize);
+
+inline String
+decompressFast(String const & data,size_t rawSize)
+{return decompressFast(data.data(),data.size(),rawSize); }
+
+}
+
+#endif
+
+// */
@@ -9,6 +9,7 @@
 #include "FgDataflow.hpp"
 #include "FgCommand.hpp"
 #include "FgTime.hpp"
+#include "FgMemory.hpp"
 
 using namespace std;
 
@@ -102,10 +103,13 @@ DfgOutput::update() const
         src->update();      // Ensure sources updated
 //fgout << fgpop;
     try {
+        MemTagScope mts(MemTag::dataflow);
+        int64       m0 = memThreadNet();
         uint64      t0 = getTimeMs();
         func(sources,data);
         uint64      t1 = getTimeMs();
         time += t1-t0;
+        dataBytes += memThreadNet()-m0;
     }
     catch(FgException & e)
     {
@@ -157,6 +161,29 @@ DfgOutput::addSink(const DfgDPtr & snk)
     sinks.push_back(snk);
 }
 
+size_t
+memoryFootprint(DfgNPtrs const & roots)
+{
+    size_t                  ret = 0;
+    set<DfgNode const *>    visited;
+    DfgNPtrs                todo = roots;
+    while (!todo.empty()) {
+        DfgNPtr                 node = todo.back();
+        todo.pop_back();
+        if (!node || !visited.insert(node.get()).second)
+            continue;
+        DfgOutput const *       op = dynamic_cast<DfgOutput const *>(node.get());
+        if (op != nullptr) {
+            ret += size_t(std::max(op->dataBytes,int64(0)));
+            todo.insert(todo.end(),op->sources.begin(),op->sources.end());
+        }
+        DfgReceptor const *     rp = dynamic_cast<DfgReceptor const *>(node.get());
+        if (rp != nullptr)
+            todo.push_back(rp->getSource());
+    }
+    return ret;
+}
+
 void DfgReceptor::update() const
 {
     FGASSERT(src);
@@ -97,6 +97,9 @@ struct  DfgOutput : DfgNode, DfgDependent
     // Has data we depend on anywhere above this node in the graph been modified since 'func' last run:
     mutable bool                dirty = true;
     mutable uint64              time = 0;
+    // Net bytes allocated by 'func' over all its runs while memory tracking (FgMemory.hpp) was enabled.
+    // This is the size of the cached 'data' if tracking was enabled for all runs:
+    mutable int64               dataBytes = 0;
 
     virtual ~DfgOutput();
     virtual void update() const;
@@ -126,9 +129,14 @@ public:
     virtual boost::any const & getDataCref() const;
     virtual void addSink(const DfgDPtr & snk);
     void setSource(DfgNPtr const & nptr);
+    DfgNPtr const & getSource() const {return src; }
 };
 typedef std::shared_ptr<DfgReceptor>   DfgRPtr;
 
+// Sum of 'dataBytes' over all output nodes which are 'roots' or which they depend on:
+size_t
+memoryFootprint(DfgNPtrs const & roots);
+
 // Allows client objects to keep track of their own dirty state based on one or more sources:
 struct  DirtyFlag : DfgDependent
 {
@@ -178,14 +186,17 @@ struct  IPT
         FGASSERT(!storeFile.empty());
         ptr->init(defaultVal,true);
         if (binary) {
+            // Stored in the native archive format but the previous boost portable binary format is
+            // still read:
             if (pathExists(storeFile))
-                loadBsaPBin(storeFile,ref(),false);
+                if (!loadNative(storeFile,ref(),false))
+                    loadBsaPBin(storeFile,ref(),false);
             ptr->onDestruct = [storeFile](boost::any const & v)
             {
                 if (v.empty())
                     fgWarn("IPT onDestruct save with empty data",cSignature(v));
                 else
-                    saveBsaPBin(storeFile,boost::any_cast<T const &>(v),false);
+                    saveNative(storeFile,boost::any_cast<T const &>(v),false);
             };
         }
         else {
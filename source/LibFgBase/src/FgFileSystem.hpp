@@ -175,6 +175,27 @@ fileReadable(Ustring const & filename);
 String
 loadRawString(Ustring const & filename);
 
+// Read-only memory mapped view of an entire file. Throws if the file cannot be opened or mapped.
+// The data pointer is null for an empty file:
+struct  MappedFile
+{
+    explicit MappedFile(Ustring const & filename);
+    ~MappedFile();
+
+    MappedFile(MappedFile const &) = delete;
+    void operator=(MappedFile const &) = delete;
+
+    uchar const *
+    data() const {return m_data; }
+
+    size_t
+    size() const {return m_size; }
+
+private:
+    uchar const *       m_data = nullptr;
+    size_t              m_size = 0;
+};
+
 // Setting 'onlyIfChanged' to false will result in the file always being written,
 // regardless of whether the new data may be identical.
 // Leaving 'true' is useful to avoid triggering unwanted change detections.
@@ -10,6 +10,7 @@
 
 #include "FgImage.hpp"
 #include "FgAffineCwC.hpp"
+#include "FgMemory.hpp"
 
 namespace Fg {
 
@@ -24,6 +25,7 @@ struct  GridIndex
     void
     setup(Mat22F clientBounds,uint approxNumBins)
     {
+        MemTagScope         mts(MemTag::gridIndex);
         FGASSERT((approxNumBins > 0) && (approxNumBins < (1 << 20)));   // Sanity check
         Vec2F        clientSz = clientBounds.colVec(1) - clientBounds.colVec(0);
         FGASSERT((clientSz[0]>0) && (clientSz[1]>0));
@@ -39,6 +41,7 @@ struct  GridIndex
     void
     add(T const & val,Mat22F clientBounds)
     {
+        MemTagScope         mts(MemTag::gridIndex);
         Mat22F        ipcsBounds = clientToGridIpcs * clientBounds;
         ipcsBounds[0] = cMax(ipcsBounds[0],0.0f);
         ipcsBounds[2] = cMax(ipcsBounds[2],0.0f);
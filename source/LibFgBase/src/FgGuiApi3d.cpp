@@ -35,56 +35,25 @@ intersectMeshes(
     Mat44F              worldToD3ps,
     RendMeshes const &  rendMeshes)
 {
-    MeshesIntersect     ret;
-    Valid<float>        minDepth;
-    Vec2D               pnt {pos};
-    Mat32F              d3ps {-1,1,1,-1,0,1};
-    Mat32F              rcs {-0.5f,winSize[0]-0.5f,-0.5f,winSize[1]-0.5f,0,1};
-    AffineEw3F          d3psToRcs {d3ps,rcs};
-    Mat44F              invXform = asHomogMat(d3psToRcs.asAffine()) * worldToD3ps;
+    Opt<MeshesIntersect>    ret;
+    if (rendMeshes.empty())
+        return ret;
+    PickRay             ray = cPickRay(worldToD3ps,winSize,pos);
+    double              minDepth = numeric_limits<double>::max();
     for (size_t mm=0; mm<rendMeshes.size(); ++mm) {
         RendMesh const &    rendMesh = rendMeshes[mm];
-        Mesh const &        mesh = rendMesh.origMeshN.cref();
-        Vec3Fs const &      verts = rendMesh.posedVertsN.cref();
-        Vec3Fs              pvs(verts.size());
-        for (size_t ii=0; ii<pvs.size(); ++ii) {
-            Vec4F               v = invXform * asHomogVec(verts[ii]);
-            pvs[ii] = v.subMatrix<3,1>(0,0) / v[3];
-        }
-        for (size_t ss=0; ss<mesh.surfaces.size(); ++ss) {
-            Surf const & surf = mesh.surfaces[ss];
-            size_t              numTriEquivs = surf.numTriEquivs();
-            for (size_t tt=0; tt<numTriEquivs; ++tt) {
-                Vec3UI          tri = surf.getTriEquivPosInds(tt);
-                Vec3F           t0 = pvs[tri[0]],
-                                t1 = pvs[tri[1]],
-                                t2 = pvs[tri[2]];
-                Vec2D           v0 = Vec2D(t0.subMatrix<2,1>(0,0)),
-                                v1 = Vec2D(t1.subMatrix<2,1>(0,0)),
-                                v2 = Vec2D(t2.subMatrix<2,1>(0,0));
-                if (pointInTriangle(pnt,v0,v1,v2) == -1) {     // CC winding
-                    Opt<Vec3D>      vbc = barycentricCoord(pnt,v0,v1,v2);
-                    if (vbc.valid()) {
-                        Vec3D           bc = vbc.val();
-                        // Depth value range for unclipped polys is [-1,1]. These correspond to the
-                        // negative inverse depth values of the frustum.
-                        // Only an approximation to the depth value but who cares:
-                        double          dep = cDot(bc,Vec3D(t0[2],t1[2],t2[2]));
-                        if (!minDepth.valid() || (dep < minDepth.val())) {    // OGL prj inverts depth
-                            minDepth = dep;
-                            ret.meshIdx = mm;
-                            ret.surfIdx = ss;
-                            ret.surfPnt.triEquivIdx = uint(tt);
-                            ret.surfPnt.weights = Vec3F(bc);
-                        }
-                    }
-                }
-            }
+        // The picker only needs updating when the posed verts (which depend on the mesh) change,
+        // and only needs rebuilding (rather than refitting) when the mesh topology changes:
+        if (!rendMesh.pickVertsFlag || rendMesh.pickVertsFlag->checkUpdate())
+            rendMesh.picker->update(rendMesh.origMeshN.cref(),rendMesh.posedVertsN.cref());
+        Opt<MeshPick>       pick = rendMesh.picker->pick(ray);
+        if (pick.valid() && (pick.val().rayParam < minDepth)) {
+            MeshPick const &    mp = pick.val();
+            minDepth = mp.rayParam;
+            ret = MeshesIntersect {mm,mp.surfIdx,mp.surfPnt};
         }
     }
-    if (minDepth.valid())
-        return Opt<MeshesIntersect>(ret);
-    return Opt<MeshesIntersect>();
+    return ret;
 }
 
 void
@@ -13,6 +13,7 @@
 #include "FgLighting.hpp"
 #include "Fg3dNormals.hpp"
 #include "FgAny.hpp"
+#include "Fg3dPick.hpp"
 
 namespace Fg {
 
@@ -86,12 +87,16 @@ struct  RendMesh
     NPT<Vec3Fs>             posedVertsN;
     DfgFPtr                 surfVertsFlag;      // Must point to 'posedVertsN'
     DfgFPtr                 allVertsFlag;       // "
+    DfgFPtr                 pickVertsFlag;      // " [opt] If null the picker is updated on every pick
     NPT<MeshNormals>        normalsN;
     Sptr<Any>               gpuData = std::make_shared<Any>();
+    // Picking index for 'posedVertsN', updated lazily by 'intersectMeshes':
+    Sptr<MeshPicker>        picker = std::make_shared<MeshPicker>();
     RendSurfs               rendSurfs;
 };
 typedef Svec<RendMesh>      RendMeshes;
 
+// Closest front facing surface under the given pixel:
 Opt<MeshesIntersect>
 intersectMeshes(
     Vec2UI                  winSize,
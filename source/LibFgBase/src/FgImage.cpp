@@ -10,6 +10,7 @@
 #include "FgMath.hpp"
 #include "FgTime.hpp"
 #include "FgScaleTrans.hpp"
+#include "FgMemory.hpp"
 
 using namespace std;
 
@@ -373,79 +374,124 @@ fgImgGetIrcsToBounds(
     return Affine2D(centre,linear);
 }
 
+namespace {
+
+// Back-projection of destination pixels into the source image IRCS along one axis for 'imgResize':
+struct  ResizeAxis
+{
+    uint        srcSize;
+    float       ext;        // Extent of a destination pixel in source pixels
+
+    ResizeAxis(uint srcSz,uint dstSz) : srcSize(srcSz)
+    {
+        float       scale = (float)dstSz / (float)srcSz;
+        ext = 1.0f / scale;
+    }
+
+    // Note that we need to check the upper bound since
+    // this algorithm will want to add an out of bounds pixel
+    // with weight 0. This still works with the weighting
+    // algorithm in the inner loop since the float value
+    // will only ever just hit the out of bounds integer
+    // value and not exceed it.
+    void
+    bounds(uint dstIdx,float & lo,float & hi,uint & lob,uint & hib) const
+    {
+        lo = (float)dstIdx * ext;
+        hi = lo + ext;
+        lob = (uint)lo;
+        hib = (uint)hi;
+        if (hib >= srcSize)
+            --hib;
+    }
+};
+
+}
+
+Mat22UI
+imgResizeSrcBounds(Vec2UI srcDims,Vec2UI dstDims,Vec2UI dstLo,Vec2UI dstRegionDims)
+{
+    FGASSERT(cMinElem(dstRegionDims) > 0);
+    Mat22UI         ret;
+    for (uint dd=0; dd<2; ++dd) {
+        ResizeAxis      axis(srcDims[dd],dstDims[dd]);
+        float           lo,hi;
+        uint            lob,hib;
+        axis.bounds(dstLo[dd],lo,hi,lob,hib);
+        ret.rc(dd,0) = lob;
+        axis.bounds(dstLo[dd]+dstRegionDims[dd]-1,lo,hi,lob,hib);
+        ret.rc(dd,1) = hib;
+    }
+    return ret;
+}
+
 void
-imgResize(
-	ImgC4UC const & src,
-	ImgC4UC       & dst)
+imgResizeRegion(
+    ImgC4UC const & src,
+    Vec2UI          srcLo,
+    Vec2UI          srcDims,
+    Vec2UI          dstDims,
+    Vec2UI          dstLo,
+    ImgC4UC &       dst)
 {
     FGASSERT(!src.empty());
     FGASSERT(!dst.empty());
-    typedef ImgC4UC          ImageType;
-    typedef ImageType::PixelType PixelType;
-	uint        swid = src.width(),
-                shgt = src.height(),
-                wid = dst.width(),
-                hgt = dst.height();
-    if ((wid == swid) && (hgt == shgt)) {
-        dst = src;
-		return;
-	}
-	float   sx = (float)wid / (float)swid,
-            sy   = (float)hgt / (float)shgt;
-	const PixelType *srcPtr = src.data();
-	PixelType       *dstPtr	= dst.data();
-	uint        srcStep = src.width(),
-                dstStep  = dst.width();
-	float       ex    = 1.0f / sx,
-                ey      = 1.0f / sy,
-                invArea	= 1.0f / (ex * ey);
-	for	(uint yDstRcs=0; yDstRcs<hgt; yDstRcs++) {
-		// Calculate the y pixel bounds in the source image IRCS
-		// Note that we need to check the upper bound since
-		// this algorithm will want to add an out of bounds pixel
-		// with weight 0. This still works with the weighting
-		// algorithm in the inner loop since the float value
-		// will only ever just hit the out of bounds integer
-		// value and not exceed it.
-		float	yblo = (float)yDstRcs * ey,
-				ybhi = yblo + ey;
-		uint	yblob = (uint)yblo,
-				ybhib = (uint)ybhi;
-		if (ybhib >= shgt)
-            --ybhib;
-		for (uint xDstRcs=0; xDstRcs<wid; xDstRcs++) {
-            // Calculate the x pixel bounds in the source image IRCS
-			float	xblo = (float)xDstRcs * ex,
-					xbhi = xblo + ex;
-			uint	xblob = (uint)xblo,
-					xbhib = (uint)xbhi;
-			if (xbhib >= swid)
-                --xbhib;
+    Mat22UI         srcBounds = imgResizeSrcBounds(srcDims,dstDims,dstLo,dst.dims());
+    for (uint dd=0; dd<2; ++dd)
+        FGASSERT((srcBounds.rc(dd,0) >= srcLo[dd]) && (srcBounds.rc(dd,1) < srcLo[dd]+src.dims()[dd]));
+    ResizeAxis      ax(srcDims[0],dstDims[0]),
+                    ay(srcDims[1],dstDims[1]);
+    float           invArea = 1.0f / (ax.ext * ay.ext);
+    RgbaUC          *dstPtr = dst.data();
+    for (uint yd=0; yd<dst.height(); ++yd) {
+        float       yblo,ybhi;
+        uint        yblob,ybhib;
+        ay.bounds(dstLo[1]+yd,yblo,ybhi,yblob,ybhib);
+        for (uint xd=0; xd<dst.width(); ++xd) {
+            float       xblo,xbhi;
+            uint        xblob,xbhib;
+            ax.bounds(dstLo[0]+xd,xblo,xbhi,xblob,xbhib);
             // Now sum up the contributions of the source pixels
             // that fall within this back-projected window.
-			Rgba<float> acc, fpix;
-			for (uint yy=yblob; yy<=ybhib; yy++) {
-				float	yfac = 1.0f;
-				if (yy == yblob)
-					yfac -= yblo - (float)yblob;
-				if (yy == ybhib)
-					yfac -= (float)(ybhib+1) - ybhi;
-				for (uint xx=xblob; xx<=xbhib; xx++) {
-					float	xfac = 1.0f;
-					if (xx == xblob)
-						xfac -= xblo - (float)xblob;
-					if (xx == xbhib)
-						xfac -= (float)(xbhib+1) - xbhi;
-					scast_(srcPtr[yy*srcStep + xx],fpix);
-					acc += fpix * xfac * yfac;
-				}
-			}
+            Rgba<float> acc, fpix;
+            for (uint yy=yblob; yy<=ybhib; yy++) {
+                float       yfac = 1.0f;
+                if (yy == yblob)
+                    yfac -= yblo - (float)yblob;
+                if (yy == ybhib)
+                    yfac -= (float)(ybhib+1) - ybhi;
+                RgbaUC const *  srcRow = src.rowPtr(yy-srcLo[1]);
+                for (uint xx=xblob; xx<=xbhib; xx++) {
+                    float       xfac = 1.0f;
+                    if (xx == xblob)
+                        xfac -= xblo - (float)xblob;
+                    if (xx == xbhib)
+                        xfac -= (float)(xbhib+1) - xbhi;
+                    scast_(srcRow[xx-srcLo[0]],fpix);
+                    acc += fpix * xfac * yfac;
+                }
+            }
             // Divide by the area of the back-project and convert
             // back to fixed point.
-            round_(acc * invArea,dstPtr[xDstRcs]);
-		}
-		dstPtr += dstStep;
-	}
+            round_(acc * invArea,dstPtr[xd]);
+        }
+        dstPtr += dst.width();
+    }
+}
+
+void
+imgResize(
+    ImgC4UC const & src,
+    ImgC4UC       & dst)
+{
+    MemTagScope     mts(MemTag::image);
+    FGASSERT(!src.empty());
+    FGASSERT(!dst.empty());
+    if (src.dims() == dst.dims()) {
+        dst = src;
+        return;
+    }
+    imgResizeRegion(src,Vec2UI(0),src.dims(),dst.dims(),Vec2UI(0),dst);
 }
 
 ImgC4UC
@@ -541,6 +587,55 @@ cMipMap(ImgC4UC const & img)
     return ret;
 }
 
+// Linear interpolation between mip map levels, where 'lod' is the log2 of the footprint size in
+// level 0 texels:
+static
+RgbaF
+sampleMipLod(ImgC4UCs const & mipMap,Vec2F iucs,float lod)
+{
+    lod = clampBounds(lod,0.0f,float(mipMap.size()-1));
+    size_t          lo = size_t(lod);
+    float           frac = lod - float(lo);
+    RgbaF           ret = sampleClipIucs(mipMap[lo],iucs);
+    if (frac > 0.0f)
+        ret = ret * (1.0f-frac) + sampleClipIucs(mipMap[lo+1],iucs) * frac;
+    return ret;
+}
+
+RgbaF
+sampleMipIucs(
+    ImgC4UCs const &    mipMap,
+    Vec2F               iucs,
+    Vec2F               dIucsDx,
+    Vec2F               dIucsDy,
+    TexFilter           filter,
+    uint                maxAniso)
+{
+    FGASSERT(!mipMap.empty());
+    if (filter == TexFilter::bilinear)
+        return sampleClipIucs(mipMap[0],iucs);
+    Vec2F           dims0 {mipMap[0].dims()};
+    float           lenX = mapMul(dIucsDx,dims0).len(),     // Footprint axis lengths in level 0 texels
+                    lenY = mapMul(dIucsDy,dims0).len(),
+                    major = cMax(lenX,lenY),
+                    minor = cMin(lenX,lenY);
+    if (major <= 1.0f)                                      // Magnification
+        return sampleClipIucs(mipMap[0],iucs);
+    uint            num = 1;
+    if ((filter == TexFilter::anisotropic) && (maxAniso > 1))
+        num = (minor*float(maxAniso) <= major) ? maxAniso : uint(std::ceil(major/minor));
+    if (num <= 1)
+        return sampleMipLod(mipMap,iucs,std::log2(major));
+    // Spread the samples evenly along the major axis footprint, each with a reduced footprint:
+    Vec2F           axis = (lenX > lenY) ? dIucsDx : dIucsDy;
+    float           lod = std::log2(major/float(num)),
+                    step = 1.0f / float(num);
+    RgbaF           acc(0.0f);
+    for (uint ii=0; ii<num; ++ii)
+        acc += sampleMipLod(mipMap,iucs+axis*((float(ii)+0.5f)*step-0.5f),lod);
+    return acc * step;
+}
+
 Img3F
 fgImgToF3(ImgC4UC const & img)
 {
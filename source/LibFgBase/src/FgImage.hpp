@@ -232,6 +232,22 @@ imgResize(
     ImgC4UC const & src,
     ImgC4UC &       dst);   // MODIFIED
 
+// Source image pixel bounds (inclusive) required by 'imgResizeRegion' for the given destination region:
+Mat22UI
+imgResizeSrcBounds(Vec2UI srcDims,Vec2UI dstDims,Vec2UI dstLo,Vec2UI dstRegionDims);
+
+// Computes the region of 'imgResize' from 'srcDims' to 'dstDims' starting at 'dstLo' and of size
+// 'dst.dims()', with identical results, given the source image region starting at 'srcLo', which
+// must contain the above bounds:
+void
+imgResizeRegion(
+    ImgC4UC const & src,
+    Vec2UI          srcLo,
+    Vec2UI          srcDims,
+    Vec2UI          dstDims,
+    Vec2UI          dstLo,
+    ImgC4UC &       dst);   // MODIFIED
+
 void
 fgImgPntRescaleConvert(const ImgD & src,ImgUC & dst);
 
@@ -717,6 +733,24 @@ paintDot(ImgC4UC & img,Vec2F ipcs,Vec4UC color=fgRed(),uint radius=3);
 Svec<ImgC4UC>
 cMipMap(ImgC4UC const & img);
 
+// Texture filtering when sampling a (possibly minified) image:
+enum class TexFilter {
+    bilinear,           // Full resolution level only. Aliases when minified.
+    trilinear,          // Interpolate mip map levels chosen by the larger footprint axis.
+    anisotropic         // Average trilinear samples along the major footprint axis.
+};
+
+// Filtered sample of a mip map as returned by 'cMipMap'. The sample footprint is given by the
+// IUCS derivatives with respect to the screen X and Y axes over one screen pixel:
+RgbaF
+sampleMipIucs(
+    ImgC4UCs const &    mipMap,             // Must not be empty
+    Vec2F               coordIucs,
+    Vec2F               dIucsDx,
+    Vec2F               dIucsDy,
+    TexFilter           filter,
+    uint                maxAniso=8);        // Max samples for anisotropic filtering
+
 // Convert, no scaling:
 Img3F
 fgImgToF3(ImgC4UC const &);
@@ -210,6 +210,12 @@ struct  Img
     {m_data *= rhs; }
 };
 
+// Bytes used by the image including its pixel buffer. Pixel types must not own heap memory:
+template<class T>
+size_t
+memoryFootprint(Img<T> const & img)
+{return sizeof(img) + img.m_data.capacity() * sizeof(T); }
+
 typedef Img<uchar>     ImgUC;
 typedef Img<float>     ImgF;
 typedef Img<double>    ImgD;
@@ -15,23 +15,13 @@ using namespace std;
 
 namespace Fg {
 
-void
-loadImage_(Ustring const & fname,ImgUC & ret)
-{
-    ImgC4UC     img = loadImage(fname);
-    ret.resize(img.dims());
-    for (size_t ii=0; ii<ret.numPixels(); ++ii)
-        ret[ii] = img[ii].rec709();
-}
-
-void
-loadImage_(Ustring const & fname,ImgF & img)
+AsyncResult<ImgC4UC>
+loadImageAsync(AsyncLoader & loader,Ustring const & fname)
 {
-    ImgC4UC     tmp;
-    loadImage_(fname,tmp);
-    img.resize(tmp.dims());
-    for (size_t ii=0; ii<tmp.numPixels(); ++ii)
-        img.m_data[ii] = tmp.m_data[ii].rec709();
+    // Decoded size is known from the header. If it can't be read the load will fail quickly anyway:
+    Opt<ImgFileInfo>    info = probeImage(fname);
+    size_t              memEstimate = info.valid() ? size_t(info.val().dims[0]) * info.val().dims[1] * sizeof(RgbaUC) : 0;
+    return loader.submit<ImgC4UC>(memEstimate,[fname]{return loadImage(fname); });
 }
 
 void
@@ -12,17 +12,43 @@
 #include "FgStdExtensions.hpp"
 #include "FgImage.hpp"
 #include "FgMatrixV.hpp"
+#include "FgAsyncLoad.hpp"
+#include "FgOpt.hpp"
 
 namespace Fg {
 
-// Load an image from any supported format:
+// Load an image from any supported format. The file is decoded in its own channel count and
+// converted directly into the target pixel type. Greyscale values are rec.709 luminance:
 void    loadImage_(Ustring const & fname,ImgC4UC & img);
 void    loadImage_(Ustring const & fname,ImgF & img);
 void    loadImage_(Ustring const & fname,ImgUC & img);
 
+// As above but decoded directly into caller-owned rows (eg. a region of a larger image or a
+// mapped buffer), one per image row, each with room for 'width' pixels.
+// Throws if the image dimensions do not match 'width' and 'rows.size()':
+void    loadImageRows(Ustring const & fname,uint width,Svec<RgbaUC*> const & rows);
+void    loadImageRows(Ustring const & fname,uint width,Svec<uchar*> const & rows);
+void    loadImageRows(Ustring const & fname,uint width,Svec<float*> const & rows);
+
+struct  ImgFileInfo
+{
+    Vec2UI          dims;
+    uint            channels;       // 1: grey, 2: grey alpha, 3: RGB, 4: RGBA
+};
+
+// Reads only the file header without decoding. Returns invalid if the file cannot be opened
+// or is not a supported format:
+Opt<ImgFileInfo>
+probeImage(Ustring const & fname);
+
 ImgC4UC
 loadImage(Ustring const & fname);
 
+// As above but queued for concurrent loading. The memory estimate is the decoded size given by
+// 'probeImage':
+AsyncResult<ImgC4UC>
+loadImageAsync(AsyncLoader & loader,Ustring const & fname);
+
 // Save an image to any supported format:
 void
 saveImage(Ustring const & fname,ImgC4UC const & img);
@@ -75,9 +101,22 @@ imgEncodeJpeg(uint wid,uint hgt,uchar const * data,int quality);
 Uchars
 imgEncodeJpeg(ImgC4UC const & img,int quality=100);
 
-// Decode from JFIF format blob (can be read from JFIF format .jpg file):
+// Decode from JFIF format blob (can be read from JFIF format .jpg file).
+// If 'minDims' is non-zero, the image is decoded at the smallest DCT scale (1/8, 1/4, 1/2 or 1)
+// whose dimensions are at least 'minDims', which is much faster for thumbnails and previews:
+ImgC4UC
+imgDecodeJpeg(Uchars const & jfifBlob,Vec2UI minDims=Vec2UI(0));
+
+// As above directly from a JFIF file:
 ImgC4UC
-imgDecodeJpeg(Uchars const & jfifBlob);
+loadJpeg(Ustring const & fname,Vec2UI minDims=Vec2UI(0));
+
+AsyncResult<ImgC4UC>
+loadJpegAsync(AsyncLoader &,Ustring const & fname,Vec2UI minDims=Vec2UI(0));
+
+// Decodes all files concurrently:
+ImgC4UCs
+loadJpegs(Ustrings const & fnames,Vec2UI minDims=Vec2UI(0));
 
 }
 
@@ -9,6 +9,8 @@
 #include "FgImageIo.hpp"
 #include "FgFileSystem.hpp"
 #include "FgStdio.hpp"
+#include "FgCommand.hpp"
+#include "FgMemory.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -19,30 +21,166 @@ using namespace std;
 
 namespace Fg {
 
-struct  StbiFree
+namespace {
+
+// Decoded in the file's own channel count so that STB does not make a second converted copy;
+// conversion to the target pixel type is then done directly into the target storage:
+struct  StbImg
 {
-    uchar       *data;
-    StbiFree(uchar * d) : data(d) {}
-    ~StbiFree() {stbi_image_free(data); }
+    uchar *         data = nullptr;
+    Vec2UI          dims;
+    uint            channels = 0;       // 1: grey, 2: grey alpha, 3: RGB, 4: RGBA
+
+    explicit
+    StbImg(Ustring const & fname)
+    {
+        int                 width,height,chans;
+        FILE *              fPtr = openFile(fname,false);     // Throws if unable to open
+        FGASSERT(fPtr);
+        data = stbi_load_from_file(fPtr,&width,&height,&chans,0);   // Can't throw
+        fclose(fPtr);
+        if (data == nullptr) {
+            string          reason(stbi__g_failure_reason);
+            fgThrow("Unable to decode image",reason,fname.m_str);
+        }
+        if ((width*height <= 0) || (chans < 1) || (chans > 4)) {
+            stbi_image_free(data);
+            fgThrow("Invalid image dimensions or channels",Vec3I(width,height,chans));
+        }
+        dims = Vec2UI(width,height);
+        channels = uint(chans);
+    }
+
+    ~StbImg() {stbi_image_free(data); }
+
+    StbImg(StbImg const &) = delete;
+    StbImg & operator=(StbImg const &) = delete;
 };
 
+// Channel expansion identical to STB's own conversion to 4 channels:
+template<uint C> RgbaUC toRgba(uchar const * p);
+template<> inline RgbaUC toRgba<1>(uchar const * p) {return RgbaUC(p[0],p[0],p[0],255); }
+template<> inline RgbaUC toRgba<2>(uchar const * p) {return RgbaUC(p[0],p[0],p[0],p[1]); }
+template<> inline RgbaUC toRgba<3>(uchar const * p) {return RgbaUC(p[0],p[1],p[2],255); }
+template<> inline RgbaUC toRgba<4>(uchar const * p) {return RgbaUC(p[0],p[1],p[2],p[3]); }
+
+// Rec.709 luminance in integer arithmetic so results don't depend on floating point optimization
+// (which can truncate an exact grey value to one less) and grey is returned unchanged:
+inline uchar
+toGrey(RgbaUC const & in)
+{return uchar((213U*in.red() + 715U*in.green() + 72U*in.blue()) / 1000U); }
+
+inline void convPixel(RgbaUC const & in,RgbaUC & out) {out = in; }
+inline void convPixel(RgbaUC const & in,uchar & out) {out = toGrey(in); }
+inline void convPixel(RgbaUC const & in,float & out) {out = toGrey(in); }
+
+template<uint C,class T>
+void
+convRows(StbImg const & src,Svec<T*> const & rows)
+{
+    size_t              rowSize = size_t(src.dims[0]) * C;
+    for (size_t yy=0; yy<rows.size(); ++yy) {
+        uchar const *       srcPtr = src.data + yy*rowSize;
+        T *                 dstPtr = rows[yy];
+        for (uint xx=0; xx<src.dims[0]; ++xx)
+            convPixel(toRgba<C>(srcPtr+xx*C),dstPtr[xx]);
+    }
+}
+
+template<>
+void
+convRows<4,RgbaUC>(StbImg const & src,Svec<RgbaUC*> const & rows)
+{
+    size_t              rowSize = size_t(src.dims[0]) * 4;
+    for (size_t yy=0; yy<rows.size(); ++yy)
+        memcpy(static_cast<void*>(rows[yy]),src.data+yy*rowSize,rowSize);
+}
+
+template<class T>
+void
+writeRows(StbImg const & src,Svec<T*> const & rows)
+{
+    FGASSERT(rows.size() == src.dims[1]);
+    if (src.channels == 1)
+        convRows<1>(src,rows);
+    else if (src.channels == 2)
+        convRows<2>(src,rows);
+    else if (src.channels == 3)
+        convRows<3>(src,rows);
+    else
+        convRows<4>(src,rows);
+}
+
+template<class T>
+Svec<T*>
+imgRows(Img<T> & img)
+{
+    Svec<T*>            ret; ret.reserve(img.height());
+    for (uint yy=0; yy<img.height(); ++yy)
+        ret.push_back(img.rowPtr(yy));
+    return ret;
+}
+
+template<class T>
+void
+loadImg(Ustring const & fname,Img<T> & img)
+{
+    MemTagScope         mts(MemTag::image);
+    StbImg              src(fname);
+    img.resize(src.dims);
+    writeRows(src,imgRows(img));
+}
+
+template<class T>
+void
+loadRows(Ustring const & fname,uint width,Svec<T*> const & rows)
+{
+    StbImg              src(fname);
+    if ((src.dims[0] != width) || (src.dims[1] != rows.size()))
+        fgThrow("Image dimensions do not match target rows",fname.m_str,toStr(src.dims));
+    writeRows(src,rows);
+}
+
+}
+
 void
 loadImage_(Ustring const & fname,ImgC4UC & img)
+{loadImg(fname,img); }
+
+void
+loadImage_(Ustring const & fname,ImgUC & img)
+{loadImg(fname,img); }
+
+void
+loadImage_(Ustring const & fname,ImgF & img)
+{loadImg(fname,img); }
+
+void
+loadImageRows(Ustring const & fname,uint width,Svec<RgbaUC*> const & rows)
+{loadRows(fname,width,rows); }
+
+void
+loadImageRows(Ustring const & fname,uint width,Svec<uchar*> const & rows)
+{loadRows(fname,width,rows); }
+
+void
+loadImageRows(Ustring const & fname,uint width,Svec<float*> const & rows)
+{loadRows(fname,width,rows); }
+
+Opt<ImgFileInfo>
+probeImage(Ustring const & fname)
 {
-    int                 width,height,channels;
-    uchar *             data = nullptr;
-    FILE *              fPtr = openFile(fname,false);     // Throws if unable to open
+    Opt<ImgFileInfo>    ret;
+    FILE *              fPtr = nullptr;
+    try {fPtr = openFile(fname,false); }
+    catch (FgException const &) {return ret; }
     FGASSERT(fPtr);
-    data = stbi_load_from_file(fPtr,&width,&height,&channels,4);    // request 4 channels. Can't throw.
+    int                 width,height,chans;
+    int                 ok = stbi_info_from_file(fPtr,&width,&height,&chans);   // Reads header only
     fclose(fPtr);
-    if (data == nullptr) {
-        string          reason(stbi__g_failure_reason);
-        fgThrow("Unable to decode image",reason,fname.m_str);
-    }
-    StbiFree            sf(data);           // Can't use ScopeGuard since 'stbi_image_free' is extern C
-    if (width*height <= 0)
-        fgThrow("Invalid image dimensions",Vec2I(width,height));
-    img = ImgC4UC{Vec2UI(width,height),reinterpret_cast<RgbaUC*>(data)};
+    if ((ok != 0) && (width > 0) && (height > 0))
+        ret = ImgFileInfo {Vec2UI(width,height),uint(chans)};
+    return ret;
 }
 
 ImgC4UC
@@ -110,4 +248,113 @@ saveJfif(ImgC4UC const & img,Ustring const & fname,uint quality)
         fgThrow("STB JFIF image write error",fname);
 }
 
+namespace {
+
+// The previous implementation, using STB's own conversion to RGBA followed by a copy:
+ImgC4UC
+loadImageRef(Ustring const & fname)
+{
+    int                 width,height,channels;
+    uchar *             data = stbi_load(fname.m_str.c_str(),&width,&height,&channels,4);
+    FGASSERT(data != nullptr);
+    ImgC4UC             ret {Vec2UI(width,height),reinterpret_cast<RgbaUC*>(data)};
+    stbi_image_free(data);
+    return ret;
+}
+
+void
+saveStb(String const & fname,Vec2UI dims,int channels,uchar const * data)
+{
+    Ofstream            ofs {fname};
+    int                 wid = int(dims[0]),
+                        hgt = int(dims[1]),
+                        ret = 0;
+    Path                path {fname};
+    if (path.ext == "png")
+        ret = stbi_write_png_to_func(writeToFile,&ofs,wid,hgt,channels,data,wid*channels);
+    else if (path.ext == "tga")
+        ret = stbi_write_tga_to_func(writeToFile,&ofs,wid,hgt,channels,data);
+    else if (path.ext == "bmp")
+        ret = stbi_write_bmp_to_func(writeToFile,&ofs,wid,hgt,channels,data);
+    else
+        ret = stbi_write_jpg_to_func(writeToFile,&ofs,wid,hgt,channels,data,90);
+    FGASSERT(ret != 0);
+}
+
+template<class T>
+void
+testRows(Ustring const & fname,Img<T> const & ref,T marker)
+{
+    Vec2UI              off(5,3);
+    Img<T>              canvas(ref.dims()+Vec2UI(11,7),marker);
+    Svec<T*>            rows;
+    for (uint yy=0; yy<ref.height(); ++yy)
+        rows.push_back(&canvas.xy(off[0],off[1]+yy));
+    loadImageRows(fname,ref.width(),rows);
+    for (Iter2UI it(canvas.dims()); it.valid(); it.next()) {
+        Vec2UI              crd = it();
+        if ((crd[0] >= off[0]) && (crd[1] >= off[1]) && (crd[0] < off[0]+ref.width()) && (crd[1] < off[1]+ref.height()))
+            FGASSERT(canvas[crd] == ref[crd-off]);
+        else
+            FGASSERT(canvas[crd] == marker);
+    }
+    bool                threw = false;
+    try {loadImageRows(fname,ref.width()+1,rows); }
+    catch (FgException const &) {threw = true; }
+    FGASSERT(threw);
+}
+
+}
+
+void
+testImgDecode(CLArgs const & args)
+{
+    FGTESTDIR
+    Vec2UI              dims(67,43);
+    Uchars              pixels(dims[0]*dims[1]*4);
+    for (size_t ii=0; ii<pixels.size(); ++ii)
+        pixels[ii] = uchar((ii*7 + (ii/97)*13) % 256);
+    // Direct decodes must match the previous RGBA conversion path for all channel counts and formats:
+    for (int channels=1; channels<=4; ++channels) {
+        for (String ext : Strings{"png","tga","bmp","jpg"}) {
+            Ustring             fname = "decode" + toStr(channels) + "." + ext;
+            saveStb(fname.m_str,dims,channels,pixels.data());
+            int                 wid,hgt,fileChannels;
+            uchar *             data = stbi_load(fname.m_str.c_str(),&wid,&hgt,&fileChannels,0);
+            FGASSERT(data != nullptr);
+            stbi_image_free(data);
+            Opt<ImgFileInfo>    info = probeImage(fname);
+            FGASSERT(info.valid());
+            FGASSERT(info.val().dims == dims);
+            FGASSERT(info.val().channels == uint(fileChannels));
+            ImgC4UC             ref = loadImageRef(fname);
+            ImgC4UC             imgC;
+            ImgUC               imgUC;
+            ImgF                imgF;
+            loadImage_(fname,imgC);
+            loadImage_(fname,imgUC);
+            loadImage_(fname,imgF);
+            FGASSERT(imgC == ref);
+            // Grey must be exact, otherwise within rounding of the floating point conversion:
+            for (size_t ii=0; ii<ref.numPixels(); ++ii) {
+                RgbaUC              p = ref.m_data[ii];
+                int                 grey = imgUC.m_data[ii];
+                if ((p.red() == p.green()) && (p.red() == p.blue()))
+                    FGASSERT(grey == p.red());
+                else
+                    FGASSERT(std::abs(grey - int(p.rec709())) <= 1);
+                FGASSERT(imgF.m_data[ii] == float(grey));
+            }
+            ImgUC               refUC = imgUC;
+            ImgF                refF = imgF;
+            testRows(fname,ref,RgbaUC(1,2,3,4));
+            testRows(fname,refUC,uchar(7));
+            testRows(fname,refF,-1.0f);
+        }
+    }
+    FGASSERT(!probeImage("nonexistent.png").valid());
+    saveRaw("not an image","notImage.png");
+    FGASSERT(!probeImage("notImage.png").valid());
+}
+
 }
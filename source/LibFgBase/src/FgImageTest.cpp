@@ -85,6 +85,31 @@ testConvolve(CLArgs const &)
     FGASSERT(isApproxEqualRelMag(i0.m_data,i1.m_data));
 }
 
+void
+testMipSample(CLArgs const &)
+{
+    // 1-pixel checkerboard; the mean of any minified footprint should be mid-grey:
+    ImgC4UC         chk(64,64);
+    for (Iter2UI it(chk.dims()); it.valid(); it.next())
+        chk[it()] = ((it()[0] + it()[1]) % 2 == 0) ? RgbaUC(0,0,0,255) : RgbaUC(255,255,255,255);
+    ImgC4UCs        mip = cMipMap(chk);
+    Vec2F           pos(0.37f,0.61f),
+                    zero(0);
+    // Magnified: all filters reduce to bilinear on the base level:
+    RgbaF           b = RgbaF(sampleClipIucs(chk,pos));
+    FGASSERT(isApproxEqual(sampleMipIucs(mip,pos,zero,zero,TexFilter::trilinear).red(),b.red(),1.0f));
+    // Minified isotropically by 8x:
+    Vec2F           dx(8.0f/64.0f,0),
+                    dy(0,8.0f/64.0f);
+    for (TexFilter f : {TexFilter::trilinear,TexFilter::anisotropic})
+        FGASSERT(isApproxEqual(sampleMipIucs(mip,pos,dx,dy,f).red(),127.5f,2.0f));
+    // Minified anisotropically, 16x along one axis only. Trilinear over-blurs but still averages;
+    // anisotropic averages multiple samples at a finer level:
+    Vec2F           dxa(16.0f/64.0f,0),
+                    dya(0,1.0f/64.0f);
+    FGASSERT(isApproxEqual(sampleMipIucs(mip,pos,dxa,dya,TexFilter::anisotropic).red(),127.5f,2.0f));
+}
+
 }
 
 void
@@ -98,6 +123,9 @@ fgImageTestm(CLArgs const & args)
 }
 
 void    fgImgTestWrite(CLArgs const &);
+void    testJpeg(CLArgs const &);
+void    testImgTiled(CLArgs const &);
+void    testImgDecode(CLArgs const &);
 
 void
 fgImageTest(CLArgs const & args)
@@ -105,7 +133,11 @@ fgImageTest(CLArgs const & args)
     Cmds       cmds;
     cmds.push_back(Cmd(composite,"composite"));
     cmds.push_back(Cmd(testConvolve,"conv"));
+    cmds.push_back(Cmd(testMipSample,"mip","Mip-mapped texture sampling"));
     cmds.push_back(Cmd(fgImgTestWrite,"write"));
+    cmds.push_back(Cmd(testImgTiled,"tiled","Out-of-core tiled image operations match in-core"));
+    cmds.push_back(Cmd(testImgDecode,"decode","Direct decode into each pixel type, row targets and header probe"));
+    cmds.push_back(Cmd(testJpeg,"jpeg","JPEG fast paths match IJG, scaled and concurrent decode"));
     doMenu(args,cmds,true,false,true);
 }
 
@@ -0,0 +1,525 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+
+#include "stdafx.h"
+
+#include "FgImageTiled.hpp"
+#include "FgFileSystem.hpp"
+#include "FgParallel.hpp"
+#include "FgCommand.hpp"
+#include "FgRandom.hpp"
+#include "FgImageIo.hpp"
+#include <list>
+
+using namespace std;
+
+namespace Fg {
+
+struct  ImgTiledCache
+{
+    struct  Entry
+    {
+        Sptr<ImgC4UC>           img;                // Null when not resident
+        size_t                  pins = 0;
+        bool                    dirty = false;      // Modified since last written to the spill file
+        bool                    spilled = false;    // The spill file holds a copy
+        bool                    inLru = false;      // Resident and unpinned
+        bool                    busy = false;       // Being read from or written to the spill file
+        list<size_t>::iterator  lruIt;
+    };
+    // A tile removed from the cache which must be written to the spill file:
+    struct  Evicted
+    {
+        size_t                  idx;
+        Sptr<ImgC4UC>           img;
+    };
+    Vec2UI                  numTiles;
+    RgbaUC                  fill;
+    size_t                  budget;
+    size_t                  slotBytes;              // Spill file space per tile
+    mutex                   mtx;                    // Protects all of the below except the spill file
+    condition_variable      cv;                     // Signalled when an entry is no longer busy
+    Svec<Entry>             entries;                // By linear tile index
+    list<size_t>            lru;                    // Least recently used at front
+    size_t                  used = 0;
+    // Spill file I/O is done without holding 'mtx' so that resident tiles remain accessible:
+    mutex                   spillMtx;               // Protects the members below
+    boost::filesystem::path spillPath;
+    fstream                 spill;
+    size_t                  numSpilled = 0;
+    size_t                  numReloaded = 0;
+
+    ImgTiledCache(Vec2UI nt,uint tileSize,RgbaUC f,size_t b) :
+        numTiles(nt), fill(f), budget(b), slotBytes(size_t(tileSize)*tileSize*sizeof(RgbaUC)),
+        entries(size_t(nt[0])*nt[1])
+    {}
+
+    ~ImgTiledCache()
+    {
+        if (spill.is_open()) {
+            spill.close();
+            boost::system::error_code   ec;
+            boost::filesystem::remove(spillPath,ec);
+        }
+    }
+
+    void
+    writeSpill(size_t idx,ImgC4UC const & img)
+    {
+        lock_guard<mutex>   lock(spillMtx);
+        if (!spill.is_open()) {
+            spillPath = boost::filesystem::temp_directory_path() /
+                boost::filesystem::unique_path("fgtiles-%%%%-%%%%-%%%%-%%%%.tmp");
+            spill.open(spillPath.c_str(),ios::in | ios::out | ios::binary | ios::trunc);
+            if (!spill.is_open())
+                fgThrow("Unable to create tile spill file",spillPath.string());
+        }
+        spill.seekp(streamoff(idx*slotBytes));
+        spill.write(reinterpret_cast<char const *>(img.data()),streamsize(img.numPixels()*sizeof(RgbaUC)));
+        if (!spill)
+            fgThrow("Tile spill file write failed",spillPath.string());
+        ++numSpilled;
+    }
+
+    void
+    readSpill(size_t idx,ImgC4UC & img)
+    {
+        lock_guard<mutex>   lock(spillMtx);
+        spill.seekg(streamoff(idx*slotBytes));
+        spill.read(reinterpret_cast<char *>(img.data()),streamsize(img.numPixels()*sizeof(RgbaUC)));
+        if (!spill)
+            fgThrow("Tile spill file read failed",spillPath.string());
+        ++numReloaded;
+    }
+
+    // Remove least recently used unpinned tiles until 'extra' more bytes fit within the budget.
+    // Modified tiles are returned (and marked busy) to be written to the spill file by the caller.
+    // Must be called with 'mtx' locked:
+    Svec<Evicted>
+    evict(size_t extra)
+    {
+        Svec<Evicted>       ret;
+        while ((used + extra > budget) && !lru.empty()) {
+            size_t          idx = lru.front();
+            Entry &         e = entries[idx];
+            if (e.dirty) {
+                ret.push_back({idx,e.img});
+                e.busy = true;
+                e.dirty = false;
+            }
+            lru.pop_front();
+            e.inLru = false;
+            used -= e.img->numPixels() * sizeof(RgbaUC);
+            e.img.reset();
+        }
+        return ret;
+    }
+
+    // Loads the tile if it is not resident. If 'overwrite' the caller will replace every pixel so the
+    // previous contents need not be loaded:
+    ImgC4UC &
+    pin(Vec2UI tileIdx,Vec2UI dims,bool modify,bool overwrite)
+    {
+        unique_lock<mutex>  lock(mtx);
+        size_t              idx = tileIdx[1] * numTiles[0] + tileIdx[0];
+        Entry &             e = entries[idx];
+        cv.wait(lock,[&]{return !e.busy; });
+        if (!e.img) {
+            // Reserve the entry then do any spill file I/O without holding the lock:
+            size_t              bytes = size_t(dims[0]) * dims[1] * sizeof(RgbaUC);
+            Svec<Evicted>       evicted = evict(bytes);
+            Sptr<ImgC4UC>       img = make_shared<ImgC4UC>(dims);
+            bool                reload = !overwrite && e.spilled;
+            e.img = img;
+            e.busy = true;
+            used += bytes;
+            lock.unlock();
+            size_t              numWritten = 0;
+            exception_ptr       failure;
+            try {
+                for (Evicted const & ev : evicted) {
+                    writeSpill(ev.idx,*ev.img);
+                    ++numWritten;
+                }
+                if (reload)
+                    readSpill(idx,*img);
+                else if (!overwrite)
+                    std::fill(img->m_data.begin(),img->m_data.end(),fill);
+            }
+            catch (...) {
+                failure = current_exception();
+            }
+            lock.lock();
+            for (size_t ii=0; ii<evicted.size(); ++ii) {
+                Entry &             ee = entries[evicted[ii].idx];
+                ee.busy = false;
+                if (ii < numWritten)
+                    ee.spilled = true;
+                else {                          // Not written so keep it resident
+                    ee.img = evicted[ii].img;
+                    ee.dirty = true;
+                    ee.lruIt = lru.insert(lru.begin(),evicted[ii].idx);
+                    ee.inLru = true;
+                    used += ee.img->numPixels() * sizeof(RgbaUC);
+                }
+            }
+            e.busy = false;
+            if (failure) {
+                e.img.reset();
+                used -= bytes;
+            }
+            cv.notify_all();
+            if (failure)
+                rethrow_exception(failure);
+        }
+        else if (e.inLru) {
+            lru.erase(e.lruIt);
+            e.inLru = false;
+        }
+        ++e.pins;
+        if (modify)
+            e.dirty = true;
+        return *e.img;
+    }
+
+    // Does not evict (and so cannot throw) since it is called from destructors. The cache may
+    // thus exceed its budget until the next 'pin':
+    void
+    unpin(Vec2UI tileIdx)
+    {
+        lock_guard<mutex>   lock(mtx);
+        size_t              idx = tileIdx[1] * numTiles[0] + tileIdx[0];
+        Entry &             e = entries[idx];
+        if (--e.pins == 0) {
+            e.lruIt = lru.insert(lru.end(),idx);
+            e.inLru = true;
+        }
+    }
+};
+
+namespace {
+
+// Keeps a tile resident for the lifetime of this object:
+struct  TilePin
+{
+    ImgTiledCache &     cache;
+    Vec2UI              idx;
+    ImgC4UC &           img;
+
+    TilePin(ImgTiledCache & c,Vec2UI i,Vec2UI dims,bool modify,bool overwrite=false) :
+        cache(c), idx(i), img(c.pin(i,dims,modify,overwrite))
+    {}
+    ~TilePin() {cache.unpin(idx); }
+};
+
+// Copies the overlap of 'src' (with origin at 'srcLo') and 'dst' (with origin at 'dstLo'):
+void
+copyOverlap(ImgC4UC const & src,Vec2UI srcLo,ImgC4UC & dst,Vec2UI dstLo)
+{
+    Vec2UI          lo = cMax(srcLo,dstLo),
+                    hi = cMin(srcLo+src.dims(),dstLo+dst.dims());
+    if ((hi[0] <= lo[0]) || (hi[1] <= lo[1]))
+        return;
+    size_t          rowLen = hi[0] - lo[0];
+    for (uint yy=lo[1]; yy<hi[1]; ++yy) {
+        RgbaUC const *  srcRow = &src.xy(lo[0]-srcLo[0],yy-srcLo[1]);
+        std::copy(srcRow,srcRow+rowLen,&dst.xy(lo[0]-dstLo[0],yy-dstLo[1]));
+    }
+}
+
+}
+
+ImgTiled::ImgTiled(Vec2UI dims,uint tileSize,RgbaUC fill,size_t cacheBytes) :
+    m_dims(dims), m_tileSize(tileSize)
+{
+    FGASSERT((tileSize > 0) && (tileSize % 2 == 0));
+    m_cache = make_shared<ImgTiledCache>(numTiles(),tileSize,fill,cacheBytes);
+}
+
+ImgTiled::~ImgTiled()
+{}
+
+Vec2UI
+ImgTiled::numTiles() const
+{
+    return (m_dims + Vec2UI(m_tileSize-1)) / m_tileSize;
+}
+
+Vec2UI
+ImgTiled::tileDims(Vec2UI tileIdx) const
+{
+    FGASSERT(tileIdx[0] < numTiles()[0] && tileIdx[1] < numTiles()[1]);
+    Vec2UI          lo = tileLo(tileIdx);
+    return cMin(Vec2UI(m_tileSize),m_dims-lo);
+}
+
+ImgC4UC
+ImgTiled::readTile(Vec2UI tileIdx) const
+{
+    TilePin         pin(*m_cache,tileIdx,tileDims(tileIdx),false);
+    return pin.img;
+}
+
+void
+ImgTiled::writeTile(Vec2UI tileIdx,ImgC4UC const & tile)
+{
+    FGASSERT(tile.dims() == tileDims(tileIdx));
+    TilePin         pin(*m_cache,tileIdx,tile.dims(),true,true);
+    pin.img = tile;
+}
+
+ImgC4UC
+ImgTiled::readRegion(Vec2UI lo,Vec2UI dims) const
+{
+    FGASSERT((lo[0]+dims[0] <= m_dims[0]) && (lo[1]+dims[1] <= m_dims[1]));
+    ImgC4UC         ret(dims);
+    if (ret.empty())
+        return ret;
+    Vec2UI          t0 = lo / m_tileSize,
+                    t1 = (lo + dims - Vec2UI(1)) / m_tileSize + Vec2UI(1);
+    for (uint ty=t0[1]; ty<t1[1]; ++ty) {
+        for (uint tx=t0[0]; tx<t1[0]; ++tx) {
+            Vec2UI          idx(tx,ty);
+            TilePin         pin(*m_cache,idx,tileDims(idx),false);
+            copyOverlap(pin.img,tileLo(idx),ret,lo);
+        }
+    }
+    return ret;
+}
+
+void
+ImgTiled::writeRegion(Vec2UI lo,ImgC4UC const & region)
+{
+    Vec2UI          dims = region.dims();
+    FGASSERT((lo[0]+dims[0] <= m_dims[0]) && (lo[1]+dims[1] <= m_dims[1]));
+    if (region.empty())
+        return;
+    Vec2UI          t0 = lo / m_tileSize,
+                    t1 = (lo + dims - Vec2UI(1)) / m_tileSize + Vec2UI(1);
+    for (uint ty=t0[1]; ty<t1[1]; ++ty) {
+        for (uint tx=t0[0]; tx<t1[0]; ++tx) {
+            Vec2UI          idx(tx,ty),
+                            tlo = tileLo(idx),
+                            tdims = tileDims(idx);
+            bool            covered = (lo[0] <= tlo[0]) && (lo[1] <= tlo[1]) &&
+                                      (lo[0]+dims[0] >= tlo[0]+tdims[0]) &&
+                                      (lo[1]+dims[1] >= tlo[1]+tdims[1]);
+            TilePin         pin(*m_cache,idx,tdims,true,covered);
+            copyOverlap(region,lo,pin.img,tlo);
+        }
+    }
+}
+
+void
+ImgTiled::forEachTile(function<void(Vec2UI,ImgC4UC &)> const & fn)
+{
+    Vec2UI          nt = numTiles();
+    parallelFor(size_t(nt[0])*nt[1],[&](size_t ii)
+    {
+        Vec2UI          idx(uint(ii % nt[0]),uint(ii / nt[0]));
+        TilePin         pin(*m_cache,idx,tileDims(idx),true);
+        fn(idx,pin.img);
+    });
+}
+
+size_t
+ImgTiled::numSpilled() const
+{
+    lock_guard<mutex>   lock(m_cache->spillMtx);
+    return m_cache->numSpilled;
+}
+
+size_t
+ImgTiled::numReloaded() const
+{
+    lock_guard<mutex>   lock(m_cache->spillMtx);
+    return m_cache->numReloaded;
+}
+
+Sptr<ImgTiled>
+toTiled(ImgC4UC const & img,uint tileSize,size_t cacheBytes)
+{
+    Sptr<ImgTiled>      ret = make_shared<ImgTiled>(img.dims(),tileSize,RgbaUC(0,0,0,0),cacheBytes);
+    ImgTiled &          tiled = *ret;
+    for (Iter2UI it(tiled.numTiles()); it.valid(); it.next()) {
+        ImgC4UC             tile(tiled.tileDims(it()));
+        copyOverlap(img,Vec2UI(0),tile,tiled.tileLo(it()));
+        tiled.writeTile(it(),tile);
+    }
+    return ret;
+}
+
+ImgC4UC
+toImg(ImgTiled const & img)
+{
+    return img.readRegion(Vec2UI(0),img.dims());
+}
+
+void
+imgShrink2(ImgTiled const & src,ImgTiled & dst)
+{
+    FGASSERT(cMinElem(src.dims()) > 0);
+    FGASSERT(dst.dims() == src.dims()/2);
+    dst.forEachTile([&](Vec2UI idx,ImgC4UC & tile)
+    {
+        ImgC4UC         srcRegion = src.readRegion(dst.tileLo(idx)*2,tile.dims()*2);
+        imgShrink2(srcRegion,tile);
+    });
+}
+
+void
+imgResize(ImgTiled const & src,ImgTiled & dst)
+{
+    FGASSERT((cMinElem(src.dims()) > 0) && (cMinElem(dst.dims()) > 0));
+    if (src.dims() == dst.dims()) {
+        dst.forEachTile([&](Vec2UI idx,ImgC4UC & tile)
+        {
+            tile = src.readRegion(dst.tileLo(idx),tile.dims());
+        });
+        return;
+    }
+    dst.forEachTile([&](Vec2UI idx,ImgC4UC & tile)
+    {
+        Vec2UI          lo = dst.tileLo(idx);
+        Mat22UI         bounds = imgResizeSrcBounds(src.dims(),dst.dims(),lo,tile.dims());
+        Vec2UI          srcLo(bounds.rc(0,0),bounds.rc(1,0)),
+                        srcHi(bounds.rc(0,1),bounds.rc(1,1));
+        ImgC4UC         srcRegion = src.readRegion(srcLo,srcHi-srcLo+Vec2UI(1));
+        imgResizeRegion(srcRegion,srcLo,src.dims(),dst.dims(),lo,tile);
+    });
+}
+
+void
+composite(ImgTiled const & foreground,ImgTiled & background)
+{
+    FGASSERT(foreground.dims() == background.dims());
+    background.forEachTile([&](Vec2UI idx,ImgC4UC & tile)
+    {
+        ImgC4UC         fg = foreground.readRegion(background.tileLo(idx),tile.dims());
+        for (size_t ii=0; ii<tile.numPixels(); ++ii)
+            tile[ii] = compositeFragmentUnweighted(fg[ii],tile[ii]);
+    });
+}
+
+Svec<Sptr<ImgTiled> >
+cMipMap(ImgTiled const & img,size_t cacheBytes)
+{
+    FGASSERT(isPow2(img.dims()));
+    Svec<Sptr<ImgTiled> >   ret;
+    size_t                  numLevels = log2Ceil(cMinElem(img.dims()));
+    ImgTiled const *        prev = &img;
+    for (size_t ll=1; ll<numLevels; ++ll) {
+        Sptr<ImgTiled>          level = make_shared<ImgTiled>(prev->dims()/2,img.tileSize(),RgbaUC(0,0,0,0),cacheBytes);
+        imgShrink2(*prev,*level);
+        ret.push_back(level);
+        prev = level.get();
+    }
+    return ret;
+}
+
+void
+testImgTiled(CLArgs const &)
+{
+    randSeedRepeatable();
+    ImgC4UC             mandrill = loadImage(dataDir()+"base/Mandrill512.png"),
+                        odd(333,217);
+    for (RgbaUC & p : odd.m_data)
+        p = RgbaUC(randUint(256),randUint(256),randUint(256),255);
+    // Cache only holds 4 tiles so nearly every operation goes through the spill file:
+    uint                ts = 64;
+    size_t              cache = 4 * ts * ts * sizeof(RgbaUC);
+    for (ImgC4UC const * imgPtr : {&mandrill,&odd}) {
+        ImgC4UC const &     img = *imgPtr;
+        Sptr<ImgTiled>      tiled = toTiled(img,ts,cache);
+        FGASSERT(toImg(*tiled) == img);
+        FGASSERT(tiled->numSpilled() > 0);
+        FGASSERT(tiled->numReloaded() > 0);
+        // Region read and write spanning several tiles:
+        Vec2UI              lo(37,51),
+                            dims(150,100);
+        ImgC4UC             region = tiled->readRegion(lo,dims),
+                            patch(dims);
+        for (Iter2UI it(dims); it.valid(); it.next()) {
+            FGASSERT(region[it()] == img[it()+lo]);
+            patch[it()] = RgbaUC(uchar(it()[0]),uchar(it()[1]),0,255);
+        }
+        tiled->writeRegion(lo,patch);
+        ImgC4UC             patched = img;
+        for (Iter2UI it(dims); it.valid(); it.next())
+            patched[it()+lo] = patch[it()];
+        FGASSERT(toImg(*tiled) == patched);
+        // Operations must give identical results to in-core:
+        ImgTiled            shrunk(img.dims()/2,ts,RgbaUC(0),cache);
+        imgShrink2(*tiled,shrunk);
+        FGASSERT(toImg(shrunk) == imgShrink2(patched));
+        for (Vec2UI rdims : {Vec2UI(200,150),Vec2UI(700,500),Vec2UI(41,23)}) {
+            ImgTiled            resized(rdims,ts,RgbaUC(0),cache);
+            imgResize(*tiled,resized);
+            ImgC4UC             ref(rdims);
+            imgResize(patched,ref);
+            FGASSERT(toImg(resized) == ref);
+        }
+        Sptr<ImgTiled>      bg = toTiled(img,ts,cache);
+        ImgC4UC             fg = patched;
+        for (RgbaUC & p : fg.m_data)                // Alpha-weighted half transparent
+            p = RgbaUC(p.red()/2,p.green()/2,p.blue()/2,128);
+        composite(*toTiled(fg,ts,cache),*bg);
+        FGASSERT(toImg(*bg) == fgComposite(fg,img));
+        // Parallel per-tile processing:
+        tiled->forEachTile([](Vec2UI,ImgC4UC & tile)
+        {
+            for (RgbaUC & p : tile.m_data)
+                p = RgbaUC(255-p.red(),255-p.green(),255-p.blue(),p.alpha());
+        });
+        ImgC4UC             inverted = toImg(*tiled);
+        for (size_t ii=0; ii<inverted.numPixels(); ++ii)
+            FGASSERT(inverted[ii].red() == 255-patched[ii].red());
+    }
+    // Mip map of power of 2 image:
+    Sptr<ImgTiled>          tiled = toTiled(mandrill,ts,cache);
+    Svec<Sptr<ImgTiled> >   mip = cMipMap(*tiled,cache);
+    ImgC4UCs                ref = cMipMap(mandrill);
+    FGASSERT(mip.size()+1 == ref.size());
+    for (size_t ll=0; ll<mip.size(); ++ll)
+        FGASSERT(toImg(*mip[ll]) == ref[ll+1]);
+    // Concurrent region reads and writes of disjoint columns, with tiles continually spilled and
+    // reloaded by other threads:
+    {
+        Sptr<ImgTiled>          shared = toTiled(mandrill,ts,cache);
+        ImgC4UC                 expected = mandrill;
+        uint                    numThreads = 4,
+                                colWid = mandrill.width() / numThreads;
+        Svec<thread>            threads;
+        for (uint tt=0; tt<numThreads; ++tt) {
+            threads.emplace_back([&,tt]()
+            {
+                for (uint yy=0; yy+ts<=mandrill.height(); yy+=ts/2) {
+                    Vec2UI              lo(tt*colWid,yy);
+                    ImgC4UC             region = shared->readRegion(lo,Vec2UI(colWid,ts));
+                    for (RgbaUC & p : region.m_data)
+                        p.alpha() = uchar(tt);
+                    shared->writeRegion(lo,region);
+                }
+            });
+        }
+        for (thread & t : threads)
+            t.join();
+        for (Iter2UI it(expected.dims()); it.valid(); it.next())
+            expected[it()].alpha() = uchar(it()[0] / colWid);
+        FGASSERT(toImg(*shared) == expected);
+    }
+    // Image larger than the cache by a factor of 16:
+    ImgC4UC                 big(2048,2048);
+    imgResize(mandrill,big);
+    Sptr<ImgTiled>          bigTiled = toTiled(big,256,size_t(1) << 22);
+    ImgTiled                bigShrunk(big.dims()/2,256,RgbaUC(0),size_t(1) << 22);
+    imgShrink2(*bigTiled,bigShrunk);
+    FGASSERT(toImg(bigShrunk) == imgShrink2(big));
+}
+
+}
+
+// */
@@ -0,0 +1,96 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Tiled, out-of-core RGBA image for textures too large to hold in memory (eg. UDIM atlases).
+//
+// The image is divided into square tiles (smaller along the right and bottom edges) which are
+// held in a memory cache of bounded size. When the cache is full the least recently used tile is
+// evicted, being written to a temporary spill file if it has been modified. Tiles which have never
+// been written read as the fill value. Member functions may be called concurrently as long as
+// concurrent writes do not overlap. Tiles currently in use by any thread are never evicted so the
+// cache can temporarily exceed its budget by that many.
+//
+// Iterate over tiles with 'Iter2UI(img.numTiles())', or use 'forEachTile' to process them in parallel.
+//
+
+#ifndef FGIMAGETILED_HPP
+#define FGIMAGETILED_HPP
+
+#include "FgImage.hpp"
+
+namespace Fg {
+
+struct  ImgTiledCache;
+
+struct  ImgTiled
+{
+    // 'tileSize' must be even so that 2x shrinking maps whole tiles:
+    ImgTiled(
+        Vec2UI              dims,
+        uint                tileSize=256,
+        RgbaUC              fill=RgbaUC(0,0,0,0),
+        size_t              cacheBytes=size_t(1) << 28);
+    ~ImgTiled();                        // Deletes the spill file if any
+
+    ImgTiled(ImgTiled const &) = delete;
+    void operator=(ImgTiled const &) = delete;
+
+    Vec2UI              dims() const {return m_dims; }
+    uint                tileSize() const {return m_tileSize; }
+    Vec2UI              numTiles() const;
+    Vec2UI              tileLo(Vec2UI tileIdx) const {return tileIdx * m_tileSize; }
+    Vec2UI              tileDims(Vec2UI tileIdx) const;
+
+    ImgC4UC             readTile(Vec2UI tileIdx) const;
+    void                writeTile(Vec2UI tileIdx,ImgC4UC const & tile);  // Must be of size 'tileDims'
+
+    // Region reads and writes may span any number of tiles but must lie within the image bounds:
+    ImgC4UC             readRegion(Vec2UI lo,Vec2UI dims) const;
+    void                writeRegion(Vec2UI lo,ImgC4UC const & region);
+
+    // Calls 'fn' with the index and (modifiable) image of each tile, in parallel over tiles:
+    void                forEachTile(std::function<void(Vec2UI,ImgC4UC &)> const & fn);
+
+    // Statistics for the lifetime of this object:
+    size_t              numSpilled() const;     // Tile writes to the spill file
+    size_t              numReloaded() const;    // Tile reads from the spill file
+
+private:
+    Vec2UI              m_dims;
+    uint                m_tileSize;
+    Sptr<ImgTiledCache> m_cache;
+};
+
+Sptr<ImgTiled>
+toTiled(ImgC4UC const & img,uint tileSize=256,size_t cacheBytes=size_t(1) << 28);
+
+ImgC4UC
+toImg(ImgTiled const & img);
+
+// Out-of-core versions of the operations in FgImage.hpp, with identical results. The destination
+// must already have the required dimensions:
+
+// As 'imgShrink2'. 'dst' must be of size src.dims()/2:
+void
+imgShrink2(ImgTiled const & src,ImgTiled & dst);
+
+// As 'imgResize':
+void
+imgResize(ImgTiled const & src,ImgTiled & dst);
+
+// As 'fgComposite' but the result replaces the background. Requires alpha-weighted colour values:
+void
+composite(ImgTiled const & foreground,ImgTiled & background);
+
+// Mip-map levels of an image with power of 2 dimensions down to minimum dimension 2 (as 'cMipMap'),
+// not including the original image. Each level uses the tile size and cache budget of the original:
+Svec<Sptr<ImgTiled> >
+cMipMap(ImgTiled const & img,size_t cacheBytes=size_t(1) << 28);
+
+}
+
+#endif
+
+// */
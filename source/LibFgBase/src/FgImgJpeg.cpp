@@ -4,6 +4,9 @@
 // see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
 //
 // Authors: Sohail Somani, Andrew Beatty
+//
+// For the common YCbCr 4:4:4 / 4:2:2 / 4:2:0 cases the IJG colour conversion and chroma resampling
+// are bypassed (raw data in/out) and done here with SSE2, giving results bit-identical to the IJG code.
 
 #include "stdafx.h"
 
@@ -12,7 +15,16 @@
 #include "FgStdStream.hpp"
 #include "FgException.hpp"
 #include "FgImage.hpp"
+#include "FgImageIo.hpp"
 #include "FgStdString.hpp"
+#include "FgFileSystem.hpp"
+#include "FgCommand.hpp"
+#include "FgMemory.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FG_JPEG_SSE2
+#include <emmintrin.h>
+#endif
 
 #ifdef _MSC_VER
 // _setjmp and C++ object destruction is non-portable.
@@ -53,10 +65,294 @@ using namespace std;
 
 namespace Fg {
 
-static
+namespace {
+
+inline uchar
+clampByte(int val)
+{return uchar(val < 0 ? 0 : (val > 255 ? 255 : val)); }
+
+// YCbCr to RGBA using the IJG fixed point (16 bit fraction) coefficients. The coefficients
+// 1.402, 1.772 and 0.71414 don't fit in 16 bits so are split into an integer and fractional part:
+//   R = Y + Cr + (0.402 Cr)
+//   G = Y - Cr + (-0.34414 Cb + 0.28586 Cr)
+//   B = Y + 2 Cb + (-0.228 Cb)
+void
+yccToRgba(uchar const * ys,uchar const * cbs,uchar const * crs,size_t num,uchar * rgba)
+{
+    size_t              ii = 0;
+#ifdef FG_JPEG_SSE2
+    __m128i             zero = _mm_setzero_si128(),
+                        c128 = _mm_set1_epi16(128),
+                        half = _mm_set1_epi32(1 << 15),
+                        alpha = _mm_set1_epi8(char(255)),
+                        kR = _mm_set1_epi32(26345),                             // Cr * 26345
+                        kG = _mm_set1_epi32((18734 << 16) | (-22554 & 0xFFFF)), // Cb * -22554 + Cr * 18734
+                        kB = _mm_set1_epi32(-14942 & 0xFFFF);                   // Cb * -14942
+    // Fixed point product(s) of interleaved 16 bit (Cb,Cr) pairs, rounded and shifted back to 16 bits:
+    auto                fix = [&](__m128i lo,__m128i hi,__m128i k)
+    {
+        return _mm_packs_epi32(
+            _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo,k),half),16),
+            _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi,k),half),16));
+    };
+    for (; ii+8<=num; ii+=8) {
+        __m128i         y = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(ys+ii)),zero),
+                        cb = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(cbs+ii)),zero),c128),
+                        cr = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(crs+ii)),zero),c128),
+                        crLo = _mm_unpacklo_epi16(cr,zero),
+                        crHi = _mm_unpackhi_epi16(cr,zero),
+                        cbcrLo = _mm_unpacklo_epi16(cb,cr),
+                        cbcrHi = _mm_unpackhi_epi16(cb,cr),
+                        r = _mm_add_epi16(_mm_add_epi16(y,cr),fix(crLo,crHi,kR)),
+                        g = _mm_add_epi16(_mm_sub_epi16(y,cr),fix(cbcrLo,cbcrHi,kG)),
+                        b = _mm_add_epi16(_mm_add_epi16(y,_mm_add_epi16(cb,cb)),fix(cbcrLo,cbcrHi,kB)),
+                        rg = _mm_unpacklo_epi8(_mm_packus_epi16(r,zero),_mm_packus_epi16(g,zero)),
+                        ba = _mm_unpacklo_epi8(_mm_packus_epi16(b,zero),alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(rgba+ii*4),_mm_unpacklo_epi16(rg,ba));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(rgba+ii*4+16),_mm_unpackhi_epi16(rg,ba));
+    }
+#endif
+    for (; ii<num; ++ii) {
+        int             y = ys[ii],
+                        cb = int(cbs[ii]) - 128,
+                        cr = int(crs[ii]) - 128;
+        uchar *         p = rgba + ii*4;
+        p[0] = clampByte(y + cr + ((26345*cr + 32768) >> 16));
+        p[1] = clampByte(y - cr + ((18734*cr - 22554*cb + 32768) >> 16));
+        p[2] = clampByte(y + 2*cb + ((-14942*cb + 32768) >> 16));
+        p[3] = 255;
+    }
+}
+
+// RGBA to YCbCr using the IJG fixed point coefficients. Coefficients that don't fit in a signed
+// 16 bit value are split across two products:
+//   Y  = 0.299 R + 0.587 G + 0.114 B
+//   Cb = -0.16874 R - 0.33126 G + 0.5 B + 128
+//   Cr = 0.5 R - 0.41869 G - 0.08131 B + 128
+void
+rgbaToYcc(uchar const * rgba,size_t num,uchar * ys,uchar * cbs,uchar * crs)
+{
+    size_t              ii = 0;
+#ifdef FG_JPEG_SSE2
+    auto                k2 = [](int lo,int hi) {return _mm_set1_epi32((hi << 16) | (lo & 0xFFFF)); };
+    __m128i             mask = _mm_set1_epi32(0xFF),
+                        yOff = _mm_set1_epi32(1 << 15),
+                        cOff = _mm_set1_epi32((128 << 16) + (1 << 15) - 1),
+                        kY0 = k2(19595,19235),      // R,G
+                        kY1 = k2(19235,7471),       // G,B
+                        kCb0 = k2(-11059,16384),    // R,B
+                        kCb1 = k2(-21709,16384),    // G,B
+                        kCr0 = k2(16384,-27439),    // R,G
+                        kCr1 = k2(16384,-5329);     // R,B
+    auto                chan = [&](__m128i p0,__m128i p1,int shift)
+    {
+        return _mm_packs_epi32(
+            _mm_and_si128(_mm_srli_epi32(p0,shift),mask),
+            _mm_and_si128(_mm_srli_epi32(p1,shift),mask));
+    };
+    auto                fix = [](__m128i a0,__m128i b0,__m128i k0,__m128i a1,__m128i b1,__m128i k1,__m128i off)
+    {
+        __m128i         lo = _mm_add_epi32(_mm_add_epi32(
+                            _mm_madd_epi16(_mm_unpacklo_epi16(a0,b0),k0),
+                            _mm_madd_epi16(_mm_unpacklo_epi16(a1,b1),k1)),off),
+                        hi = _mm_add_epi32(_mm_add_epi32(
+                            _mm_madd_epi16(_mm_unpackhi_epi16(a0,b0),k0),
+                            _mm_madd_epi16(_mm_unpackhi_epi16(a1,b1),k1)),off),
+                        v = _mm_packs_epi32(_mm_srai_epi32(lo,16),_mm_srai_epi32(hi,16));
+        return _mm_packus_epi16(v,v);
+    };
+    for (; ii+8<=num; ii+=8) {
+        __m128i         p0 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(rgba+ii*4)),
+                        p1 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(rgba+ii*4+16)),
+                        r = chan(p0,p1,0),
+                        g = chan(p0,p1,8),
+                        b = chan(p0,p1,16);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(ys+ii),fix(r,g,kY0,g,b,kY1,yOff));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(cbs+ii),fix(r,b,kCb0,g,b,kCb1,cOff));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(crs+ii),fix(r,g,kCr0,r,b,kCr1,cOff));
+    }
+#endif
+    for (; ii<num; ++ii) {
+        int             r = rgba[ii*4],
+                        g = rgba[ii*4+1],
+                        b = rgba[ii*4+2];
+        ys[ii] = uchar((19595*r + 38470*g + 7471*b + 32768) >> 16);
+        cbs[ii] = uchar((-11059*r - 21709*g + 32768*b + (128 << 16) + 32767) >> 16);
+        crs[ii] = uchar((32768*r - 27439*g - 5329*b + (128 << 16) + 32767) >> 16);
+    }
+}
+
+// IJG 'fancy' (triangle filter) 2x horizontal upsampling. 'in' must be readable over [-1,num+8)
+// with the edge values replicated at -1 and 'num'. 'out' must be writable for 2*num rounded up to 16:
+//   out[2i]   = (3 in[i] + in[i-1] + bias0) >> shift
+//   out[2i+1] = (3 in[i] + in[i+1] + bias1) >> shift
+void
+fancyUpsample2(short const * in,size_t num,short bias0,short bias1,int shift,uchar * out)
+{
+    size_t              ii = 0;
+#ifdef FG_JPEG_SSE2
+    __m128i             b0 = _mm_set1_epi16(bias0),
+                        b1 = _mm_set1_epi16(bias1),
+                        sh = _mm_cvtsi32_si128(shift);
+    for (; ii<num; ii+=8) {
+        __m128i         c = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in+ii)),
+                        l = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in+ii-1)),
+                        r = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in+ii+1)),
+                        c3 = _mm_add_epi16(_mm_add_epi16(c,c),c),
+                        even = _mm_sra_epi16(_mm_add_epi16(_mm_add_epi16(c3,l),b0),sh),
+                        odd = _mm_sra_epi16(_mm_add_epi16(_mm_add_epi16(c3,r),b1),sh);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out+2*ii),
+            _mm_packus_epi16(_mm_unpacklo_epi16(even,odd),_mm_unpackhi_epi16(even,odd)));
+    }
+#else
+    for (; ii<num; ++ii) {
+        int             c3 = in[ii]*3;
+        out[2*ii] = uchar((c3 + in[ii-1] + bias0) >> shift);
+        out[2*ii+1] = uchar((c3 + in[ii+1] + bias1) >> shift);
+    }
+#endif
+}
+
+// IJG 2x2 box downsampling with alternating rounding bias. 'r0' and 'r1' must have 2*num samples:
+void
+downsample2x2(uchar const * r0,uchar const * r1,size_t num,uchar * out)
+{
+    size_t              ii = 0;
+#ifdef FG_JPEG_SSE2
+    __m128i             zero = _mm_setzero_si128(),
+                        ones = _mm_set1_epi16(1),
+                        bias = _mm_set_epi16(2,1,2,1,2,1,2,1);
+    for (; ii+8<=num; ii+=8) {
+        __m128i         a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r0+2*ii)),
+                        b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r1+2*ii)),
+                        lo = _mm_add_epi16(_mm_unpacklo_epi8(a,zero),_mm_unpacklo_epi8(b,zero)),
+                        hi = _mm_add_epi16(_mm_unpackhi_epi8(a,zero),_mm_unpackhi_epi8(b,zero)),
+                        sums = _mm_packs_epi32(_mm_madd_epi16(lo,ones),_mm_madd_epi16(hi,ones)),
+                        v = _mm_srli_epi16(_mm_add_epi16(sums,bias),2);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out+ii),_mm_packus_epi16(v,v));
+    }
+#endif
+    for (; ii<num; ++ii)
+        out[ii] = uchar((r0[2*ii] + r0[2*ii+1] + r1[2*ii] + r1[2*ii+1] + 1 + (ii & 1)) >> 2);
+}
+
+enum struct ChromaUp {full, h2v1, h2v2};
+
+// A component plane as stored by the IJG raw data interface:
+struct  JpegPlane
+{
+    Uchars              data;
+    Svec<JSAMPROW>      rows;
+    size_t              stride = 0;
+    uint                width = 0;      // Valid samples per row
+    uint                height = 0;     // Valid rows
+
+    void
+    alloc(size_t strd,size_t numRows,uint wid,uint hgt)
+    {
+        data.resize(strd*numRows);
+        rows.resize(numRows);
+        stride = strd;
+        for (size_t rr=0; rr<numRows; ++rr)
+            rows[rr] = &data[rr*strd];
+        width = wid;
+        height = hgt;
+    }
+};
+
+// Returns true if the decompression can be done with raw data output followed by 'rawToRgba' with
+// results identical to the IJG colour conversion and 'fancy' upsampling:
+bool
+canDecodeRaw(jpeg_decompress_struct const & cinfo,ChromaUp & up)
+{
+    if ((cinfo.num_components != 3) || (cinfo.jpeg_color_space != JCS_YCbCr) || cinfo.CCIR601_sampling)
+        return false;
+    jpeg_component_info const * comps = cinfo.comp_info;
+    int                 hOut = cinfo.max_h_samp_factor,
+                        vOut = cinfo.max_v_samp_factor;
+    auto                hIn = [&](int ci) {return (comps[ci].h_samp_factor*comps[ci].DCT_scaled_size) / cinfo.min_DCT_scaled_size; };
+    auto                vIn = [&](int ci) {return (comps[ci].v_samp_factor*comps[ci].DCT_scaled_size) / cinfo.min_DCT_scaled_size; };
+    if ((hIn(0) != hOut) || (vIn(0) != vOut))
+        return false;
+    if ((hIn(1) != hIn(2)) || (vIn(1) != vIn(2)) || (comps[1].downsampled_width != comps[2].downsampled_width))
+        return false;
+    if ((hIn(1) == hOut) && (vIn(1) == vOut))
+        up = ChromaUp::full;
+    // IJG does not use fancy upsampling at 1/8 scale:
+    else if (cinfo.min_DCT_scaled_size < 2)
+        return false;
+    else if ((hIn(1)*2 == hOut) && (vIn(1) == vOut) && (comps[1].downsampled_width > 2))
+        up = ChromaUp::h2v1;
+    else if ((hIn(1)*2 == hOut) && (vIn(1)*2 == vOut) && (comps[1].downsampled_width > 2))
+        up = ChromaUp::h2v2;
+    else
+        return false;
+    return true;
+}
+
+void
+rawToRgba(JpegPlane const planes[3],ChromaUp up,ImgC4UC & img)
+{
+    uint                wid = img.width(),
+                        cw = planes[1].width;
+    Svec<short>         sums(cw+16);
+    Uchars              cbRow(2*cw+32),
+                        crRow(2*cw+32);
+    for (uint yy=0; yy<img.height(); ++yy) {
+        uchar const *       cb = planes[1].rows[yy];
+        uchar const *       cr = planes[2].rows[yy];
+        if (up != ChromaUp::full) {
+            for (size_t ci=1; ci<3; ++ci) {
+                JpegPlane const &   plane = planes[ci];
+                short *             s = &sums[1];
+                if (up == ChromaUp::h2v1) {
+                    uchar const *       in = plane.rows[yy];
+                    for (uint ii=0; ii<cw; ++ii)
+                        s[ii] = in[ii];
+                }
+                else {
+                    // Nearest chroma row and next nearest, with edge rows replicated:
+                    uint                r0 = yy/2,
+                                        r1 = (yy & 1) ? std::min(r0+1,plane.height-1) : (r0 > 0 ? r0-1 : 0);
+                    uchar const *       in0 = plane.rows[r0];
+                    uchar const *       in1 = plane.rows[r1];
+                    for (uint ii=0; ii<cw; ++ii)
+                        s[ii] = short(in0[ii]*3 + in1[ii]);
+                }
+                s[-1] = s[0];
+                s[cw] = s[cw-1];
+                uchar *             out = (ci == 1) ? cbRow.data() : crRow.data();
+                if (up == ChromaUp::h2v1)
+                    fancyUpsample2(s,cw,1,2,2,out);
+                else
+                    fancyUpsample2(s,cw,8,7,4,out);
+            }
+            cb = cbRow.data();
+            cr = crRow.data();
+        }
+        yccToRgba(planes[0].rows[yy],cb,cr,wid,reinterpret_cast<uchar*>(img.rowPtr(yy)));
+    }
+}
+
+// Largest IJG scaling denominator for which the decoded dimensions are no less than 'minDims':
+uint
+jpegScaleDenom(uint wid,uint hgt,Vec2UI minDims)
+{
+    if (minDims == Vec2UI(0))
+        return 1;
+    for (uint denom=8; denom>1; denom/=2)
+        if (((wid+denom-1)/denom >= minDims[0]) && ((hgt+denom-1)/denom >= minDims[1]))
+            return denom;
+    return 1;
+}
+
+// 'fast' selects the raw data paths (where possible) rather than IJG colour conversion / resampling:
 bool
-loadJpeg(
-    const Uchars &   jpgBuffer,
+decodeJpeg(
+    uchar const *       jpgData,
+    size_t              jpgSize,
+    Vec2UI              minDims,
+    bool                fast,
     ImgC4UC &           img)
 {
     jpeg_decompress_struct cinfo;
@@ -70,6 +366,9 @@ loadJpeg(
     Vec2UI           allocErrorSz;
 
     Uchars       buff;
+    JpegPlane           planes[3];
+    bool                raw = false;
+    ChromaUp            chromaUp = ChromaUp::full;
 
     switch(setjmp(jerr.setjmp_buffer))
     {
@@ -77,7 +376,7 @@ loadJpeg(
         {
             // DO NOT ALLOCATE ANY C++ OBJECTS HERE OR ELSE THERE COULD BE A MEMORY LEAK
             jpeg_create_decompress(&cinfo);
-            jpeg_mem_src(&cinfo,&jpgBuffer[0],jpgBuffer.size());
+            jpeg_mem_src(&cinfo,jpgData,jpgSize);
             jpeg_read_header(&cinfo,TRUE);
 
             // We need to do this because libjpeg does not do a very good job at guessing.
@@ -97,11 +396,28 @@ loadJpeg(
             }
             // We always want RGB out
             cinfo.out_color_space = JCS_RGB;
+            // DCT domain scaling:
+            cinfo.scale_num = 1;
+            cinfo.scale_denom = jpegScaleDenom(cinfo.image_width,cinfo.image_height,minDims);
+            jpeg_calc_output_dimensions(&cinfo);
+            raw = fast && canDecodeRaw(cinfo,chromaUp);
+            cinfo.raw_data_out = raw ? TRUE : FALSE;
             jpeg_start_decompress(&cinfo);
             // Must try-catch C++ allocations to avoid memory leaks here:
             try {
                 img.resize(cinfo.output_width,cinfo.output_height);
-                buff.resize(img.width()*3);
+                if (raw) {
+                    for (int ci=0; ci<3; ++ci) {
+                        jpeg_component_info const & comp = cinfo.comp_info[ci];
+                        planes[ci].alloc(
+                            comp.width_in_blocks * comp.DCT_scaled_size,
+                            cinfo.total_iMCU_rows * comp.v_samp_factor * comp.DCT_scaled_size,
+                            comp.downsampled_width,
+                            comp.downsampled_height);
+                    }
+                }
+                else
+                    buff.resize(img.width()*3);
             }
             catch(...)
             {
@@ -110,23 +426,34 @@ loadJpeg(
                 allocErrorSz = Vec2UI(cinfo.output_width,cinfo.output_height);
                 goto cleanup;
             }
-            uchar*              buffer = &buff[0];
-            uint                row = 0;
-            // Here we use the library's state variable cinfo.output_scanline as the
-            // loop counter, so that we don't have to keep track ourselves:
-            while (cinfo.output_scanline < cinfo.output_height) {
-                // jpeg_read_scanlines expects an array of pointers to scanlines.
-                // Here the array is only one element long, but you could ask for
-                // more than one scanline at a time if that's more convenient:
-                jpeg_read_scanlines(&cinfo,&buffer,1);
-                uchar         *ptr = buffer;
-                for (uint col=0; col<img.width(); col++) {
-                    img.xy(col,row).red() = *ptr++;
-                    img.xy(col,row).green() = *ptr++;
-                    img.xy(col,row).blue() = *ptr++;
-                    img.xy(col,row).alpha() = 255;
+            if (raw) {
+                JSAMPARRAY          rows[3];
+                for (JDIMENSION mm=0; mm<cinfo.total_iMCU_rows; ++mm) {
+                    for (int ci=0; ci<3; ++ci) {
+                        jpeg_component_info const & comp = cinfo.comp_info[ci];
+                        rows[ci] = &planes[ci].rows[mm * comp.v_samp_factor * comp.DCT_scaled_size];
+                    }
+                    jpeg_read_raw_data(&cinfo,rows,cinfo.max_v_samp_factor*cinfo.min_DCT_scaled_size);
+                }
+            }
+            else {
+                uchar*              buffer = &buff[0];
+                uint                row = 0;
+                // Here we use the library's state variable cinfo.output_scanline as the
+                // loop counter, so that we don't have to keep track ourselves:
+                while (cinfo.output_scanline < cinfo.output_height) {
+                    // jpeg_read_scanlines expects an array of pointers to scanlines.
+                    // Here the array is only one element long, but you could ask for
+                    // more than one scanline at a time if that's more convenient:
+                    jpeg_read_scanlines(&cinfo,&buffer,1);
+                    uchar const *       ptr = buffer;
+                    RgbaUC *            dst = img.rowPtr(row);
+                    for (uint col=0; col<img.width(); col++) {
+                        dst[col] = RgbaUC(ptr[0],ptr[1],ptr[2],255);
+                        ptr += 3;
+                    }
+                    row++;
                 }
-                row++;
             }
             jpeg_finish_decompress(&cinfo);
             goto ok;
@@ -149,17 +476,60 @@ cleanup:
     jpeg_destroy_decompress(&cinfo);
     if (allocError)
         fgThrow("Allocation error in loadJpeg for size: "+toStr(allocErrorSz));
+    if (succeeded && raw)
+        rawToRgba(planes,chromaUp,img);
     return succeeded;
 }
 
-static
+// Fill the raw data planes for default (4:2:0) sampling with edge replication identical to
+// the IJG preprocessing:
+void
+rgbaToRawPlanes(uint wid,uint hgt,uchar const * srcImg,JpegPlane planes[3])
+{
+    size_t              yStride = planes[0].stride,
+                        cStride = planes[1].stride,
+                        fullStride = 2*cStride;
+    Uchars              cb0(fullStride),cr0(fullStride),cb1(fullStride),cr1(fullStride);
+    auto                convertRow = [&](uint row,uchar * cb,uchar * cr)
+    {
+        uchar *             y = planes[0].rows[row];
+        rgbaToYcc(srcImg+size_t(row)*wid*4,wid,y,cb,cr);
+        std::fill(y+wid,y+yStride,y[wid-1]);
+        std::fill(cb+wid,cb+fullStride,cb[wid-1]);
+        std::fill(cr+wid,cr+fullStride,cr[wid-1]);
+    };
+    uint                cHgt = (hgt+1)/2;
+    for (uint kk=0; kk<cHgt; ++kk) {
+        uint                r0 = 2*kk,
+                            r1 = std::min(r0+1,hgt-1);
+        convertRow(r0,cb0.data(),cr0.data());
+        if (r1 != r0)
+            convertRow(r1,cb1.data(),cr1.data());
+        else {
+            cb1 = cb0;
+            cr1 = cr0;
+        }
+        downsample2x2(cb0.data(),cb1.data(),cStride,planes[1].rows[kk]);
+        downsample2x2(cr0.data(),cr1.data(),cStride,planes[2].rows[kk]);
+    }
+    for (size_t rr=hgt; rr<planes[0].rows.size(); ++rr)
+        std::copy_n(planes[0].rows[hgt-1],yStride,planes[0].rows[rr]);
+    for (size_t ci=1; ci<3; ++ci)
+        for (size_t rr=cHgt; rr<planes[ci].rows.size(); ++rr)
+            std::copy_n(planes[ci].rows[cHgt-1],cStride,planes[ci].rows[rr]);
+}
+
+enum struct JpegSampling {s420, s422, s444, s440, grey};
+
 bool
-saveJpeg(
+encodeJpeg(
     uint                    wid,
     uint                    hgt,
     const uchar *           srcImg,     // Must be RGBA of size wid*hgt*4
     vector<unsigned char> & jpgBuffer,
-    int                     quality)
+    int                     quality,
+    JpegSampling            sampling,
+    bool                    fast)       // Use raw data input when possible
 {
     jpeg_compress_struct cinfo;
     JSAMPROW row_pointer[1];
@@ -173,8 +543,11 @@ saveJpeg(
     jerr.pub.error_exit = fgIJGErrorExit;
 
     bool succeeded = false;
+    bool allocError = false;
+    bool raw = fast && (sampling == JpegSampling::s420);
 
-    Uchars img_buffer(wid*hgt*3);
+    Uchars img_buffer;
+    JpegPlane planes[3];
 
     switch(setjmp(jerr.setjmp_buffer))
     {
@@ -193,25 +566,65 @@ saveJpeg(
             jpeg_set_defaults(&cinfo);
 
             jpeg_set_quality(&cinfo,quality,TRUE /* limit to baseline range*/ );
-            jpeg_set_colorspace(&cinfo,JCS_YCbCr);
+            if (sampling == JpegSampling::grey)
+                jpeg_set_colorspace(&cinfo,JCS_GRAYSCALE);
+            else {
+                jpeg_set_colorspace(&cinfo,JCS_YCbCr);
+                if (sampling != JpegSampling::s420) {
+                    cinfo.comp_info[0].h_samp_factor = (sampling == JpegSampling::s422) ? 2 : 1;
+                    cinfo.comp_info[0].v_samp_factor = (sampling == JpegSampling::s440) ? 2 : 1;
+                }
+            }
+            cinfo.raw_data_in = raw ? TRUE : FALSE;
 
             jpeg_start_compress(&cinfo, TRUE);
 
-            for(uint yy=0; yy<hgt; yy++) {
-                const uchar *   srcPtr = srcImg + yy*wid*4;
-                size_t          dstOff = yy*wid*3;
-                for(uint xx=0; xx<wid; xx++) {
-                    img_buffer[dstOff+xx*3] = srcPtr[xx*4];
-                    img_buffer[dstOff+xx*3+1] = srcPtr[xx*4+1];
-                    img_buffer[dstOff+xx*3+2] = srcPtr[xx*4+2];
+            try {
+                if (raw) {
+                    for (int ci=0; ci<3; ++ci) {
+                        jpeg_component_info const & comp = cinfo.comp_info[ci];
+                        planes[ci].alloc(
+                            comp.width_in_blocks * DCTSIZE,
+                            cinfo.total_iMCU_rows * comp.v_samp_factor * DCTSIZE,
+                            comp.downsampled_width,
+                            comp.downsampled_height);
+                    }
+                    rgbaToRawPlanes(wid,hgt,srcImg,planes);
                 }
+                else
+                    img_buffer.resize(size_t(wid)*hgt*3);
             }
-
-            uint row_stride = wid * 3;
-            while(cinfo.next_scanline < cinfo.image_height)
+            catch(...)
             {
-                row_pointer[0] = &img_buffer[cinfo.next_scanline * row_stride];
-                jpeg_write_scanlines(&cinfo,row_pointer,1);
+                allocError = true;
+                goto failure;
+            }
+
+            if (raw) {
+                JSAMPARRAY          rows[3];
+                for (JDIMENSION mm=0; mm<cinfo.total_iMCU_rows; ++mm) {
+                    for (int ci=0; ci<3; ++ci)
+                        rows[ci] = &planes[ci].rows[mm * cinfo.comp_info[ci].v_samp_factor * DCTSIZE];
+                    jpeg_write_raw_data(&cinfo,rows,cinfo.max_v_samp_factor*DCTSIZE);
+                }
+            }
+            else {
+                for(uint yy=0; yy<hgt; yy++) {
+                    const uchar *   srcPtr = srcImg + size_t(yy)*wid*4;
+                    size_t          dstOff = size_t(yy)*wid*3;
+                    for(uint xx=0; xx<wid; xx++) {
+                        img_buffer[dstOff+xx*3] = srcPtr[xx*4];
+                        img_buffer[dstOff+xx*3+1] = srcPtr[xx*4+1];
+                        img_buffer[dstOff+xx*3+2] = srcPtr[xx*4+2];
+                    }
+                }
+
+                uint row_stride = wid * 3;
+                while(cinfo.next_scanline < cinfo.image_height)
+                {
+                    row_pointer[0] = &img_buffer[cinfo.next_scanline * row_stride];
+                    jpeg_write_scanlines(&cinfo,row_pointer,1);
+                }
             }
             jpeg_finish_compress(&cinfo);
             goto ok;
@@ -232,14 +645,18 @@ ok:
     goto cleanup;
 cleanup:
     jpeg_destroy_compress(&cinfo);
+    if (allocError)
+        fgThrow("Allocation error in saveJpeg for size: "+toStr(Vec2UI(wid,hgt)));
     return succeeded;
 }
 
+}
+
 Uchars
 imgEncodeJpeg(uint wid,uint hgt,const uchar * data,int quality)
 {
     Uchars       ret;
-    if(!saveJpeg(wid,hgt,data,ret,quality)) 
+    if(!encodeJpeg(wid,hgt,data,ret,quality,JpegSampling::s420,true))
         fgThrow("Could not encode as JPEG/JFIF");
     return ret;
 }
@@ -248,18 +665,120 @@ Uchars
 imgEncodeJpeg(ImgC4UC const & img,int quality)
 {
     Uchars       ret;
-    if(!saveJpeg(img.width(),img.height(),&img.m_data[0].m_c[0],ret,quality)) 
+    if(!encodeJpeg(img.width(),img.height(),&img.m_data[0].m_c[0],ret,quality,JpegSampling::s420,true))
         fgThrow("Could not encode as JPEG/JFIF");
     return ret;
 }
 
 ImgC4UC
-imgDecodeJpeg(Uchars const & data)
+imgDecodeJpeg(Uchars const & data,Vec2UI minDims)
 {
+    MemTagScope     mts(MemTag::image);
     ImgC4UC         ret;
-    if(!loadJpeg(data,ret))
+    if(data.empty() || !decodeJpeg(data.data(),data.size(),minDims,true,ret))
         fgThrow("Could not decode as JPEG/JFIF");
     return ret;
 }
 
+ImgC4UC
+loadJpeg(Ustring const & fname,Vec2UI minDims)
+{
+    MappedFile      file(fname);
+    ImgC4UC         ret;
+    if((file.size() == 0) || !decodeJpeg(file.data(),file.size(),minDims,true,ret))
+        fgThrow("Could not decode as JPEG/JFIF",fname);
+    return ret;
+}
+
+AsyncResult<ImgC4UC>
+loadJpegAsync(AsyncLoader & loader,Ustring const & fname,Vec2UI minDims)
+{
+    // Typical JFIF compression ratios are around 10:1 relative to RGB:
+    size_t          memEstimate = size_t(fileSizeOrZero(fname)) * 16;
+    return loader.submit<ImgC4UC>(memEstimate,[fname,minDims]{return loadJpeg(fname,minDims); });
+}
+
+ImgC4UCs
+loadJpegs(Ustrings const & fnames,Vec2UI minDims)
+{
+    AsyncLoader &               loader = asyncLoaderDefault();
+    Svec<AsyncResult<ImgC4UC> > loads;
+    for (Ustring const & fname : fnames)
+        loads.push_back(loadJpegAsync(loader,fname,minDims));
+    ImgC4UCs                    ret;
+    ret.reserve(loads.size());
+    for (AsyncResult<ImgC4UC> & load : loads)
+        ret.push_back(load.get());
+    return ret;
+}
+
+void
+testJpeg(CLArgs const & args)
+{
+    FGTESTDIR
+    // Smooth colour gradients with added texture so all DCT frequencies are exercised:
+    auto                makeImg = [](uint wid,uint hgt)
+    {
+        ImgC4UC             img(wid,hgt);
+        for (uint yy=0; yy<hgt; ++yy) {
+            for (uint xx=0; xx<wid; ++xx) {
+                uint                t = (xx*7 + yy*13 + ((xx*yy) % 17)*5) % 64;
+                img.xy(xx,yy) = RgbaUC(
+                    uchar((xx*255)/std::max(wid-1,1U)),
+                    uchar((yy*255)/std::max(hgt-1,1U)),
+                    uchar(255 - std::min(255U,t*4 + (xx+yy)/2)),
+                    255);
+            }
+        }
+        return img;
+    };
+    Svec<Vec2UI>        sizes {{1,1},{2,3},{5,2},{17,9},{64,48},{333,217}};
+    Svec<JpegSampling>  samplings {JpegSampling::s420,JpegSampling::s422,JpegSampling::s444,JpegSampling::s440,JpegSampling::grey};
+    for (Vec2UI sz : sizes) {
+        ImgC4UC             img = makeImg(sz[0],sz[1]);
+        uchar const *       data = &img.m_data[0].m_c[0];
+        // Raw data encode must be bit-identical to the IJG path:
+        Uchars              fast,ref;
+        FGASSERT(encodeJpeg(sz[0],sz[1],data,fast,90,JpegSampling::s420,true));
+        FGASSERT(encodeJpeg(sz[0],sz[1],data,ref,90,JpegSampling::s420,false));
+        FGASSERT(fast == ref);
+        // Raw data decode must be bit-identical to the IJG path for all samplings and scales:
+        for (JpegSampling sampling : samplings) {
+            Uchars              blob;
+            FGASSERT(encodeJpeg(sz[0],sz[1],data,blob,90,sampling,false));
+            for (uint denom=1; denom<=8; denom*=2) {
+                Vec2UI              minDims((sz[0]+denom-1)/denom,(sz[1]+denom-1)/denom);
+                ImgC4UC             fastImg,refImg;
+                FGASSERT(decodeJpeg(blob.data(),blob.size(),minDims,true,fastImg));
+                FGASSERT(decodeJpeg(blob.data(),blob.size(),minDims,false,refImg));
+                FGASSERT(fastImg.dims() == refImg.dims());
+                FGASSERT(fastImg.m_data == refImg.m_data);
+            }
+        }
+    }
+    // Scaled decode chooses the smallest size no smaller than requested:
+    {
+        Uchars              blob = imgEncodeJpeg(makeImg(333,217),90);
+        FGASSERT(imgDecodeJpeg(blob).dims() == Vec2UI(333,217));
+        FGASSERT(imgDecodeJpeg(blob,Vec2UI(40,0)).dims() == Vec2UI(42,28));
+        FGASSERT(imgDecodeJpeg(blob,Vec2UI(43,0)).dims() == Vec2UI(84,55));
+        FGASSERT(imgDecodeJpeg(blob,Vec2UI(0,200)).dims() == Vec2UI(333,217));
+    }
+    // Concurrent decode of many files matches serial:
+    {
+        ImgC4UC             img = makeImg(512,384);
+        Ustrings            fnames;
+        for (uint ii=0; ii<8; ++ii) {
+            Ustring             fname = "jpeg" + toStr(ii) + ".jpg";
+            Uchars              blob = imgEncodeJpeg(img,50+ii*5);
+            saveRaw(String(blob.begin(),blob.end()),fname);
+            fnames.push_back(fname);
+        }
+        ImgC4UCs            imgs = loadJpegs(fnames,Vec2UI(100,0));
+        for (size_t ii=0; ii<fnames.size(); ++ii)
+            FGASSERT(imgs[ii] == loadJpeg(fnames[ii],Vec2UI(100,0)));
+        FGASSERT(imgs[0].dims() == Vec2UI(128,96));
+    }
+}
+
 }
@@ -13,6 +13,8 @@
 #include "FgSyntax.hpp"
 #include "FgFileSystem.hpp"
 #include "FgTime.hpp"
+#include "FgProfile.hpp"
+#include "FgMemory.hpp"
 #include "FgGuiApiDialogs.hpp"
 
 using namespace std;
@@ -42,7 +44,9 @@ mainConsole(CmdFunc func,int argc,NativeUtfChar const * argv[])
     int         retval = 0;
     string      errStr;
     // Display caught errors in GUI dialog; useful when spawned without visible console by eg. Mercurial diffs:
-    bool        guiErr = false;
+    bool        guiErr = false,
+                profile = false,
+                memPeak = false;
     try
     {
         CLArgs          args;
@@ -54,12 +58,18 @@ mainConsole(CmdFunc func,int argc,NativeUtfChar const * argv[])
         }
         for (int ii=1; ii<argc; ++ii) {
             Ustring         tmp(argv[ii]);
-            if ((ii == 1) && (tmp == "-guiErr"))
+            if ((args.size() == 1) && (tmp == "-guiErr"))
                 guiErr = true;
+            else if ((args.size() == 1) && (tmp == "-profile"))
+                profile = true;
+            else if ((args.size() == 1) && (tmp == "-memPeak"))
+                memPeak = true;
             else
                 args.push_back(tmp.m_str);
         }
         s_mainArgs = args;
+        profileEnable(profile);
+        memTrackingEnable(memPeak);
         func(args);
     }
     catch(FgExceptionCommandSyntax const &)
@@ -95,6 +105,22 @@ mainConsole(CmdFunc func,int argc,NativeUtfChar const * argv[])
         errStr += "\nERROR (unknown type):";
         retval = -3;
     }
+    if (profile) {
+        profileEnable(false);
+        try {
+            fgout.setDefOut(true);
+            fgout << fgnl << profileSummary();
+            profileSaveTrace("fgProfileTrace.json");
+        }
+        catch (...) {
+            fgout << fgnl << "Unable to save profile trace";
+        }
+    }
+    if (memPeak) {
+        memTrackingEnable(false);
+        fgout.setDefOut(true);
+        fgout << fgnl << memPeakReport();
+    }
     if (!errStr.empty()) {
         // Don't use std::cout directly since errors need to be logged if logging is on:
         fgout.setDefOut(true);
@@ -29,6 +29,11 @@ typedef wchar_t NativeUtfChar;
 typedef char NativeUtfChar;
 #endif
 
+// Leading options handled here rather than passed on to 'func':
+// -guiErr      Display any error in a dialog
+// -profile     Enable the profiler (FgProfile.hpp) then output its summary and save its trace
+//              to 'fgProfileTrace.json' on exit
+// -memPeak     Enable allocation tracking (FgMemory.hpp) then output the peak memory summary on exit
 int
 mainConsole(CmdFunc func,int argc,const NativeUtfChar * argv[]);
 
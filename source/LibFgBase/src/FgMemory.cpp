@@ -0,0 +1,336 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+
+#include "stdafx.h"
+
+#include "FgMemory.hpp"
+#include "FgSystemInfo.hpp"
+#include "FgDiagnostics.hpp"
+#include "FgCommand.hpp"
+#include "FgImage.hpp"
+#include "Fg3dMesh.hpp"
+#include "FgDataflow.hpp"
+
+#if defined(FG_MEM_TRACKING) && defined(_WIN32)
+#error "FG_MEM_TRACKING is not supported on Windows"
+#endif
+
+using namespace std;
+
+namespace Fg {
+
+namespace {
+
+uint const              totalIdx = uint(MemTag::numTags);
+
+struct  Counters
+{
+    atomic<int64>       current {0};
+    atomic<int64>       peak {0};
+    atomic<uint64>      allocs {0};
+};
+
+// All constant initialized so usable by allocations during static initialization:
+atomic<bool>            g_enabled {false};
+Counters                g_counters[totalIdx+1];
+thread_local int64      t_net = 0;
+
+#ifdef FG_MEM_TRACKING
+
+thread_local uint       t_tag = 0;
+
+// The header preceding each block. 16 bytes to preserve the malloc alignment:
+struct  AllocHdr
+{
+    uint64              size;
+    uint32              tag;            // 'untracked' if allocated while tracking was disabled
+    uint32              pad;
+};
+static_assert(sizeof(AllocHdr) == 16,"AllocHdr must preserve malloc alignment");
+
+uint32 const            untracked = 0xFFFFFFFF;
+
+void
+raisePeak(atomic<int64> & peak,int64 val)
+{
+    int64               pk = peak.load(memory_order_relaxed);
+    while ((val > pk) && !peak.compare_exchange_weak(pk,val,memory_order_relaxed))
+        ;
+}
+
+void
+charge(uint tag,int64 bytes)
+{
+    Counters &          tc = g_counters[tag];
+    raisePeak(tc.peak,tc.current.fetch_add(bytes,memory_order_relaxed)+bytes);
+    tc.allocs.fetch_add(1,memory_order_relaxed);
+    Counters &          tot = g_counters[totalIdx];
+    raisePeak(tot.peak,tot.current.fetch_add(bytes,memory_order_relaxed)+bytes);
+    tot.allocs.fetch_add(1,memory_order_relaxed);
+    t_net += bytes;
+}
+
+void
+credit(uint tag,int64 bytes)
+{
+    g_counters[tag].current.fetch_sub(bytes,memory_order_relaxed);
+    g_counters[totalIdx].current.fetch_sub(bytes,memory_order_relaxed);
+    t_net -= bytes;
+}
+
+#endif
+
+}
+
+char const *
+memTagName(MemTag tag)
+{
+    static char const * names[] = {"other","mesh","image","gridIndex","dataflow","render"};
+    static_assert(sizeof(names)/sizeof(names[0]) == size_t(MemTag::numTags),"memTagName names");
+    FGASSERT(tag < MemTag::numTags);
+    return names[uint(tag)];
+}
+
+#ifdef FG_MEM_TRACKING
+
+MemTagScope::MemTagScope(MemTag tag) : m_prev(t_tag)
+{t_tag = uint(tag); }
+
+MemTagScope::~MemTagScope()
+{t_tag = m_prev; }
+
+#else
+
+MemTagScope::MemTagScope(MemTag) : m_prev(0) {}
+
+MemTagScope::~MemTagScope() {}
+
+#endif
+
+bool
+memTrackingAvailable()
+{
+#ifdef FG_MEM_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void
+memTrackingEnable(bool enable)
+{g_enabled.store(enable); }
+
+bool
+memTrackingEnabled()
+{return g_enabled.load(); }
+
+void
+memResetPeaks()
+{
+    for (Counters & c : g_counters)
+        c.peak.store(c.current.load());
+}
+
+MemStatss
+memStats()
+{
+    MemStatss           ret;
+    for (uint ii=0; ii<=totalIdx; ++ii) {
+        Counters const &    c = g_counters[ii];
+        String              name = (ii == totalIdx) ? "total" : memTagName(MemTag(ii));
+        ret.push_back(MemStats{name,c.current.load(),c.peak.load(),c.allocs.load()});
+    }
+    return ret;
+}
+
+int64
+memThreadNet()
+{return t_net; }
+
+String
+toStrBytes(uint64 bytes)
+{
+    char const *        units[] = {"B","KB","MB","GB","TB"};
+    double              val = double(bytes);
+    size_t              uu = 0;
+    while ((val >= 1024.0) && (uu < 4)) {
+        val /= 1024.0;
+        ++uu;
+    }
+    if (uu == 0)
+        return toStr(bytes) + " B";
+    return toStrFixed(val,2) + " " + units[uu];
+}
+
+String
+memPeakReport()
+{
+    ostringstream       oss;
+    if (memTrackingAvailable()) {
+        oss << left << setw(12) << "tag" << right << setw(14) << "current" << setw(14) << "peak"
+            << setw(14) << "allocs";
+        for (MemStats const & ms : memStats()) {
+            if (ms.allocs == 0)
+                continue;
+            oss << "\n" << left << setw(12) << ms.name << right
+                << setw(14) << toStrBytes(uint64(max(ms.current,int64(0))))
+                << setw(14) << toStrBytes(uint64(ms.peak)) << setw(14) << ms.allocs;
+        }
+        oss << "\n";
+    }
+    else
+        oss << "Allocation tracking not available (build with FG_MEM_TRACKING)\n";
+    oss << "Process peak resident memory: " << toStrBytes(processPeakMemory());
+    return oss.str();
+}
+
+void
+testMemory(CLArgs const &)
+{
+    // Footprints:
+    ImgC4UC             img(100,50);
+    FGASSERT(memoryFootprint(img) == sizeof(img) + 100*50*4);
+    Mesh                mesh {Vec3Fs(300),Vec3UIs(200)};
+    mesh.deltaMorphs.push_back(Morph("m",Vec3Fs(300)));
+    size_t              meshBytes = memoryFootprint(mesh);
+    FGASSERT(meshBytes >= sizeof(Mesh) + 2*300*12 + 200*12);
+    FGASSERT(meshBytes < sizeof(Mesh) + 2*300*12 + 200*12 + 1000);
+    if (!memTrackingAvailable()) {
+        FGASSERT(memStats().back().allocs == 0);
+        return;
+    }
+    bool                wasEnabled = memTrackingEnabled();
+    memTrackingEnable(true);
+    auto                findStats = [](MemTag tag)
+    {
+        MemStatss           stats = memStats();
+        return stats[uint(tag)];
+    };
+    {
+        MemStats            before = findStats(MemTag::image);
+        int64               net0 = memThreadNet();
+        ImgC4UC             tagged;
+        {
+            MemTagScope         scope(MemTag::image);
+            tagged.resize(Vec2UI(512,256));
+        }
+        MemStats            during = findStats(MemTag::image);
+        int64               bytes = 512*256*4;
+        FGASSERT(during.current - before.current == bytes);
+        FGASSERT(during.peak >= during.current);
+        FGASSERT(during.allocs == before.allocs + 1);
+        FGASSERT(memThreadNet() - net0 == bytes);
+        // Allocations outside the scope are not charged to it:
+        Uchars              untagged(1000);
+        FGASSERT(findStats(MemTag::image).current == during.current);
+        tagged = ImgC4UC();
+        FGASSERT(findStats(MemTag::image).current == before.current);
+        FGASSERT(memThreadNet() - net0 == 1000);
+        // Freeing on another thread credits the original tag:
+        Sptr<Floats>        floats;
+        {
+            MemTagScope         scope(MemTag::mesh);
+            floats = make_shared<Floats>(10000);
+        }
+        int64               meshCur = findStats(MemTag::mesh).current;
+        thread              thr([&floats](){floats.reset(); });
+        thr.join();
+        FGASSERT(meshCur - findStats(MemTag::mesh).current >= int64(10000*sizeof(float)));
+    }
+    // Dataflow cached values (measured by tracking):
+    memResetPeaks();
+    IPT<size_t>         sz(1000);
+    OPT<Doubles>        vals = link1<size_t,Doubles>(sz,[](size_t s){return Doubles(s); });
+    vals.cref();
+    // The cached value is held in a 'boost::any' which adds a small allocation:
+    size_t              dfgBytes = memoryFootprint(DfgNPtrs{vals.ptr});
+    FGASSERT((dfgBytes >= 1000*sizeof(double)) && (dfgBytes < 1000*sizeof(double)+256));
+    sz.set(4000);
+    vals.cref();
+    dfgBytes = memoryFootprint(DfgNPtrs{vals.ptr});
+    FGASSERT((dfgBytes >= 4000*sizeof(double)) && (dfgBytes < 4000*sizeof(double)+256));
+    FGASSERT(findStats(MemTag::dataflow).peak >= int64(4000*sizeof(double)));
+    fgout << fgnl << memPeakReport();
+    memTrackingEnable(wasEnabled);
+}
+
+}
+
+#ifdef FG_MEM_TRACKING
+
+// Global allocation replacement. Must not itself use operator new.
+
+static void *
+fgTrackedMalloc(size_t size)
+{
+    if (size > SIZE_MAX - sizeof(Fg::AllocHdr))
+        return nullptr;
+    Fg::AllocHdr *      hdr = static_cast<Fg::AllocHdr*>(std::malloc(size+sizeof(Fg::AllocHdr)));
+    if (hdr == nullptr)
+        return nullptr;
+    hdr->size = size;
+    if (Fg::g_enabled.load(std::memory_order_relaxed)) {
+        hdr->tag = Fg::t_tag;
+        Fg::charge(hdr->tag,Fg::int64(size));
+    }
+    else
+        hdr->tag = Fg::untracked;
+    return hdr+1;
+}
+
+static void
+fgTrackedFree(void * ptr) noexcept
+{
+    if (ptr == nullptr)
+        return;
+    Fg::AllocHdr *      hdr = static_cast<Fg::AllocHdr*>(ptr) - 1;
+    if (hdr->tag != Fg::untracked)
+        Fg::credit(hdr->tag,Fg::int64(hdr->size));
+    std::free(hdr);
+}
+
+static void *
+fgTrackedNew(size_t size)
+{
+    if (size == 0)
+        size = 1;
+    for (;;) {
+        void *              ptr = fgTrackedMalloc(size);
+        if (ptr != nullptr)
+            return ptr;
+        std::new_handler    handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void * operator new(size_t size) {return fgTrackedNew(size); }
+void * operator new[](size_t size) {return fgTrackedNew(size); }
+void operator delete(void * ptr) noexcept {fgTrackedFree(ptr); }
+void operator delete[](void * ptr) noexcept {fgTrackedFree(ptr); }
+
+void *
+operator new(size_t size,std::nothrow_t const &) noexcept
+{
+    try {return fgTrackedNew(size); }
+    catch (...) {return nullptr; }
+}
+
+void *
+operator new[](size_t size,std::nothrow_t const &) noexcept
+{
+    try {return fgTrackedNew(size); }
+    catch (...) {return nullptr; }
+}
+
+void operator delete(void * ptr,std::nothrow_t const &) noexcept {fgTrackedFree(ptr); }
+void operator delete[](void * ptr,std::nothrow_t const &) noexcept {fgTrackedFree(ptr); }
+
+#endif
+
+// */
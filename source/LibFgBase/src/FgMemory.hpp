@@ -0,0 +1,105 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Heap allocation accounting by subsystem.
+//
+// Only compiled in when FG_MEM_TRACKING is defined for the whole build (eg. -DFG_MEM_TRACKING),
+// otherwise the 'MemTagScope's are no-ops, the statistics stay at zero and only the process peak
+// resident memory is reported.
+//
+// When compiled in, the global operator new / delete are replaced by versions which keep the size
+// and subsystem tag of each block in a 16 byte header. When tracking is disabled (the default) the
+// only cost is the header and a relaxed atomic load. When enabled, each allocation is charged to the
+// innermost 'MemTagScope' of the allocating thread (or 'other' if none), and the current and peak
+// bytes are kept for each tag and in total. A block is credited back to the tag it was charged to
+// regardless of which thread frees it. Blocks allocated while tracking was disabled are never counted.
+//
+// Not supported on Windows, where each DLL has its own allocator so replacement is not process-wide.
+//
+
+#ifndef FGMEMORY_HPP
+#define FGMEMORY_HPP
+
+#include "FgStdLibs.hpp"
+#include "FgStdString.hpp"
+#include "FgStdVector.hpp"
+#include "FgTypes.hpp"
+
+namespace Fg {
+
+enum struct MemTag : uint
+{
+    other,          // Allocations outside any tagged scope
+    mesh,           // Mesh loading
+    image,          // Image loading, decoding and resizing
+    gridIndex,      // Spatial index bins
+    dataflow,       // Dataflow graph function evaluation (cached values)
+    render,         // Software rendering
+    numTags
+};
+
+char const *    memTagName(MemTag tag);
+
+// Allocations by the calling thread are charged to 'tag' for the life of this object:
+struct  MemTagScope
+{
+    explicit MemTagScope(MemTag tag);
+    ~MemTagScope();
+
+    MemTagScope(MemTagScope const &) = delete;
+    void operator=(MemTagScope const &) = delete;
+
+private:
+    uint                m_prev;
+};
+
+struct  MemStats
+{
+    String              name;
+    int64               current;        // Bytes currently allocated
+    int64               peak;           // Maximum of 'current' since enabled or last peak reset
+    uint64              allocs;         // Number of allocations
+};
+typedef Svec<MemStats>  MemStatss;
+
+// False unless built with FG_MEM_TRACKING:
+bool            memTrackingAvailable();
+
+// Enabling does not reset previous statistics:
+void            memTrackingEnable(bool enable);
+
+bool            memTrackingEnabled();
+
+// Sets all peaks to their current values:
+void            memResetPeaks();
+
+// Statistics for each tag in 'MemTag' order followed by the total:
+MemStatss       memStats();
+
+// Net bytes of tracked memory allocated minus freed by the calling thread. The difference between two
+// calls gives the memory retained by the code in between (if it didn't free memory of other threads):
+int64           memThreadNet();
+
+// Table of current and peak bytes per tag along with the process peak resident memory:
+String          memPeakReport();
+
+// Human-readable byte count with binary units, eg. "1.50 MB":
+String          toStrBytes(uint64 bytes);
+
+// Heap bytes used by a vector of plain data (use a loop for elements which own heap memory):
+template<class T>
+size_t
+heapBytes(Svec<T> const & v)
+{return v.capacity() * sizeof(T); }
+
+inline size_t
+heapBytes(String const & s)
+{return s.capacity(); }
+
+}
+
+#endif
+
+// */
@@ -3,7 +3,8 @@
 // Use, modification and distribution is subject to the MIT License,
 // see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
 //
-// Handy way to serialize to/from files using boost serialization / archive
+// Handy way to serialize to/from files using boost serialization / archive, or the native archive
+// (FgSerial.hpp) which is much faster for binary data
 //
 // * Terminology: load/save is used for whole files, read/write is used for streams.
 // * All serialization formats can change between boost versions breaking application back-compatibility.
@@ -17,6 +18,7 @@
 #include "FgFileSystem.hpp"
 #include "FgString.hpp"
 #include "FgSerialize.hpp"
+#include "FgSerial.hpp"
 #include "FgStdStream.hpp"
 
 namespace Fg {
@@ -166,6 +168,69 @@ inline bool
 saveBsaPBin(Ustring const & filename,T const & val,bool throwOnFail=true)
 {return saveBsa<portable_binary_oarchive>(filename,val,throwOnFail); }
 
+// 'val' is only modified on success:
+template<class T>
+bool
+loadNative(Ustring const & filename,T & val,bool throwOnFail=true)
+{
+    if (!throwOnFail && !pathExists(filename))
+        return false;
+    try
+    {
+        MappedFile      file(filename);
+        T               tmp;
+        fromNative(reinterpret_cast<char const *>(file.data()),file.size(),tmp);
+        val = std::move(tmp);
+    }
+    catch(FgException &)
+    {
+        if (throwOnFail)
+            throw;
+        return false;
+    }
+    catch(...)
+    {
+        if (throwOnFail)
+            fgThrow("Error while deserializing "+String(typeid(T).name())+" from native file",filename);
+        return false;
+    }
+    return true;
+}
+
+template<class T>
+T
+loadNative(Ustring const & filename)
+{
+    T           ret;
+    loadNative(filename,ret,true);
+    return ret;
+}
+
+template<class T>
+bool
+saveNative(Ustring const & filename,T const & val,bool throwOnFail=true)
+{
+    try
+    {
+        saveRaw(toNative(val),filename,false);
+    }
+    catch(FgException & e)
+    {
+        if (throwOnFail)
+            throw;
+        fgout << fgnl << "ERROR (FG exception): " << e.tr_message();
+        return false;
+    }
+    catch(...)
+    {
+        if (throwOnFail)
+            fgThrow("Error while serializing to native file",filename);
+        fgout << fgnl << "ERROR (unknown exception)";
+        return false;
+    }
+    return true;
+}
+
 }
 
 #endif
@@ -0,0 +1,67 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+
+#include "stdafx.h"
+
+#include "FgParallel.hpp"
+
+using namespace std;
+
+namespace Fg {
+
+size_t
+cNumHardwareThreads()
+{
+    size_t          nt = thread::hardware_concurrency();
+    return (nt == 0) ? 1 : nt;
+}
+
+void
+parallelFor(size_t num,function<void(size_t)> const & func,size_t maxThreads)
+{
+    if (num == 0)
+        return;
+    if (maxThreads == 0)
+        maxThreads = cNumHardwareThreads();
+    size_t              nt = min(maxThreads,num);
+    if (nt == 1) {                      // Avoid thread overhead
+        for (size_t ii=0; ii<num; ++ii)
+            func(ii);
+        return;
+    }
+    atomic<size_t>      next {0};
+    atomic<bool>        failed {false};
+    exception_ptr       firstError;
+    mutex               errorMutex;
+    auto                worker = [&]()
+    {
+        for (size_t ii=next++; (ii<num) && !failed; ii=next++) {
+            try {
+                func(ii);
+            }
+            catch (...) {
+                lock_guard<mutex>   lock(errorMutex);
+                if (!failed) {
+                    firstError = current_exception();
+                    failed = true;
+                }
+            }
+        }
+    };
+    vector<thread>      threads;
+    threads.reserve(nt-1);
+    for (size_t tt=1; tt<nt; ++tt)
+        threads.push_back(thread{worker});
+    worker();                           // Calling thread does its share
+    for (thread & t : threads)
+        t.join();
+    if (firstError)
+        rethrow_exception(firstError);
+}
+
+}
+
+// */
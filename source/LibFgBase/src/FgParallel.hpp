@@ -0,0 +1,34 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Simple multi-threaded task distribution
+//
+
+#ifndef FGPARALLEL_HPP
+#define FGPARALLEL_HPP
+
+#include "FgStdLibs.hpp"
+#include "FgTypes.hpp"
+
+namespace Fg {
+
+// Returns the number of hardware threads (at least 1):
+size_t
+cNumHardwareThreads();
+
+// Calls 'func' once for each index in [0,num) distributed over at most 'maxThreads' threads
+// (0 means the number of hardware threads). Indices are handed out in increasing order as
+// threads become free so tasks of uneven duration are load-balanced.
+// 'func' must be safe to call concurrently for different indices.
+// If any call throws, no further indices are started and the first exception is re-thrown
+// in the calling thread once all threads have finished:
+void
+parallelFor(size_t num,std::function<void(size_t)> const & func,size_t maxThreads=0);
+
+}
+
+#endif
+
+// */
@@ -0,0 +1,562 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+
+#include "stdafx.h"
+
+#include "FgProfile.hpp"
+#include "FgTime.hpp"
+#include "FgStdStream.hpp"
+#include "FgCommand.hpp"
+#include "FgDiagnostics.hpp"
+#include "FgStdPtr.hpp"
+#include "FgFileSystem.hpp"
+
+using namespace std;
+
+namespace Fg {
+
+namespace Profile {
+    atomic<bool>        g_enabled {false};
+}
+
+namespace {
+
+uint64 const        invalidNs = numeric_limits<uint64>::max();
+
+struct  Node
+{
+    char const *                    name;       // String literal or interned in 'ThreadData::names'
+    Uints                           children;
+    uint64                          calls = 0,
+                                    totalNs = 0,
+                                    minNs = invalidNs,
+                                    maxNs = 0;
+    Svec<pair<char const *,int64> > counters;
+
+    explicit Node(char const * n) : name(n) {}
+};
+
+struct  Event
+{
+    uint                node;
+    uint64              startNs;
+    uint64              durNs;
+};
+
+size_t const        maxEvents = size_t(1) << 22;     // Over all threads
+atomic<size_t>      g_numEvents {0};
+atomic<size_t>      g_numDropped {0};
+
+struct  ThreadData
+{
+    mutex               mtx;        // Only contended when reporting
+    uint                id;
+    Svec<Node>          nodes {Node("")};   // Root node at index 0
+    Uints               stack {0};          // Current path through 'nodes'
+    Svec<Event>         events;
+    set<String>         names;              // Interned dynamic names (std::set nodes are stable)
+
+    void
+    clear()
+    {
+        FGASSERT(stack.size() == 1);
+        nodes.clear();
+        nodes.push_back(Node(""));
+        events.clear();
+    }
+
+    uint
+    child(char const * name)
+    {
+        uint                parent = stack.back();
+        for (uint cc : nodes[parent].children)
+            if ((nodes[cc].name == name) || (strcmp(nodes[cc].name,name) == 0))
+                return cc;
+        uint                ret = uint(nodes.size());
+        nodes.push_back(Node(name));
+        nodes[parent].children.push_back(ret);
+        return ret;
+    }
+};
+
+// Trace event of an exited thread:
+struct  ExitedEvent
+{
+    uint                tid;
+    char const *        name;       // Interned in 'Registry::names'
+    uint64              startNs;
+    uint64              durNs;
+};
+
+void merge(ThreadData const & td,uint nodeIdx,ProfileNode & dst);
+
+struct  Registry
+{
+    mutex                       mtx;
+    uint                        nextId = 0;
+    Svec<Sptr<ThreadData> >     threads;        // Live threads only
+    ProfileNode                 exited;         // Merged call trees of exited threads
+    Svec<ExitedEvent>           exitedEvents;
+    set<String>                 names;          // Interned names of exited threads' events
+
+    // Merges the data of an exiting thread into the aggregate and drops it:
+    void
+    retire(Sptr<ThreadData> const & td)
+    {
+        lock_guard<mutex>   lock(mtx);
+        {
+            lock_guard<mutex>   tdLock(td->mtx);
+            merge(*td,0,exited);
+            Svec<char const *>  nodeNames(td->nodes.size(),nullptr);
+            for (Event const & ev : td->events) {
+                char const * &      name = nodeNames[ev.node];
+                if (name == nullptr)
+                    name = names.insert(td->nodes[ev.node].name).first->c_str();
+                exitedEvents.push_back(ExitedEvent {td->id,name,ev.startNs,ev.durNs});
+            }
+        }
+        threads.erase(find(threads.begin(),threads.end(),td));
+    }
+};
+
+Registry &
+registry()
+{
+    static Registry     reg;
+    return reg;
+}
+
+struct  ThreadHolder
+{
+    Sptr<ThreadData>    td;
+
+    ~ThreadHolder()
+    {
+        if (td)
+            registry().retire(td);
+    }
+};
+
+ThreadData &
+threadData()
+{
+    thread_local ThreadHolder   holder;
+    Sptr<ThreadData> &  td = holder.td;
+    if (!td) {
+        td = make_shared<ThreadData>();
+        Registry &          reg = registry();
+        lock_guard<mutex>   lock(reg.mtx);
+        td->id = reg.nextId++;
+        reg.threads.push_back(td);
+    }
+    return *td;
+}
+
+void
+addCounter(Svec<pair<String,int64> > & counters,String const & name,int64 val)
+{
+    for (auto & c : counters) {
+        if (c.first == name) {
+            c.second += val;
+            return;
+        }
+    }
+    counters.push_back(make_pair(name,val));
+}
+
+void
+merge(ThreadData const & td,uint nodeIdx,ProfileNode & dst)
+{
+    Node const &        src = td.nodes[nodeIdx];
+    dst.calls += src.calls;
+    dst.totalNs += src.totalNs;
+    dst.minNs = min(dst.minNs,src.minNs);
+    dst.maxNs = max(dst.maxNs,src.maxNs);
+    for (auto const & c : src.counters)
+        addCounter(dst.counters,c.first,c.second);
+    for (uint cc : src.children) {
+        String              name = td.nodes[cc].name;
+        ProfileNode *       child = nullptr;
+        for (ProfileNode & pn : dst.children)
+            if (pn.name == name)
+                child = &pn;
+        if (child == nullptr) {
+            dst.children.push_back(ProfileNode());
+            child = &dst.children.back();
+            child->name = name;
+        }
+        merge(td,cc,*child);
+    }
+}
+
+double
+toMs(uint64 ns)
+{return double(ns) / 1.0e6; }
+
+double
+toUs(uint64 ns)
+{return double(ns) / 1.0e3; }
+
+void
+treeReport(ProfileNode const & node,size_t depth,ostream & os)
+{
+    for (ProfileNode const & child : node.children) {
+        String              label = String(depth*2,' ') + child.name;
+        os << left << setw(40) << label << right
+            << setw(10) << child.calls
+            << setw(12) << toMs(child.totalNs)
+            << setw(12) << toMs(child.selfNs())
+            << setw(12) << toUs(child.totalNs / max(child.calls,uint64(1)))
+            << setw(12) << toUs(child.maxNs) << "\n";
+        for (auto const & c : child.counters)
+            os << String(depth*2+2,' ') << "#" << c.first << " " << c.second << "\n";
+        treeReport(child,depth+1,os);
+    }
+}
+
+struct  Flat
+{
+    uint64              calls = 0,
+                        totalNs = 0,
+                        selfNs = 0,
+                        maxNs = 0;
+};
+
+void
+flatten(ProfileNode const & node,map<String,Flat> & flat)
+{
+    for (ProfileNode const & child : node.children) {
+        Flat &              f = flat[child.name];
+        f.calls += child.calls;
+        f.totalNs += child.totalNs;     // Double counted for recursive zones
+        f.selfNs += child.selfNs();
+        f.maxNs = max(f.maxNs,child.maxNs);
+        flatten(child,flat);
+    }
+}
+
+String
+jsonEscape(String const & str)
+{
+    String              ret;
+    for (char ch : str) {
+        if ((ch == '"') || (ch == '\\'))
+            ret += String("\\") + ch;
+        else if (uchar(ch) < 0x20)
+            ret += ' ';
+        else
+            ret += ch;
+    }
+    return ret;
+}
+
+}
+
+void
+profileEnable(bool enable)
+{Profile::g_enabled.store(enable); }
+
+void
+profileReset()
+{
+    Registry &          reg = registry();
+    lock_guard<mutex>   lock(reg.mtx);
+    for (Sptr<ThreadData> const & td : reg.threads) {
+        lock_guard<mutex>   tdLock(td->mtx);
+        td->clear();
+    }
+    reg.exited = ProfileNode();
+    reg.exitedEvents.clear();
+    g_numEvents = 0;
+    g_numDropped = 0;
+}
+
+void
+ProfileZone::begin(char const * name)
+{
+    ThreadData &        td = threadData();
+    {
+        lock_guard<mutex>   lock(td.mtx);
+        td.stack.push_back(td.child(name));
+    }
+    m_active = true;
+    m_start = getTimeNs();
+}
+
+void
+ProfileZone::end()
+{
+    uint64              endNs = getTimeNs(),
+                        durNs = endNs - m_start;
+    ThreadData &        td = threadData();
+    lock_guard<mutex>   lock(td.mtx);
+    FGASSERT(td.stack.size() > 1);
+    uint                nodeIdx = td.stack.back();
+    td.stack.pop_back();
+    Node &              node = td.nodes[nodeIdx];
+    ++node.calls;
+    node.totalNs += durNs;
+    node.minNs = min(node.minNs,durNs);
+    node.maxNs = max(node.maxNs,durNs);
+    if (g_numEvents.fetch_add(1,memory_order_relaxed) < maxEvents)
+        td.events.push_back(Event {nodeIdx,m_start,durNs});
+    else
+        g_numDropped.fetch_add(1,memory_order_relaxed);
+}
+
+ProfileZoneDyn::ProfileZoneDyn(String const & name)
+{
+    if (profileEnabled()) {
+        ThreadData &        td = threadData();
+        char const *        ptr;
+        {
+            lock_guard<mutex>   lock(td.mtx);
+            ptr = td.names.insert(name).first->c_str();
+        }
+        begin(ptr);
+    }
+}
+
+void
+profileCount(char const * name,int64 delta)
+{
+    if (!profileEnabled())
+        return;
+    ThreadData &        td = threadData();
+    lock_guard<mutex>   lock(td.mtx);
+    auto &              counters = td.nodes[td.stack.back()].counters;
+    for (auto & c : counters) {
+        if ((c.first == name) || (strcmp(c.first,name) == 0)) {
+            c.second += delta;
+            return;
+        }
+    }
+    counters.push_back(make_pair(name,delta));
+}
+
+uint64
+ProfileNode::childNs() const
+{
+    uint64              ret = 0;
+    for (ProfileNode const & child : children)
+        ret += child.totalNs;
+    return ret;
+}
+
+ProfileNode
+profileCallTree()
+{
+    Registry &          reg = registry();
+    ProfileNode         ret;
+    Svec<Sptr<ThreadData> >     threads;
+    {
+        lock_guard<mutex>   lock(reg.mtx);
+        ret = reg.exited;
+        threads = reg.threads;
+    }
+    for (Sptr<ThreadData> const & td : threads) {
+        lock_guard<mutex>   lock(td->mtx);
+        merge(*td,0,ret);
+    }
+    return ret;
+}
+
+String
+profileTreeReport()
+{
+    ProfileNode         root = profileCallTree();
+    ostringstream       oss;
+    oss << fixed << setprecision(3)
+        << left << setw(40) << "Zone" << right << setw(10) << "Calls" << setw(12) << "Total ms"
+        << setw(12) << "Self ms" << setw(12) << "Mean us" << setw(12) << "Max us" << "\n";
+    treeReport(root,0,oss);
+    return oss.str();
+}
+
+String
+profileSummary()
+{
+    map<String,Flat>    flat;
+    flatten(profileCallTree(),flat);
+    Svec<pair<String,Flat> >    rows(flat.begin(),flat.end());
+    sort(rows.begin(),rows.end(),[](pair<String,Flat> const & l,pair<String,Flat> const & r)
+        {return (l.second.selfNs > r.second.selfNs); });
+    uint64              totalSelf = 0;
+    for (auto const & row : rows)
+        totalSelf += row.second.selfNs;
+    ostringstream       oss;
+    oss << fixed << setprecision(3)
+        << left << setw(40) << "Zone" << right << setw(10) << "Calls" << setw(12) << "Self ms"
+        << setw(8) << "Self %" << setw(12) << "Total ms" << setw(12) << "Mean us" << setw(12) << "Max us" << "\n";
+    for (auto const & row : rows) {
+        Flat const &        f = row.second;
+        oss << left << setw(40) << row.first << right
+            << setw(10) << f.calls
+            << setw(12) << toMs(f.selfNs)
+            << setw(8) << setprecision(1) << 100.0 * double(f.selfNs) / double(max(totalSelf,uint64(1)))
+            << setprecision(3)
+            << setw(12) << toMs(f.totalNs)
+            << setw(12) << toUs(f.totalNs / max(f.calls,uint64(1)))
+            << setw(12) << toUs(f.maxNs) << "\n";
+    }
+    return oss.str();
+}
+
+void
+profileSaveTrace(Ustring const & fname)
+{
+    Registry &          reg = registry();
+    Svec<Sptr<ThreadData> >     threads;
+    Svec<ExitedEvent>   exitedEvents;
+    {
+        lock_guard<mutex>   lock(reg.mtx);
+        threads = reg.threads;
+        exitedEvents = reg.exitedEvents;    // Names remain valid as 'Registry::names' is never cleared
+    }
+    uint64              startNs = invalidNs;
+    for (ExitedEvent const & ev : exitedEvents)
+        startNs = min(startNs,ev.startNs);
+    for (Sptr<ThreadData> const & td : threads) {
+        lock_guard<mutex>   lock(td->mtx);
+        for (Event const & ev : td->events)
+            startNs = min(startNs,ev.startNs);
+    }
+    Ofstream            ofs(fname);
+    ofs << "{\"traceEvents\":[";
+    ofs << fixed << setprecision(3);
+    bool                first = true;
+    auto                writeEvent = [&](char const * name,uint tid,uint64 evStartNs,uint64 durNs)
+    {
+        ofs << (first ? "\n" : ",\n")
+            << "{\"name\":\"" << jsonEscape(name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+            << tid << ",\"ts\":" << toUs(evStartNs-startNs) << ",\"dur\":" << toUs(durNs) << "}";
+        first = false;
+    };
+    if (g_numDropped > 0)
+        fgout << fgnl << "WARNING: profile trace events dropped: " << g_numDropped.load();
+    for (ExitedEvent const & ev : exitedEvents)
+        writeEvent(ev.name,ev.tid,ev.startNs,ev.durNs);
+    for (Sptr<ThreadData> const & td : threads) {
+        lock_guard<mutex>   lock(td->mtx);
+        for (Event const & ev : td->events)
+            writeEvent(td->nodes[ev.node].name,td->id,ev.startNs,ev.durNs);
+    }
+    ofs << "\n]}\n";
+}
+
+static
+uint64
+spin(uint64 iters)
+{
+    uint64              acc = 0;
+    for (uint64 ii=0; ii<iters; ++ii)
+        acc = acc * 6364136223846793005ULL + ii;
+    return acc;
+}
+
+void
+testProfile(CLArgs const &)
+{
+    profileReset();
+    // Disabled zones are not recorded:
+    for (size_t ii=0; ii<1000; ++ii) {
+        FG_PROFILE("disabled");
+        profileCount("count");
+    }
+    FGASSERT(profileCallTree().children.empty());
+    profileEnable(true);
+    uint64              sink = 0;
+    {
+        FG_PROFILE("outer");
+        for (size_t ii=0; ii<100; ++ii) {
+            FG_PROFILE("inner");
+            profileCount("items",3);
+            sink += spin(1000);
+        }
+        ProfileZoneDyn      dyn("dyn"+toStr(7));
+        sink += spin(10000);
+    }
+    thread              other([&sink]()
+    {
+        FG_PROFILE("outer");
+        FG_PROFILE("inner");
+        sink += spin(100);
+    });
+    other.join();
+    // Exited threads are merged into the aggregate so the registry doesn't grow with threads created:
+    auto                numLive = []()
+    {
+        Registry &          reg = registry();
+        lock_guard<mutex>   lock(reg.mtx);
+        return reg.threads.size();
+    };
+    size_t              numLiveBefore = numLive();
+    for (size_t ii=0; ii<100; ++ii)
+        thread([](){FG_PROFILE("shortLived"); }).join();
+    FGASSERT(numLive() == numLiveBefore);
+    for (size_t ii=0; ii<100000; ++ii)
+        FG_PROFILE("many");
+    profileEnable(false);
+    ProfileNode         root = profileCallTree();
+    FGASSERT(root.children.size() == 3);
+    ProfileNode const & outer = root.children[0];
+    FGASSERT((outer.name == "outer") && (outer.calls == 2));
+    FGASSERT(outer.children.size() == 2);
+    ProfileNode const & inner = outer.children[0];
+    FGASSERT((inner.name == "inner") && (inner.calls == 101));
+    FGASSERT((inner.counters.size() == 1) && (inner.counters[0].second == 300));
+    FGASSERT(outer.children[1].name == "dyn7");
+    FGASSERT(outer.totalNs >= inner.totalNs + outer.children[1].totalNs);
+    FGASSERT(inner.minNs <= inner.maxNs);
+    FGASSERT(inner.totalNs > 0);
+    FGASSERT((root.children[1].name == "shortLived") && (root.children[1].calls == 100));
+    FGASSERT((root.children[2].name == "many") && (root.children[2].calls == 100000));
+    // Report rows start with the zone name (indented by nesting depth in the tree report) padded
+    // to 40 characters followed by the call count:
+    auto                reportCalls = [](String const & report,String const & label)
+    {
+        istringstream       iss(report);
+        String              line;
+        while (getline(iss,line))
+            if ((line.size() > 50) && (line.compare(0,label.size(),label) == 0) &&
+                (line.find_first_not_of(' ',label.size()) >= 40))
+                return stoull(line.substr(40,10));
+        fgThrow("Zone not found in profile report",label);
+        return 0ULL;
+    };
+    String              tree = profileTreeReport();
+    FGASSERT(reportCalls(tree,"outer") == 2);
+    FGASSERT(reportCalls(tree,"  inner") == 101);
+    FGASSERT(reportCalls(tree,"  dyn7") == 1);
+    FGASSERT(reportCalls(tree,"shortLived") == 100);
+    FGASSERT(reportCalls(tree,"many") == 100000);
+    size_t              posOuter = tree.find("\nouter "),
+                        posInner = tree.find("\n  inner "),
+                        posItems = tree.find("\n    #items 300\n"),
+                        posDyn = tree.find("\n  dyn7 ");
+    FGASSERT((posOuter < posInner) && (posInner < posItems) && (posItems < posDyn) && (posDyn != String::npos));
+    FGASSERT(tree.find("disabled") == String::npos);
+    String              summary = profileSummary();
+    FGASSERT(reportCalls(summary,"outer") == 2);
+    FGASSERT(reportCalls(summary,"inner") == 101);
+    FGASSERT(reportCalls(summary,"dyn7") == 1);
+    FGASSERT(reportCalls(summary,"shortLived") == 100);
+    FGASSERT(reportCalls(summary,"many") == 100000);
+    TestDir             td("profile");
+    profileSaveTrace("trace.json");
+    String              trace = loadRawString("trace.json");
+    FGASSERT(beginsWith(trace,"{\"traceEvents\":["));
+    FGASSERT(trace.find("\"name\":\"dyn7\"") != String::npos);
+    FGASSERT(trace.find("\"name\":\"shortLived\"") != String::npos);     // From exited threads
+    profileReset();
+    FGASSERT(profileCallTree().children.empty());
+    if (sink == 42)
+        fgout << " ";
+}
+
+}
+
+// */
@@ -0,0 +1,118 @@
+//
+// Coypright (c) 2020 Singular Inversions Inc. (facegen.com)
+// Use, modification and distribution is subject to the MIT License,
+// see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
+//
+// Hierarchical profiler using a nanosecond monotonic clock.
+//
+// Each thread keeps a stack of the zones (scopes) it is in, so that each zone's timing is recorded
+// at a node of that thread's call tree identified by the path of zone names from the root. Counters
+// are recorded at the current node. The trees from all threads are merged for reporting.
+//
+// Disabled by default, in which case a zone costs a single relaxed atomic load. When enabled, a zone
+// costs two clock reads and an uncontended lock, which is small enough for zones of a microsecond
+// or more. Each zone instance is also recorded as a trace event (up to a total limit) which can be
+// saved in the Chrome trace event format for viewing in chrome://tracing or ui.perfetto.dev.
+// When a thread exits its call tree is merged into a single aggregate so memory use does not grow
+// with the number of threads created.
+//
+// 'PushTimer' (FgTime.hpp) opens a zone so existing timing sites appear in the profile.
+//
+
+#ifndef FGPROFILE_HPP
+#define FGPROFILE_HPP
+
+#include "FgStdLibs.hpp"
+#include "FgStdString.hpp"
+#include "FgStdVector.hpp"
+#include "FgTypes.hpp"
+#include "FgString.hpp"
+
+namespace Fg {
+
+namespace Profile {
+    extern std::atomic<bool>    g_enabled;
+}
+
+inline bool     profileEnabled() {return Profile::g_enabled.load(std::memory_order_relaxed); }
+
+// Enabling does not reset previous data:
+void            profileEnable(bool enable);
+
+// Clears all data from all threads. Must not be called while any zones are open:
+void            profileReset();
+
+// Zone names should be string literals as only the pointer is kept (use 'ProfileZoneDyn' otherwise):
+struct  ProfileZone
+{
+    explicit ProfileZone(char const * name)
+    {
+        if (profileEnabled())
+            begin(name);
+    }
+
+    ~ProfileZone()
+    {
+        if (m_active)
+            end();
+    }
+
+protected:
+    ProfileZone() {}
+
+    bool                m_active = false;
+    uint64              m_start;
+
+    void                begin(char const * name);
+    void                end();
+};
+
+// For names which are not string literals. Has the cost of a string copy when enabled:
+struct  ProfileZoneDyn : ProfileZone
+{
+    explicit ProfileZoneDyn(String const & name);
+};
+
+#define FG_PROFILE_CAT2(a,b) a##b
+#define FG_PROFILE_CAT(a,b) FG_PROFILE_CAT2(a,b)
+// Profiles the remainder of the current scope:
+#define FG_PROFILE(name) Fg::ProfileZone FG_PROFILE_CAT(fgProfileZone,__LINE__) (name)
+
+// Adds 'delta' to the named counter at the current zone of the calling thread. Does nothing if disabled:
+void            profileCount(char const * name,int64 delta=1);
+
+struct  ProfileNode
+{
+    String              name;
+    uint64              calls = 0;
+    uint64              totalNs = 0;
+    uint64              minNs = std::numeric_limits<uint64>::max();
+    uint64              maxNs = 0;
+    Svec<std::pair<String,int64> >  counters;
+    Svec<ProfileNode>   children;
+
+    uint64              childNs() const;
+    uint64              selfNs() const {return totalNs - std::min(totalNs,childNs()); }
+};
+
+// Merged over all threads. The root node has no name or timing and contains the top-level zones:
+ProfileNode
+profileCallTree();
+
+// Indented call tree with calls, total, self, mean and max times and counters:
+String
+profileTreeReport();
+
+// Table of zone names (merged over all call paths) in order of decreasing self time:
+String
+profileSummary();
+
+// Chrome trace event format (JSON):
+void
+profileSaveTrace(Ustring const & fname);
+
+}
+
+#endif
+
+// */
@@ -13,6 +13,12 @@
 #include "FgMath.hpp"
 #include "FgAffine1.hpp"
 #include "FgMain.hpp"
+#include "FgParallel.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FG_RANDOM_SSE2
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -174,6 +180,276 @@ std::vector<double>
 randNearUnits(size_t num)
 {return generate<double>(num,randNearUnit); }
 
+namespace {
+
+uint32 const        philoxM0 = 0xD2511F53,
+                    philoxM1 = 0xCD9E8D57,
+                    philoxW0 = 0x9E3779B9,
+                    philoxW1 = 0xBB67AE85;
+
+// Bijective 64 bit mix (SplitMix64 finalizer):
+uint64
+mix64(uint64 v)
+{
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBULL;
+    return v ^ (v >> 31);
+}
+
+Arr<uint32,4>
+cCounter(uint64 substream,uint64 block)
+{return {{uint32(block),uint32(block >> 32),uint32(substream),uint32(substream >> 32)}}; }
+
+uint64
+toUint64(uint32 lo,uint32 hi)
+{return uint64(lo) | (uint64(hi) << 32); }
+
+// 53 random bits to [0,1):
+double
+toUniform(uint64 bits)
+{return double(bits >> 11) * (1.0 / 9007199254740992.0); }
+
+// 53 random bits to (0,1] for use with log:
+double
+toUniformPos(uint64 bits)
+{return double((bits >> 11) + 1) * (1.0 / 9007199254740992.0); }
+
+void
+boxMuller(Arr<uint32,4> const & blk,double & n0,double & n1)
+{
+    double              r = sqrt(-2.0 * log(toUniformPos(toUint64(blk[0],blk[1])))),
+                        theta = 2.0 * pi() * toUniform(toUint64(blk[2],blk[3]));
+    n0 = r * cos(theta);
+    n1 = r * sin(theta);
+}
+
+#ifdef FG_RANDOM_SSE2
+
+// 32x32 -> 64 bit multiply of all 4 lanes of 'a' by 'm', returning the low and high words:
+void
+mulHiLo(__m128i a,__m128i m,__m128i & lo,__m128i & hi)
+{
+    __m128i             p02 = _mm_mul_epu32(a,m),                       // lanes 0,2 as 64 bit
+                        p13 = _mm_mul_epu32(_mm_srli_epi64(a,32),m);    // lanes 1,3 as 64 bit
+    lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(p02,_MM_SHUFFLE(0,0,2,0)),_mm_shuffle_epi32(p13,_MM_SHUFFLE(0,0,2,0)));
+    hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(p02,_MM_SHUFFLE(0,0,3,1)),_mm_shuffle_epi32(p13,_MM_SHUFFLE(0,0,3,1)));
+}
+
+// 4 consecutive blocks starting at 'first', computed in SIMD lanes:
+void
+philox4x32x4(Arr<uint32,2> key,uint64 substream,uint64 first,Arr<uint32,4> * dst)
+{
+    uint64              b1 = first+1,
+                        b2 = first+2,
+                        b3 = first+3;
+    __m128i             c0 = _mm_set_epi32(int(uint32(b3)),int(uint32(b2)),int(uint32(b1)),int(uint32(first))),
+                        c1 = _mm_set_epi32(int(uint32(b3>>32)),int(uint32(b2>>32)),int(uint32(b1>>32)),int(uint32(first>>32))),
+                        c2 = _mm_set1_epi32(int(uint32(substream))),
+                        c3 = _mm_set1_epi32(int(uint32(substream >> 32))),
+                        k0 = _mm_set1_epi32(int(key[0])),
+                        k1 = _mm_set1_epi32(int(key[1])),
+                        m0 = _mm_set1_epi32(int(philoxM0)),
+                        m1 = _mm_set1_epi32(int(philoxM1)),
+                        w0 = _mm_set1_epi32(int(philoxW0)),
+                        w1 = _mm_set1_epi32(int(philoxW1));
+    for (uint rr=0; rr<10; ++rr) {
+        __m128i             lo0,hi0,lo1,hi1;
+        mulHiLo(c0,m0,lo0,hi0);
+        mulHiLo(c2,m1,lo1,hi1);
+        c0 = _mm_xor_si128(_mm_xor_si128(hi1,c1),k0);
+        c1 = lo1;
+        c2 = _mm_xor_si128(_mm_xor_si128(hi0,c3),k1);
+        c3 = lo0;
+        k0 = _mm_add_epi32(k0,w0);
+        k1 = _mm_add_epi32(k1,w1);
+    }
+    alignas(16) uint32  words[4][4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(words[0]),c0);
+    _mm_store_si128(reinterpret_cast<__m128i*>(words[1]),c1);
+    _mm_store_si128(reinterpret_cast<__m128i*>(words[2]),c2);
+    _mm_store_si128(reinterpret_cast<__m128i*>(words[3]),c3);
+    for (uint ll=0; ll<4; ++ll)
+        dst[ll] = {{words[0][ll],words[1][ll],words[2][ll],words[3][ll]}};
+}
+
+#endif
+
+// 'num' consecutive blocks starting at 'first':
+void
+philoxBlocks(Arr<uint32,2> key,uint64 substream,uint64 first,size_t num,Arr<uint32,4> * dst)
+{
+    size_t              ii = 0;
+#ifdef FG_RANDOM_SSE2
+    for (; ii+4<=num; ii+=4)
+        philox4x32x4(key,substream,first+ii,dst+ii);
+#endif
+    for (; ii<num; ++ii)
+        dst[ii] = philox4x32(cCounter(substream,first+ii),key);
+}
+
+// Calls 'fn(block,vals)' for each block used by elements [begin,begin+num), generating the blocks in
+// batches. 'fn' sets the 2 element values of the block, which are written to 'dst' if in range:
+template<class Fn>
+void
+forBlocks(RandStream const & rs,uint64 begin,size_t num,double * dst,Fn fn)
+{
+    if (num == 0)
+        return;
+    size_t const        batch = 256;
+    Arr<uint32,4>       blocks[batch];
+    uint64              end = begin + num,
+                        blk = begin / 2;
+    while (2*blk < end) {
+        size_t              nb = size_t(cMin((end+1)/2 - blk,uint64(batch)));
+        philoxBlocks(rs.key,rs.substream,blk,nb,blocks);
+        for (size_t bb=0; bb<nb; ++bb) {
+            double              vals[2];
+            fn(blocks[bb],vals);
+            uint64              e0 = 2*(blk+bb);
+            for (uint64 ee=cMax(e0,begin); ee<cMin(e0+2,end); ++ee)
+                dst[ee-begin] = vals[ee-e0];
+        }
+        blk += nb;
+    }
+}
+
+}
+
+Arr<uint32,4>
+philox4x32(Arr<uint32,4> ctr,Arr<uint32,2> key)
+{
+    for (uint rr=0; rr<10; ++rr) {
+        uint64              p0 = uint64(philoxM0) * ctr[0],
+                            p1 = uint64(philoxM1) * ctr[2];
+        ctr = {{uint32(p1 >> 32) ^ ctr[1] ^ key[0],uint32(p1),uint32(p0 >> 32) ^ ctr[3] ^ key[1],uint32(p0)}};
+        key[0] += philoxW0;
+        key[1] += philoxW1;
+    }
+    return ctr;
+}
+
+RandStream::RandStream(uint64 seed,uint64 stream,uint64 sub) : substream(sub)
+{
+    uint64              k = mix64(mix64(seed) + stream);
+    key = {{uint32(k),uint32(k >> 32)}};
+}
+
+uint64
+RandStream::uint64At(uint64 idx) const
+{
+    Arr<uint32,4>       blk = philox4x32(cCounter(substream,idx/2),key);
+    uint                off = uint(idx & 1) * 2;
+    return toUint64(blk[off],blk[off+1]);
+}
+
+double
+RandStream::uniformAt(uint64 idx) const
+{return toUniform(uint64At(idx)); }
+
+double
+RandStream::normalAt(uint64 idx) const
+{
+    double              n0,n1;
+    boxMuller(philox4x32(cCounter(substream,idx/2),key),n0,n1);
+    return (idx & 1) ? n1 : n0;
+}
+
+void
+RandStream::uniforms(uint64 begin,size_t num,double * dst) const
+{
+    forBlocks(*this,begin,num,dst,[](Arr<uint32,4> const & blk,double * vals)
+    {
+        vals[0] = toUniform(toUint64(blk[0],blk[1]));
+        vals[1] = toUniform(toUint64(blk[2],blk[3]));
+    });
+}
+
+void
+RandStream::normals(uint64 begin,size_t num,double * dst) const
+{
+    forBlocks(*this,begin,num,dst,[](Arr<uint32,4> const & blk,double * vals)
+    {boxMuller(blk,vals[0],vals[1]); });
+}
+
+Doubles
+RandStream::uniforms(uint64 begin,size_t num) const
+{
+    Doubles             ret(num);
+    uniforms(begin,num,ret.data());
+    return ret;
+}
+
+Doubles
+RandStream::normals(uint64 begin,size_t num) const
+{
+    Doubles             ret(num);
+    normals(begin,num,ret.data());
+    return ret;
+}
+
+Floats
+RandStream::normalFs(uint64 begin,size_t num) const
+{return scast<float>(normals(begin,num)); }
+
+void
+testRandStream(CLArgs const &)
+{
+    // Known answer tests from the Random123 distribution:
+    typedef Arr<uint32,4>   A4;
+    typedef Arr<uint32,2>   A2;
+    FGASSERT(philox4x32(A4{{0,0,0,0}},A2{{0,0}}) == (A4{{0x6627e8d5,0xe169c58d,0xbc57ac4c,0x9b00dbd8}}));
+    FGASSERT(philox4x32(A4{{0xffffffff,0xffffffff,0xffffffff,0xffffffff}},A2{{0xffffffff,0xffffffff}}) ==
+        (A4{{0x408f276d,0x41c83b0e,0xa20bc7c6,0x6d5451fd}}));
+    FGASSERT(philox4x32(A4{{0x243f6a88,0x85a308d3,0x13198a2e,0x03707344}},A2{{0xa4093822,0x299f31d0}}) ==
+        (A4{{0xd16cfe09,0x94fdcceb,0x5001e420,0x24126ea1}}));
+    RandStream          rs(42,7,3);
+    // Bulk generation matches random access for unaligned ranges, including across the SIMD batches:
+    for (uint64 begin : {uint64(0),uint64(1),uint64(6),uint64(511),uint64(1ULL<<33)-3}) {
+        for (size_t num : {size_t(0),size_t(1),size_t(2),size_t(7),size_t(9),size_t(1031)}) {
+            Doubles             us = rs.uniforms(begin,num),
+                                ns = rs.normals(begin,num);
+            for (size_t ii=0; ii<num; ++ii) {
+                FGASSERT(us[ii] == rs.uniformAt(begin+ii));
+                FGASSERT(ns[ii] == rs.normalAt(begin+ii));
+            }
+        }
+    }
+    // Results are bitwise identical for any division among threads:
+    size_t              num = 100003;
+    Doubles             ref = rs.normals(0,num);
+    for (size_t numThreads : {1,2,3,8}) {
+        size_t              chunk = (num + numThreads*5 - 1) / (numThreads*5);
+        Doubles             vals(num);
+        parallelFor((num+chunk-1)/chunk,[&](size_t cc)
+        {
+            size_t              beg = cc * chunk;
+            rs.normals(beg,cMin(chunk,num-beg),vals.data()+beg);
+        },numThreads);
+        FGASSERT(memcmp(vals.data(),ref.data(),num*sizeof(double)) == 0);
+    }
+    // Streams and substreams differ, identical seeds match:
+    FGASSERT(RandStream(42,7,3).uniforms(0,8) == rs.uniforms(0,8));
+    FGASSERT(RandStream(42,7,4).uniforms(0,8) != rs.uniforms(0,8));
+    FGASSERT(RandStream(42,8,3).uniforms(0,8) != rs.uniforms(0,8));
+    FGASSERT(RandStream(43,7,3).uniforms(0,8) != rs.uniforms(0,8));
+    FGASSERT(rs.sub(4).uniforms(0,8) == RandStream(42,7,4).uniforms(0,8));
+    // Sequential access follows the element mapping:
+    RandSeq             seq(rs,5);
+    FGASSERT(seq.nextNormal() == ref[5]);
+    FGASSERT(seq.nextUniform() == rs.uniformAt(6));
+    FGASSERT(seq.nextUint64() == rs.uint64At(7));
+    FGASSERT(seq.nextUint(10) < 10);
+    // Distribution moments:
+    Doubles             us = rs.uniforms(0,num);
+    double              uMean = cMean(us),
+                        nMean = cMean(ref),
+                        nVar = cMag(ref) / double(num) - sqr(nMean);
+    FGASSERT((*min_element(us.begin(),us.end()) >= 0.0) && (*max_element(us.begin(),us.end()) < 1.0));
+    FGASSERT(std::abs(uMean-0.5) < 0.005);
+    FGASSERT(std::abs(nMean) < 0.01);
+    FGASSERT(std::abs(nVar-1.0) < 0.02);
+}
+
 }
 
 // */
@@ -3,8 +3,8 @@
 // Use, modification and distribution is subject to the MIT License,
 // see accompanying file LICENSE.txt or facegen.com/base_library_license.txt
 //
-// Not threadsafe. If threaded RNG is needed, make explicit generator for each thread so
-// that seeding policy for different threads is explicit:
+// The global generator functions below are not threadsafe. For threaded or order-independent
+// generation use 'RandStream' below.
 //
 
 #ifndef FGRANDOM_HPP
@@ -12,6 +12,7 @@
 
 #include "FgStdLibs.hpp"
 #include "FgStdExtensions.hpp"
+#include "FgStdArray.hpp"
 
 namespace Fg {
 
@@ -74,6 +75,62 @@ randNearUnitsArr()
     return ret;
 }
 
+// Counter-based random numbers (Philox4x32-10 from Salmon et al. "Parallel Random Numbers: As Easy
+// as 1, 2, 3", SC11). Each 128 bit block is a pure function of a 64 bit key and a 128 bit counter so
+// any value of a stream can be generated directly, in any order, on any thread. Results are thus
+// bitwise identical however the generation is divided between threads.
+//
+// A stream's key is a hash of its seed and stream ID. The counter is the substream ID (upper 64 bits)
+// and the block index (lower 64 bits). Element 'ii' of a substream maps to random bits as follows:
+//   uniform:   the lower or upper 64 bits of block ii/2 for even or odd 'ii' respectively
+//   normal:    Box-Muller pair from block ii/2, even 'ii' using cos and odd 'ii' using sin
+Arr<uint32,4>
+philox4x32(Arr<uint32,4> ctr,Arr<uint32,2> key);
+
+struct  RandStream
+{
+    Arr<uint32,2>       key;
+    uint64              substream;
+
+    explicit RandStream(uint64 seed,uint64 stream=0,uint64 substream=0);
+
+    // Same stream with a different substream:
+    RandStream
+    sub(uint64 substreamId) const
+    {
+        RandStream          ret = *this;
+        ret.substream = substreamId;
+        return ret;
+    }
+
+    // Random access to single elements:
+    uint64              uint64At(uint64 idx) const;
+    double              uniformAt(uint64 idx) const;    // [0,1)
+    double              normalAt(uint64 idx) const;     // Standard normal
+
+    // Elements [begin,begin+num) written to 'dst'. Blocks are generated 4 at a time with SSE2 if available:
+    void                uniforms(uint64 begin,size_t num,double * dst) const;
+    void                normals(uint64 begin,size_t num,double * dst) const;
+    Doubles             uniforms(uint64 begin,size_t num) const;
+    Doubles             normals(uint64 begin,size_t num) const;
+    Floats              normalFs(uint64 begin,size_t num) const;
+};
+
+// Sequential access to a substream from a single thread. Each call consumes one element index:
+struct  RandSeq
+{
+    RandStream          stream;
+    uint64              pos = 0;
+
+    explicit RandSeq(RandStream const & s,uint64 p=0) : stream(s), pos(p) {}
+
+    uint64              nextUint64() {return stream.uint64At(pos++); }
+    double              nextUniform() {return stream.uniformAt(pos++); }
+    double              nextNormal() {return stream.normalAt(pos++); }
+    // Uniform in [0,size). Bias is below 2^-32 for any 'size':
+    uint                nextUint(uint size) {return uint(nextUint64() % size); }
+};
+
 }
 
 #endif
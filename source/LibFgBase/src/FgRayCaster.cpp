@@ -22,32 +22,21 @@ TriInd::TriInd(size_t triIdx_,size_t surfIdx_,size_t meshIdx_)
     FGASSERT(meshIdx < numeric_limits<uint16>::max());
 }
 
-RayCaster::RayCaster(
-    Meshes const &      meshes,
-    SimilarityD         modelview,
-    AffineEw2D          itcsToIucs_,
-    Lighting const &    lighting_,
-    RgbaF               background_,
-    bool                useMaps_,
-    bool                allShiny_)
-    :
-    itcsToIucs(itcsToIucs_),
-    lighting(lighting_),
-    background(background_),
-    useMaps(useMaps_),
-    allShiny(allShiny_)
+RayCastScene::RayCastScene(Meshes const & meshes,bool mipMaps) :
+    RayCastScene(meshes,mapFuncT<Vec3Fs,Mesh>(meshes,[](Mesh const & m){return m.verts; }),mipMaps)
+{}
+
+RayCastScene::RayCastScene(Meshes const & meshes,Vec3Fss const & posedVertss,bool mipMaps) :
+    vertss(posedVertss)
 {
+    FGASSERT(meshes.size() == posedVertss.size());
     trisss.resize(meshes.size());
     materialss.resize(meshes.size());
-    vertss.resize(meshes.size());
     uvsPtrs.resize(meshes.size());
     normss.resize(meshes.size());
-    iucsVertss.resize(meshes.size());
-    // TODO: set up grid only after seeing how many verts fall in frustum, possibly use smaller grid size,
-    // and what their bounding box is for setting client to grid transform:
-    grid.setup(Mat22F(0,1,0,1),uint(fgNumTriEquivs(meshes)));
     for (size_t mm=0; mm<meshes.size(); ++mm) {
         Mesh const &    mesh = meshes[mm];
+        FGASSERT(vertss[mm].size() == mesh.verts.size());
         Triss &           triss = trisss[mm];
         Materials &       materials = materialss[mm];
         triss.reserve(mesh.surfaces.size());
@@ -55,11 +44,133 @@ RayCaster::RayCaster(
         for (size_t ss=0; ss<mesh.surfaces.size(); ++ss) {
             triss.push_back(mesh.surfaces[ss].asTris());
             materials.push_back(mesh.surfaces[ss].material);
+            numTris += triss.back().size();
         }
-        Vec3Fs &           verts = vertss[mm];
-        verts = mapMul(Affine3F{modelview.asAffine()},mesh.verts);
         uvsPtrs[mm] = &mesh.uvs;
-        normss[mm] = cNormals(mesh.surfaces,verts);
+        normss[mm] = cNormals(mesh.surfaces,vertss[mm]);
+    }
+    if (mipMaps) {
+        // Maps are frequently shared between surfaces and meshes so only build each once:
+        map<ImgC4UC const *,Sptr<ImgC4UCs const> >  cache;
+        auto                getMips = [&cache](Sptr<ImgC4UC> const & img)
+        {
+            Sptr<ImgC4UCs const>    ret;
+            if (img && (cMinElem(img->dims()) > 1)) {
+                auto                it = cache.find(img.get());
+                if (it == cache.end())
+                    it = cache.insert(make_pair(img.get(),make_shared<ImgC4UCs const>(cMipMap(*img)))).first;
+                ret = it->second;
+            }
+            return ret;
+        };
+        mipss.resize(meshes.size());
+        for (size_t mm=0; mm<meshes.size(); ++mm)
+            for (Material const & mat : materialss[mm])
+                mipss[mm].push_back(MaterialMips {getMips(mat.albedoMap),getMips(mat.specularMap)});
+    }
+}
+
+// Sample a material map, using its mip map if available and selected:
+static
+RgbaF
+sampleMap(
+    ImgC4UC const &             map,
+    Sptr<ImgC4UCs const> const & mipMap,
+    Vec2F                       uv,
+    Vec2F                       dUvDx,
+    Vec2F                       dUvDy,
+    TexFilter                   filter)
+{
+    if (mipMap && (filter != TexFilter::bilinear))
+        return sampleMipIucs(*mipMap,uv,dUvDx,dUvDy,filter);
+    return RgbaF(sampleClipIucs(map,uv));
+}
+
+RayCaster::RayCaster(
+    Meshes const &      meshes,
+    SimilarityD         modelview,
+    AffineEw2D          itcsToIucs_,
+    Lighting const &    lighting_,
+    RgbaF               background_,
+    bool                useMaps_,
+    bool                allShiny_,
+    bool                cullBackFaces)
+    :
+    RayCaster(make_shared<RayCastScene>(meshes),modelview,itcsToIucs_,lighting_,background_,useMaps_,allShiny_,
+        cullBackFaces)
+{}
+
+// IUCS bounds of the part of an OECS tri in front of the plane at depth 'nearDepth', if any:
+static
+Opt<Mat22F>
+clippedBounds(RayCaster const & rc,Vec3F const * verts,float nearDepth)
+{
+    Mat22F              bnds(maxFloat(),-maxFloat(),maxFloat(),-maxFloat());
+    bool                any = false;
+    auto                addPoint = [&](Vec3F p)
+    {
+        Vec3F               iucs = rc.oecsToIucs(p);
+        bnds[0] = cMin(bnds[0],iucs[0]);
+        bnds[1] = cMax(bnds[1],iucs[0]);
+        bnds[2] = cMin(bnds[2],iucs[1]);
+        bnds[3] = cMax(bnds[3],iucs[1]);
+        any = true;
+    };
+    for (uint ii=0; ii<3; ++ii) {                   // Clip each edge (OECS looks down -Z):
+        Vec3F               a = verts[ii],
+                            b = verts[(ii+1)%3];
+        bool                aIn = (-a[2] >= nearDepth),
+                            bIn = (-b[2] >= nearDepth);
+        if (aIn)
+            addPoint(a);
+        if (aIn != bIn)
+            addPoint(a + (b-a) * ((-nearDepth-a[2]) / (b[2]-a[2])));
+    }
+    if (any)
+        return bnds;
+    return Opt<Mat22F>();
+}
+
+RayCaster::RayCaster(
+    Sptr<RayCastScene const> const & scene_,
+    SimilarityD         modelview,
+    AffineEw2D          itcsToIucs_,
+    Lighting const &    lighting_,
+    RgbaF               background_,
+    bool                useMaps_,
+    bool                allShiny_,
+    bool                cullBackFaces)
+    :
+    scene(scene_),
+    itcsToIucs(itcsToIucs_),
+    lighting(lighting_),
+    background(background_),
+    useMaps(useMaps_),
+    allShiny(allShiny_)
+{
+    FGASSERT(scene);
+    Trisss const &      trisss = scene->trisss;
+    size_t              numMeshes = trisss.size();
+    vertss.resize(numMeshes);
+    normss.resize(numMeshes);
+    iucsVertss.resize(numMeshes);
+    Affine3F            toOecs {modelview.asAffine()};
+    // Normals are invariant to translation and (positive) scale so only need rotation:
+    Mat33F              rotToOecs {modelview.rot.asMatrix()};
+    // Cull tris before binning, keeping the IUCS bounds (clipped to the image) of those remaining:
+    Svec<pair<TriInd,Mat22F> > binTris;
+    Mat22F              binBounds(maxFloat(),-maxFloat(),maxFloat(),-maxFloat());
+    double              binArea = 0.0;
+    for (size_t mm=0; mm<numMeshes; ++mm) {
+        Triss const &       triss = trisss[mm];
+        Vec3Fs &            verts = vertss[mm];
+        verts = mapMul(toOecs,scene->vertss[mm]);
+        MeshNormals const & normsMcs = scene->normss[mm];
+        MeshNormals &       norms = normss[mm];
+        norms.vert = mapMul(rotToOecs,normsMcs.vert);
+        norms.facet.reserve(normsMcs.facet.size());
+        for (FacetNormals const & fn : normsMcs.facet)
+            norms.facet.push_back(FacetNormals {mapMul(rotToOecs,fn.tri),mapMul(rotToOecs,fn.quad)});
         Vec3Fs &           iucsVerts = iucsVertss[mm];
         iucsVerts.reserve(verts.size());
         for (Vec3F v : verts)
@@ -67,21 +178,71 @@ RayCaster::RayCaster(
         for (size_t ss=0; ss<triss.size(); ++ss) {
             Tris const &  tris = triss[ss];
             for (size_t tt=0; tt<tris.posInds.size(); ++tt) {
-                Vec3UI       t = tris.posInds[tt];
-                Vec3F        v0 = iucsVerts[t[0]],
-                                v1 = iucsVerts[t[1]],
-                                v2 = iucsVerts[t[2]];
-                if ((v0[2] > 0.0f) && (v1[2] > 0.0f) && (v2[2] > 0.0f)) {   // Only render tris fully in front of camera
-                    Mat22F    bnds;
+                Vec3UI              t = tris.posInds[tt];
+                Vec3F               o[3] {verts[t[0]],verts[t[1]],verts[t[2]]};
+                // The camera is at the OECS origin and CC winding faces the viewer:
+                if (cullBackFaces && (cDot(crossProduct(o[1]-o[0],o[2]-o[0]),o[0]) >= 0.0f))
+                    continue;
+                Vec3F               v0 = iucsVerts[t[0]],
+                                    v1 = iucsVerts[t[1]],
+                                    v2 = iucsVerts[t[2]];
+                Mat22F              bnds;
+                if ((v0[2] > 0.0f) && (v1[2] > 0.0f) && (v2[2] > 0.0f)) {   // Tri fully in front of camera
+                    Vec2F               e1 = (v1-v0).subMatrix<2,1>(0,0),
+                                        e2 = (v2-v0).subMatrix<2,1>(0,0);
+                    if (e1[0]*e2[1] == e1[1]*e2[0])                         // Degenerate projection
+                        continue;
                     bnds[0] = cMin(v0[0],v1[0],v2[0]);
                     bnds[1] = cMax(v0[0],v1[0],v2[0]);
                     bnds[2] = cMin(v0[1],v1[1],v2[1]);
                     bnds[3] = cMax(v0[1],v1[1],v2[1]);
-                    grid.add(TriInd(tt,ss,mm),bnds);
                 }
+                else {
+                    // Tri crosses the camera plane. Clip to a near plane relative to the tri's own depth range
+                    // so projected bounds are finite:
+                    float               maxDepth = -cMin(o[0][2],o[1][2],o[2][2]);
+                    if (maxDepth <= 0.0f)                                   // Entirely behind camera
+                        continue;
+                    Opt<Mat22F>         cb = clippedBounds(*this,o,maxDepth*1.0e-4f);
+                    if (!cb.valid())
+                        continue;
+                    bnds = cb.val();
+                }
+                // Frustum cull against the image bounds, which are [0,1] in IUCS:
+                if ((bnds[0] >= 1.0f) || (bnds[1] <= 0.0f) || (bnds[2] >= 1.0f) || (bnds[3] <= 0.0f))
+                    continue;
+                bnds[0] = cMax(bnds[0],0.0f);
+                bnds[1] = cMin(bnds[1],1.0f);
+                bnds[2] = cMax(bnds[2],0.0f);
+                bnds[3] = cMin(bnds[3],1.0f);
+                binTris.push_back(make_pair(TriInd(tt,ss,mm),bnds));
+                binBounds[0] = cMin(binBounds[0],bnds[0]);
+                binBounds[1] = cMax(binBounds[1],bnds[1]);
+                binBounds[2] = cMin(binBounds[2],bnds[2]);
+                binBounds[3] = cMax(binBounds[3],bnds[3]);
+                binArea += double(bnds[1]-bnds[0]) * double(bnds[3]-bnds[2]);
             }
         }
     }
+    numBinned = binTris.size();
+    if (binTris.empty())
+        grid.setup(Mat22F(0,1,0,1),1);
+    else {
+        // Aim for bins about the size of the mean tri bounds; smaller bins just replicate large tris
+        // across more bins, while more bins than tris does not reduce the tris tested per ray:
+        double              clientArea = double(binBounds[1]-binBounds[0]) * double(binBounds[3]-binBounds[2]),
+                            numBins = double(numBinned);
+        // Pad so that rays exactly on the outermost tri edges are not lost to rounding in the grid transform:
+        binBounds[0] -= 1.0e-4f;
+        binBounds[1] += 1.0e-4f;
+        binBounds[2] -= 1.0e-4f;
+        binBounds[3] += 1.0e-4f;
+        if (binArea > 0.0)
+            numBins = cMin(numBins,clientArea*numBins/binArea);
+        grid.setup(binBounds,uint(clampBounds(numBins,1.0,double((1 << 20)-1))));
+        for (auto const & bt : binTris)
+            grid.add(bt.first,bt.second);
+    }
 }
 
 RgbaF
@@ -92,8 +253,8 @@ RayCaster::cast(Vec2F posIucs) const
     RgbaF               color = background;
     for (uint ii=best.size(); ii>0; --ii) {             // Render back to front
         Intersect           isct = best[ii-1].second;
-        Tris const &        tris = trisss[isct.triInd.meshIdx][isct.triInd.surfIdx];
-        Material            material = materialss[isct.triInd.meshIdx][isct.triInd.surfIdx];
+        Tris const &        tris = scene->trisss[isct.triInd.meshIdx][isct.triInd.surfIdx];
+        Material const &    material = scene->materialss[isct.triInd.meshIdx][isct.triInd.surfIdx];
         MeshNormals const &     norms = normss[isct.triInd.meshIdx];
         Vec3UI              vis = tris.posInds[isct.triInd.triIdx];
         // TODO: Use perspective-correct normal and UV interpolation (makes very little difference for small tris):
@@ -103,14 +264,37 @@ RayCaster::cast(Vec2F posIucs) const
                             bc = Vec3F(isct.barycentric),
                             norm = normalize(bc[0]*n0 + bc[1]*n1 + bc[2]*n2);
         RgbaF               albedo(230,230,230,255);
-        Vec2Fs const &      uvs = *uvsPtrs[isct.triInd.meshIdx];
-        Vec2F               uv {maxFloat()};
+        Vec2Fs const &      uvs = *scene->uvsPtrs[isct.triInd.meshIdx];
+        Vec2F               uv {maxFloat()},
+                            dUvDx {0},      // Texture footprint of one image pixel
+                            dUvDy {0};
+        MaterialMips        mips;
         if ((!tris.uvInds.empty()) && (!uvs.empty()) && (material.albedoMap) &&
             (!material.albedoMap->empty()) && useMaps) {
             Vec3UI              uvInds = tris.uvInds[isct.triInd.triIdx];
             uv = bc[0]*uvs[uvInds[0]] + bc[1]*uvs[uvInds[1]] + bc[2]*uvs[uvInds[2]];
             uv[1] = 1.0f - uv[1];   // OTCS to IUCS
-            albedo = RgbaF(sampleClipIucs(*material.albedoMap,uv));
+            if ((texFilter != TexFilter::bilinear) && !scene->mipss.empty()) {
+                mips = scene->mipss[isct.triInd.meshIdx][isct.triInd.surfIdx];
+                // UVs are affine in IUCS over the projected tri (consistent with the barycentric interpolation
+                // above) so the derivatives are constant over the tri and are those of neighbouring rays:
+                Vec3Fs const &      iucsVerts = iucsVertss[isct.triInd.meshIdx];
+                Vec2F               p0 = iucsVerts[vis[0]].subMatrix<2,1>(0,0),
+                                    e1 = iucsVerts[vis[1]].subMatrix<2,1>(0,0) - p0,
+                                    e2 = iucsVerts[vis[2]].subMatrix<2,1>(0,0) - p0,
+                                    t1 = uvs[uvInds[1]] - uvs[uvInds[0]],
+                                    t2 = uvs[uvInds[2]] - uvs[uvInds[0]];
+                float               det = e1[0]*e2[1] - e1[1]*e2[0];
+                bool                projected = (iucsVerts[vis[0]][2] > 0.0f) && (iucsVerts[vis[1]][2] > 0.0f) &&
+                                                (iucsVerts[vis[2]][2] > 0.0f);
+                if (projected && (det != 0.0f)) {
+                    dUvDx = (t1*e2[1] - t2*e1[1]) * (pixelSizeIucs[0] / det);
+                    dUvDy = (t2*e1[0] - t1*e2[0]) * (pixelSizeIucs[1] / det);
+                    dUvDx[1] = -dUvDx[1];   // OTCS to IUCS
+                    dUvDy[1] = -dUvDy[1];
+                }
+            }
+            albedo = sampleMap(*material.albedoMap,mips.albedo,uv,dUvDx,dUvDy,texFilter);
         }
         Vec3F               acc(0.0f);
 	    float	            aw = albedo.alpha() / 255.0f;
@@ -122,7 +306,7 @@ RayCaster::cast(Vec2F posIucs) const
                 acc += mapMul(surfColour,lgt.colour) * fac;
                 float           shininess = material.shiny ? 1.0f : 0.0f;
                 if ((uv[0] != maxFloat()) && material.specularMap && !material.specularMap->empty()) {
-                    RgbaF           s = sampleClipIucs(*material.specularMap,uv);
+                    RgbaF           s = sampleMap(*material.specularMap,mips.specular,uv,dUvDx,dUvDy,texFilter);
                     shininess = scast<float>(s.red()) / 255.0f;
                 }
                 if (allShiny)
@@ -159,13 +343,38 @@ RayCaster::closestIntersects(Vec2F posIucs) const
 {
     const TriInds &     triInds = grid[posIucs];
     BestN<float,Intersect,4> best;
+    Opt<Vec3D>          rayOecs;        // Only needed for tris crossing the camera plane
     for (TriInd ti : triInds) {
-        Tris const &        tris = trisss[ti.meshIdx][ti.surfIdx];
+        Tris const &        tris = scene->trisss[ti.meshIdx][ti.surfIdx];
         Vec3UI              vis = tris.posInds[ti.triIdx];
         Vec3Fs const &      iucsVerts = iucsVertss[ti.meshIdx];
         Vec3F               v0 = iucsVerts[vis[0]],
                             v1 = iucsVerts[vis[1]],
                             v2 = iucsVerts[vis[2]];
+        if ((v0[2] <= 0.0f) || (v1[2] <= 0.0f) || (v2[2] <= 0.0f)) {
+            // Projected coordinates are not valid so intersect in OECS (Moller-Trumbore):
+            if (!rayOecs.valid()) {
+                Vec2D               itcs = itcsToIucs.inverse() * Vec2D(posIucs);
+                rayOecs = Vec3D(itcs[0],-itcs[1],-1.0);     // Both Y and Z change sign ITCS -> OECS
+            }
+            Vec3D               dir = rayOecs.val();
+            Vec3Fs const &      verts = vertss[ti.meshIdx];
+            Vec3D               p0(verts[vis[0]]),
+                                e1 = Vec3D(verts[vis[1]]) - p0,
+                                e2 = Vec3D(verts[vis[2]]) - p0,
+                                pv = crossProduct(dir,e2);
+            double              det = cDot(e1,pv);
+            if (det == 0.0)
+                continue;
+            Vec3D               tv = -p0,
+                                qv = crossProduct(tv,e1);
+            double              u = cDot(tv,pv) / det,
+                                v = cDot(dir,qv) / det,
+                                depth = cDot(e2,qv) / det;      // Ray Z component is -1
+            if ((u >= 0) && (v >= 0) && (u+v <= 1) && (depth > 0))
+                best.update(float(1.0/depth),Intersect(ti,Vec3D(1.0-u-v,u,v)));
+            continue;
+        }
         Vec2D               u0(v0[0],v0[1]),
                             u1(v1[0],v1[1]),
                             u2(v2[0],v2[1]);
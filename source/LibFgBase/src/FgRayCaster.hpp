@@ -29,21 +29,58 @@ struct  TriInd
 };
 typedef Svec<TriInd>    TriInds;
 
-// Ray-casting requires caching the projected coordinates as well as their mesh and surface indices:
-struct  RayCaster
+// Mip maps of the maps of a material. Null where the material has no such map:
+struct  MaterialMips
+{
+    Sptr<ImgC4UCs const>    albedo;
+    Sptr<ImgC4UCs const>    specular;
+};
+typedef Svec<MaterialMips>      MaterialMipss;
+
+// Camera-independent ray-casting data for a set of meshes in a given pose. Construct once and share
+// between the RayCasters of multiple views of the same posed meshes.
+// Keeps pointers into the given meshes so must not be kept beyond their lifetime:
+struct  RayCastScene
 {
     Trisss                  trisss;         // By mesh, by surface
     Materialss              materialss;     // By mesh, by surface
-    Vec3Fss                 vertss;         // By mesh, in OECS
+    Vec3Fss                 vertss;         // By mesh, posed, in mesh coordinates
     Svec<Vec2Fs const *>    uvsPtrs;        // By mesh, in OTCS
+    MeshNormalss            normss;         // By mesh, in mesh coordinates
+    Svec<MaterialMipss>     mipss;          // By mesh, by surface. Empty if mip maps not requested.
+    size_t                  numTris = 0;    // Over all meshes and surfaces
+
+    // Use the base shape of each mesh:
+    explicit
+    RayCastScene(Meshes const & meshes,bool mipMaps=false);
+
+    RayCastScene(
+        Meshes const &      meshes,
+        Vec3Fss const &     posedVertss,    // By mesh, must be 1-1 with 'meshes' base verts
+        // Build mip maps for each albedo and specular map (required for mip-mapped texture filtering):
+        bool                mipMaps=false);
+};
+
+// Ray-casting requires caching the projected coordinates as well as their mesh and surface indices:
+struct  RayCaster
+{
+    Sptr<RayCastScene const> scene;
+    Vec3Fss                 vertss;         // By mesh, in OECS
     MeshNormalss                normss;         // By mesh, in OECS
     AffineEw2D              itcsToIucs;
     Vec3Fss                 iucsVertss;     // By mesh, X,Y in IUCS, Z component is inverse FCCS depth
-    GridIndex<TriInd>       grid;           // Index from IUCS to bin of TriInds
+    // Index from IUCS to bin of TriInds. Only covers the image region overlapped by tris which survive
+    // frustum and (optionally) backface culling, with bin size adapted to the projected tri sizes:
+    GridIndex<TriInd>       grid;
+    size_t                  numBinned = 0;  // Number of tris which survived culling
     Lighting                lighting;
     RgbaF                   background;     // Must be alpha-weighted
     bool                    useMaps = true;
     bool                    allShiny = false;
+    // Mip-mapped filtering is only used if the scene has mip maps and 'pixelSizeIucs' is set:
+    TexFilter               texFilter = TexFilter::bilinear;
+    // Size of an image pixel in IUCS, used to determine the texture footprint of each ray:
+    Vec2F                   pixelSizeIucs {0};
 
     RayCaster(
         Meshes const &      meshes,
@@ -52,7 +89,21 @@ struct  RayCaster
         Lighting const &    lighting,       // In OECS
         RgbaF               background,      // Must be alpha-weighted
         bool                useMaps = true,
-        bool                allShiny = false);
+        bool                allShiny = false,
+        bool                cullBackFaces = false);
+
+    // Only the camera-dependent work (transform, projection and binning) is done here:
+    RayCaster(
+        Sptr<RayCastScene const> const & scene,
+        SimilarityD         modelview,      // to OECS
+        AffineEw2D          itcsToIucs,
+        Lighting const &    lighting,       // In OECS
+        RgbaF               background,      // Must be alpha-weighted
+        bool                useMaps = true,
+        bool                allShiny = false,
+        // Backfaces are otherwise visible (eg. through transparent surfaces or open meshes).
+        // Tris crossing the camera plane are always handled by clipping:
+        bool                cullBackFaces = false);
 
     RgbaF
     cast(Vec2F posIucs) const;
@@ -70,7 +121,8 @@ struct  RayCaster
         Intersect(TriInd ti,Vec3D bc) : triInd(ti), barycentric(bc) {}
     };
 
-    // Return closest tri intersects for given ray:
+    // Return closest tri intersects for given ray. Barycentric coordinates are in IUCS except for tris
+    // crossing the camera plane, which are intersected in OECS:
     BestN<float,Intersect,4>
     closestIntersects(Vec2F posIucs) const;
 };
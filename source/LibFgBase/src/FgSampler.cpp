@@ -32,7 +32,7 @@ valsDiffer(
         (cMaxElem(mapAbs(corners[3].m_c - centre.m_c)) > maxDiff));
 }
 
-static uint64 rayCount;
+static thread_local uint64 rayCount;       // Per-thread since views may be rendered concurrently
 
 static
 RgbaF
@@ -90,27 +90,33 @@ sampleAdaptiveF(
     FGASSERT(dims.cmpntsProduct() > 0);
     FGASSERT((antiAliasBitDepth > 0) && (antiAliasBitDepth <= 16));
     rayCount = (img.width()+1) * (img.height()+1);
-    float               widf = float(img.width()),
-                        hgtf = float(img.height());
+    // Pixel boundary positions in IUCS. Divide in double since vectorized float division may be
+    // approximated (eg. -ffast-math), which would move samples off geometry edges lying exactly on
+    // pixel boundaries and make the render platform-dependent:
+    auto                boundaries = [](uint num)
+    {
+        Floats              ret(num+1);
+        for (uint ii=0; ii<=num; ++ii)
+            ret[ii] = float(double(ii) / double(num));
+        return ret;
+    };
+    Floats              xs = boundaries(img.width()),
+                        ys = boundaries(img.height());
     ImgC4F          sampleLines(img.width()+1,2);
     for (uint col=0; col<sampleLines.width(); ++col)
         sampleLines.xy(col,0) = 
-            sample(Vec2F(float(col)/widf,0.0f));
+            sample(Vec2F(xs[col],0.0f));
     for (uint row=0; row<img.height(); ++row) {
         uint            fbit = row%2,
                         sbit = 1-fbit;
         for (uint col=0; col<sampleLines.width(); ++col)
             sampleLines.xy(col,sbit) = 
-                sample(Vec2F(float(col)/widf,float(row+1)/hgtf));
+                sample(Vec2F(xs[col],ys[row+1]));
         for (uint col=0; col<img.width(); ++col) {
             img.xy(col,row) =
                 sampleRecurse(
                     sample,
-                    Mat22F(
-                        float(col)/widf,
-                        float(col+1)/widf,
-                        float(row)/hgtf,
-                        float(row+1)/hgtf),
+                    Mat22F(xs[col],xs[col+1],ys[row],ys[row+1]),
                     Mat<RgbaF,2,2>(
                         sampleLines.xy(col,fbit),
                         sampleLines.xy(col+1,fbit),
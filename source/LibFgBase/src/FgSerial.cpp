@@ -9,6 +9,11 @@
 #include "FgSerial.hpp"
 #include "MurmurHash2.h"
 #include "FgCommand.hpp"
+#include "FgSerialize.hpp"
+#include "FgRandom.hpp"
+#include "FgMetaFormat.hpp"
+#include "FgDataflow.hpp"
+#include "FgTestUtils.hpp"
 
 using namespace std;
 
@@ -54,6 +59,68 @@ fgDsr(const char * & ptr,const char * end,unsigned long & val)
     val = long(tmp);
 }
 
+void
+dsr_(SerIn & in,long & val)
+{
+    int64           tmp;
+    in.scalar(tmp);
+    FGASSERT((tmp <= std::numeric_limits<long>::max()) && (tmp >= std::numeric_limits<long>::min()));
+    val = long(tmp);
+}
+
+void
+dsr_(SerIn & in,unsigned long & val)
+{
+    uint64          tmp;
+    in.scalar(tmp);
+    FGASSERT(tmp <= std::numeric_limits<unsigned long>::max());
+    val = (unsigned long)(tmp);
+}
+
+void
+dsr_(SerIn & in,bool & val)
+{
+    uchar           tmp;
+    in.scalar(tmp);
+    FGASSERT(tmp < 2);
+    val = (tmp == 1);
+}
+
+static char const       nativeMagic[8] = {'F','G','N','A','T','I','V','E'};
+static uint32 const     nativeVersion = 1;
+
+void
+serNativeHeader_(SerOut & out,uint64 schemaHash)
+{
+    out.raw(nativeMagic,8);
+    out.scalar(nativeVersion);
+    out.scalar(uint32(0));          // Reserved
+    out.scalar(schemaHash);
+}
+
+void
+dsrNativeHeader_(SerIn & in,uint64 schemaHash)
+{
+    if (!isNative(in.ptr,in.remaining()))
+        fgThrow("Not a native serialization archive");
+    in.ptr += 8;
+    uint32          version,reserved;
+    uint64          hash;
+    in.scalar(version);
+    in.scalar(reserved);
+    if (version > nativeVersion)
+        fgThrow("Native serialization archive is from a newer version",toStr(version));
+    in.scalar(hash);
+    if (hash != schemaHash)
+        fgThrow("Native serialization archive does not match the structure of the type being read");
+}
+
+bool
+isNative(char const * data,size_t size)
+{
+    return ((size >= 24) && (memcmp(data,nativeMagic,8) == 0));
+}
+
 // TEST
 
 struct  FgSerTest
@@ -76,4 +143,172 @@ fgSerTest(CLArgs const &)
     fgout << fgnl << sig;
 }
 
+namespace {
+
+template<class T>
+void
+testRoundTrip(T const & val)
+{
+    T               ret;
+    fromSer(toSer(val),ret);
+    FGASSERT(ret == val);
+}
+
+}
+
+void
+testSerial(CLArgs const &)
+{
+    randSeedRepeatable();
+    // Same format as fgSer / fgDsr:
+    Svec<uint>          uints(1000);
+    for (uint & u : uints)
+        u = randUint();
+    Strings             strs {"", "a", "hello world", String(1000,'x')};
+    FGASSERT(toSer(uints) == fgSer(uints));
+    FGASSERT(toSer(strs) == fgSer(strs));
+    FGASSERT(toSer(-5L) == fgSer(-5L));
+    {
+        Strings             tmp;
+        String              blob = fgSer(strs);
+        fromSer(blob,tmp);
+        FGASSERT(tmp == strs);
+    }
+    // Round trips:
+    testRoundTrip(-7);
+    testRoundTrip(3000000000UL);
+    testRoundTrip(-3L);
+    testRoundTrip(true);
+    testRoundTrip(3.14159f);
+    testRoundTrip(uints);
+    testRoundTrip(strs);
+    testRoundTrip(Svec<Svec<int> >{{1,2},{},{3}});
+    testRoundTrip(Vec3Fs{Vec3F(1,2,3),Vec3F(-1,0.5f,1e30f)});
+    testRoundTrip(Svec<Mat<String,2,1> >{Mat<String,2,1>("a","bc")});
+    testRoundTrip(MatD(2,3,1.5));
+    ImgC4UC             img(17,5,RgbaUC(1,2,3,4));
+    img.xy(3,2) = RgbaUC(9,8,7,6);
+    testRoundTrip(img);
+    // Explicit little-endian layout:
+    FGASSERT(toSer(0x01020304U) == String("\x04\x03\x02\x01",4));
+    FGASSERT(serSwap(0x0102030405060708ULL) == 0x0807060504030201ULL);
+    // Truncated or corrupt data is detected before allocating:
+    {
+        String              blob = toSer(uints);
+        bool                threw = false;
+        try {Svec<uint> tmp; fromSer(blob.substr(0,blob.size()-1),tmp); }
+        catch (FgException const &) {threw = true; }
+        FGASSERT(threw);
+        threw = false;
+        try {Svec<double> tmp; fromSer(toSer(uint64(1) << 60),tmp); }
+        catch (FgException const &) {threw = true; }
+        FGASSERT(threw);
+    }
+}
+
+namespace {
+
+enum struct TestEnum {a, b, c};
+
+struct  TestNative
+{
+    String                  name;
+    Vec3Fs                  verts;
+    Svec<Vec3UI>            tris;
+    ImgC4UC                 img;
+    std::map<String,double> params;
+    TestEnum                mode = TestEnum::a;
+    FG_SERIALIZE6(name,verts,tris,img,params,mode)
+
+    bool
+    operator==(TestNative const & rhs) const
+    {
+        return ((name == rhs.name) && (verts == rhs.verts) && (tris == rhs.tris) && (img == rhs.img) &&
+                (params == rhs.params) && (mode == rhs.mode));
+    }
+};
+
+struct  TestNativeRenamed
+{
+    String                  title;
+    Vec3Fs                  positions;
+    Svec<Vec3UI>            tris;
+    ImgC4UC                 img;
+    std::map<String,double> params;
+    TestEnum                mode;
+    FG_SERIALIZE6(title,positions,tris,img,params,mode)
+};
+
+struct  TestNativeReordered
+{
+    Vec3Fs                  verts;
+    String                  name;
+    Svec<Vec3UI>            tris;
+    ImgC4UC                 img;
+    std::map<String,double> params;
+    TestEnum                mode;
+    FG_SERIALIZE6(verts,name,tris,img,params,mode)
+};
+
+}
+
+void
+testNativeArchive(CLArgs const &)
+{
+    randSeedRepeatable();
+    TestNative              val;
+    val.name = "test";
+    val.verts.resize(size_t(1) << 20);
+    for (Vec3F & v : val.verts)
+        v = Vec3F(randNormal(),randNormal(),randNormal());
+    val.tris.resize(size_t(1) << 20);
+    for (Vec3UI & t : val.tris)
+        t = Vec3UI(randUint(),randUint(),randUint());
+    val.img = ImgC4UC(64,32,RgbaUC(1,2,3,4));
+    val.params["x"] = 1.5;
+    val.params["y"] = -2.0;
+    val.mode = TestEnum::c;
+    // Round trip:
+    String                  blob = toNative(val);
+    FGASSERT(isNative(blob));
+    TestNative              ret;
+    fromNative(blob,ret);
+    FGASSERT(ret == val);
+    // Schema hash ignores member names but not structure:
+    FGASSERT(serSchemaHash<TestNative>() == serSchemaHash<TestNativeRenamed>());
+    FGASSERT(serSchemaHash<TestNative>() != serSchemaHash<TestNativeReordered>());
+    FGASSERT(serSchemaHash<Vec3Fs>() != serSchemaHash<Vec3Ds>());
+    FGASSERT(serSchemaHash<long>() == serSchemaHash<int64>());
+    {
+        TestNativeRenamed       renamed;
+        fromNative(blob,renamed);
+        FGASSERT(renamed.positions == val.verts);
+        bool                    threw = false;
+        try {TestNativeReordered tmp; fromNative(blob,tmp); }
+        catch (FgException const &) {threw = true; }
+        FGASSERT(threw);
+        threw = false;
+        try {TestNative tmp; fromNative(fgSerialize(val),tmp); }
+        catch (FgException const &) {threw = true; }
+        FGASSERT(threw);
+    }
+    // IPT binary persistence uses the native format and still reads the previous format:
+    {
+        TestDir                 td("nativeArchive");
+        ImgC4UC                 img(5,3,RgbaUC(9,8,7,6));
+        saveBsaPBin("store",img);
+        {
+            IPT<ImgC4UC>            ipt;
+            ipt.initSaved(ImgC4UC(),"store",true);
+            FGASSERT(ipt.cref() == img);
+            ipt.ref().xy(0,0) = RgbaUC(0);
+        }
+        FGASSERT(isNative(loadRawString("store")));
+        img.xy(0,0) = RgbaUC(0);
+        IPT<ImgC4UC>            ipt;
+        ipt.initSaved(ImgC4UC(),"store",true);
+        FGASSERT(ipt.cref() == img);
+    }
+}
+
 }
@@ -11,12 +11,18 @@
 //   1. version updates are not forward compatible
 //   2. portable binary serialization is not directly supported but relies on an example file
 //   3. class or field name changes can break compatibility
+//
+// 'fgSer' / 'fgDsr' return and slice a string per element. For large data use 'SerOut' / 'SerIn'
+// (via 'toSer' / 'fromSer') below, which write the same format (little-endian on all platforms)
+// to a single growable buffer and read it back from a span, with bulk copies for arrays.
 
 #ifndef FGSERIAL_HPP
 #define FGSERIAL_HPP
 
 #include "FgStdString.hpp"
 #include "FgStdVector.hpp"
+#include "FgImageBase.hpp"
+#include "FgMatrixV.hpp"
 
 namespace Fg {
 
@@ -124,6 +130,579 @@ fgDsr(const char * & ptr,const char * end,Svec<T> & v)
         fgDsr(ptr,end,v[ii]);
 }
 
+
+// BUFFERED SERIALIZATION
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+constexpr bool serBigEndian = true;
+#else
+constexpr bool serBigEndian = false;
+#endif
+
+template<class T>
+inline
+T
+serSwap(T v)
+{
+    T               ret;
+    char const *    src = reinterpret_cast<char const *>(&v);
+    char *          dst = reinterpret_cast<char *>(&ret);
+    for (size_t ii=0; ii<sizeof(T); ++ii)
+        dst[ii] = src[sizeof(T)-1-ii];
+    return ret;
+}
+
+// Types whose serialized form is their in-memory layout (modulo byte order), so contiguous arrays
+// of them can be copied in bulk. 'Scalar' is the builtin type making up 'num' elements of 'T':
+template<class T>
+struct  SerPod
+{
+    static const bool   value = false;
+    typedef T           Scalar;
+    static const size_t num = 1;
+};
+
+template<class T,uint nrows,uint ncols>
+struct  SerPod<Mat<T,nrows,ncols> >
+{
+    static const bool   value = SerPod<T>::value;
+    typedef typename SerPod<T>::Scalar Scalar;
+    static const size_t num = SerPod<T>::num * nrows * ncols;
+};
+
+template<class T>
+struct  SerPod<Rgba<T> >
+{
+    static const bool   value = SerPod<T>::value;
+    typedef typename SerPod<T>::Scalar Scalar;
+    static const size_t num = SerPod<T>::num * 4;
+};
+
+// Growable output buffer. The allocation cost is amortized over the whole object rather than
+// incurred per element:
+struct  SerOut
+{
+    String              data;
+
+    void
+    reserve(size_t bytes)
+    {data.reserve(bytes); }
+
+    void
+    raw(void const * ptr,size_t bytes)
+    {data.append(static_cast<char const *>(ptr),bytes); }
+
+    template<class T>
+    void
+    scalar(T v)
+    {
+        if (serBigEndian)
+            v = serSwap(v);
+        raw(&v,sizeof(T));
+    }
+
+    template<class T>
+    void
+    pods(T const * ptr,size_t num)
+    {
+        typedef typename SerPod<T>::Scalar  S;
+        static_assert(sizeof(T) == sizeof(S)*SerPod<T>::num,"SerPod type has padding");
+        if (serBigEndian) {
+            S const *           sp = reinterpret_cast<S const *>(ptr);
+            for (size_t ii=0; ii<num*SerPod<T>::num; ++ii)
+                scalar(sp[ii]);
+        }
+        else
+            raw(ptr,num*sizeof(T));
+    }
+};
+
+// Reads from a span of serialized data which must remain valid during use:
+struct  SerIn
+{
+    char const *        ptr;
+    char const *        end;
+
+    SerIn(char const * data,size_t size) : ptr(data), end(data+size) {}
+    explicit SerIn(String const & data) : ptr(data.data()), end(data.data()+data.size()) {}
+
+    size_t
+    remaining() const
+    {return size_t(end-ptr); }
+
+    void
+    raw(void * dst,size_t bytes)
+    {
+        FGASSERT(bytes <= remaining());
+        if (bytes > 0)
+            std::memcpy(dst,ptr,bytes);
+        ptr += bytes;
+    }
+
+    template<class T>
+    void
+    scalar(T & v)
+    {
+        raw(&v,sizeof(T));
+        if (serBigEndian)
+            v = serSwap(v);
+    }
+
+    template<class T>
+    void
+    pods(T * dst,size_t num)
+    {
+        typedef typename SerPod<T>::Scalar  S;
+        static_assert(sizeof(T) == sizeof(S)*SerPod<T>::num,"SerPod type has padding");
+        FGASSERT(num <= remaining() / sizeof(T));
+        raw(dst,num*sizeof(T));
+        if (serBigEndian) {
+            S *                 sp = reinterpret_cast<S *>(dst);
+            for (size_t ii=0; ii<num*SerPod<T>::num; ++ii)
+                sp[ii] = serSwap(sp[ii]);
+        }
+    }
+
+    // Size prefix for 'num' elements of at least 'minBytes' each, checked against the remaining data
+    // before anything is allocated:
+    size_t
+    count(size_t minBytes)
+    {
+        uint64          num;
+        scalar(num);
+        FGASSERT(num <= remaining() / std::max(minBytes,size_t(1)));
+        return size_t(num);
+    }
+};
+
+#define FG_SER_POD(T)                                                                   \
+    template<> struct SerPod<T> {static const bool value = true; typedef T Scalar; static const size_t num = 1; }; \
+    inline void ser_(SerOut & out,T v) {out.scalar(v); }                                \
+    inline void dsr_(SerIn & in,T & v) {in.scalar(v); }
+
+FG_SER_POD(char)
+FG_SER_POD(uchar)
+FG_SER_POD(short)
+FG_SER_POD(ushort)
+FG_SER_POD(int)
+FG_SER_POD(uint)
+FG_SER_POD(long long)
+FG_SER_POD(unsigned long long)
+FG_SER_POD(float)
+FG_SER_POD(double)
+
+// Handle the LLP64 - LP64 difference:
+inline void ser_(SerOut & out,long v) {out.scalar(int64(v)); }
+inline void ser_(SerOut & out,unsigned long v) {out.scalar(uint64(v)); }
+void dsr_(SerIn & in,long & v);
+void dsr_(SerIn & in,unsigned long & v);
+
+inline void ser_(SerOut & out,bool v) {out.scalar(uchar(v ? 1 : 0)); }
+void dsr_(SerIn & in,bool & v);
+
+inline
+void
+ser_(SerOut & out,String const & str)
+{
+    out.scalar(uint64(str.size()));
+    out.raw(str.data(),str.size());
+}
+
+inline
+void
+dsr_(SerIn & in,String & str)
+{
+    size_t          sz = in.count(1);
+    str.assign(in.ptr,sz);
+    in.ptr += sz;
+}
+
+template<class T>
+void
+serArr_(SerOut & out,T const * ptr,size_t num,std::true_type)
+{out.pods(ptr,num); }
+
+template<class T>
+void
+serArr_(SerOut & out,T const * ptr,size_t num,std::false_type)
+{
+    for (size_t ii=0; ii<num; ++ii)
+        ser_(out,ptr[ii]);
+}
+
+template<class T>
+void
+dsrArr_(SerIn & in,T * ptr,size_t num,std::true_type)
+{in.pods(ptr,num); }
+
+template<class T>
+void
+dsrArr_(SerIn & in,T * ptr,size_t num,std::false_type)
+{
+    for (size_t ii=0; ii<num; ++ii)
+        dsr_(in,ptr[ii]);
+}
+
+template<class T>
+void
+ser_(SerOut & out,Svec<T> const & v)
+{
+    out.scalar(uint64(v.size()));
+    serArr_(out,v.data(),v.size(),std::integral_constant<bool,SerPod<T>::value>());
+}
+
+template<class T>
+void
+dsr_(SerIn & in,Svec<T> & v)
+{
+    v.resize(in.count(SerPod<T>::value ? sizeof(T) : 1));
+    dsrArr_(in,v.data(),v.size(),std::integral_constant<bool,SerPod<T>::value>());
+}
+
+template<class T,uint nrows,uint ncols>
+void
+ser_(SerOut & out,Mat<T,nrows,ncols> const & mat)
+{serArr_(out,mat.m.data(),nrows*ncols,std::integral_constant<bool,SerPod<T>::value>()); }
+
+template<class T,uint nrows,uint ncols>
+void
+dsr_(SerIn & in,Mat<T,nrows,ncols> & mat)
+{dsrArr_(in,mat.m.data(),nrows*ncols,std::integral_constant<bool,SerPod<T>::value>()); }
+
+template<class T>
+void
+ser_(SerOut & out,Rgba<T> const & v)
+{ser_(out,v.m_c); }
+
+template<class T>
+void
+dsr_(SerIn & in,Rgba<T> & v)
+{dsr_(in,v.m_c); }
+
+template<class T>
+void
+ser_(SerOut & out,Img<T> const & img)
+{
+    ser_(out,img.m_dims);
+    ser_(out,img.m_data);
+}
+
+template<class T>
+void
+dsr_(SerIn & in,Img<T> & img)
+{
+    Vec2UI          dims;
+    dsr_(in,dims);
+    dsr_(in,img.m_data);
+    FGASSERT(img.m_data.size() == size_t(dims[0])*dims[1]);
+    img.m_dims = dims;
+}
+
+template<class T>
+void
+ser_(SerOut & out,MatV<T> const & mat)
+{
+    out.scalar(mat.nrows);
+    out.scalar(mat.ncols);
+    ser_(out,mat.m_data);
+}
+
+template<class T>
+void
+dsr_(SerIn & in,MatV<T> & mat)
+{
+    uint            nrows,ncols;
+    in.scalar(nrows);
+    in.scalar(ncols);
+    dsr_(in,mat.m_data);
+    FGASSERT(mat.m_data.size() == size_t(nrows)*ncols);
+    mat.nrows = nrows;
+    mat.ncols = ncols;
+}
+
+template<class T,class U>
+void
+ser_(SerOut & out,std::pair<T,U> const & pair)
+{
+    ser_(out,pair.first);
+    ser_(out,pair.second);
+}
+
+template<class T,class U>
+void
+dsr_(SerIn & in,std::pair<T,U> & pair)
+{
+    dsr_(in,pair.first);
+    dsr_(in,pair.second);
+}
+
+template<class K,class V>
+void
+ser_(SerOut & out,std::map<K,V> const & map)
+{
+    out.scalar(uint64(map.size()));
+    for (auto const & kv : map) {
+        ser_(out,kv.first);
+        ser_(out,kv.second);
+    }
+}
+
+template<class K,class V>
+void
+dsr_(SerIn & in,std::map<K,V> & map)
+{
+    size_t          num = in.count(1);
+    map.clear();
+    for (size_t ii=0; ii<num; ++ii) {
+        K               key;
+        V               val;
+        dsr_(in,key);
+        dsr_(in,val);
+        map.emplace_hint(map.end(),std::move(key),std::move(val));
+    }
+}
+
+// Types declaring their members with FG_SERIALIZE (boost serialization) are handled by passing
+// these adapters as the archive. The current class version (BOOST_CLASS_VERSION) is passed so all
+// members of versioned types are included:
+struct  SerOutArchive
+{
+    SerOut &            out;
+
+    explicit SerOutArchive(SerOut & o) : out(o) {}
+
+    template<class T>
+    SerOutArchive &
+    operator&(boost::serialization::nvp<T> const & nvp)
+    {
+        ser_(out,nvp.const_value());
+        return *this;
+    }
+};
+
+struct  SerInArchive
+{
+    SerIn &             in;
+
+    explicit SerInArchive(SerIn & i) : in(i) {}
+
+    template<class T>
+    SerInArchive &
+    operator&(boost::serialization::nvp<T> const & nvp)
+    {
+        dsr_(in,nvp.value());
+        return *this;
+    }
+};
+
+// Enums are stored as int as with boost serialization:
+template<class T>
+void
+serObj_(SerOut & out,T const & val,std::true_type)
+{out.scalar(int(val)); }
+
+template<class T>
+void
+serObj_(SerOut & out,T const & val,std::false_type)
+{
+    SerOutArchive       ar(out);
+    const_cast<T &>(val).serialize(ar,boost::serialization::version<T>::value);
+}
+
+template<class T>
+void
+dsrObj_(SerIn & in,T & val,std::true_type)
+{
+    int                 tmp;
+    in.scalar(tmp);
+    val = T(tmp);
+}
+
+template<class T>
+void
+dsrObj_(SerIn & in,T & val,std::false_type)
+{
+    SerInArchive        ar(in);
+    val.serialize(ar,boost::serialization::version<T>::value);
+}
+
+// Overloads above take precedence over these:
+template<class T>
+void
+ser_(SerOut & out,T const & val)
+{serObj_(out,val,std::is_enum<T>()); }
+
+template<class T>
+void
+dsr_(SerIn & in,T & val)
+{dsrObj_(in,val,std::is_enum<T>()); }
+
+template<class T>
+String
+toSer(T const & val)
+{
+    SerOut          out;
+    ser_(out,val);
+    return out.data;
+}
+
+// Throws if the data is not entirely consumed:
+template<class T>
+void
+fromSer(String const & data,T & val)
+{
+    SerIn           in(data);
+    dsr_(in,val);
+    FGASSERT(in.remaining() == 0);
+}
+
+// SCHEMA HASH
+
+// Hash of the serialized structure of a type; the sequence of builtin types and containers.
+// Member names are not included so renaming a member does not change the hash, but changing,
+// adding, removing or reordering members does:
+template<class T>
+struct  SerTag {};
+
+#define FG_SER_SCHEMA(T,H) inline uint64 serSchema(SerTag<T>) {return H; }
+
+FG_SER_SCHEMA(char,fgSerSig<char>())
+FG_SER_SCHEMA(uchar,0x1D4E2B4C6A5F2E93ULL)
+FG_SER_SCHEMA(short,0x8C0E33A1D45B6F17ULL)
+FG_SER_SCHEMA(ushort,0x4B9D1E7A20C3F865ULL)
+FG_SER_SCHEMA(int,fgSerSig<int>())
+FG_SER_SCHEMA(uint,fgSerSig<unsigned int>())
+FG_SER_SCHEMA(long long,fgSerSig<long long>())
+FG_SER_SCHEMA(unsigned long long,fgSerSig<unsigned long long>())
+// LLP64 - LP64 difference:
+FG_SER_SCHEMA(long,fgSerSig<long long>())
+FG_SER_SCHEMA(unsigned long,fgSerSig<unsigned long long>())
+FG_SER_SCHEMA(float,0xE8A3C2917B5D0F44ULL)
+FG_SER_SCHEMA(double,0x36F0B4D82C9E1A7BULL)
+FG_SER_SCHEMA(bool,0xA5C7182F9E3B6D01ULL)
+FG_SER_SCHEMA(String,fgSerSig<String>())
+
+template<class T>
+uint64
+serSchema(SerTag<Svec<T> >)
+{return fgHash(0x9A77AEB690E81D6EULL,serSchema(SerTag<T>())); }
+
+template<class T,uint nrows,uint ncols>
+uint64
+serSchema(SerTag<Mat<T,nrows,ncols> >)
+{return fgHash(0x5F0D2C7E91A4B368ULL,uint64(nrows)*ncols,serSchema(SerTag<T>())); }
+
+// Same serialized form as Mat<T,4,1>:
+template<class T>
+uint64
+serSchema(SerTag<Rgba<T> >)
+{return serSchema(SerTag<Mat<T,4,1> >()); }
+
+template<class T>
+uint64
+serSchema(SerTag<Img<T> >)
+{return fgHash(0x2E6B9F04C7D13A85ULL,serSchema(SerTag<T>())); }
+
+template<class T>
+uint64
+serSchema(SerTag<MatV<T> >)
+{return fgHash(0xC41A8E3B6F2D9057ULL,serSchema(SerTag<T>())); }
+
+template<class T,class U>
+uint64
+serSchema(SerTag<std::pair<T,U> >)
+{return fgHash(0x7B3E05D9A1C64F28ULL,serSchema(SerTag<T>()),serSchema(SerTag<U>())); }
+
+template<class K,class V>
+uint64
+serSchema(SerTag<std::map<K,V> >)
+{return fgHash(0xD8926C1F4E07B3A9ULL,serSchema(SerTag<K>()),serSchema(SerTag<V>())); }
+
+struct  SerSchemaArchive
+{
+    uint64              hash = 0x63A9D5E0172B8FC4ULL;
+
+    template<class T>
+    SerSchemaArchive &
+    operator&(boost::serialization::nvp<T> const &)
+    {
+        hash = fgHash(hash,serSchema(SerTag<typename std::remove_const<T>::type>()));
+        return *this;
+    }
+};
+
+template<class T>
+uint64
+serSchemaObj(std::true_type)
+{return serSchema(SerTag<int>()); }
+
+template<class T>
+uint64
+serSchemaObj(std::false_type)
+{
+    T                   tmp;
+    SerSchemaArchive    ar;
+    tmp.serialize(ar,boost::serialization::version<T>::value);
+    return ar.hash;
+}
+
+template<class T>
+uint64
+serSchema(SerTag<T>)
+{return serSchemaObj<T>(std::is_enum<T>()); }
+
+template<class T>
+uint64
+serSchemaHash()
+{
+    static uint64       hash = serSchema(SerTag<T>());
+    return hash;
+}
+
+// NATIVE ARCHIVE
+
+// Versioned binary archive for types supported by 'ser_' / 'dsr_', including those declaring
+// their members with FG_SERIALIZE. Arrays are written in bulk and there is no per-object
+// tracking or virtual dispatch as with boost archives. The header contains the schema hash
+// so reading into an incompatible type fails rather than silently misreading:
+
+void
+serNativeHeader_(SerOut & out,uint64 schemaHash);
+
+// Throws if the header is not valid or the schema hash does not match:
+void
+dsrNativeHeader_(SerIn & in,uint64 schemaHash);
+
+// Returns true if the data starts with a native archive header (of any version):
+bool
+isNative(char const * data,size_t size);
+inline bool isNative(String const & data) {return isNative(data.data(),data.size()); }
+
+template<class T>
+String
+toNative(T const & val)
+{
+    SerOut          out;
+    serNativeHeader_(out,serSchemaHash<T>());
+    ser_(out,val);
+    return out.data;
+}
+
+template<class T>
+void
+fromNative(char const * data,size_t size,T & val)
+{
+    SerIn           in(data,size);
+    dsrNativeHeader_(in,serSchemaHash<T>());
+    dsr_(in,val);
+    FGASSERT(in.remaining() == 0);
+}
+
+template<class T>
+void
+fromNative(String const & data,T & val)
+{fromNative(data.data(),data.size(),val); }
+
 }
 
 #endif
@@ -11,6 +11,9 @@
 #include "FgBounds.hpp"
 #include "FgApproxEqual.hpp"
 #include "FgMain.hpp"
+#include "FgParallel.hpp"
+#include "FgRandom.hpp"
+#include "FgTestUtils.hpp"
 
 using namespace std;
 
@@ -26,30 +29,54 @@ similarityRand()
             Vec3D::randNormal());
 }
 
+namespace {
+
 // Uses approach originally from [Horn '87 "Closed-Form Solution of Absolute Orientation..."
-// (taken from [Jain '95 "machine vision" 12.3]) to find an approximate similarity transform
-// between two sets of corresponding points, FROM the domain points TO the range points:
+// (taken from [Jain '95 "machine vision" 12.3]) with each point's contribution to the sufficient
+// statistics weighted. Optionally fits scale, otherwise scale is 1:
 SimilarityD
-similarityApprox(Vec3Ds const & domainPts,Vec3Ds const & rangePts)
+hornWeighted(Vec3Ds const & domainPts,Vec3Ds const & rangePts,Doubles const & weights,bool fitScale)
 {
-    SimilarityD     ret;
-    FGASSERT(domainPts.size() > 2);     // Not solvable with only 2 points.
-    uint            numPts = uint(domainPts.size());
-    FGASSERT(numPts == rangePts.size());
-    // Compute the sufficient statistics for scale & rotation
-    Vec3D           domMean = cMean(domainPts),
-                    ranMean = cMean(rangePts);
+    size_t          numPts = domainPts.size();
+    FGASSERT(rangePts.size() == numPts);
+    FGASSERT(weights.empty() || (weights.size() == numPts));
+    double          wgtSum = 0.0;
+    size_t          numNonZero = 0;
+    Vec3D           domMean(0),
+                    ranMean(0);
+    for (size_t ii=0; ii<numPts; ++ii) {
+        double          w = weights.empty() ? 1.0 : weights[ii];
+        FGASSERT(w >= 0.0);
+        if (w > 0.0) {
+            wgtSum += w;
+            ++numNonZero;
+            domMean += domainPts[ii] * w;
+            ranMean += rangePts[ii] * w;
+        }
+    }
+    if (numNonZero < 3)
+        fgThrow("Similarity alignment requires at least 3 points with non-zero weight",numNonZero);
+    domMean /= wgtSum;
+    ranMean /= wgtSum;
+    // Compute the sufficient statistics for scale & rotation:
     double          domRayMag = 0.0,
                     ranRayMag = 0.0;
-    Mat33D     S(0.0);
-    for (uint ii=0; ii<numPts; ii++) {
-        Vec3D       domRay = domainPts[ii] - domMean,
-                    ranRay = rangePts[ii] - ranMean;
-        domRayMag += domRay.mag();
-        ranRayMag += ranRay.mag();
-        S += domRay * ranRay.transpose();
+    Mat33D          S(0.0);
+    for (size_t ii=0; ii<numPts; ++ii) {
+        double          w = weights.empty() ? 1.0 : weights[ii];
+        if (w > 0.0) {
+            Vec3D           domRay = domainPts[ii] - domMean,
+                            ranRay = rangePts[ii] - ranMean;
+            domRayMag += domRay.mag() * w;
+            ranRayMag += ranRay.mag() * w;
+            S += domRay * ranRay.transpose() * w;
+        }
     }
-    double          scale = sqrt(ranRayMag / domRayMag );
+    if (!(domRayMag > 0.0))
+        fgThrow("Similarity alignment domain points are coincident");
+    double          scale = fitScale ? sqrt(ranRayMag / domRayMag) : 1.0;
+    if (!(scale > 0.0))
+        fgThrow("Similarity alignment range points are coincident");
     Mat44D          N(0.0);
     double  Sxx = S.cr(0,0),   Sxy = S.cr(1,0),   Sxz = S.cr(2,0),
             Syx = S.cr(0,1),   Syy = S.cr(1,1),   Syz = S.cr(2,1),
@@ -66,17 +93,298 @@ similarityApprox(Vec3Ds const & domainPts,Vec3Ds const & rangePts)
     N.cr(2,2) = Syy-Sxx-Szz;
     N.cr(3,3) = Szz-Sxx-Syy;
     // Calculate rotation from N per [Jain '95]. 'cEigsRsm' Leaves largest eigVal in last index:
-    QuaternionD         pose(cEigsRsm(N).vecs.colVec(3));
+    QuaternionD     pose(cEigsRsm(N).vecs.colVec(3));
     // Calculate the 'trans' term: The transform is given by:
     // X = SR(d-dm)+rm = SR(d)-SR(dm)+rm
-    Vec3D               trans = -scale * (pose.asMatrix() * domMean) + ranMean;
-    ret = SimilarityD(scale,pose,trans);
+    Vec3D           trans = -scale * (pose.asMatrix() * domMean) + ranMean;
+    return SimilarityD(scale,pose,trans);
+}
+
+Vec3D
+applyXf(SimilarityD const & s,Vec3D const & v)
+{return s * v; }
+
+Vec3D
+applyXf(Affine3D const & a,Vec3D const & v)
+{return a * v; }
+
+double
+lossWeight(RobustLoss loss,double c,double u)     // 'u' is the residual in units of the residual scale
+{
+    if (loss == RobustLoss::huber)
+        return (u <= c) ? 1.0 : c / u;
+    if (loss == RobustLoss::cauchy)
+        return 1.0 / (1.0 + sqr(u/c));
+    if (loss == RobustLoss::tukey)
+        return (u < c) ? sqr(1.0 - sqr(u/c)) : 0.0;
+    return 1.0;
+}
+
+double
+defaultTuning(RobustLoss loss)
+{
+    if (loss == RobustLoss::huber)
+        return 1.345;
+    if (loss == RobustLoss::cauchy)
+        return 2.385;
+    return 4.685;
+}
+
+double
+medianOf(Doubles vals)
+{
+    FGASSERT(!vals.empty());
+    auto            mid = vals.begin() + vals.size()/2;
+    nth_element(vals.begin(),mid,vals.end());
+    return *mid;
+}
+
+template<class T>
+RobustAlign<T>
+alignRobust(
+    Vec3Ds const &          domainPts,
+    Vec3Ds const &          rangePts,
+    RobustOptions const &   opts,
+    Doubles const &         weightsIn,
+    size_t                  setIdx,
+    size_t                  minPts,
+    function<T(Vec3Ds const &,Vec3Ds const &,Doubles const &)> const & fit)
+{
+    size_t                  numPts = domainPts.size();
+    FGASSERT(rangePts.size() == numPts);
+    FGASSERT(weightsIn.empty() || (weightsIn.size() == numPts));
+    Doubles                 prior = weightsIn.empty() ? Doubles(numPts,1.0) : weightsIn;
+    Sizes                   candidates;
+    for (size_t ii=0; ii<numPts; ++ii)
+        if (prior[ii] > 0.0)
+            candidates.push_back(ii);
+    if (candidates.size() < minPts)
+        fgThrow("Robust alignment requires more points with non-zero weight",candidates.size());
+    auto                    residuals = [&](T const & xf)
+    {
+        Doubles                 ret(numPts);
+        for (size_t ii=0; ii<numPts; ++ii)
+            ret[ii] = (rangePts[ii] - applyXf(xf,domainPts[ii])).len();
+        return ret;
+    };
+    RobustAlign<T>          ret;
+    if (opts.ransacIters > 0) {
+        FGASSERT(opts.inlierThreshold > 0.0);
+        RandSeq                 rand(RandStream(opts.ransacSeed,setIdx));
+        double                  bestScore = -1.0;
+        Doubles                 bestInliers;
+        for (uint it=0; it<opts.ransacIters; ++it) {
+            Vec3Ds                  sd,sr;
+            Sizes                   sample;
+            while (sample.size() < minPts) {
+                size_t                  idx = candidates[rand.nextUint(uint(candidates.size()))];
+                if (!contains(sample,idx)) {
+                    sample.push_back(idx);
+                    sd.push_back(domainPts[idx]);
+                    sr.push_back(rangePts[idx]);
+                }
+            }
+            T                       xf;
+            try {xf = fit(sd,sr,Doubles()); }
+            catch (FgException const &) {continue; }    // Degenerate sample
+            Doubles                 res = residuals(xf),
+                                    inliers(numPts,0.0);
+            double                  score = 0.0;
+            for (size_t ii=0; ii<numPts; ++ii) {
+                if (res[ii] < opts.inlierThreshold) {
+                    inliers[ii] = prior[ii];
+                    // Prefer tighter consensus among equal counts:
+                    score += prior[ii] * (1.0 - 0.5 * res[ii] / opts.inlierThreshold);
+                }
+            }
+            if (score > bestScore) {
+                bestScore = score;
+                bestInliers = inliers;
+            }
+        }
+        size_t                  numBest = 0;
+        for (double w : bestInliers)
+            if (w > 0.0)
+                ++numBest;
+        if (numBest < minPts)
+            fgThrow("RANSAC alignment found no consensus",numBest);
+        ret.xform = fit(domainPts,rangePts,bestInliers);
+    }
+    else
+        ret.xform = fit(domainPts,rangePts,prior);
+    double                  tuning = (opts.tuning > 0.0) ? opts.tuning : defaultTuning(opts.loss);
+    double                  sizeSq = 0.0;
+    Vec3D                   ranMean = cMean(rangePts);
+    for (Vec3D const & r : rangePts)
+        sizeSq += (r - ranMean).mag();
+    double                  tolAbs = opts.tolerance * sqrt(sizeSq / double(numPts));
+    ret.weights = prior;
+    Doubles                 res = residuals(ret.xform);
+    for (uint it=0; it<opts.maxIters; ++it) {
+        double                  scale = opts.scale;
+        if (!(scale > 0.0)) {
+            Doubles                 cres;
+            for (size_t idx : candidates)
+                cres.push_back(res[idx]);
+            scale = 1.4826 * medianOf(cres);
+        }
+        ret.residualScale = scale;
+        if (!(scale > tolAbs))           // Exact fit of at least half the points
+            break;
+        Doubles                 wgts(numPts);
+        size_t                  numNonZero = 0;
+        for (size_t ii=0; ii<numPts; ++ii) {
+            wgts[ii] = prior[ii] * lossWeight(opts.loss,tuning,res[ii]/scale);
+            if (wgts[ii] > 0.0)
+                ++numNonZero;
+        }
+        if (numNonZero < minPts)
+            break;
+        T                       xf;
+        try {xf = fit(domainPts,rangePts,wgts); }
+        catch (FgException const &) {break; }
+        ++ret.iterations;
+        double                  change = 0.0;
+        for (Vec3D const & d : domainPts)
+            change += (applyXf(xf,d) - applyXf(ret.xform,d)).mag();
+        ret.xform = xf;
+        ret.weights = wgts;
+        res = residuals(xf);
+        if (sqrt(change / double(numPts)) < tolAbs)
+            break;
+    }
+    double                  inlierThresh = (opts.inlierThreshold > 0.0) ? opts.inlierThreshold : 2.5 * ret.residualScale;
+    for (size_t idx : candidates)
+        if (res[idx] <= inlierThresh)
+            ++ret.numInliers;
+    return ret;
+}
+
+template<class T>
+Svec<Opt<T> >
+alignBatch(
+    Svec<Vec3Ds> const &    domains,
+    Svec<Vec3Ds> const &    ranges,
+    Svec<Doubles> const &   weights,
+    size_t                  maxThreads,
+    function<T(Vec3Ds const &,Vec3Ds const &,Doubles const &,size_t)> const & fn)
+{
+    FGASSERT(ranges.size() == domains.size());
+    FGASSERT(weights.empty() || (weights.size() == domains.size()));
+    Svec<Opt<T> >           ret(domains.size());
+    parallelFor(domains.size(),[&](size_t ii)
+    {
+        // A set which can't be aligned is left invalid rather than failing the whole batch:
+        try {ret[ii] = fn(domains[ii],ranges[ii],weights.empty() ? Doubles() : weights[ii],ii); }
+        catch (FgException const &) {}
+    },maxThreads);
+    return ret;
+}
+
+}
+
+SimilarityD
+similarityApprox(Vec3Ds const & domainPts,Vec3Ds const & rangePts)
+{
+    SimilarityD         ret = hornWeighted(domainPts,rangePts,Doubles(),true);
     // Measure residual:
     double  resid = cRms(rangePts-mapMul(ret.asAffine(),domainPts)) / cMaxElem(cDims(rangePts));
     fgout << fgnl << "SimilarityApprox() relative RMS residual: " << resid;
     return ret;
 }
 
+SimilarityD
+similarityApprox(Vec3Ds const & domainPts,Vec3Ds const & rangePts,Doubles const & weights)
+{return hornWeighted(domainPts,rangePts,weights,true); }
+
+SimilarityD
+rigidApprox(Vec3Ds const & domainPts,Vec3Ds const & rangePts,Doubles const & weights)
+{return hornWeighted(domainPts,rangePts,weights,false); }
+
+Affine3D
+affineApprox(Vec3Ds const & domainPts,Vec3Ds const & rangePts,Doubles const & weights)
+{
+    size_t          numPts = domainPts.size();
+    FGASSERT(rangePts.size() == numPts);
+    FGASSERT(weights.empty() || (weights.size() == numPts));
+    // Normal equations in homogeneous domain coordinates, centred on the domain mean for conditioning:
+    Vec3D           domMean = cMean(domainPts);
+    Mat44D          A(0.0);
+    Mat<double,4,3> B(0.0);
+    size_t          numNonZero = 0;
+    for (size_t ii=0; ii<numPts; ++ii) {
+        double          w = weights.empty() ? 1.0 : weights[ii];
+        FGASSERT(w >= 0.0);
+        if (w > 0.0) {
+            Vec3D           d = domainPts[ii] - domMean;
+            Vec4D           h(d[0],d[1],d[2],1.0);
+            A += h * h.transpose() * w;
+            B += h * rangePts[ii].transpose() * w;
+            ++numNonZero;
+        }
+    }
+    if (numNonZero < 4)
+        fgThrow("Affine alignment requires at least 4 points with non-zero weight",numNonZero);
+    Affine3D        ret;
+    for (uint rr=0; rr<3; ++rr) {
+        Opt<Vec4D>      sol = solveLinear(A,B.colVec(rr));
+        if (!sol.valid())
+            fgThrow("Affine alignment domain points are coplanar");
+        Vec4D           s = sol.val();
+        for (uint cc=0; cc<3; ++cc)
+            ret.linear.rc(rr,cc) = s[cc];
+        ret.translation[rr] = s[3];
+    }
+    ret.translation -= ret.linear * domMean;
+    return ret;
+}
+
+RobustSimilarity
+similarityRobust(Vec3Ds const & domainPts,Vec3Ds const & rangePts,RobustOptions const & options,Doubles const & weights,size_t setIdx)
+{
+    return alignRobust<SimilarityD>(domainPts,rangePts,options,weights,setIdx,3,
+        [](Vec3Ds const & d,Vec3Ds const & r,Doubles const & w){return hornWeighted(d,r,w,true); });
+}
+
+RobustSimilarity
+rigidRobust(Vec3Ds const & domainPts,Vec3Ds const & rangePts,RobustOptions const & options,Doubles const & weights,size_t setIdx)
+{
+    return alignRobust<SimilarityD>(domainPts,rangePts,options,weights,setIdx,3,
+        [](Vec3Ds const & d,Vec3Ds const & r,Doubles const & w){return hornWeighted(d,r,w,false); });
+}
+
+RobustAffine
+affineRobust(Vec3Ds const & domainPts,Vec3Ds const & rangePts,RobustOptions const & options,Doubles const & weights,size_t setIdx)
+{return alignRobust<Affine3D>(domainPts,rangePts,options,weights,setIdx,4,affineApprox); }
+
+Svec<Opt<SimilarityD> >
+similarityApproxBatch(Svec<Vec3Ds> const & domains,Svec<Vec3Ds> const & ranges,Svec<Doubles> const & weights,size_t maxThreads)
+{
+    return alignBatch<SimilarityD>(domains,ranges,weights,maxThreads,
+        [](Vec3Ds const & d,Vec3Ds const & r,Doubles const & w,size_t){return hornWeighted(d,r,w,true); });
+}
+
+Svec<Opt<RobustSimilarity> >
+similarityRobustBatch(Svec<Vec3Ds> const & domains,Svec<Vec3Ds> const & ranges,RobustOptions const & options,Svec<Doubles> const & weights,size_t maxThreads)
+{
+    return alignBatch<RobustSimilarity>(domains,ranges,weights,maxThreads,
+        [&options](Vec3Ds const & d,Vec3Ds const & r,Doubles const & w,size_t idx){return similarityRobust(d,r,options,w,idx); });
+}
+
+Svec<Opt<RobustSimilarity> >
+rigidRobustBatch(Svec<Vec3Ds> const & domains,Svec<Vec3Ds> const & ranges,RobustOptions const & options,Svec<Doubles> const & weights,size_t maxThreads)
+{
+    return alignBatch<RobustSimilarity>(domains,ranges,weights,maxThreads,
+        [&options](Vec3Ds const & d,Vec3Ds const & r,Doubles const & w,size_t idx){return rigidRobust(d,r,options,w,idx); });
+}
+
+Svec<Opt<RobustAffine> >
+affineRobustBatch(Svec<Vec3Ds> const & domains,Svec<Vec3Ds> const & ranges,RobustOptions const & options,Svec<Doubles> const & weights,size_t maxThreads)
+{
+    return alignBatch<RobustAffine>(domains,ranges,weights,maxThreads,
+        [&options](Vec3Ds const & d,Vec3Ds const & r,Doubles const & w,size_t idx){return affineRobust(d,r,options,w,idx); });
+}
+
 SimilarityD
 interpolateAsModelview(SimilarityD s0,SimilarityD s1,double val)
 {
@@ -137,6 +445,110 @@ fgSimilarityApproxTest(CLArgs const &)
     }
 }
 
+void
+testSimilarityRobust(CLArgs const &)
+{
+    randSeedRepeatable();
+    size_t              numPts = 60;
+    Vec3Ds              domain = randVecNormals<double,3>(numPts,1.0);
+    SimilarityD         ref = similarityRand();
+    Vec3Ds              range = mapMul(ref.asAffine(),domain);
+    // RMS error of 'xf' on the true correspondences relative to the range size:
+    auto                relErr = [&](Affine3D const & xf)
+    {
+        double              ssd = 0.0;
+        for (size_t ii=0; ii<numPts; ++ii)
+            ssd += (xf * domain[ii] - range[ii]).mag();
+        return sqrt(ssd / cMag(range - Vec3Ds(numPts,cMean(range))));
+    };
+    double const        tol = 1e-9;
+    // Weighted least squares with zero weights on corrupted points is exact:
+    Vec3Ds              corrupt = range;
+    Doubles             weights(numPts,1.0);
+    for (size_t ii=0; ii<numPts; ii+=7) {
+        corrupt[ii] += Vec3D::randNormal() * ref.scale * 3.0;
+        weights[ii] = 0.0;
+    }
+    FGASSERT(relErr(similarityApprox(domain,corrupt,Doubles()).asAffine()) > 0.01);
+    FGASSERT(relErr(similarityApprox(domain,corrupt,weights).asAffine()) < tol);
+    // Rigid and affine solvers:
+    SimilarityD         rigidRef(1.0,ref.rot,ref.trans);
+    Vec3Ds              rigidRange = mapMul(rigidRef.asAffine(),domain);
+    SimilarityD         rigid = rigidApprox(domain,rigidRange,weights);
+    FGASSERT((rigid.scale == 1.0) && isApproxEqualRelMag(mapMul(rigid.asAffine(),domain),rigidRange));
+    Affine3D            affRef(Mat33D::randNormal(),Vec3D::randNormal());
+    Vec3Ds              affRange = mapMul(affRef,domain);
+    FGASSERT(isApproxEqualRelMag(mapMul(affineApprox(domain,affRange,weights),domain),affRange));
+    Vec3Ds              planar {Vec3D(0,0,0),Vec3D(1,0,0),Vec3D(0,1,0),Vec3D(1,1,0)};
+    FG_TEST_CHECK_THROW_1(affineApprox(planar,planar),"Affine alignment domain points are coplanar");
+    // Robust fits with injected outliers and small noise on the inliers:
+    Vec3Ds              noisy = range;
+    double              noise = 0.001 * ref.scale;
+    for (Vec3D & r : noisy)
+        r += Vec3D::randNormal() * noise;
+    Svec<bool>          outlier(numPts,false);
+    for (size_t ii=0; ii<numPts; ii+=3) {       // One third outliers
+        noisy[ii] += Vec3D::randNormal() * ref.scale * 2.0;
+        outlier[ii] = true;
+    }
+    double              olsErr = relErr(similarityApprox(domain,noisy,Doubles()).asAffine());
+    RobustOptions       opts;
+    opts.loss = RobustLoss::tukey;
+    opts.ransacIters = 100;
+    opts.inlierThreshold = noise * 10.0;
+    RobustSimilarity    rs = similarityRobust(domain,noisy,opts);
+    double              robErr = relErr(rs.xform.asAffine());
+    FGASSERT(olsErr > 0.05);
+    FGASSERT(robErr < 0.002);
+    FGASSERT(rs.numInliers == numPts - numPts/3);
+    for (size_t ii=0; ii<numPts; ++ii)
+        FGASSERT(!outlier[ii] || (rs.weights[ii] == 0.0));
+    // IRLS alone handles a smaller fraction of outliers with each loss:
+    Vec3Ds              fewOut = range;
+    for (size_t ii=0; ii<numPts; ii+=10)
+        fewOut[ii] += Vec3D::randNormal() * ref.scale * 2.0;
+    for (RobustLoss loss : {RobustLoss::huber,RobustLoss::cauchy,RobustLoss::tukey}) {
+        RobustOptions       o;
+        o.loss = loss;
+        FGASSERT(relErr(similarityRobust(domain,fewOut,o).xform.asAffine()) < 0.01);
+    }
+    RobustOptions       sq;
+    sq.loss = RobustLoss::squared;
+    FGASSERT(relErr(similarityRobust(domain,fewOut,sq).xform.asAffine()) > 0.01);
+    RobustAffine        ra = affineRobust(domain,mapMul(affRef,domain),opts);
+    FGASSERT(isApproxEqualRelMag(mapMul(ra.xform,domain),affRange));
+    auto                same = [](SimilarityD const & l,SimilarityD const & r)
+    {return (l.scale == r.scale) && (l.rot.real == r.rot.real) && (l.rot.imag == r.rot.imag) && (l.trans == r.trans); };
+    // Batch results match individual results regardless of the number of threads:
+    size_t              numSets = 64;
+    Svec<Vec3Ds>        domains,
+                        ranges;
+    for (size_t ss=0; ss<numSets; ++ss) {
+        Vec3Ds              d = randVecNormals<double,3>(20,1.0),
+                            r = mapMul(similarityRand().asAffine(),d);
+        r[ss%20] += Vec3D(10,0,0);
+        domains.push_back(d);
+        ranges.push_back(r);
+    }
+    opts.inlierThreshold = 1e-6;
+    // A degenerate set (coincident domain points) doesn't fail the rest of the batch:
+    size_t              badIdx = numSets / 2;
+    domains[badIdx] = Vec3Ds(20,Vec3D(1,2,3));
+    Svec<Opt<RobustSimilarity> >    batch1 = similarityRobustBatch(domains,ranges,opts,{},1),
+                                    batch4 = similarityRobustBatch(domains,ranges,opts,{},4);
+    Svec<Opt<SimilarityD> >         approx = similarityApproxBatch(domains,ranges);
+    FGASSERT(!batch1[badIdx].valid() && !batch4[badIdx].valid() && !approx[badIdx].valid());
+    for (size_t ss=0; ss<numSets; ++ss) {
+        if (ss == badIdx)
+            continue;
+        RobustSimilarity        single = similarityRobust(domains[ss],ranges[ss],opts,{},ss);
+        FGASSERT(same(batch1[ss].val().xform,single.xform));
+        FGASSERT(same(batch4[ss].val().xform,single.xform));
+        FGASSERT(batch1[ss].val().numInliers == 19);
+        FGASSERT(same(approx[ss].val(),similarityApprox(domains[ss],ranges[ss],Doubles())));
+    }
+}
+
 std::ostream &
 operator<<(std::ostream & os,SimilarityRD const & v)
 {
@@ -14,6 +14,7 @@
 
 #include "FgQuaternion.hpp"
 #include "FgAffineC.hpp"
+#include "FgOpt.hpp"
 #include "FgStdStream.hpp"
 
 namespace Fg {
@@ -81,6 +82,7 @@ struct  Similarity
 
 typedef Similarity<float>   SimilarityF;
 typedef Similarity<double>  SimilarityD;
+typedef Svec<SimilarityD>   SimilarityDs;
 
 template<typename T>
 Mat<T,4,4>
@@ -98,6 +100,74 @@ SimilarityD
 similarityApprox(Vec3Fs const & d,Vec3Fs const & r)
 {return similarityApprox(scast<double>(d),scast<double>(r)); }
 
+// Weighted least squares versions FROM the domain points TO the range points. 'weights' must be
+// non-negative and 1-1 with the points, or empty for uniform weights. At least 3 points (4 for affine)
+// must have non-zero weight. Unlike the above they do not output the residual:
+SimilarityD
+similarityApprox(Vec3Ds const & domainPts,Vec3Ds const & rangePts,Doubles const & weights);
+// Scale is fixed to 1:
+SimilarityD
+rigidApprox(Vec3Ds const & domainPts,Vec3Ds const & rangePts,Doubles const & weights=Doubles());
+// Throws if the weighted domain points are coplanar:
+Affine3D
+affineApprox(Vec3Ds const & domainPts,Vec3Ds const & rangePts,Doubles const & weights=Doubles());
+
+// Loss functions of the residual relative to the residual scale, applied by IRLS:
+enum struct RobustLoss
+{
+    squared,        // Ordinary least squares (no robustness)
+    huber,          // Quadratic then linear beyond the tuning constant (default 1.345)
+    cauchy,         // Log loss (default tuning constant 2.385)
+    tukey,          // Biweight, zero weight beyond the tuning constant (default 4.685)
+};
+
+struct  RobustOptions
+{
+    RobustLoss          loss = RobustLoss::huber;
+    double              tuning = 0;         // Tuning constant in units of residual scale. 0 for the loss default.
+    // Residual scale. 0 to estimate it at each iteration as 1.4826 * median absolute residual:
+    double              scale = 0;
+    uint                maxIters = 30;      // IRLS iterations
+    double              tolerance = 1e-9;   // Stop when the RMS change in transformed points is below this relative size
+    // RANSAC initialization. If 'ransacIters' is zero the initial estimate is the weighted least squares fit.
+    // Minimal samples are drawn from 'RandStream(ransacSeed,setIdx)' where 'setIdx' is the index in
+    // a batch (0 otherwise), so results do not depend on the number of threads:
+    uint                ransacIters = 0;
+    double              inlierThreshold = 0;    // Required for RANSAC. Residual distance below which a point is an inlier.
+    uint64              ransacSeed = 42;
+};
+
+template<class T>
+struct  RobustAlign
+{
+    T                   xform;
+    Doubles             weights;            // Final IRLS weight of each point including the input weight
+    double              residualScale = 0;
+    size_t              numInliers = 0;     // Points within 'inlierThreshold', or 2.5 residual scales if that is zero
+    uint                iterations = 0;     // IRLS iterations performed
+};
+typedef RobustAlign<SimilarityD>    RobustSimilarity;
+typedef RobustAlign<Affine3D>       RobustAffine;
+
+RobustSimilarity
+similarityRobust(Vec3Ds const & domainPts,Vec3Ds const & rangePts,RobustOptions const & options,Doubles const & weights=Doubles(),size_t setIdx=0);
+RobustSimilarity
+rigidRobust(Vec3Ds const & domainPts,Vec3Ds const & rangePts,RobustOptions const & options,Doubles const & weights=Doubles(),size_t setIdx=0);
+RobustAffine
+affineRobust(Vec3Ds const & domainPts,Vec3Ds const & rangePts,RobustOptions const & options,Doubles const & weights=Doubles(),size_t setIdx=0);
+
+// Align many sets concurrently (using at most 'maxThreads', 0 for all hardware threads). 'weights' can be
+// empty for uniform weights, otherwise 1-1 with the sets. Results are 1-1 with the sets and invalid
+// for any set which could not be aligned (eg. too few points with non-zero weight or degenerate points):
+Svec<Opt<SimilarityD> >
+similarityApproxBatch(Svec<Vec3Ds> const & domains,Svec<Vec3Ds> const & ranges,Svec<Doubles> const & weights=Svec<Doubles>(),size_t maxThreads=0);
+Svec<Opt<RobustSimilarity> >
+similarityRobustBatch(Svec<Vec3Ds> const & domains,Svec<Vec3Ds> const & ranges,RobustOptions const & options,Svec<Doubles> const & weights=Svec<Doubles>(),size_t maxThreads=0);
+Svec<Opt<RobustSimilarity> >
+rigidRobustBatch(Svec<Vec3Ds> const & domains,Svec<Vec3Ds> const & ranges,RobustOptions const & options,Svec<Doubles> const & weights=Svec<Doubles>(),size_t maxThreads=0);
+Svec<Opt<RobustAffine> >
+affineRobustBatch(Svec<Vec3Ds> const & domains,Svec<Vec3Ds> const & ranges,RobustOptions const & options,Svec<Doubles> const & weights=Svec<Doubles>(),size_t maxThreads=0);
+
 SimilarityD
 interpolateAsModelview(SimilarityD s0,SimilarityD s1,double val);  // val [0,1]
 
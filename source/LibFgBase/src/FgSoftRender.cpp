@@ -15,30 +15,31 @@
 #include "FgMath.hpp"
 #include "FgTestUtils.hpp"
 #include "Fg3dMeshIo.hpp"
+#include "FgMemory.hpp"
 #include "Fg3dCamera.hpp"
 #include "FgTime.hpp"
 #include "FgMain.hpp"
 #include "FgCommand.hpp"
 #include "FgImgDisplay.hpp"
+#include "FgParallel.hpp"
 
 using namespace std;
 using namespace std::placeholders;
 
 namespace Fg {
 
+static
 ImgC4UC
 renderSoft(
     Vec2UI                  pxSz,
     Meshes const &          meshes,
-    SimilarityD             modelview,
-    AffineEw2D              itcsToIucs,
+    RayCaster &             rc,
     RenderOptions const &   options)
 {
+    FG_PROFILE("renderSoft");
+    rc.texFilter = options.texFilter;
+    rc.pixelSizeIucs = Vec2F(1.0f/pxSz[0],1.0f/pxSz[1]);
     ImgC4UC             img;
-    VecF2               colorBounds = cBounds(options.backgroundColor.m_c.m);
-    FGASSERT((colorBounds[0] >= 0.0f) && (colorBounds[1] <= 255.0f));
-    RayCaster           rc(meshes,modelview,itcsToIucs,
-        options.lighting,options.backgroundColor,options.useMaps,options.allShiny);
     // The 'cref' for the 'rc' arg is critical; otherwise 'rc' gets copied on every call:
     img = sampleAdaptive(pxSz,bind(&RayCaster::cast,cref(rc),_1),options.antiAliasBitDepth);
 
@@ -96,6 +97,23 @@ renderSoft(
     return img;
 }
 
+ImgC4UC
+renderSoft(
+    Vec2UI                  pxSz,
+    Meshes const &          meshes,
+    SimilarityD             modelview,
+    AffineEw2D              itcsToIucs,
+    RenderOptions const &   options)
+{
+    MemTagScope         mts(MemTag::render);
+    VecF2               colorBounds = cBounds(options.backgroundColor.m_c.m);
+    FGASSERT((colorBounds[0] >= 0.0f) && (colorBounds[1] <= 255.0f));
+    bool                mipMaps = options.useMaps && (options.texFilter != TexFilter::bilinear);
+    RayCaster           rc(make_shared<RayCastScene>(meshes,mipMaps),modelview,itcsToIucs,
+        options.lighting,options.backgroundColor,options.useMaps,options.allShiny,options.cullBackFaces);
+    return renderSoft(pxSz,meshes,rc,options);
+}
+
 ImgC4UC
 renderSoft(Vec2UI pixelSize,Meshes const & meshes,RgbaF bgColor)
 {
@@ -106,9 +124,80 @@ renderSoft(Vec2UI pixelSize,Meshes const & meshes,RgbaF bgColor)
     return renderSoft(pixelSize,meshes,camera.modelview,camera.itcsToIucs,ro);
 }
 
+ImgC4UCs
+renderSoftBatch(
+    Meshes const &          meshes,
+    Svec<MorphVals> const & poses,
+    RenderViews const &     views)
+{
+    MemTagScope         mts(MemTag::render);
+    for (RenderView const & view : views) {
+        VecF2               colorBounds = cBounds(view.options.backgroundColor.m_c.m);
+        FGASSERT((colorBounds[0] >= 0.0f) && (colorBounds[1] <= 255.0f));
+        FGASSERT(view.poseIdx < cMax(poses.size(),size_t(1)));
+    }
+    // Camera-independent setup for each pose, shared by all views in that pose:
+    size_t              numPoses = cMax(poses.size(),size_t(1));
+    Svec<Sptr<RayCastScene const> > scenes(numPoses);
+    bool                mipMaps = false;
+    for (RenderView const & view : views)
+        if (view.options.useMaps && (view.options.texFilter != TexFilter::bilinear))
+            mipMaps = true;
+    parallelFor(numPoses,[&](size_t pp)
+    {
+        if (poses.empty())
+            scenes[pp] = make_shared<RayCastScene>(meshes,mipMaps);
+        else {
+            Vec3Fss             vertss;
+            vertss.reserve(meshes.size());
+            for (Mesh const & mesh : meshes)
+                vertss.push_back(poseMesh(mesh,poses[pp]));
+            scenes[pp] = make_shared<RayCastScene>(meshes,vertss,mipMaps);
+        }
+    });
+    ImgC4UCs            ret(views.size());
+    parallelFor(views.size(),[&](size_t vv)
+    {
+        RenderView const &  view = views[vv];
+        RenderOptions const & ro = view.options;
+        RayCaster           rc(scenes[view.poseIdx],view.xform.modelview,view.xform.itcsToIucs,
+            ro.lighting,ro.backgroundColor,ro.useMaps,ro.allShiny,ro.cullBackFaces);
+        ret[vv] = renderSoft(view.pixelSize,meshes,rc,ro);
+    });
+    return ret;
+}
+
+static void
+testRenderCulling()
+{
+    RenderOptions   ro;
+    AffineEw2D      itcsToIucs(Vec2D(0.5),Vec2D(0.5));
+    // Culling must not change any pixel of the render of a closed opaque mesh, whether seen whole or as
+    // a close-up crop:
+    Meshes          cube {c3dCube()};
+    SimilarityD     modelview = SimilarityD(Vec3D(0,0,-6)) * SimilarityD(cRotateX(0.4)*cRotateY(0.7));
+    for (AffineEw2D xf : {itcsToIucs,AffineEw2D(Vec2D(2),Vec2D(0.3,0.6))}) {
+        ro.cullBackFaces = false;
+        ImgC4UC         all = renderSoft(Vec2UI(64),cube,modelview,xf,ro);
+        FGASSERT(all.xy(32,32).alpha() == 255);
+        ro.cullBackFaces = true;
+        FGASSERT(all == renderSoft(Vec2UI(64),cube,modelview,xf,ro));
+    }
+    ro.cullBackFaces = false;
+    // A floor extending behind the camera must be clipped rather than discarded:
+    Meshes          floor(1);
+    floor[0].verts = {{-5,-1,1}, {5,-1,1}, {-5,-1,-9}, {5,-1,-9}};
+    floor[0].surfaces.resize(1);
+    floor[0].surfaces[0].tris.posInds = {{0,1,2}, {2,1,3}};
+    ImgC4UC         img = renderSoft(Vec2UI(64),floor,SimilarityD(),itcsToIucs,ro);
+    FGASSERT(img.xy(32,60).alpha() == 255);     // Floor close below the camera
+    FGASSERT(img.xy(32,4).alpha() == 0);        // Above the horizon
+}
+
 static void
 testSoftRender(CLArgs const &)
 {
+    testRenderCulling();
     PushDir         pd(dataDir()+"base/test/render/");
 
     // Set up structures required for rendering:
@@ -119,6 +208,13 @@ testSoftRender(CLArgs const &)
     SimilarityD     modelview;      // Default is identity
     AffineEw2D      itcsToIucs(Vec2D(0.5),Vec2D(0.5));
     RenderOptions   ro;
+    // Backface culling is only an optimization so must give identical renders of front facing tris:
+    auto            sameCulled = [&](ImgC4UC const & img)
+    {
+        RenderOptions   roc = ro;
+        roc.cullBackFaces = true;
+        FGASSERT(img == renderSoft(img.dims(),meshes,modelview,itcsToIucs,roc));
+    };
 
     // Model a single triangle of equal width and height intersected by the optical axis in OECS at the barycentric centre:
     mesh.verts = { {-1,1.5,-4}, {-1,-1.5,-4}, {2,0,-4} };
@@ -128,6 +224,7 @@ testSoftRender(CLArgs const &)
     ro.renderSurfPoints = RenderSurfPoints::whenVisible;
     ImgC4UC     img = renderSoft(Vec2UI(64),meshes,modelview,itcsToIucs,ro);
     regressTestApprox<ImgC4UC>(img,"t0.png",bind(fgImgApproxEqual,_1,_2,2U));
+    sameCulled(img);
     // Flip the winding to test the surface point is not visible from behind:
     surf.tris.posInds.back() = {1,0,2};
     img = renderSoft(Vec2UI(64),meshes,modelview,itcsToIucs,ro);
@@ -138,6 +235,7 @@ testSoftRender(CLArgs const &)
     surf.tris.posInds.push_back( {0,1,3} );
     img = renderSoft(Vec2UI(64),meshes,modelview,itcsToIucs,ro);
     regressTestApprox<ImgC4UC>(img,"t3.png",bind(fgImgApproxEqual,_1,_2,2U));
+    sameCulled(img);
 
 
     // Model 2 right angle triangles making a sqaure with a checkerboard color map (preserving aspect ratio):
@@ -154,16 +252,58 @@ testSoftRender(CLArgs const &)
     // View undistorted checkerboard flat on:
     img = renderSoft(Vec2UI(256),meshes,modelview,itcsToIucs,ro);
     regressTestApprox<ImgC4UC>(img,"t1.png",bind(fgImgApproxEqual,_1,_2,2U));
+    sameCulled(img);
     // View at an angle to see perspective distortion:
     modelview = SimilarityD(Vec3D(0,0,-4)) * SimilarityD(cRotateY(1.0)) * SimilarityD(Vec3D(0,0,4));
     img = renderSoft(Vec2UI(256),meshes,modelview,itcsToIucs,ro);
     regressTestApprox<ImgC4UC>(img,"t2.png",bind(fgImgApproxEqual,_1,_2,2U));
+    sameCulled(img);
+    // Batch rendering of the shared scene must match individual renders:
+    RenderViews     views {
+        RenderView(0,RenderXform(SimilarityD(),itcsToIucs),Vec2UI(256),ro),
+        RenderView(0,RenderXform(modelview,itcsToIucs),Vec2UI(256),ro),
+    };
+    ImgC4UCs        imgs = renderSoftBatch(meshes,{},views);
+    FGASSERT(imgs.size() == 2);
+    FGASSERT(fgImgApproxEqual(imgs[0],renderSoft(Vec2UI(256),meshes,SimilarityD(),itcsToIucs,ro),1));
+    FGASSERT(fgImgApproxEqual(imgs[1],img,1));
 }
 
 Cmd
 testSoftRenderInfo()
 {return Cmd(testSoftRender,"rend","renderSoft function"); }
 
+void
+testmSoftRender(CLArgs const &)
+{
+    // Time camera setup and render for increasingly close-up crops of a large textured mesh:
+    Mesh            mesh = loadMeshMaps(dataDir()+"base/Jane");
+    for (Surf & surf : mesh.surfaces)
+        surf = surf.convertToTris();
+    mesh = subdivide(subdivide(mesh,false),false);
+    Meshes          meshes {mesh};
+    Vec2UI          pxSz(512);
+    Camera          camera = CameraParams{Mat32D(cBounds(meshes))}.camera(pxSz);
+    auto            scene = make_shared<RayCastScene const>(meshes,true);
+    RenderOptions   ro;
+    fgout << fgnl << "Tris: " << scene->numTris << fgpush;
+    for (double zoom : {1.0,4.0,16.0,64.0}) {
+        // Zoom about the image centre:
+        AffineEw2D      crop = AffineEw2D(Vec2D(zoom),Vec2D(0.5-0.5*zoom)) * camera.itcsToIucs;
+        for (bool cull : {false,true}) {
+            Timer           timer;
+            RayCaster       rc(scene,camera.modelview,crop,ro.lighting,ro.backgroundColor,true,false,cull);
+            uint64          setupMs = timer.readMs();
+            timer.start();
+            renderSoft(pxSz,meshes,rc,ro);
+            fgout << fgnl << "zoom " << zoom << (cull ? " culled" : "       ")
+                << " binned: " << rc.numBinned << " grid: " << rc.grid.grid.dims()
+                << " setup: " << setupMs << "ms render: " << timer.readMs() << "ms";
+        }
+    }
+    fgout << fgpop;
+}
+
 }
 
 // */
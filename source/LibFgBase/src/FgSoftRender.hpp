@@ -15,6 +15,7 @@
 #include "FgImage.hpp"
 #include "FgSimilarity.hpp"
 #include "Fg3dCamera.hpp"
+#include "Fg3dMeshOps.hpp"
 
 namespace Fg {
 
@@ -41,10 +42,32 @@ struct  RenderOptions
     Sptr<ProjectedSurfPoints> projSurfPoints;
     bool                useMaps = true;     // Turn off to see raw geometry
     bool                allShiny = false;
-
-    FG_SERIALIZE6(lighting,backgroundColor,antiAliasBitDepth,renderSurfPoints,useMaps,allShiny);
+    // Mip-mapped filters reduce aliasing of maps which are minified in the render but are slower
+    // and change the output, so must be selected explicitly:
+    TexFilter           texFilter = TexFilter::bilinear;
+    // Faster, but only use when backfaces can never be seen (eg. closed opaque meshes):
+    bool                cullBackFaces = false;
+
+    // 'texFilter' and 'cullBackFaces' were added in class version 1. Archives from before then
+    // (version 0) still load, leaving those members at their defaults:
+    template<class Archive>
+    void
+    serialize(Archive & ar,unsigned int version)
+    {
+        ar & BOOST_SERIALIZATION_NVP(lighting) & BOOST_SERIALIZATION_NVP(backgroundColor)
+            & BOOST_SERIALIZATION_NVP(antiAliasBitDepth) & BOOST_SERIALIZATION_NVP(renderSurfPoints)
+            & BOOST_SERIALIZATION_NVP(useMaps) & BOOST_SERIALIZATION_NVP(allShiny);
+        if (version > 0)
+            ar & BOOST_SERIALIZATION_NVP(texFilter) & BOOST_SERIALIZATION_NVP(cullBackFaces);
+    }
 };
 
+}
+
+BOOST_CLASS_VERSION(Fg::RenderOptions,1)
+
+namespace Fg {
+
 struct  RenderXform
 {
     SimilarityD            modelview;
@@ -89,6 +112,30 @@ renderSoft(
     Meshes const &          meshes,
     RgbaF                   bgColor);
 
+// A single view for batch rendering:
+struct  RenderView
+{
+    size_t                  poseIdx;        // Index into the morph poses of the batch
+    RenderXform             xform;
+    Vec2UI                  pixelSize;
+    // Lighting etc. for this view. Set a separate 'projSurfPoints' for each view if required:
+    RenderOptions           options;
+
+    RenderView(size_t p,RenderXform const & x,Vec2UI ps,RenderOptions const & o)
+        : poseIdx(p), xform(x), pixelSize(ps), options(o) {}
+};
+typedef Svec<RenderView>    RenderViews;
+
+// Render multiple views of the same meshes in one or more morph poses. The camera-independent work
+// (posed vertices, normals, triangulation, maps) is done once for each pose and shared between views,
+// which are rendered concurrently. Returned images are 1-1 with 'views':
+ImgC4UCs
+renderSoftBatch(
+    Meshes const &          meshes,
+    // Morph poses. Morphs not in a mesh are ignored. If empty, the base shape is used for all views:
+    Svec<MorphVals> const & poses,
+    RenderViews const &     views);
+
 #endif
 
 }
@@ -7,6 +7,9 @@
 #include "stdafx.h"
 #include "FgStdStream.hpp"
 #include "FgException.hpp"
+#include "FgCommand.hpp"
+#include "FgRandom.hpp"
+#include "FgParallel.hpp"
 
 using namespace std;
 
@@ -61,6 +64,105 @@ Ifstream::open(
 
 #endif
 
+void
+OutBuffer::writeInt(int64 val)
+{
+    if (val < 0) {
+        m_data.push_back('-');
+        // Negate in unsigned to handle the minimum value:
+        writeUint(uint64(0) - uint64(val));
+    }
+    else
+        writeUint(uint64(val));
+}
+
+void
+OutBuffer::writeUint(uint64 val)
+{
+    char            str[24];
+    char *          end = str + sizeof(str),
+        *           ptr = end;
+    do {
+        *(--ptr) = char('0' + val % 10);
+        val /= 10;
+    } while (val > 0);
+    write(ptr,size_t(end-ptr));
+}
+
+void
+OutBuffer::writeReal(double val,bool isFloat)
+{
+    char            str[40];
+    int             len;
+    if (precision > 0)
+        len = snprintf(str,sizeof(str),"%.*g",precision,val);
+    else {
+        // Fewer digits than these always read back identically if they are sufficient, since '%g'
+        // removes trailing zeros:
+        int             digits = isFloat ? 6 : 15,
+                        maxDigits = isFloat ? 9 : 17;
+        for (;;) {
+            len = snprintf(str,sizeof(str),"%.*g",digits,val);
+            if (digits == maxDigits)
+                break;
+            if (isFloat ? (strtof(str,nullptr) == float(val)) : (strtod(str,nullptr) == val))
+                break;
+            ++digits;
+        }
+    }
+    write(str,size_t(len));
+}
+
+void
+writeBlocks(OutBuffer & out,size_t num,function<void(size_t,OutBuffer &)> const & fn)
+{
+    size_t              numThreads = std::min(cNumHardwareThreads(),num);
+    if (numThreads < 2) {
+        for (size_t ii=0; ii<num; ++ii)
+            fn(ii,out);
+        return;
+    }
+    // Limit memory use by only holding a few blocks per thread at a time:
+    size_t              batchSize = numThreads * 4;
+    for (size_t begin=0; begin<num; begin+=batchSize) {
+        size_t              end = std::min(begin+batchSize,num);
+        Svec<OutBuffer>     bufs(end-begin,OutBuffer{out.precision});
+        // Stops handing out blocks after the first exception, which is re-thrown here:
+        parallelFor(end-begin,[&](size_t ii){fn(begin+ii,bufs[ii]); },numThreads);
+        for (OutBuffer const & buf : bufs)
+            out.write(buf.str().data(),buf.str().size());
+    }
+}
+
+BufferedOfstream::BufferedOfstream(Ustring const & fname,size_t chunkSize) :
+    m_fname(fname), m_ofs(fname)
+{
+    m_flushSize = std::max(chunkSize,size_t(64));
+    m_data.reserve(m_flushSize + 1024);
+}
+
+BufferedOfstream::~BufferedOfstream()
+{
+    if (m_ofs.is_open())
+        m_ofs.write(m_data.data(),m_data.size());
+}
+
+void
+BufferedOfstream::flush()
+{
+    m_ofs.write(m_data.data(),m_data.size());
+    m_data.clear();
+}
+
+void
+BufferedOfstream::close()
+{
+    flush();
+    m_ofs.close();
+    if (m_ofs.fail())
+        fgThrow("Error writing to file",m_fname);
+}
+
 void
 fgWriteFile(Ustring const & fname,const std::string & data,bool appendFile)
 {
@@ -68,6 +170,66 @@ fgWriteFile(Ustring const & fname,const std::string & data,bool appendFile)
     ofs << data;
 }
 
+void
+testOutBuffer(CLArgs const &)
+{
+    randSeedRepeatable();
+    Svec<double>        vals {0.0,-0.0,1.0,-1.0,0.5,0.1,1.0e-30,3.0e38,123456789.0,1.0/3.0};
+    for (size_t ii=0; ii<1000; ++ii)
+        vals.push_back(randNormal() * std::pow(10.0,randUniform(-20.0,20.0)));
+    // Fixed precision must match std::ostream:
+    for (int prec : {6,7}) {
+        OutBuffer           buf {prec};
+        ostringstream       oss;
+        oss.precision(prec);
+        for (double val : vals) {
+            buf << float(val) << ' ' << val << ' ';
+            oss << float(val) << ' ' << val << ' ';
+        }
+        buf << int64(-1234567890123LL) << ' ' << uint64(18446744073709551615ULL) << ' ' << int32(0) << ' ' << -7;
+        oss << int64(-1234567890123LL) << ' ' << uint64(18446744073709551615ULL) << ' ' << int32(0) << ' ' << -7;
+        FGASSERT(buf.str() == oss.str());
+    }
+    // Shortest round trip must read back identically:
+    for (double val : vals) {
+        OutBuffer           bf {0},
+                            bd {0};
+        bf << float(val);
+        bd << val;
+        FGASSERT(strtof(bf.str().c_str(),nullptr) == float(val));
+        FGASSERT(strtod(bd.str().c_str(),nullptr) == val);
+        FGASSERT(bf.str().size() <= 15);
+    }
+    // Concurrent blocks must be written in order:
+    auto                block = [&](size_t ii,OutBuffer & out)
+    {
+        out << "block " << ii << ':';
+        for (size_t jj=0; jj<1000; ++jj)
+            out << ' ' << vals[(ii*1000+jj) % vals.size()];
+        out << '\n';
+    };
+    OutBuffer           serial,
+                        parallel;
+    for (size_t ii=0; ii<200; ++ii)
+        block(ii,serial);
+    writeBlocks(parallel,200,block);
+    FGASSERT(parallel.str() == serial.str());
+    // An exception stops any further blocks being formatted:
+    atomic<size_t>      calls {0};
+    bool                threw = false;
+    try {
+        writeBlocks(parallel,1000,[&](size_t ii,OutBuffer &)
+        {
+            ++calls;
+            if (ii == 5)
+                fgThrow("test");
+        });
+    }
+    catch (FgException const &) {threw = true; }
+    FGASSERT(threw);
+    FGASSERT(calls < 1000);
+}
+
 }
 
 // */
@@ -47,6 +47,146 @@ struct  Ofstream : public std::ofstream
     {write(reinterpret_cast<const char*>(&val),sizeof(val)); }
 };
 
+// Fast binary and text formatting to memory, avoiding the per-value overhead of std::ostream.
+// Unlike std::ostream, (u)char values other than 'char' are output as numbers.
+// Assumes little-endian native for binary output.
+struct  OutBuffer
+{
+    // Significant digits for floating point text, formatted as with the std::ostream default ('%g').
+    // Zero selects the shortest text which reads back to the identical value:
+    int                 precision = 6;
+
+    OutBuffer() {}
+    explicit OutBuffer(int prec) : precision(prec) {}
+    virtual ~OutBuffer() {}
+
+    void
+    write(char const * data,size_t size)
+    {
+        m_data.append(data,size);
+        if (m_data.size() >= m_flushSize)
+            overflow();
+    }
+
+    template<class T>
+    void
+    writeb(T const & val)       // Only use for builtins and Mat of builtins
+    {write(reinterpret_cast<char const *>(&val),sizeof(val)); }
+
+    OutBuffer &
+    operator<<(char c)
+    {
+        m_data.push_back(c);
+        if (m_data.size() >= m_flushSize)
+            overflow();
+        return *this;
+    }
+
+    OutBuffer &
+    operator<<(char const * str)
+    {
+        write(str,strlen(str));
+        return *this;
+    }
+
+    OutBuffer &
+    operator<<(String const & str)
+    {
+        write(str.data(),str.size());
+        return *this;
+    }
+
+    OutBuffer &
+    operator<<(Ustring const & str)
+    {return operator<<(str.m_str); }
+
+    template<class T,FG_ENABLE_IF(T,is_integral)>
+    OutBuffer &
+    operator<<(T val)
+    {
+        if (std::is_signed<T>::value)
+            writeInt(static_cast<int64>(val));
+        else
+            writeUint(static_cast<uint64>(val));
+        return *this;
+    }
+
+    OutBuffer &
+    operator<<(float val)
+    {
+        writeReal(val,true);
+        return *this;
+    }
+
+    OutBuffer &
+    operator<<(double val)
+    {
+        writeReal(val,false);
+        return *this;
+    }
+
+    String const &
+    str() const
+    {return m_data; }
+
+    void
+    clear()
+    {m_data.clear(); }
+
+protected:
+    String              m_data;
+    size_t              m_flushSize = std::numeric_limits<size_t>::max();
+
+    // Called when the data reaches 'm_flushSize':
+    virtual void
+    overflow()
+    {}
+
+private:
+    void
+    writeInt(int64 val);
+
+    void
+    writeUint(uint64 val);
+
+    void
+    writeReal(double val,bool isFloat);
+};
+
+// Formats 'num' independent blocks of output concurrently, each by calling 'fn(index,buffer)' on a
+// separate buffer with the precision of 'out', then writes them to 'out' in index order:
+void
+writeBlocks(OutBuffer & out,size_t num,std::function<void(size_t,OutBuffer &)> const & fn);
+
+// Buffered file output. Data is written to the file in chunks of roughly 'chunkSize' bytes:
+struct  BufferedOfstream : OutBuffer
+{
+    explicit
+    BufferedOfstream(Ustring const & fname,size_t chunkSize=size_t(1) << 22);
+    // Flushes, ignoring any error. Call 'close' to have errors thrown:
+    virtual ~BufferedOfstream();
+
+    BufferedOfstream(BufferedOfstream const &) = delete;
+    void operator=(BufferedOfstream const &) = delete;
+
+    // Writes the buffer contents to the file:
+    void
+    flush();
+
+    // Flushes and closes the file, throwing if any write failed:
+    void
+    close();
+
+protected:
+    virtual void
+    overflow()
+    {flush(); }
+
+private:
+    Ustring             m_fname;
+    Ofstream            m_ofs;
+};
+
 // 32/64 portable file format interface (boost::serialization tends to be incompatible with past versions).
 // Just casts size_t to 32 bit and assumes little-endian native and IEEE floats:
 
@@ -25,6 +25,9 @@ Ustring     getDefaultGpuDescription();
 
 Ustring    fgComputerName();
 
+// Peak resident (working set) memory of this process in bytes:
+uint64      processPeakMemory();
+
 }
 
 #endif
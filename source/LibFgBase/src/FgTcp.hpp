@@ -10,6 +10,8 @@
 
 #include "FgStdString.hpp"
 #include "FgTypes.hpp"
+#include "FgStdPtr.hpp"
+#include "FgStdFunction.hpp"
 
 namespace Fg {
 
@@ -50,6 +52,81 @@ fgTcpServer(
     FgFuncTcpHandler    handler,
     size_t              maxRecvBytes);  // Maximum number of bytes to receive in incomimg message
 
+#ifdef __linux__
+
+// Concurrent server for many clients with persistent connections. Each message in either direction
+// is framed as a little-endian uint64 byte count followed by the data. Every message received is
+// answered by exactly one response frame (empty if the handler doesn't set one), and a connection
+// can send any number of messages, one at a time. Connections are multiplexed on a single event
+// thread (epoll) and messages are passed to a pool of handler threads so a slow handler only delays
+// its own client. Linux (including Android) only.
+struct  TcpServerOptions
+{
+    uint16          port = 0;                   // 0 uses any free port (see 'TcpServer::port')
+    size_t          numThreads = 0;             // Handler threads. 0 = number of hardware threads
+    size_t          maxMsgBytes = size_t(1) << 26;  // Connection closed on receiving a larger frame
+    uint            idleTimeoutMs = 60000;      // Connection closed if no message starts within this time
+    uint            ioTimeoutMs = 5000;         // Connection closed if a partial frame stalls this long
+    // Backpressure: when this many messages are waiting for or running in a handler, no more are
+    // read from the sockets (so clients block in TCP flow control rather than using server memory):
+    size_t          maxQueued = 1024;
+    size_t          maxConnections = 4096;      // New connections are not accepted beyond this
+};
+
+struct  TcpServerState;
+
+struct  TcpServer
+{
+    // Binds and listens so clients can connect as soon as this returns. Throws on failure:
+    TcpServer(TcpServerOptions const & options,FgFuncTcpHandler const & handler);
+    // Must not be called while 'run' is executing:
+    ~TcpServer();
+    TcpServer(TcpServer const &) = delete;
+    void operator=(TcpServer const &) = delete;
+
+    // The port actually bound:
+    uint16          port() const;
+    // Peak total memory allocated for receiving messages. Grows with the data actually received
+    // rather than the sizes claimed in frame headers. Thread-safe:
+    size_t          inputBytesPeak() const;
+    // Serves until a handler returns false or 'stop' is called. Messages already passed to handlers
+    // are completed and responded to, other connections are closed. Can only be called once.
+    // Handler exceptions result in an empty response and the server continues:
+    void            run();
+    // Thread-safe:
+    void            stop();
+
+private:
+    Sptr<TcpServerState>    m_state;
+};
+
+// Convenience function for the above:
+void
+fgTcpServerConcurrent(TcpServerOptions const & options,FgFuncTcpHandler const & handler);
+
+// Persistent connection to a 'TcpServer':
+struct  TcpConnection
+{
+    TcpConnection() {}
+    ~TcpConnection() {close(); }
+    TcpConnection(TcpConnection const &) = delete;
+    void operator=(TcpConnection const &) = delete;
+
+    // Returns false if unable to connect. 'timeoutMs' applies to each send and receive, so must
+    // be longer than the handler takes:
+    bool            connect(String const & hostname,uint16 port,uint timeoutMs=30000);
+    bool            connected() const {return (m_sock >= 0); }
+    // Sends the message and waits for the response. On failure (eg. the server closed the connection
+    // after a timeout or due to the message size) the connection is closed and false returned:
+    bool            request(String const & msg,String & response);
+    void            close();
+
+private:
+    int             m_sock = -1;
+};
+
+#endif
+
 }
 
 #endif
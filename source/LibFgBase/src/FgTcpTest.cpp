@@ -10,6 +10,14 @@
 #include "FgTcp.hpp"
 #include "FgNc.hpp"
 #include "FgMain.hpp"
+#include "FgCommand.hpp"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -48,4 +56,200 @@ fgTcpClientTest(CLArgs const &)
     fgTcpClient("peano",getNcServerPort(),message);
 }
 
+#ifdef __linux__
+
+namespace {
+
+String
+reversed(String const & str)
+{return String(str.rbegin(),str.rend()); }
+
+// Raw loopback socket for sending partial frames:
+int
+rawConnect(uint16 port)
+{
+    int                 fd = socket(AF_INET,SOCK_STREAM,0);
+    FGASSERT(fd >= 0);
+    sockaddr_in         addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    FGASSERT(connect(fd,(sockaddr*)&addr,sizeof(addr)) == 0);
+    return fd;
+}
+
+}
+
+void
+testTcpServer(CLArgs const &)
+{
+    std::atomic<size_t>     numHandled {0};
+    // The slow handler blocks until the main thread has completed its fast requests, so these can
+    // only complete if the slow handler doesn't hold up other clients:
+    std::atomic<bool>       slowStarted {false};
+    std::promise<void>      fastDone;
+    std::shared_future<void> fastDoneFut = fastDone.get_future().share();
+    FgFuncTcpHandler        handler = [&](String const &,String const & msg,String & response) -> bool
+    {
+        ++numHandled;
+        if (msg == "slow") {
+            slowStarted = true;
+            if (fastDoneFut.wait_for(std::chrono::seconds(10)) != std::future_status::ready) {
+                response = "blocked";
+                return true;
+            }
+        }
+        if (msg == "throw")
+            fgThrow("Test handler exception");
+        response = reversed(msg);
+        return (msg != "quit");
+    };
+    TcpServerOptions        opts;
+    opts.numThreads = 4;
+    opts.maxMsgBytes = 1 << 20;
+    opts.idleTimeoutMs = 500;
+    TcpServer               server(opts,handler);
+    uint16                  port = server.port();
+    std::thread             serverThread(&TcpServer::run,&server);
+    // Many concurrent clients each sending many messages of various sizes over one connection:
+    {
+        size_t                  numClients = 64,
+                                numMsgs = 20;
+        std::atomic<size_t>     numOk {0};
+        Svec<std::thread>       clients;
+        for (size_t cc=0; cc<numClients; ++cc) {
+            clients.emplace_back([&,cc]()
+            {
+                TcpConnection           conn;
+                if (!conn.connect("127.0.0.1",port))
+                    return;
+                for (size_t mm=0; mm<numMsgs; ++mm) {
+                    size_t                  sz = ((cc*numMsgs + mm) * 7919) % 100000;
+                    if (mm == 0)
+                        sz = 0;
+                    String                  msg(sz,'\0'),
+                                            resp;
+                    for (size_t ii=0; ii<sz; ++ii)
+                        msg[ii] = char((ii*31 + cc) % 251);
+                    if (!conn.request(msg,resp) || (resp != reversed(msg)))
+                        return;
+                }
+                ++numOk;
+            });
+        }
+        for (std::thread & client : clients)
+            client.join();
+        FGASSERT(numOk == numClients);
+    }
+    // A slow handler does not delay other clients:
+    {
+        String                  slowResp;
+        bool                    slowOk = false;
+        std::thread             slowClient([&]()
+        {
+            TcpConnection           conn;
+            slowOk = conn.connect("127.0.0.1",port) && conn.request("slow",slowResp);
+        });
+        while (!slowStarted)
+            std::this_thread::yield();
+        TcpConnection           conn;
+        FGASSERT(conn.connect("127.0.0.1",port));
+        for (uint ii=0; ii<10; ++ii) {
+            String                  resp;
+            FGASSERT(conn.request("fast",resp));
+            FGASSERT(resp == "tsaf");
+        }
+        fastDone.set_value();
+        slowClient.join();
+        FGASSERT(slowOk && (slowResp == "wols"));
+    }
+    // Handler exceptions give an empty response and the connection remains usable:
+    {
+        TcpConnection           conn;
+        String                  resp;
+        FGASSERT(conn.connect("127.0.0.1",port));
+        FGASSERT(conn.request("throw",resp));
+        FGASSERT(resp.empty());
+        FGASSERT(conn.request("abc",resp));
+        FGASSERT(resp == "cba");
+    }
+    // Oversize messages and idle connections are closed:
+    {
+        TcpConnection           conn;
+        String                  resp;
+        FGASSERT(conn.connect("127.0.0.1",port));
+        FGASSERT(!conn.request(String(opts.maxMsgBytes+1,'x'),resp));
+        FGASSERT(!conn.connected());
+        FGASSERT(conn.connect("127.0.0.1",port));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        FGASSERT(!conn.request("late",resp));
+    }
+    // A handler returning false stops the server after responding:
+    {
+        TcpConnection           conn;
+        String                  resp;
+        FGASSERT(conn.connect("127.0.0.1",port));
+        FGASSERT(conn.request("quit",resp));
+        FGASSERT(resp == "tiuq");
+        serverThread.join();
+    }
+    // Backpressure with a single handler thread and queue of one still serves every client:
+    {
+        TcpServerOptions        bpOpts;
+        bpOpts.numThreads = 1;
+        bpOpts.maxQueued = 1;
+        TcpServer               bpServer(bpOpts,handler);
+        std::thread             bpThread(&TcpServer::run,&bpServer);
+        std::atomic<size_t>     numOk {0};
+        Svec<std::thread>       clients;
+        for (size_t cc=0; cc<16; ++cc) {
+            clients.emplace_back([&]()
+            {
+                TcpConnection           conn;
+                String                  resp;
+                if (conn.connect("127.0.0.1",bpServer.port()) && conn.request("xyz",resp) && (resp == "zyx"))
+                    ++numOk;
+            });
+        }
+        for (std::thread & client : clients)
+            client.join();
+        FGASSERT(numOk == 16);
+        bpServer.stop();
+        bpThread.join();
+    }
+    // Many connections which send only a header claiming a large message don't cause the server
+    // to allocate for the claimed size:
+    {
+        TcpServerOptions        hdrOpts;
+        hdrOpts.numThreads = 1;
+        hdrOpts.maxMsgBytes = size_t(1) << 24;
+        TcpServer               hdrServer(hdrOpts,handler);
+        std::thread             hdrThread(&TcpServer::run,&hdrServer);
+        String                  hdr(8,'\0');
+        for (uint ii=0; ii<8; ++ii)
+            hdr[ii] = char((hdrOpts.maxMsgBytes >> (8*ii)) & 0xFF);
+        Svec<int>               fds;
+        for (size_t cc=0; cc<32; ++cc) {
+            int                     fd = rawConnect(hdrServer.port());
+            FGASSERT(write(fd,hdr.data(),hdr.size()) == ssize_t(hdr.size()));
+            fds.push_back(fd);
+        }
+        // Connections are accepted in order and the event thread reads every ready socket before
+        // sending responses, so once this has been answered the headers above have been read:
+        TcpConnection           conn;
+        String                  resp;
+        FGASSERT(conn.connect("127.0.0.1",hdrServer.port()));
+        FGASSERT(conn.request("abc",resp));
+        size_t                  peak = hdrServer.inputBytesPeak();
+        for (int fd : fds)
+            close(fd);
+        hdrServer.stop();
+        hdrThread.join();
+        FGASSERT(resp == "cba");
+        FGASSERT(peak < (size_t(1) << 20));
+    }
+}
+
+#endif
+
 }
@@ -79,12 +79,21 @@ cYearString()
     return oss.str();
 }
 
+uint64
+getTimeNs()
+{
+    return uint64(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+}
+
 String
-msToPrettyTime(uint64 durationInMilliseconds)
+msToPrettyTime(double durationInMilliseconds)
 {
     double          d = durationInMilliseconds;
+    if (d < 1.0)
+        return toStrPrecision(d*1000.0,4) + " us";
     if (d < 1000.0)
-        return toStr(d) + " ms";
+        return toStrPrecision(d,4) + " ms";
     d /= 1000.0;
     if (d < 60.0)
         return toStrPrecision(d,4) + " s";
@@ -11,6 +11,7 @@
 #include "FgStdString.hpp"
 #include "FgTypes.hpp"
 #include "FgOut.hpp"
+#include "FgProfile.hpp"
 
 namespace Fg {
 
@@ -22,6 +23,11 @@ sleepSeconds(uint seconds);
 uint64
 getTimeMs();
 
+// Nanoseconds from an arbitrary start point, unaffected by changes to the system clock.
+// Use for measuring durations:
+uint64
+getTimeNs();
+
 // GMT date and time string in format: yyyy.mm.dd hh:mm:ss
 String
 getDateTimeString();
@@ -40,32 +46,33 @@ getDateTimeFilename();
 String
 cYearString();
 
-// Show the time in appropriate units (milliseconds, seconds, minutes, hours, days):
+// Show the time in appropriate units (microseconds, milliseconds, seconds, minutes, hours, days):
 String
-msToPrettyTime(uint64 durationInMilliseconds);
+msToPrettyTime(double durationInMilliseconds);
 
 struct  Timer
 {
-    uint64      m_startTime;
+    uint64      m_startTime;    // Nanoseconds (see 'getTimeNs')
 
     Timer()
     {start(); }
 
     void
     start()
-    {m_startTime = getTimeMs(); }
+    {m_startTime = getTimeNs(); }
 
     // Returns the time since 'start()' (or object construction) in seconds.
     double
     read() const
-    {
-        uint64  stopTime = getTimeMs();
-        return (double(stopTime - m_startTime) / 1000.0);
-    }
+    {return double(getTimeNs() - m_startTime) / 1.0e9; }
 
     uint64
     readMs() const
-    {return getTimeMs()-m_startTime; }
+    {return (getTimeNs()-m_startTime) / 1000000; }
+
+    uint64
+    readNs() const
+    {return getTimeNs()-m_startTime; }
 
     // Outputs 'label' to 'fgout' newline along with pretty print of duration
     void
@@ -75,20 +82,22 @@ struct  Timer
 std::ostream &
 operator<<(std::ostream &,const Timer &);
 
+// Also records a profile zone (if profiling is enabled) named by 'msg':
 struct PushTimer
 {
+    ProfileZoneDyn  zone;
     uint64          startTime;
 
-    PushTimer(String const & msg)
+    PushTimer(String const & msg) : zone(msg)
     {
         fgout << fgnl << "Beginning " << msg << ":" << fgpush << fgnl;
-        startTime = getTimeMs();
+        startTime = getTimeNs();
     }
 
     ~PushTimer()
     {
-        uint64      t = getTimeMs() - startTime;
-        fgout << fgpop << fgnl << "Completed in " << msToPrettyTime(t);
+        uint64      t = getTimeNs() - startTime;
+        fgout << fgpop << fgnl << "Completed in " << msToPrettyTime(double(t) / 1.0e6);
     }
 };
 
@@ -11,6 +11,8 @@
 
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include "FgFileSystem.hpp"
 #include "FgException.hpp"
@@ -167,6 +169,36 @@ uint64
 getLastWriteTime(Ustring const & path)
 {return boost::filesystem::last_write_time(path.ns()); }
 
+MappedFile::MappedFile(Ustring const & fname)
+{
+    string          fn = fname.as_utf8_string();
+    int             fd = open(fn.c_str(),O_RDONLY);
+    if (fd < 0)
+        fgThrow("Unable to open file for reading",fname);
+    struct stat     st;
+    if (fstat(fd,&st) != 0) {
+        close(fd);
+        fgThrow("Unable to read file size",fname);
+    }
+    m_size = size_t(st.st_size);
+    if (m_size > 0) {
+        void *          ptr = mmap(nullptr,m_size,PROT_READ,MAP_PRIVATE,fd,0);
+        close(fd);      // The mapping remains valid
+        if (ptr == MAP_FAILED)
+            fgThrow("Unable to memory map file",fname);
+        madvise(ptr,m_size,MADV_SEQUENTIAL);
+        m_data = static_cast<uchar const *>(ptr);
+    }
+    else
+        close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr)
+        munmap(const_cast<uchar *>(m_data),m_size);
+}
+
 #if defined(__APPLE__)
 
 #include <CoreFoundation/CFBundle.h>
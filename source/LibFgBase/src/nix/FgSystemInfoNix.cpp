@@ -9,6 +9,8 @@
 #include "FgSystemInfo.hpp"
 #include "FgPlatform.hpp"
 
+#include <sys/resource.h>
+
 using namespace std;
 
 namespace Fg {
@@ -41,4 +43,17 @@ Ustring
 fgComputerName()
 {return Ustring("Unknown"); }
 
+uint64
+processPeakMemory()
+{
+    struct rusage       ru;
+    if (getrusage(RUSAGE_SELF,&ru) != 0)
+        return 0;
+#ifdef __APPLE__
+    return uint64(ru.ru_maxrss);            // Bytes
+#else
+    return uint64(ru.ru_maxrss) * 1024;     // Kilobytes
+#endif
+}
+
 }
@@ -24,12 +24,24 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <time.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#include <unordered_map>
+#include <deque>
+#include <condition_variable>
+#include <chrono>
 #include "FgTcp.hpp"
 #include "FgException.hpp"
 #include "FgDiagnostics.hpp"
 #include "FgStdString.hpp"
 #include "FgScopeGuard.hpp"
 #include "FgOut.hpp"
+#include "FgString.hpp"
+#include "FgParallel.hpp"
 
 // Do NOT use std namespace to avoid collision with posix 'bind'
 
@@ -244,6 +256,569 @@ fgTcpServer(
         close(listenSockFd);
 }
 
+#ifdef __linux__
+
+namespace {
+
+uint64
+steadyMs()
+{
+    return uint64(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void
+setNoDelay(int sockFd)
+{
+    // Messages are request / response so don't delay small frames waiting to coalesce them:
+    int                 yes = 1;
+    setsockopt(sockFd,IPPROTO_TCP,TCP_NODELAY,&yes,sizeof(yes));
+}
+
+String
+frameHeader(uint64 size)
+{
+    String              ret(8,'\0');
+    for (uint ii=0; ii<8; ++ii)
+        ret[ii] = char((size >> (8*ii)) & 0xFF);
+    return ret;
+}
+
+uint64
+frameSize(char const * hdr)
+{
+    uint64              ret = 0;
+    for (uint ii=0; ii<8; ++ii)
+        ret |= uint64(uchar(hdr[ii])) << (8*ii);
+    return ret;
+}
+
+// Connection state owned by the event thread:
+struct  TcpConn
+{
+    enum class State {reading, waiting, handling, writing};
+
+    int                 fd;
+    uint64              id;             // Distinguishes connections when the OS re-uses an fd
+    String              ip;
+    State               state = State::reading;
+    String              in;             // Received data not yet passed to a handler
+    String              out;            // Response frame being sent
+    size_t              outPos = 0;
+    uint64              lastMs;         // Time of the last progress
+};
+
+}
+
+struct  TcpServerState
+{
+    struct  Job
+    {
+        int                 fd;
+        uint64              connId;
+        String              ip;
+        String              msg;
+    };
+    struct  Done
+    {
+        int                 fd;
+        uint64              connId;
+        String              response;
+        bool                keepRunning;
+    };
+
+    TcpServerOptions    opts;
+    FgFuncTcpHandler    handler;
+    int                 listenFd = -1;
+    int                 epollFd = -1;
+    int                 wakeFd = -1;        // eventfd used by handler threads and 'stop'
+    uint16              port = 0;
+    bool                ran = false;
+    std::atomic<bool>   stopRequested {false};
+    std::atomic<size_t> inBytesPeak {0};    // Peak total capacity of connection input buffers
+    std::mutex          mtx;
+    std::condition_variable cv;
+    std::deque<Job>     jobs;               // Protected by 'mtx'
+    Svec<Done>          dones;              // "
+    bool                closing = false;    // "
+
+    ~TcpServerState()
+    {
+        if (listenFd >= 0)
+            close(listenFd);
+        if (epollFd >= 0)
+            close(epollFd);
+        if (wakeFd >= 0)
+            close(wakeFd);
+    }
+
+    void
+    wake()
+    {
+        uint64              one = 1;
+        ssize_t             ret = write(wakeFd,&one,8);
+        (void)ret;                          // Only fails if the counter is saturated, which still wakes
+    }
+
+    void
+    setEvents(int fd,uint32 events)
+    {
+        epoll_event         ev;
+        ev.events = events;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd,EPOLL_CTL_MOD,fd,&ev) != 0)
+            fgThrow("TcpServer epoll_ctl failed",strerror(errno));
+    }
+
+    void
+    handlerThread()
+    {
+        for (;;) {
+            Job                 job;
+            {
+                std::unique_lock<std::mutex>    lock(mtx);
+                cv.wait(lock,[this]{return (closing || !jobs.empty()); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            Done                done {job.fd,job.connId,String(),true};
+            try {
+                done.keepRunning = handler(job.ip,job.msg,done.response);
+            }
+            catch (...) {
+                done.response.clear();
+            }
+            {
+                std::lock_guard<std::mutex>     lock(mtx);
+                dones.push_back(std::move(done));
+            }
+            wake();
+        }
+    }
+};
+
+TcpServer::TcpServer(TcpServerOptions const & options,FgFuncTcpHandler const & handler) :
+    m_state(std::make_shared<TcpServerState>())
+{
+    TcpServerState &    s = *m_state;
+    s.opts = options;
+    s.handler = handler;
+    if (s.opts.numThreads == 0)
+        s.opts.numThreads = cNumHardwareThreads();
+    s.opts.maxQueued = std::max(s.opts.maxQueued,size_t(1));
+    s.opts.maxConnections = std::max(s.opts.maxConnections,size_t(1));
+    s.listenFd = socket(AF_INET,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+    if (s.listenFd < 0)
+        fgThrow("TcpServer unable to create socket",strerror(errno));
+    int                 yes = 1;
+    if (setsockopt(s.listenFd,SOL_SOCKET,SO_REUSEADDR,&yes,sizeof(yes)) == -1)
+        FGASSERT_FALSE;
+    sockaddr_in         addr;
+    std::memset(&addr,0,sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(options.port);
+    if (bind(s.listenFd,(sockaddr*)&addr,sizeof(addr)) != 0)
+        fgThrow("TcpServer unable to bind port",toStr(options.port),strerror(errno));
+    if (listen(s.listenFd,SOMAXCONN) != 0)
+        fgThrow("TcpServer unable to listen",strerror(errno));
+    socklen_t           len = sizeof(addr);
+    if (getsockname(s.listenFd,(sockaddr*)&addr,&len) != 0)
+        FGASSERT_FALSE;
+    s.port = ntohs(addr.sin_port);
+    s.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    s.wakeFd = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((s.epollFd < 0) || (s.wakeFd < 0))
+        fgThrow("TcpServer unable to create epoll / eventfd",strerror(errno));
+    for (int fd : {s.listenFd,s.wakeFd}) {
+        epoll_event         ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(s.epollFd,EPOLL_CTL_ADD,fd,&ev) != 0)
+            fgThrow("TcpServer epoll_ctl failed",strerror(errno));
+    }
+}
+
+TcpServer::~TcpServer()
+{}
+
+uint16
+TcpServer::port() const
+{return m_state->port; }
+
+size_t
+TcpServer::inputBytesPeak() const
+{return m_state->inBytesPeak; }
+
+void
+TcpServer::stop()
+{
+    m_state->stopRequested = true;
+    m_state->wake();
+}
+
+void
+TcpServer::run()
+{
+    TcpServerState &    s = *m_state;
+    FGASSERT(!s.ran);
+    s.ran = true;
+    TcpServerOptions const & opts = s.opts;
+    Svec<std::thread>   threads;
+    for (size_t ii=0; ii<opts.numThreads; ++ii)
+        threads.emplace_back(&TcpServerState::handlerThread,&s);
+    std::unordered_map<int,TcpConn> conns;
+    std::deque<int>     waiting;            // Connections with a complete message awaiting queue space
+    size_t              numOutstanding = 0; // Messages queued or in a handler
+    uint64              nextId = 1;
+    size_t              inBytes = 0;        // Total capacity of connection input buffers
+    bool                listening = true,
+                        acceptPaused = false,
+                        stopping = false;
+    auto                closeConn = [&](int fd)
+    {
+        auto                it = conns.find(fd);
+        if (it != conns.end())
+            inBytes -= it->second.in.capacity();
+        // Closing the fd also removes it from the epoll set:
+        close(fd);
+        conns.erase(fd);
+    };
+    // The input buffer only grows (geometrically) as data actually arrives, never on the size
+    // claimed by a frame header, so clients can't make the server allocate memory they don't send:
+    auto                appendIn = [&](TcpConn & c,char const * data,size_t size)
+    {
+        size_t              before = c.in.capacity();
+        c.in.append(data,size);
+        inBytes += c.in.capacity() - before;
+        if (inBytes > s.inBytesPeak)
+            s.inBytesPeak = inBytes;
+    };
+    // Takes a complete message from the input buffer if available. Returns false on a framing error:
+    auto                takeMsg = [&](TcpConn & c)
+    {
+        if (c.in.size() < 8)
+            return true;
+        uint64              sz = frameSize(c.in.data());
+        if (sz > opts.maxMsgBytes)
+            return false;
+        if (c.in.size() - 8 < sz)
+            return true;
+        c.state = TcpConn::State::waiting;
+        s.setEvents(c.fd,0);                // Don't read more from this client until responded
+        waiting.push_back(c.fd);
+        return true;
+    };
+    // Sends as much of the response as possible without blocking. Returns false on error:
+    auto                writeConn = [&](TcpConn & c,uint64 now)
+    {
+        while (c.outPos < c.out.size()) {
+            ssize_t             num = send(c.fd,c.out.data()+c.outPos,c.out.size()-c.outPos,MSG_NOSIGNAL);
+            if (num < 0) {
+                if (errno == EINTR)
+                    continue;
+                if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                    s.setEvents(c.fd,EPOLLOUT);
+                    return true;
+                }
+                return false;
+            }
+            c.outPos += size_t(num);
+            c.lastMs = now;
+        }
+        c.out.clear();
+        c.outPos = 0;
+        c.lastMs = now;
+        if (stopping)
+            return false;
+        c.state = TcpConn::State::reading;
+        s.setEvents(c.fd,EPOLLIN);
+        return takeMsg(c);                  // The client may have pipelined another message
+    };
+    // Reads until the socket is empty or a complete message is buffered. Returns false on
+    // error or if the client closed the connection:
+    auto                readConn = [&](TcpConn & c,uint64 now)
+    {
+        char                buff[0x10000];
+        for (;;) {
+            ssize_t             num = recv(c.fd,buff,sizeof(buff),0);
+            if (num == 0)
+                return false;
+            if (num < 0) {
+                if (errno == EINTR)
+                    continue;
+                return ((errno == EAGAIN) || (errno == EWOULDBLOCK));
+            }
+            appendIn(c,buff,size_t(num));
+            c.lastMs = now;
+            if (!takeMsg(c))
+                return false;
+            if (c.state != TcpConn::State::reading)
+                return true;
+        }
+    };
+    uint64              tickMs = std::min(opts.idleTimeoutMs,opts.ioTimeoutMs) / 4;
+    tickMs = std::max(std::min(tickMs,uint64(250)),uint64(10));
+    uint64              lastSweep = steadyMs();
+    epoll_event         events[64];
+    for (;;) {
+        int                 num = epoll_wait(s.epollFd,events,64,int(tickMs));
+        if (num < 0) {
+            if (errno != EINTR)
+                fgThrow("TcpServer epoll_wait failed",strerror(errno));
+            num = 0;
+        }
+        uint64              now = steadyMs();
+        for (int ee=0; ee<num; ++ee) {
+            int                 fd = events[ee].data.fd;
+            uint32              evs = events[ee].events;
+            if (fd == s.wakeFd) {
+                uint64              count;
+                ssize_t             ret = read(s.wakeFd,&count,8);
+                (void)ret;
+            }
+            else if (fd == s.listenFd) {
+                while (listening && (conns.size() < opts.maxConnections)) {
+                    sockaddr_in         addr;
+                    socklen_t           len = sizeof(addr);
+                    int                 connFd = accept4(s.listenFd,(sockaddr*)&addr,&len,SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (connFd < 0)
+                        break;                      // EAGAIN or a connection aborted before accept
+                    setNoDelay(connFd);
+                    char                ipBuff[INET_ADDRSTRLEN];
+                    inet_ntop(AF_INET,&addr.sin_addr,ipBuff,sizeof(ipBuff));
+                    TcpConn &           c = conns[connFd];
+                    c.fd = connFd;
+                    c.id = nextId++;
+                    c.ip = ipBuff;
+                    c.lastMs = now;
+                    epoll_event         ev;
+                    ev.events = EPOLLIN;
+                    ev.data.fd = connFd;
+                    if (epoll_ctl(s.epollFd,EPOLL_CTL_ADD,connFd,&ev) != 0)
+                        closeConn(connFd);
+                }
+            }
+            else {
+                auto                it = conns.find(fd);
+                if (it == conns.end())
+                    continue;
+                TcpConn &           c = it->second;
+                bool                ok = true;
+                if (c.state == TcpConn::State::reading)
+                    ok = readConn(c,now);
+                else if (c.state == TcpConn::State::writing)
+                    ok = writeConn(c,now);
+                else if (evs & (EPOLLHUP | EPOLLERR))
+                    ok = false;                 // Client gone while waiting for its handler
+                if (!ok)
+                    closeConn(fd);
+            }
+        }
+        // Send the responses from completed handlers:
+        Svec<TcpServerState::Done>  dones;
+        {
+            std::lock_guard<std::mutex>     lock(s.mtx);
+            dones.swap(s.dones);
+        }
+        for (TcpServerState::Done & done : dones) {
+            --numOutstanding;
+            if (!done.keepRunning)
+                s.stopRequested = true;
+            auto                it = conns.find(done.fd);
+            if ((it == conns.end()) || (it->second.id != done.connId))
+                continue;                   // Connection has since been closed
+            TcpConn &           c = it->second;
+            c.state = TcpConn::State::writing;
+            c.out = frameHeader(done.response.size());
+            c.out += done.response;
+            c.outPos = 0;
+            if (!writeConn(c,now))
+                closeConn(c.fd);
+        }
+        if (s.stopRequested && !stopping) {
+            stopping = true;
+            listening = false;
+            close(s.listenFd);
+            s.listenFd = -1;
+            waiting.clear();
+            Svec<int>           toClose;
+            for (auto const & it : conns)
+                if ((it.second.state == TcpConn::State::reading) || (it.second.state == TcpConn::State::waiting))
+                    toClose.push_back(it.first);
+            for (int fd : toClose)
+                closeConn(fd);
+        }
+        // Pass waiting messages to the handlers while within the backpressure limit:
+        if (!waiting.empty() && (numOutstanding < opts.maxQueued)) {
+            {
+                std::lock_guard<std::mutex>     lock(s.mtx);
+                while (!waiting.empty() && (numOutstanding < opts.maxQueued)) {
+                    int                 fd = waiting.front();
+                    waiting.pop_front();
+                    auto                it = conns.find(fd);
+                    if ((it == conns.end()) || (it->second.state != TcpConn::State::waiting))
+                        continue;
+                    TcpConn &           c = it->second;
+                    uint64              sz = frameSize(c.in.data());
+                    s.jobs.push_back({fd,c.id,c.ip,c.in.substr(8,size_t(sz))});
+                    c.in.erase(0,size_t(8+sz));
+                    if (c.in.empty() && (c.in.capacity() > 0x10000)) {
+                        inBytes -= c.in.capacity();     // Don't hold on to a large message buffer
+                        String().swap(c.in);
+                    }
+                    c.state = TcpConn::State::handling;
+                    ++numOutstanding;
+                }
+            }
+            s.cv.notify_all();
+        }
+        if (stopping && conns.empty())
+            break;
+        // Stop or resume accepting depending on the connection limit:
+        bool                full = (conns.size() >= opts.maxConnections);
+        if (listening && (full != acceptPaused)) {
+            s.setEvents(s.listenFd,full ? 0U : uint32(EPOLLIN));
+            acceptPaused = full;
+        }
+        // Timeouts:
+        if (now - lastSweep >= tickMs) {
+            lastSweep = now;
+            Svec<int>           toClose;
+            for (auto const & it : conns) {
+                TcpConn const &     c = it.second;
+                uint64              age = now - c.lastMs;
+                if (c.state == TcpConn::State::reading) {
+                    if (age > (c.in.empty() ? opts.idleTimeoutMs : opts.ioTimeoutMs))
+                        toClose.push_back(c.fd);
+                }
+                else if ((c.state == TcpConn::State::writing) && (age > opts.ioTimeoutMs))
+                    toClose.push_back(c.fd);
+            }
+            for (int fd : toClose)
+                closeConn(fd);
+        }
+    }
+    {
+        std::lock_guard<std::mutex>     lock(s.mtx);
+        s.closing = true;
+    }
+    s.cv.notify_all();
+    for (std::thread & thread : threads)
+        thread.join();
+}
+
+void
+fgTcpServerConcurrent(TcpServerOptions const & options,FgFuncTcpHandler const & handler)
+{
+    TcpServer           server(options,handler);
+    server.run();
+}
+
+namespace {
+
+bool
+sendAll(int sockFd,char const * data,size_t size,int flags)
+{
+    while (size > 0) {
+        ssize_t             num = send(sockFd,data,size,flags | MSG_NOSIGNAL);
+        if (num < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += num;
+        size -= size_t(num);
+    }
+    return true;
+}
+
+bool
+recvAll(int sockFd,char * data,size_t size)
+{
+    while (size > 0) {
+        ssize_t             num = recv(sockFd,data,size,0);
+        if (num < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (num == 0)
+            return false;
+        data += num;
+        size -= size_t(num);
+    }
+    return true;
+}
+
+}
+
+bool
+TcpConnection::connect(String const & hostname,uint16 port,uint timeoutMs)
+{
+    close();
+    addrinfo            hints;
+    std::memset(&hints,0,sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *          info = nullptr;
+    // Unlike 'gethostbyname', 'getaddrinfo' is thread-safe:
+    if (getaddrinfo(hostname.c_str(),toStr(port).c_str(),&hints,&info) != 0)
+        return false;
+    ScopeGuard          freeInfo(std::bind(freeaddrinfo,info));
+    int                 sockFd = socket(AF_INET,SOCK_STREAM | SOCK_CLOEXEC,IPPROTO_TCP);
+    if (sockFd < 0)
+        return false;
+    timeval             timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    // On Linux the send timeout also applies to 'connect':
+    if ((setsockopt(sockFd,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout)) != 0) ||
+        (setsockopt(sockFd,SOL_SOCKET,SO_SNDTIMEO,&timeout,sizeof(timeout)) != 0) ||
+        (::connect(sockFd,info->ai_addr,info->ai_addrlen) != 0)) {
+        ::close(sockFd);
+        return false;
+    }
+    setNoDelay(sockFd);
+    m_sock = sockFd;
+    return true;
+}
+
+bool
+TcpConnection::request(String const & msg,String & response)
+{
+    if (m_sock < 0)
+        return false;
+    String              hdr = frameHeader(msg.size());
+    char                respHdr[8];
+    // MSG_MORE avoids sending the header in a separate packet:
+    bool                ok =
+        sendAll(m_sock,hdr.data(),8,msg.empty() ? 0 : MSG_MORE) &&
+        sendAll(m_sock,msg.data(),msg.size(),0) &&
+        recvAll(m_sock,respHdr,8);
+    if (ok) {
+        uint64              sz = frameSize(respHdr);
+        response.resize(size_t(sz));
+        ok = (sz == 0) || recvAll(m_sock,&response[0],size_t(sz));
+    }
+    if (!ok)
+        close();
+    return ok;
+}
+
+void
+TcpConnection::close()
+{
+    if (m_sock >= 0) {
+        ::close(m_sock);
+        m_sock = -1;
+    }
+}
+
+#endif
+
 }
 
 // */
@@ -374,4 +374,45 @@ getLastWriteTime(Ustring const & fname)
     return time / 10000000;
 }
 
+MappedFile::MappedFile(Ustring const & fname)
+{
+    HANDLE          file =
+        CreateFile(
+            fname.as_wstring().c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            NULL,
+            OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN,
+            NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        throwWindows("Unable to open file for reading",fname);
+    LARGE_INTEGER   sz;
+    if (!GetFileSizeEx(file,&sz)) {
+        CloseHandle(file);
+        throwWindows("Unable to read file size",fname);
+    }
+    m_size = size_t(sz.QuadPart);
+    if (m_size == 0) {
+        CloseHandle(file);
+        return;
+    }
+    // The view remains valid after both handles are closed:
+    HANDLE          mapping = CreateFileMapping(file,NULL,PAGE_READONLY,0,0,NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        throwWindows("Unable to memory map file",fname);
+    void *          ptr = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+    CloseHandle(mapping);
+    if (ptr == NULL)
+        throwWindows("Unable to memory map file",fname);
+    m_data = static_cast<uchar const *>(ptr);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+}
+
 }
@@ -10,6 +10,8 @@
 #include "FgStdString.hpp"
 #include "FgString.hpp"
 
+#include <psapi.h>
+
 using namespace std;
 
 namespace Fg {
@@ -70,6 +72,15 @@ fgComputerName()
         return wstring(L"Unknown");
 }
 
+uint64
+processPeakMemory()
+{
+    PROCESS_MEMORY_COUNTERS     pmc;
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(),&pmc,sizeof(pmc)))
+        return 0;
+    return uint64(pmc.PeakWorkingSetSize);
+}
+
 }
 
 // */